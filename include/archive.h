@@ -0,0 +1,61 @@
+/**
+ * @file archive.h
+ * @author Selkamies
+ *
+ * @brief Moves the log rows of closed months from the database to one archive file per month,
+ * in small batches while nobody is using the keypad.
+ *
+ * @date Created  2024-01-12
+ * @date Modified 2024-01-12
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+
+
+// Forward declarations.
+struct ArchiveConfig;
+struct DatabaseConfig;
+struct ConfigData;
+
+
+
+/**
+ * @brief Sets the archive settings used if config.ini has no [ARCHIVE] section. Archiving is off by default.
+ *
+ * @param archiveConfig Struct holding all the variables needed by archive.c.
+ */
+void setArchiveDefaults(struct ArchiveConfig *archiveConfig);
+
+/**
+ * @brief Resets the archiving state. Called after config.ini has been read.
+ *
+ * @param archiveConfig Struct holding all the variables needed by archive.c.
+ */
+void initializeArchive(struct ArchiveConfig *archiveConfig);
+
+/**
+ * @brief Moves one batch of old log rows to their month's archive file, if enough time has passed
+ * since the last batch and nobody is entering a PIN. Checks for a new month to archive only once a minute.
+ *
+ * @param configData Struct holding data about basically all variables used by the program.
+ */
+void updateArchive(struct ConfigData *configData);
+
+/**
+ * @brief Detaches the archive file, if a month was being archived. Has to be called before cleanupDatabase().
+ * The rest of the month is moved after the next start.
+ *
+ * @param archiveConfig Struct holding all the variables needed by archive.c.
+ * @param databaseConfig Struct holding the database connection the archive file is attached to.
+ */
+void cleanupArchive(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig);
+
+
+
+#endif // ARCHIVE_H
@@ -0,0 +1,53 @@
+/**
+ * @file archive_config.h
+ * @author Selkamies
+ *
+ * @brief Defines ArchiveConfig struct, which holds basically all data used by archive.c.
+ *
+ * @date Created  2024-01-12
+ * @date Modified 2024-01-12
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef ARCHIVE_CONFIG_H
+#define ARCHIVE_CONFIG_H
+
+
+
+#include <stdbool.h>
+
+#include "database_config.h"    // struct LogMonth.
+
+
+
+/**
+ * @brief Struct holding all the variables needed by archive.c.
+ * The upper case members are read from the [ARCHIVE] section of config.ini.
+ */
+struct ArchiveConfig
+{
+    /** @brief Whether closed months are moved to archive files at all. */
+    bool ENABLED;
+    /** @brief How many of the latest months stay in the database, including the current one. */
+    int KEEP_MONTHS;
+    /** @brief Most log rows moved in one batch. */
+    int BATCH_SIZE;
+    /** @brief Minimum time between batches in seconds. */
+    double BATCH_INTERVAL_SECONDS;
+
+    /** @brief Whether a month's archive file is attached and being filled. */
+    bool archiving;
+    /** @brief The month being archived, if archiving. */
+    struct LogMonth month;
+    /** @brief Number of rows of the month moved so far. */
+    unsigned long archivedCount;
+    /** @brief Earliest time the next batch or check for a month to archive can run. */
+    double nextUpdateTime;
+};
+
+
+
+#endif // ARCHIVE_CONFIG_H
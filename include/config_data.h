@@ -6,7 +6,7 @@
  * ConfigData has substructs for separating the data used by keypad, leds and sounds.
  * 
  * @date Created 2023-12-05
- * @date Modified 2023-12-11
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
@@ -17,12 +17,17 @@
 #define CONFIG_DATA_H
 
 
-#include <sqlite3.h>             // sqlite3.
-
 // Cannot forward declare?
 #include "keypad_config.h"
 #include "leds_config.h"
 #include "sounds_config.h"
+#include "database_config.h"
+#include "log_writer_config.h"
+#include "archive_config.h"
+#include "journal_config.h"
+#include "maintenance_config.h"
+#include "spool_config.h"
+#include "gpio_config.h"
 
 
 
@@ -37,7 +42,20 @@ struct ConfigData
     struct LEDConfig LEDConfigData;
     /** @brief Struct holding all the variables needed by sounds.c. */
     struct SoundsConfig soundsConfig;
-    sqlite3 **database;
+    /** @brief Struct holding the database connection and the prepared statements used by database.c. */
+    struct DatabaseConfig databaseConfig;
+    /** @brief Struct holding the log writer thread, its queue and its own database connection. */
+    struct LogWriterConfig logWriterConfig;
+    /** @brief Struct holding the archive settings and the month being archived. */
+    struct ArchiveConfig archiveConfig;
+    /** @brief Struct holding the journal settings and the mapped segment. */
+    struct JournalConfig journalConfig;
+    /** @brief Struct holding the maintenance settings and when each task runs next. */
+    struct MaintenanceConfig maintenanceConfig;
+    /** @brief Struct holding the spool of clock events the database couldn't take, and its thread. */
+    struct SpoolConfig spoolConfig;
+    /** @brief Struct holding the GPIO backend settings. */
+    struct GPIOConfig gpioConfig;
 };
 
 
@@ -5,7 +5,7 @@
  * @brief Database operations.
  * 
  * @date Created  2023-12-08
- * @date Modified 2023-12-15
+ * @date Modified 2024-01-22
  * 
  * @copyright Copyright (c) 2023
  */
@@ -18,7 +18,17 @@
 
 
 #include <stdbool.h>
-#include <sqlite3.h>            // sqlite3.
+#include <stdint.h>             // int64_t.
+
+
+
+// Forward declarations.
+struct DatabaseConfig;
+struct DatabaseSettings;
+struct LogMonth;
+struct LogRow;
+struct UserRow;
+struct ExportCursor;
 
 
 
@@ -26,68 +36,585 @@
 #define DATABASE_PATH ""
 #define DATABASE_NAME "database.db"
 #define DATABASE_FILEPATH DATABASE_PATH DATABASE_NAME
+/** @brief Log rows of a closed month are moved to a file named with its year and month, like log_2024_01.db. */
+#define LOG_ARCHIVE_FILEPATH_FORMAT DATABASE_PATH "log_%04d_%02d.db"
 
 #define LOG_STATUS_ERROR 0
 #define LOG_STATUS_IN 1
 #define LOG_STATUS_OUT 2
 
+/**
+ * @brief Result of a clock event, used to choose the LED color and sound.
+ */
+enum ClockEventResult
+{
+    /** @brief The log row was saved, or queued to be saved. */
+    CLOCK_EVENT_ACCEPTED,
+    /** @brief No user has the PIN. */
+    CLOCK_EVENT_INVALID_PIN,
+    /** @brief The user is already IN or OUT, or is trying to clock OUT without ever clocking IN. */
+    CLOCK_EVENT_INVALID_STATUS,
+    /** @brief The database could not be read or written. */
+    CLOCK_EVENT_DATABASE_ERROR
+};
 
+/**
+ * @brief Outcome of a clock event.
+ */
+struct ClockEventOutcome
+{
+    /** @brief Whether the event was accepted, and if not, why. */
+    enum ClockEventResult result;
+    /** @brief User ID of the PIN, or -1 if the PIN was not found. */
+    int userID;
+    /** @brief Status of the user's latest log row before this event, or LOG_STATUS_ERROR if they had none. */
+    int previousStatus;
+    /** @brief ID of the inserted log row, or 0 if the event wasn't accepted. */
+    int64_t logID;
+};
+
+/**
+ * @brief What saveUserRow() did with a user.
+ */
+enum UserRowResult
+{
+    /** @brief A new user was added. */
+    USER_ROW_INSERTED,
+    /** @brief The names of the user with the same PIN were updated. */
+    USER_ROW_UPDATED,
+    /** @brief Another user already has the PIN, or the user already had the same names. Nothing was written. */
+    USER_ROW_SKIPPED
+};
+
+/**
+ * @brief Called now and then while a maintenance statement runs, see beginMaintenanceSlice().
+ * 
+ * @param data Pointer given to beginMaintenanceSlice().
+ * 
+ * @return true If the statement should stop right away.
+ * @return false If it can go on.
+ */
+typedef bool (*MaintenanceStopCheck)(void *data);
+
+/** @brief Profile used for the database settings if config.ini doesn't choose one. */
+#define DATABASE_DEFAULT_PROFILE "sd-card-safe"
+
+
+
+/**
+ * @brief Sets all the database settings from a built-in profile.
+ * "sd-card-safe": WAL journal and every commit flushed to disk. Nothing is lost on a power cut.
+ * "fast": WAL journal, flushed only at checkpoints. A power cut can lose the latest commits, but never corrupts the database.
+ * "ramdisk": For a database on a RAM disk. Nothing is flushed and the journal is kept in memory.
+ * 
+ * @param settings Struct holding the SQLite settings applied when a connection is opened.
+ * @param profileName Name of the profile.
+ * 
+ * @return true If the profile exists and was applied.
+ * @return false If there is no such profile. The settings are left unchanged.
+ */
+bool setDatabaseProfile(struct DatabaseSettings *settings, const char *profileName);
+
+/**
+ * @brief Sets the database settings for the command line tools. The same as DATABASE_DEFAULT_PROFILE,
+ * except that the journal mode is left as it is. The device chooses the journal mode in config.ini,
+ * and WAL is stored in the database file, so a tool setting it would change it for the device too.
+ * 
+ * @param settings Struct holding the SQLite settings applied when a connection is opened.
+ */
+void setDatabaseToolSettings(struct DatabaseSettings *settings);
 
 /**
  * @brief Checks if the database exists, and if not, creates a new one with tables.
+ * Prepares the statements used on every clock event, so they are only parsed once.
  * 
- * @param database SQLite database we're using.
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * databaseConfig->settings has to be set before calling this.
  * @param filePath Path with the database file name, relative to the executable location.
  * 
  * @return true If the database already exists or a new one was created successfully.
  * @return false If something went wrong when opening the database or creating a new one.
  */
-bool openOrCreateDatabase(sqlite3 **database, const char *const filePath);
+bool openOrCreateDatabase(struct DatabaseConfig *databaseConfig, const char *const filePath);
+
+/**
+ * @brief Opens an additional connection to the database, for example for the log writer thread.
+ * Same as openOrCreateDatabase(), but doesn't build the in-memory PIN index.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param filePath Path with the database file name, relative to the executable location.
+ * 
+ * @return true If the database was opened and the statements were prepared successfully.
+ * @return false If something went wrong.
+ */
+bool openDatabaseConnection(struct DatabaseConfig *databaseConfig, const char *const filePath);
+
+/**
+ * @brief Finalizes the prepared statements and closes the database connection.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+void cleanupDatabase(struct DatabaseConfig *databaseConfig);
 
 /**
  * @brief Selects user ID from the database user table using a PIN code.
  * 
- * @param database SQLite database we're using.
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
  * @param pin The PIN code we're looking for a match for.
  * @param user_id_ptr Pointer to the user ID we're looking to get.
  * 
  * @return true If user with the PIN code was found and their user ID was returned.
  * @return false If no user with matching PIN code was found.
  */
-bool selectUserIDByPIN(sqlite3 **database, const char *const pin, int *user_id_ptr);
+bool selectUserIDByPIN(struct DatabaseConfig *databaseConfig, const char *const pin, int *user_id_ptr);
+
+/**
+ * @brief Adds a user, or with updateExisting, updates the names of the user that has the PIN.
+ * Meant to be called many times inside one transaction, see clock_import.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param firstName First name of the user.
+ * @param lastName Last name of the user.
+ * @param pin PIN code of the user. Identifies the user when updating.
+ * @param updateExisting Whether an existing user with the same PIN is updated instead of skipped.
+ * @param result Pointer to what was done with the user.
+ * 
+ * @return true If the row was saved or skipped.
+ * @return false If something went wrong.
+ */
+bool saveUserRow(struct DatabaseConfig *databaseConfig, const char *firstName, const char *lastName, const char *pin,
+                 const bool updateExisting, enum UserRowResult *result);
 
 /**
  * @brief Inserts a row to the log table.
  * 
- * @param database SQLite database we're using.
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
  * @param user_id User id number that will be added to the row.
- * @param status
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the clock event in microseconds since the Unix epoch, see getCurrentTimeInMicroseconds().
  * 
  * @return true If the insert was successful.
  * @return false If something went wrong with the insert.
  */
-bool insertLogRow(sqlite3 **database, const int user_id, const int status);
+bool insertLogRow(struct DatabaseConfig *databaseConfig, const int user_id, const int status, const int64_t timestamp);
+
+/**
+ * @brief Selects the status of the latest log row of the user.
+ * Read from the trigger maintained user_status table, so the cost doesn't grow with the log table.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param user_id User id number whose status we're looking for.
+ * @param status_pointer Pointer to the status we're looking to get. Left as it is if the user has no status.
+ * @param found Pointer to whether the user has a status, false for a user who has never clocked in.
+ * 
+ * @return true If the query succeeded, whether or not the user has a status.
+ * @return false If something went wrong. The user's status is unknown then.
+ */
+bool selectUsersLatestLogStatus(struct DatabaseConfig *databaseConfig, const int user_id, int *status_pointer, bool *found);
+
+/**
+ * @brief Checks whether a user can clock in or out, based on their previous status.
+ * No previous status and IN -> ok.
+ * No previous status and OUT -> fail.
+ * Previous status and different -> ok.
+ * Previous status and same -> fail.
+ * 
+ * @param previousStatusFound Whether the user has a previous status.
+ * @param previousStatus LOG_STATUS_IN or LOG_STATUS_OUT, if previousStatusFound.
+ * @param requestedStatus LOG_STATUS_IN or LOG_STATUS_OUT.
+ * 
+ * @return true If the status change is allowed.
+ * @return false If it isn't.
+ */
+bool isValidStatusChange(const bool previousStatusFound, const int previousStatus, const int requestedStatus);
+
+/**
+ * @brief Validates the PIN, checks the user's current status and inserts the log row, 
+ * all inside one BEGIN IMMEDIATE transaction. Another terminal or an admin tool can't change
+ * the user's status between the check and the insert.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param pin The PIN code that was entered.
+ * @param requestedStatus LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the clock event in microseconds since the Unix epoch.
+ * @param outcome Pointer to the outcome we're looking to get.
+ * 
+ * @return true If the log row was inserted.
+ * @return false If the event was rejected or the database failed. See outcome->result.
+ */
+bool recordClockEvent(struct DatabaseConfig *databaseConfig, const char *const pin, const int requestedStatus,
+                      const int64_t timestamp, struct ClockEventOutcome *outcome);
+
+/**
+ * @brief Checks the user's current status and inserts the log row if the status change is allowed.
+ * Has to be called inside a transaction started with beginTransaction(), so the check and insert are atomic.
+ * Used by recordClockEvent() and the log writer thread.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID User ID of the user clocking in or out.
+ * @param requestedStatus LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the clock event in microseconds since the Unix epoch.
+ * @param outcome Pointer to the outcome we're looking to get.
+ * 
+ * @return true If the check and insert ran, whether or not the event was accepted. See outcome->result.
+ * @return false If the database failed. The caller has to roll back the transaction.
+ */
+bool recordUsersClockEvent(struct DatabaseConfig *databaseConfig, const int userID, const int requestedStatus,
+                           const int64_t timestamp, struct ClockEventOutcome *outcome);
+
+/**
+ * @brief Starts a transaction that takes the write lock right away (BEGIN IMMEDIATE).
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * 
+ * @return true If the transaction was started.
+ * @return false If the database was locked for longer than the busy timeout, or something else went wrong.
+ */
+bool beginTransaction(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Commits the current transaction.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * 
+ * @return true If the transaction was committed.
+ * @return false If something went wrong. The transaction may still be open, roll it back.
+ */
+bool commitTransaction(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Rolls back the current transaction, if there is one.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+void rollbackTransaction(struct DatabaseConfig *databaseConfig);
 
-bool selectUsersLatestLogStatus(sqlite3 **database, const int user_id, int *status_pointer);
+/**
+ * @brief Finds the month of the oldest log row, if it's old enough to be archived.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param keepMonths How many of the latest months are kept in the database, including the current one. At least 1.
+ * @param month Pointer to the month we're looking to get.
+ * 
+ * @return true If there is a month to archive.
+ * @return false If there isn't, or something went wrong.
+ */
+bool selectArchivableLogMonth(struct DatabaseConfig *databaseConfig, const int keepMonths, struct LogMonth *month);
 
+/**
+ * @brief Attaches the archive file of the month for archiving, creating it if needed.
+ * Has to be closed with closeLogArchive() before another month is opened.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param month The month being archived.
+ * 
+ * @return true If the archive file is attached and has the log table.
+ * @return false If something went wrong. Nothing is left attached.
+ */
+bool openLogArchive(struct DatabaseConfig *databaseConfig, const struct LogMonth *month);
 
+/**
+ * @brief Moves up to batchSize log rows of the month to the archive file opened with openLogArchive().
+ * The rows are copied and committed to the archive file first, and only then deleted from the database,
+ * so a crash in between leaves rows in both files instead of losing them. The next batch cleans them up.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param month The month being archived.
+ * @param batchSize Most rows moved at once. Keeps each write transaction short.
+ * @param archivedCount Pointer to the number of rows moved. 0 once the month has no rows left in the database.
+ * 
+ * @return true If the batch was moved, or there was nothing left to move.
+ * @return false If something went wrong.
+ */
+bool archiveLogBatch(struct DatabaseConfig *databaseConfig, const struct LogMonth *month, const int batchSize,
+                     int *archivedCount);
 
-/* int show_menu();
-//int create_db(sqlite3 **db, char *db_name);
-//int create_table_user(sqlite3 **db);
-//int create_table_log(sqlite3 **db);
-int insert_user_row(sqlite3 **db, char *rfid_id, char *name, int pin);
-//int insert_log_row(sqlite3 **db, int user_id, int status);
-int show_table_user(sqlite3 **db);
-int show_table_log(sqlite3 **db);
-int update_log_row(sqlite3 **db, int user_id, int status, char *datetime, int log_id);
-int update_user_table_name(sqlite3 **db, int user_id, char *rfid_id, char *name, int pin);
-int remove_user_row(sqlite3 **db, int user_id);
-int remove_log_row(sqlite3 **db, int log_id);
-int select_user_id(sqlite3 **db, char *table, char *rfid_id);
-int select_userid_by_rfidid(sqlite3 **db, char *rfid_id, int *user_id_ptr);
-int select_pin_by_userid(sqlite3 **db, int user_id, int *pin_value);
-void pause_ch(); */
+/**
+ * @brief Detaches the archive file opened with openLogArchive().
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+void closeLogArchive(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Attaches the archive file of a month under the given schema name, for reports that need old rows.
+ * The rows are then in schemaName.log. Missing files are not created.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param year Year of the month, like 2024.
+ * @param month Month, 1-12.
+ * @param schemaName Name the file is attached as, like "log_2024_01".
+ * 
+ * @return true If the file was attached.
+ * @return false If the month has no archive file, or something went wrong.
+ */
+bool attachLogArchive(struct DatabaseConfig *databaseConfig, const int year, const int month, const char *schemaName);
+
+/**
+ * @brief Detaches a file attached with attachLogArchive().
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param schemaName Name the file was attached as.
+ */
+void detachLogArchive(struct DatabaseConfig *databaseConfig, const char *schemaName);
+
+
+/**
+ * @brief Selects the next log rows after a row ID, in ID order. Used by clock_export.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param afterID ID of the last row already read. 0 reads from the start.
+ * @param rows Array the rows are saved to.
+ * @param maxRows Size of the rows array.
+ * @param rowCount Pointer to the number of rows saved. Less than maxRows when the end of the log was reached.
+ * 
+ * @return true If the rows were selected, even if there were none.
+ * @return false If something went wrong.
+ */
+bool selectLogRowsAfterID(struct DatabaseConfig *databaseConfig, const int64_t afterID, struct LogRow *rows,
+                          const int maxRows, int *rowCount);
+
+/**
+ * @brief Selects the largest log row ID the database has handed out. The row itself may have been deleted
+ * or archived since, but no new row gets this ID or a smaller one.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param logID Pointer to the ID. 0 if no log row has ever been saved.
+ * 
+ * @return true If the query succeeded.
+ * @return false If something went wrong.
+ */
+bool selectLatestLogID(struct DatabaseConfig *databaseConfig, int64_t *logID);
+
+/**
+ * @brief Makes the log hand out IDs after logID from now on. Nothing happens if it already does.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param logID Largest log row ID that must not be used again.
+ * 
+ * @return true If new log rows get IDs after logID.
+ * @return false If something went wrong.
+ */
+bool advanceLatestLogID(struct DatabaseConfig *databaseConfig, const int64_t logID);
+
+/**
+ * @brief Looks for a log row of exactly this clock event, so an event replayed from the spool isn't saved twice.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID User ID of the event.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the event in microseconds since the Unix epoch.
+ * @param logID Pointer to the ID of the row. 0 if there is no such row.
+ * 
+ * @return true If the query succeeded, whether or not the row was found.
+ * @return false If something went wrong.
+ */
+bool selectLogRowIDByEvent(struct DatabaseConfig *databaseConfig, const int userID, const int status,
+                           const int64_t timestamp, int64_t *logID);
+
+/**
+ * @brief Selects a saved export cursor by its name.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param name Name of the export.
+ * @param cursor Pointer to the cursor we're looking to get. name is set either way.
+ * @param found Pointer to whether the cursor was saved before. If not, the cursor is set to the start of the log.
+ * 
+ * @return true If the query succeeded.
+ * @return false If something went wrong.
+ */
+bool selectExportCursor(struct DatabaseConfig *databaseConfig, const char *name, struct ExportCursor *cursor, bool *found);
+
+/**
+ * @brief Saves an export cursor, adding it if it's new. Commits right away unless inside a transaction.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param cursor The cursor.
+ * 
+ * @return true If the cursor was saved.
+ * @return false If something went wrong.
+ */
+bool saveExportCursor(struct DatabaseConfig *databaseConfig, const struct ExportCursor *cursor);
+
+/**
+ * @brief Deletes an export cursor. The archiver no longer keeps log rows around for it.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param name Name of the export.
+ * @param found Pointer to whether there was such a cursor.
+ * 
+ * @return true If the delete succeeded.
+ * @return false If something went wrong.
+ */
+bool deleteExportCursor(struct DatabaseConfig *databaseConfig, const char *name, bool *found);
+
+
+
+/**
+ * @brief Changes the names and the PIN of a user. Used by clock_admin.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID ID of the user.
+ * @param firstName New first name, or NULL to keep the old one.
+ * @param lastName New last name, or NULL to keep the old one.
+ * @param pin New PIN code, or NULL to keep the old one.
+ * @param found Pointer to whether there was such a user.
+ * 
+ * @return true If the update ran.
+ * @return false If something went wrong, like another user already having the PIN.
+ */
+bool updateUserRow(struct DatabaseConfig *databaseConfig, const int userID, const char *firstName, const char *lastName,
+                   const char *pin, bool *found);
+
+/**
+ * @brief Deletes a user and their status. A user with log rows is only deleted together with them.
+ * Has to be called inside a transaction started with beginTransaction(), so nothing is left half deleted.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID ID of the user.
+ * @param withLogRows Whether the user's log rows are deleted too. Rows already archived are left alone.
+ * @param found Pointer to whether there was such a user.
+ * @param hasLogRows Pointer to whether the user has log rows. Nothing is deleted if they do and withLogRows is false.
+ * 
+ * @return true If the delete ran, or was skipped because of log rows.
+ * @return false If something went wrong. The caller has to roll back the transaction.
+ */
+bool deleteUserRow(struct DatabaseConfig *databaseConfig, const int userID, const bool withLogRows, bool *found,
+                   bool *hasLogRows);
+
+/**
+ * @brief Corrects the time or status of a log row. The user's status is refreshed by the log table triggers.
+ * Archived rows can't be corrected, they are no longer in the database.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param logID ID of the log row.
+ * @param timestamp New time in microseconds since the Unix epoch, or NULL to keep the old one.
+ * @param status New status, LOG_STATUS_IN or LOG_STATUS_OUT, or NULL to keep the old one.
+ * @param found Pointer to whether there was such a row.
+ * 
+ * @return true If the update ran.
+ * @return false If something went wrong.
+ */
+bool updateLogRow(struct DatabaseConfig *databaseConfig, const int64_t logID, const int64_t *timestamp, const int *status,
+                  bool *found);
+
+/**
+ * @brief Deletes a log row. The user's status is refreshed by the log table triggers.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param logID ID of the log row.
+ * @param found Pointer to whether there was such a row.
+ * 
+ * @return true If the delete ran.
+ * @return false If something went wrong.
+ */
+bool deleteLogRow(struct DatabaseConfig *databaseConfig, const int64_t logID, bool *found);
+
+/**
+ * @brief Selects the next users after a user ID, in ID order, with their current status.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param afterID ID of the last user already read. 0 reads from the start.
+ * @param presentOnly Whether only users who are clocked in are selected.
+ * @param rows Array the rows are saved to.
+ * @param maxRows Size of the rows array.
+ * @param rowCount Pointer to the number of rows saved. Less than maxRows when there are no more users.
+ * 
+ * @return true If the rows were selected, even if there were none.
+ * @return false If something went wrong.
+ */
+bool selectUserRowsAfterID(struct DatabaseConfig *databaseConfig, const int afterID, const bool presentOnly,
+                           struct UserRow *rows, const int maxRows, int *rowCount);
+
+/**
+ * @brief Selects the latest log rows of a user, newest first.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID ID of the user.
+ * @param rows Array the rows are saved to.
+ * @param maxRows Size of the rows array, and the most rows selected.
+ * @param rowCount Pointer to the number of rows saved.
+ * 
+ * @return true If the rows were selected, even if there were none.
+ * @return false If something went wrong.
+ */
+bool selectUsersLatestLogRows(struct DatabaseConfig *databaseConfig, const int userID, struct LogRow *rows,
+                              const int maxRows, int *rowCount);
+/**
+ * @brief Turns off the checkpoints SQLite runs when a commit makes the WAL long enough, for this connection only.
+ * Used when maintenance.c runs the checkpoints instead, so a commit on the main thread never waits for one.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+void disableAutoCheckpoint(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Starts a maintenance slice. Until endMaintenanceSlice(), the maintenance functions below give up
+ * right away if another connection holds the lock, and stop as soon as stopCheck returns true.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param stopCheck Called every few thousand SQLite instructions.
+ * @param data Passed to stopCheck.
+ */
+void beginMaintenanceSlice(struct DatabaseConfig *databaseConfig, MaintenanceStopCheck stopCheck, void *data);
+
+/**
+ * @brief Ends a maintenance slice and restores the busy timeout.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+void endMaintenanceSlice(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Copies what it can of the WAL back to the database file, without waiting for readers or writers.
+ * Can't be stopped once started, but the WAL is short when it's run often.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param walPages Pointer to the number of pages in the WAL. -1 if the database isn't in WAL mode.
+ * @param stopped Pointer to whether another connection was busy, so it should be tried again later.
+ * 
+ * @return true If the checkpoint ran.
+ * @return false If it was stopped or something went wrong.
+ */
+bool checkpointDatabase(struct DatabaseConfig *databaseConfig, int *walPages, bool *stopped);
+
+/**
+ * @brief Runs PRAGMA optimize, which updates the query planner statistics of tables that need it.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param stopped Pointer to whether it was stopped by the stop check or another connection, so it should be tried again later.
+ * 
+ * @return true If it finished.
+ * @return false If it was stopped or something went wrong.
+ */
+bool optimizeDatabase(struct DatabaseConfig *databaseConfig, bool *stopped);
+
+/**
+ * @brief Gives up to maxPages free pages back to the file system. Only works on databases created with
+ * incremental auto vacuum, on others there's nothing to do.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param maxPages Most pages freed at once.
+ * @param freePages Pointer to the number of free pages left that could still be given back.
+ * @param stopped Pointer to whether it was stopped by the stop check or another connection, so it should be tried again later.
+ * 
+ * @return true If it finished.
+ * @return false If it was stopped or something went wrong. Nothing was freed then.
+ */
+bool vacuumFreePages(struct DatabaseConfig *databaseConfig, const int maxPages, int *freePages, bool *stopped);
+
+/**
+ * @brief Runs PRAGMA quick_check, which reads the whole database file looking for corruption.
+ * Problems found are printed.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param passed Pointer to whether the database is intact.
+ * @param stopped Pointer to whether it was stopped by the stop check, so it should be tried again later.
+ * 
+ * @return true If it finished.
+ * @return false If it was stopped or something went wrong.
+ */
+bool quickCheckDatabase(struct DatabaseConfig *databaseConfig, bool *passed, bool *stopped);
 
 
 
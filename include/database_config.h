@@ -0,0 +1,199 @@
+/**
+ * @file database_config.h
+ * @author Selkamies
+ *
+ * @brief Defines DatabaseConfig struct, which holds the database connection and the
+ * prepared statements used by database.c.
+ *
+ * @date Created  2023-12-21
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2023
+ */
+
+
+
+#ifndef DATABASE_CONFIG_H
+#define DATABASE_CONFIG_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>              // int64_t.
+#include <sqlite3.h>             // sqlite3, sqlite3_stmt, sqlite3_int64.
+
+
+
+// Forward declaration.
+struct PINIndex;
+
+
+
+/** @brief Length of the text settings like "NORMAL", including the null terminator. */
+#define DATABASE_SETTING_LENGTH 16
+/** @brief Longest export cursor name, including the null terminator. */
+#define EXPORT_CURSOR_NAME_LENGTH 64
+/** @brief Longest export file path, including the null terminator. */
+#define EXPORT_CURSOR_FILE_LENGTH 4096
+/** @brief Longest first or last name read by selectUserRowsAfterID(), including the null terminator. Longer names are cut. */
+#define USER_NAME_LENGTH 64
+
+
+
+/**
+ * @brief SQLite settings applied to every connection when it is opened. Read from the [DATABASE]
+ * section of config.ini, starting from one of the built-in profiles.
+ */
+struct DatabaseSettings
+{
+    /** @brief PRAGMA journal_mode. DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF. */
+    char journalMode[DATABASE_SETTING_LENGTH];
+    /** @brief PRAGMA synchronous. OFF, NORMAL, FULL or EXTRA. */
+    char synchronous[DATABASE_SETTING_LENGTH];
+    /** @brief PRAGMA cache_size. Positive is pages, negative is KiB. */
+    int cacheSize;
+    /** @brief PRAGMA mmap_size in bytes. 0 disables memory mapped I/O. */
+    long long mmapSize;
+    /** @brief How long a connection waits for another connection's lock before giving up, in milliseconds. */
+    int busyTimeoutMilliseconds;
+    /** @brief PRAGMA temp_store. DEFAULT, FILE or MEMORY. */
+    char tempStore[DATABASE_SETTING_LENGTH];
+};
+
+
+
+/**
+ * @brief Struct holding the SQL statements that are run on every clock event.
+ * They are prepared once when the database is opened, and reset and rebound for every use.
+ */
+struct DatabaseStatements
+{
+    /** @brief Prepared SELECT_USER_ID_BY_PIN. */
+    sqlite3_stmt *selectUserIDByPIN;
+    /** @brief Prepared SELECT_USER_STATUS_BY_USER_ID. */
+    sqlite3_stmt *selectUsersLatestLogStatus;
+    /** @brief Prepared INSERT_LOG_ROW. */
+    sqlite3_stmt *insertLogRow;
+    /** @brief Prepared SELECT_DATA_VERSION. */
+    sqlite3_stmt *selectDataVersion;
+    /** @brief Prepared SELECT_USER_CHANGES_AFTER_ID. */
+    sqlite3_stmt *selectUserChangesAfterID;
+    /** @brief Prepared BEGIN_IMMEDIATE_TRANSACTION. */
+    sqlite3_stmt *beginImmediateTransaction;
+    /** @brief Prepared COMMIT_TRANSACTION. */
+    sqlite3_stmt *commitTransaction;
+    /** @brief Prepared ROLLBACK_TRANSACTION. */
+    sqlite3_stmt *rollbackTransaction;
+    /** @brief Prepared INSERT_USER_ROW_IF_NEW_PIN. Only prepared when first used, the device never adds users. */
+    sqlite3_stmt *insertUserRow;
+    /** @brief Prepared UPSERT_USER_ROW_BY_PIN. Only prepared when first used. */
+    sqlite3_stmt *upsertUserRow;
+    /** @brief Prepared SELECT_LOG_ROWS_AFTER_ID. Only prepared when first used, by clock_export. */
+    sqlite3_stmt *selectLogRowsAfterID;
+    /** @brief Prepared SAVE_EXPORT_CURSOR. Only prepared when first used, by clock_export. */
+    sqlite3_stmt *saveExportCursor;
+    /** @brief Prepared UPDATE_USER_ROW_BY_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *updateUserRow;
+    /** @brief Prepared DELETE_USER_ROW_BY_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *deleteUserRow;
+    /** @brief Prepared DELETE_USER_STATUS_BY_USER_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *deleteUserStatus;
+    /** @brief Prepared SELECT_USER_HAS_LOG_ROWS. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *selectUserHasLogRows;
+    /** @brief Prepared DELETE_LOG_ROWS_BY_USER_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *deleteUsersLogRows;
+    /** @brief Prepared UPDATE_LOG_ROW_BY_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *updateLogRow;
+    /** @brief Prepared DELETE_LOG_ROW_BY_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *deleteLogRow;
+    /** @brief Prepared SELECT_USER_ROWS_AFTER_ID. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *selectUserRowsAfterID;
+    /** @brief Prepared SELECT_USERS_LATEST_LOG_ROWS. Only prepared when first used, by clock_admin. */
+    sqlite3_stmt *selectUsersLatestLogRows;
+    /** @brief Prepared SELECT_LOG_ROW_ID_BY_EVENT. Only prepared when first used, by spool.c. */
+    sqlite3_stmt *selectLogRowIDByEvent;
+};
+
+/**
+ * @brief A calendar month in local time, and its bounds as log datetimes. Used for archiving.
+ */
+struct LogMonth
+{
+    /** @brief Year, like 2024. */
+    int year;
+    /** @brief Month, 1-12. */
+    int month;
+    /** @brief First microsecond of the month since the Unix epoch. */
+    int64_t start;
+    /** @brief First microsecond of the next month since the Unix epoch. */
+    int64_t end;
+};
+
+/**
+ * @brief A row of the log table.
+ */
+struct LogRow
+{
+    sqlite3_int64 id;
+    int userID;
+    /** @brief Microseconds since the Unix epoch. */
+    int64_t datetime;
+    /** @brief LOG_STATUS_IN or LOG_STATUS_OUT. */
+    int status;
+};
+
+/**
+ * @brief A row of the user table with the user's current status. The PIN is never read.
+ */
+struct UserRow
+{
+    int id;
+    char firstName[USER_NAME_LENGTH];
+    char lastName[USER_NAME_LENGTH];
+    /** @brief LOG_STATUS_IN or LOG_STATUS_OUT, or LOG_STATUS_ERROR if the user has never clocked in. */
+    int status;
+    /** @brief Time of the latest status change in microseconds since the Unix epoch. 0 without a status. */
+    int64_t since;
+};
+
+/**
+ * @brief How far a named export has got, saved in the export_cursor table.
+ */
+struct ExportCursor
+{
+    /** @brief Name of the export, like "payroll". */
+    char name[EXPORT_CURSOR_NAME_LENGTH];
+    /** @brief ID of the last log row written to the export file. 0 before the first export. */
+    sqlite3_int64 lastLogID;
+    /** @brief Full path of the export file the last batch was written to. Empty before the first export. */
+    char file[EXPORT_CURSOR_FILE_LENGTH];
+    /** @brief Size of that file after the last batch, in bytes. */
+    int64_t fileSize;
+};
+
+/**
+ * @brief Struct holding all the variables needed by database.c.
+ */
+struct DatabaseConfig
+{
+    /** @brief SQLite settings applied when the connection is opened. */
+    struct DatabaseSettings settings;
+    /** @brief SQLite database connection. Owned by database.c, opened by openOrCreateDatabase(). */
+    sqlite3 *database;
+    /** @brief Struct holding the prepared statements that are reused for every clock event. */
+    struct DatabaseStatements statements;
+    /** @brief In-memory PIN to user ID hash table. NULL if it couldn't be built, then PINs are looked up with SQL. */
+    struct PINIndex *pinIndex;
+    /** @brief PRAGMA data_version when pinIndex was last checked. Changes when another process commits. */
+    int dataVersion;
+    /** @brief ID of the last user_change row applied to pinIndex. */
+    sqlite3_int64 lastUserChangeID;
+    /** @brief Stops maintenance statements during a maintenance slice, see MaintenanceStopCheck. NULL outside of one. */
+    bool (*maintenanceStopCheck)(void *data);
+    /** @brief Passed to maintenanceStopCheck. */
+    void *maintenanceStopCheckData;
+};
+
+
+
+#endif // DATABASE_CONFIG_H
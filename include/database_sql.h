@@ -5,19 +5,49 @@
  * @brief Holds #defines with SQL variables like table and column names and SQL statements.
 
  * @date Created  2023-12-08
- * @date Modified 2023-12-15
+ * @date Modified 2024-01-22
  * 
  * @copyright Copyright (c) 2023
  */
 
 
 
-#ifndef DATABASE_CONFIG_H
-#define DATABASE_CONFIG_H
+#ifndef DATABASE_SQL_H
+#define DATABASE_SQL_H
 
 
 
-#define SELECT_TABLE_EXISTS "SELECT name FROM sqlite_master WHERE type = 'table' AND name = ?;"
+//////////////
+// SETTINGS //
+//////////////
+
+// PRAGMAs can't use bound parameters either. Text values are checked against a list of allowed values first.
+#define SET_JOURNAL_MODE_FORMAT "PRAGMA journal_mode = %s;"
+#define SET_SYNCHRONOUS_FORMAT "PRAGMA synchronous = %s;"
+#define SET_TEMP_STORE_FORMAT "PRAGMA temp_store = %s;"
+#define SET_CACHE_SIZE_FORMAT "PRAGMA cache_size = %d;"
+#define SET_MMAP_SIZE_FORMAT "PRAGMA mmap_size = %lld;"
+// Only takes effect on a new, empty database file, so it has to come before the journal mode, which writes the file header.
+// Existing databases keep their mode until "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;" is run on them once.
+#define SET_AUTO_VACUUM_INCREMENTAL "PRAGMA auto_vacuum = INCREMENTAL;"
+
+
+
+////////////////
+// MIGRATIONS //
+////////////////
+
+// PRAGMA user_version is an integer stored in the database file header, that SQLite itself never uses.
+// We store the number of schema migrations applied to the database in it.
+#define SELECT_USER_VERSION "PRAGMA user_version;"
+// PRAGMAs cannot use bound parameters, so the version number is formatted in with snprintf().
+#define SET_USER_VERSION_FORMAT "PRAGMA user_version = %d;"
+
+// IMMEDIATE takes the write lock right away, so two processes can't apply the same migration at once.
+#define BEGIN_TRANSACTION "BEGIN;"
+#define BEGIN_IMMEDIATE_TRANSACTION "BEGIN IMMEDIATE;"
+#define COMMIT_TRANSACTION "COMMIT;"
+#define ROLLBACK_TRANSACTION "ROLLBACK;"
 
 
 
@@ -52,18 +82,51 @@
         " (" COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER ", " COLUMN_PIN_USER ") " \
     "VALUES (?, ?, ?);"
 
+// Used by clock_import. A user whose PIN is already taken is skipped, changes() is then 0.
+#define INSERT_USER_ROW_IF_NEW_PIN \
+    "INSERT INTO " TABLE_USER \
+        " (" COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER ", " COLUMN_PIN_USER ") " \
+    "VALUES (?, ?, ?) " \
+    "ON CONFLICT (" COLUMN_PIN_USER ") DO NOTHING;"
+
+// Used by clock_import --upsert. The PIN identifies the user, and the names of an existing user are updated.
+// Rows that wouldn't change anything are skipped, changes() is then 0.
+#define UPSERT_USER_ROW_BY_PIN \
+    "INSERT INTO " TABLE_USER \
+        " (" COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER ", " COLUMN_PIN_USER ") " \
+    "VALUES (?, ?, ?) " \
+    "ON CONFLICT (" COLUMN_PIN_USER ") DO UPDATE SET " \
+        COLUMN_FIRST_NAME_USER " = excluded." COLUMN_FIRST_NAME_USER ", " \
+        COLUMN_LAST_NAME_USER " = excluded." COLUMN_LAST_NAME_USER " " \
+    "WHERE " COLUMN_FIRST_NAME_USER " IS NOT excluded." COLUMN_FIRST_NAME_USER \
+      " OR " COLUMN_LAST_NAME_USER " IS NOT excluded." COLUMN_LAST_NAME_USER ";"
+
 #define SELECT_USER_ID_BY_PIN \
     "SELECT " COLUMN_ID_USER \
     " FROM " TABLE_USER \
     " WHERE " COLUMN_PIN_USER " = ?;"
 
+// Used by clock_report to name the users in the report.
+#define SELECT_USER_NAMES_BY_ID \
+    "SELECT " COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER \
+    " FROM " TABLE_USER \
+    " WHERE " COLUMN_ID_USER " = ?;"
+
+// Used to size the in-memory PIN index at startup.
+#define SELECT_USER_COUNT "SELECT COUNT(*) FROM " TABLE_USER ";"
+
+// Used to read every user to the in-memory PIN index at startup.
+#define SELECT_USER_ID_AND_PIN "SELECT " COLUMN_ID_USER ", " COLUMN_PIN_USER " FROM " TABLE_USER ";"
+
+// Test rows are only inserted to an empty user table, so existing databases are left alone.
 #define INSERT_INTO_USER_TEST_ROWS \
     "INSERT INTO " TABLE_USER \
         " (" COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER ", " COLUMN_PIN_USER ") " \
-    "VALUES " \
+    "SELECT * FROM (VALUES " \
         "('first name', 'last name', '123A')," \
         "('John', 'Doe', 'ABCD')," \
-        "('Jane', 'Doe', '2580');"
+        "('Jane', 'Doe', '2580')) " \
+    "WHERE NOT EXISTS (SELECT 1 FROM " TABLE_USER ");"
 
 
 
@@ -78,6 +141,7 @@
 #define COLUMN_STATUS_LOG "status"
 
 // TODO: Is there a difference between (datetime('now')) and CURRENT_TIMESTAMP?
+// This is the version 1 table. Schema version 5 changes datetime to INTEGER, see INTEGER DATETIME below.
 #define CREATE_TABLE_LOG \
     "CREATE TABLE IF NOT EXISTS " TABLE_LOG " (" \
         COLUMN_ID_LOG " INTEGER PRIMARY KEY, " \
@@ -87,8 +151,17 @@
         "FOREIGN KEY (" COLUMN_USER_ID_LOG ") " \
             "REFERENCES " TABLE_USER " (" COLUMN_ID_USER ")) STRICT;"
 
-// We don't need to insert datetime, it's set automatically.
-#define INSERT_LOG_ROW "INSERT INTO " TABLE_LOG " (" COLUMN_USER_ID_LOG ", " COLUMN_STATUS_LOG ") VALUES (?, ?);"
+#define INDEX_LOG_USER_ID_DATETIME "log_user_id_datetime"
+
+// Covers SELECT_LOG_ROW_BY_USER_ID_LATEST completely: the user's rows are found and ordered by the index,
+// and status is read from the index too, so the table itself is never touched.
+#define CREATE_INDEX_LOG_USER_ID_DATETIME \
+    "CREATE INDEX IF NOT EXISTS " INDEX_LOG_USER_ID_DATETIME " ON " TABLE_LOG " (" \
+        COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ");"
+
+// Since schema version 5 datetime is set by the program, in microseconds since the Unix epoch (UTC).
+#define INSERT_LOG_ROW \
+    "INSERT INTO " TABLE_LOG " (" COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ") VALUES (?, ?, ?);"
 
 // SELECTs the status on the latest log row of the user.
 #define SELECT_LOG_ROW_BY_USER_ID_LATEST \
@@ -99,4 +172,524 @@
 
 
 
-#endif // DATABASE_CONFIG_H
\ No newline at end of file
+///////////////////////
+// USER STATUS TABLE //
+///////////////////////
+
+// Holds the status of the latest log row of every user, so checking whether a user is IN or OUT
+// is a single primary key lookup, however large the log table grows.
+// The table is kept up to date by triggers on the log table, nothing should write to it directly.
+
+#define TABLE_USER_STATUS "user_status"
+#define COLUMN_USER_ID_USER_STATUS "user_id"
+#define COLUMN_STATUS_USER_STATUS "status"
+#define COLUMN_SINCE_USER_STATUS "since"
+
+#define TRIGGER_LOG_INSERT_USER_STATUS "log_insert_user_status"
+#define TRIGGER_LOG_UPDATE_USER_STATUS "log_update_user_status"
+#define TRIGGER_LOG_DELETE_USER_STATUS "log_delete_user_status"
+
+#define CREATE_TABLE_USER_STATUS \
+    "CREATE TABLE IF NOT EXISTS " TABLE_USER_STATUS " (" \
+        COLUMN_USER_ID_USER_STATUS " INTEGER PRIMARY KEY, " \
+        COLUMN_STATUS_USER_STATUS " INTEGER NOT NULL, " \
+        COLUMN_SINCE_USER_STATUS " TEXT NOT NULL, " \
+        "FOREIGN KEY (" COLUMN_USER_ID_USER_STATUS ") " \
+            "REFERENCES " TABLE_USER " (" COLUMN_ID_USER ")) STRICT;"
+
+// Sets the user's status to the status of their latest log row. Used by the triggers that can't know
+// which row is the latest without looking. If the user has no log rows left, the last known status is kept.
+// NOTE: USER_ID_EXPRESSION is pasted into the SQL, it's meant for OLD.user_id and NEW.user_id in triggers.
+// "WHERE true" is needed so SQLite doesn't parse ON CONFLICT as a join constraint.
+#define REFRESH_USER_STATUS(USER_ID_EXPRESSION) \
+    "INSERT INTO " TABLE_USER_STATUS \
+        " (" COLUMN_USER_ID_USER_STATUS ", " COLUMN_STATUS_USER_STATUS ", " COLUMN_SINCE_USER_STATUS ") " \
+    "SELECT * FROM (" \
+        "SELECT " COLUMN_USER_ID_LOG ", " COLUMN_STATUS_LOG ", " COLUMN_DATETIME_LOG \
+        " FROM " TABLE_LOG \
+        " WHERE " COLUMN_USER_ID_LOG " = " USER_ID_EXPRESSION \
+        " ORDER BY " COLUMN_DATETIME_LOG " DESC, " COLUMN_ID_LOG " DESC LIMIT 1) WHERE true " \
+    "ON CONFLICT (" COLUMN_USER_ID_USER_STATUS ") DO UPDATE SET " \
+        COLUMN_STATUS_USER_STATUS " = excluded." COLUMN_STATUS_USER_STATUS ", " \
+        COLUMN_SINCE_USER_STATUS " = excluded." COLUMN_SINCE_USER_STATUS ";"
+
+// New log rows are normally the latest ones, so the status is simply overwritten.
+// Rows inserted with an older datetime (corrections) don't replace a newer status.
+#define CREATE_TRIGGER_LOG_INSERT_USER_STATUS \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_LOG_INSERT_USER_STATUS " AFTER INSERT ON " TABLE_LOG " BEGIN " \
+        "INSERT INTO " TABLE_USER_STATUS \
+            " (" COLUMN_USER_ID_USER_STATUS ", " COLUMN_STATUS_USER_STATUS ", " COLUMN_SINCE_USER_STATUS ") " \
+        "VALUES (NEW." COLUMN_USER_ID_LOG ", NEW." COLUMN_STATUS_LOG ", NEW." COLUMN_DATETIME_LOG ") " \
+        "ON CONFLICT (" COLUMN_USER_ID_USER_STATUS ") DO UPDATE SET " \
+            COLUMN_STATUS_USER_STATUS " = excluded." COLUMN_STATUS_USER_STATUS ", " \
+            COLUMN_SINCE_USER_STATUS " = excluded." COLUMN_SINCE_USER_STATUS " " \
+        "WHERE excluded." COLUMN_SINCE_USER_STATUS " >= " TABLE_USER_STATUS "." COLUMN_SINCE_USER_STATUS "; " \
+    "END;"
+
+#define CREATE_TRIGGER_LOG_UPDATE_USER_STATUS \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_LOG_UPDATE_USER_STATUS \
+    " AFTER UPDATE OF " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG " ON " TABLE_LOG " BEGIN " \
+        REFRESH_USER_STATUS("OLD." COLUMN_USER_ID_LOG) \
+        REFRESH_USER_STATUS("NEW." COLUMN_USER_ID_LOG) \
+    "END;"
+
+#define CREATE_TRIGGER_LOG_DELETE_USER_STATUS \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_LOG_DELETE_USER_STATUS " AFTER DELETE ON " TABLE_LOG " BEGIN " \
+        REFRESH_USER_STATUS("OLD." COLUMN_USER_ID_LOG) \
+    "END;"
+
+// Fills the table for databases that already have log rows. SQLite takes the bare columns
+// (status) from the same row that MAX() picks, so this is the status of each user's latest row.
+#define BACKFILL_USER_STATUS \
+    "INSERT OR REPLACE INTO " TABLE_USER_STATUS \
+        " (" COLUMN_USER_ID_USER_STATUS ", " COLUMN_STATUS_USER_STATUS ", " COLUMN_SINCE_USER_STATUS ") " \
+    "SELECT " COLUMN_USER_ID_LOG ", " COLUMN_STATUS_LOG ", MAX(" COLUMN_DATETIME_LOG ") " \
+    "FROM " TABLE_LOG " GROUP BY " COLUMN_USER_ID_LOG ";"
+
+#define SELECT_USER_STATUS_BY_USER_ID \
+    "SELECT " COLUMN_STATUS_USER_STATUS \
+    " FROM " TABLE_USER_STATUS \
+    " WHERE " COLUMN_USER_ID_USER_STATUS " = ?;"
+
+
+
+//////////////////////
+// INTEGER DATETIME //
+//////////////////////
+
+// Schema version 5 changes log.datetime and user_status.since from one-second CURRENT_TIMESTAMP text
+// to INTEGER microseconds since the Unix epoch (UTC). Rows of the same user no longer tie within a second,
+// and sorting and the user/datetime index compare integers instead of strings.
+// SQLite can't change the type of a column, so both tables are copied to new tables that are then renamed.
+// Dropping the old log table drops its index and triggers too, the migration creates them again.
+
+#define TABLE_LOG_REBUILD "log_rebuild"
+#define TABLE_USER_STATUS_REBUILD "user_status_rebuild"
+
+// Old text datetimes only have whole seconds.
+#define MICROSECONDS_FROM_TEXT_DATETIME(COLUMN) "CAST(strftime('%s', " COLUMN ") AS INTEGER) * 1000000"
+
+#define CREATE_TABLE_LOG_REBUILD \
+    "CREATE TABLE " TABLE_LOG_REBUILD " (" \
+        COLUMN_ID_LOG " INTEGER PRIMARY KEY, " \
+        COLUMN_USER_ID_LOG " INTEGER NOT NULL, " \
+        COLUMN_DATETIME_LOG " INTEGER NOT NULL, " \
+        COLUMN_STATUS_LOG " INTEGER NOT NULL, " \
+        "FOREIGN KEY (" COLUMN_USER_ID_LOG ") " \
+            "REFERENCES " TABLE_USER " (" COLUMN_ID_USER ")) STRICT;"
+
+#define COPY_LOG_TO_REBUILD \
+    "INSERT INTO " TABLE_LOG_REBUILD \
+        " (" COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ") " \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " \
+        MICROSECONDS_FROM_TEXT_DATETIME(COLUMN_DATETIME_LOG) ", " COLUMN_STATUS_LOG \
+    " FROM " TABLE_LOG ";"
+
+#define CREATE_TABLE_USER_STATUS_REBUILD \
+    "CREATE TABLE " TABLE_USER_STATUS_REBUILD " (" \
+        COLUMN_USER_ID_USER_STATUS " INTEGER PRIMARY KEY, " \
+        COLUMN_STATUS_USER_STATUS " INTEGER NOT NULL, " \
+        COLUMN_SINCE_USER_STATUS " INTEGER NOT NULL, " \
+        "FOREIGN KEY (" COLUMN_USER_ID_USER_STATUS ") " \
+            "REFERENCES " TABLE_USER " (" COLUMN_ID_USER ")) STRICT;"
+
+// Copied instead of filled again from the log, so users whose log rows are gone keep their status.
+#define COPY_USER_STATUS_TO_REBUILD \
+    "INSERT INTO " TABLE_USER_STATUS_REBUILD \
+        " (" COLUMN_USER_ID_USER_STATUS ", " COLUMN_STATUS_USER_STATUS ", " COLUMN_SINCE_USER_STATUS ") " \
+    "SELECT " COLUMN_USER_ID_USER_STATUS ", " COLUMN_STATUS_USER_STATUS ", " \
+        MICROSECONDS_FROM_TEXT_DATETIME(COLUMN_SINCE_USER_STATUS) \
+    " FROM " TABLE_USER_STATUS ";"
+
+#define REPLACE_LOG_WITH_REBUILD \
+    "DROP TABLE " TABLE_LOG "; " \
+    "ALTER TABLE " TABLE_LOG_REBUILD " RENAME TO " TABLE_LOG ";"
+
+#define REPLACE_USER_STATUS_WITH_REBUILD \
+    "DROP TABLE " TABLE_USER_STATUS "; " \
+    "ALTER TABLE " TABLE_USER_STATUS_REBUILD " RENAME TO " TABLE_USER_STATUS ";"
+
+#define VIEW_LOG_READABLE "log_readable"
+
+// The log with datetime as readable UTC text with milliseconds, for people and tools reading the database by hand.
+#define CREATE_VIEW_LOG_READABLE \
+    "CREATE VIEW IF NOT EXISTS " VIEW_LOG_READABLE " AS " \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " \
+        "strftime('%Y-%m-%d %H:%M:%f', " COLUMN_DATETIME_LOG " / 1000000.0, 'unixepoch') AS " COLUMN_DATETIME_LOG ", " \
+        COLUMN_STATUS_LOG \
+    " FROM " TABLE_LOG ";"
+
+
+
+///////////////////////
+// USER CHANGE TABLE //
+///////////////////////
+
+// Every insert, PIN change and delete of a user row is recorded here by triggers, with the old and new PIN.
+// The device keeps its in-memory PIN index up to date by applying the rows it hasn't seen yet,
+// instead of reading the whole user table again when another process has changed it.
+
+#define TABLE_USER_CHANGE "user_change"
+#define COLUMN_ID_USER_CHANGE "id"
+#define COLUMN_USER_ID_USER_CHANGE "user_id"
+#define COLUMN_OLD_PIN_USER_CHANGE "old_pin"
+#define COLUMN_NEW_PIN_USER_CHANGE "new_pin"
+
+#define TRIGGER_USER_INSERT_USER_CHANGE "user_insert_user_change"
+#define TRIGGER_USER_UPDATE_USER_CHANGE "user_update_user_change"
+#define TRIGGER_USER_DELETE_USER_CHANGE "user_delete_user_change"
+
+// old_pin is NULL for inserted users and new_pin is NULL for deleted users.
+#define CREATE_TABLE_USER_CHANGE \
+    "CREATE TABLE IF NOT EXISTS " TABLE_USER_CHANGE " (" \
+        COLUMN_ID_USER_CHANGE " INTEGER PRIMARY KEY, " \
+        COLUMN_USER_ID_USER_CHANGE " INTEGER NOT NULL, " \
+        COLUMN_OLD_PIN_USER_CHANGE " TEXT, " \
+        COLUMN_NEW_PIN_USER_CHANGE " TEXT) STRICT;"
+
+#define INSERT_USER_CHANGE_VALUES(USER_ID_EXPRESSION, OLD_PIN_EXPRESSION, NEW_PIN_EXPRESSION) \
+    "INSERT INTO " TABLE_USER_CHANGE \
+        " (" COLUMN_USER_ID_USER_CHANGE ", " COLUMN_OLD_PIN_USER_CHANGE ", " COLUMN_NEW_PIN_USER_CHANGE ") " \
+    "VALUES (" USER_ID_EXPRESSION ", " OLD_PIN_EXPRESSION ", " NEW_PIN_EXPRESSION "); "
+
+#define CREATE_TRIGGER_USER_INSERT_USER_CHANGE \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_USER_INSERT_USER_CHANGE " AFTER INSERT ON " TABLE_USER " BEGIN " \
+        INSERT_USER_CHANGE_VALUES("NEW." COLUMN_ID_USER, "NULL", "NEW." COLUMN_PIN_USER) \
+    "END;"
+
+#define CREATE_TRIGGER_USER_UPDATE_USER_CHANGE \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_USER_UPDATE_USER_CHANGE \
+    " AFTER UPDATE OF " COLUMN_ID_USER ", " COLUMN_PIN_USER " ON " TABLE_USER " BEGIN " \
+        INSERT_USER_CHANGE_VALUES("NEW." COLUMN_ID_USER, "OLD." COLUMN_PIN_USER, "NEW." COLUMN_PIN_USER) \
+    "END;"
+
+#define CREATE_TRIGGER_USER_DELETE_USER_CHANGE \
+    "CREATE TRIGGER IF NOT EXISTS " TRIGGER_USER_DELETE_USER_CHANGE " AFTER DELETE ON " TABLE_USER " BEGIN " \
+        INSERT_USER_CHANGE_VALUES("OLD." COLUMN_ID_USER, "OLD." COLUMN_PIN_USER, "NULL") \
+    "END;"
+
+#define SELECT_USER_CHANGE_MAX_ID \
+    "SELECT IFNULL(MAX(" COLUMN_ID_USER_CHANGE "), 0) FROM " TABLE_USER_CHANGE ";"
+
+#define SELECT_USER_CHANGES_AFTER_ID \
+    "SELECT " COLUMN_ID_USER_CHANGE ", " COLUMN_USER_ID_USER_CHANGE ", " \
+              COLUMN_OLD_PIN_USER_CHANGE ", " COLUMN_NEW_PIN_USER_CHANGE \
+    " FROM " TABLE_USER_CHANGE \
+    " WHERE " COLUMN_ID_USER_CHANGE " > ?" \
+    " ORDER BY " COLUMN_ID_USER_CHANGE ";"
+
+// Changes older than a freshly built PIN index are not needed anymore. The newest one is kept, since without
+// AUTOINCREMENT a new row gets the largest ID + 1, and an emptied table would hand out the IDs already seen again.
+#define DELETE_USER_CHANGES_BEFORE_ID \
+    "DELETE FROM " TABLE_USER_CHANGE " WHERE " COLUMN_ID_USER_CHANGE " < ?;"
+
+// Changes whenever another connection commits a change to the database. Cheap enough to check on every PIN.
+#define SELECT_DATA_VERSION "PRAGMA data_version;"
+
+
+
+/////////////////
+// LOG ARCHIVE //
+/////////////////
+
+// Closed months are moved from the log table to one database file per month, see archive.c.
+// The month's file is attached to the main connection as SCHEMA_ARCHIVE while it is being filled.
+// Reports attach the files they need under their own schema names.
+
+#define SCHEMA_ARCHIVE "archive"
+
+// ATTACH and DETACH take the file name and schema name as expressions, so they can be bound.
+#define ATTACH_DATABASE "ATTACH DATABASE ? AS ?;"
+#define DETACH_DATABASE "DETACH DATABASE ?;"
+
+// Same columns as the log table. No foreign key, it can't point to another database file.
+#define CREATE_TABLE_ARCHIVE_LOG \
+    "CREATE TABLE IF NOT EXISTS " SCHEMA_ARCHIVE "." TABLE_LOG " (" \
+        COLUMN_ID_LOG " INTEGER PRIMARY KEY, " \
+        COLUMN_USER_ID_LOG " INTEGER NOT NULL, " \
+        COLUMN_DATETIME_LOG " INTEGER NOT NULL, " \
+        COLUMN_STATUS_LOG " INTEGER NOT NULL) STRICT;"
+
+#define CREATE_INDEX_ARCHIVE_LOG_USER_ID_DATETIME \
+    "CREATE INDEX IF NOT EXISTS " SCHEMA_ARCHIVE "." INDEX_LOG_USER_ID_DATETIME " ON " TABLE_LOG " (" \
+        COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ");"
+
+// Month of the oldest log row, if it ended at least (? - 1) months before the current month started.
+// ? is bound to a date modifier like "+2 months". Months are in local time, since that's how reports are read.
+// Row IDs grow with time, so the oldest row is found from the start of the table without scanning it.
+// Rows that an export cursor hasn't passed yet are never archived, see EXPORT CURSOR.
+// Returns the year, the month, and the start and end of the month in microseconds since the Unix epoch.
+#define SELECT_ARCHIVABLE_LOG_MONTH \
+    "SELECT CAST(strftime('%Y', seconds, 'unixepoch', 'localtime') AS INTEGER), " \
+           "CAST(strftime('%m', seconds, 'unixepoch', 'localtime') AS INTEGER), " \
+           "CAST(strftime('%s', seconds, 'unixepoch', 'localtime', 'start of month', 'utc') AS INTEGER) * 1000000, " \
+           "CAST(strftime('%s', seconds, 'unixepoch', 'localtime', 'start of month', '+1 month', 'utc') AS INTEGER) * 1000000" \
+    " FROM (SELECT " COLUMN_DATETIME_LOG " / 1000000 AS seconds FROM " TABLE_LOG \
+          " WHERE " COLUMN_ID_LOG " <= " SELECT_EXPORTED_LOG_ID_LIMIT " ORDER BY " COLUMN_ID_LOG " LIMIT 1)" \
+    " WHERE CAST(strftime('%s', seconds, 'unixepoch', 'localtime', 'start of month', ?, 'utc') AS INTEGER) <= " \
+           "CAST(strftime('%s', 'now', 'localtime', 'start of month', 'utc') AS INTEGER);"
+
+// The parameters of the batch statements: ?1 is the start of the month, ?2 the end of the month,
+// and ?3 the batch size or the ID of the last row in the batch.
+// Rows are taken in ID order, so the scan starts from the beginning of the table where the old rows are.
+#define SELECT_ARCHIVE_BATCH_LAST_ID \
+    "SELECT IFNULL(MAX(" COLUMN_ID_LOG "), 0) FROM (" \
+        "SELECT " COLUMN_ID_LOG " FROM main." TABLE_LOG \
+        " WHERE " COLUMN_DATETIME_LOG " >= ?1 AND " COLUMN_DATETIME_LOG " < ?2" \
+        " AND " COLUMN_ID_LOG " <= " SELECT_EXPORTED_LOG_ID_LIMIT \
+        " ORDER BY " COLUMN_ID_LOG " LIMIT ?3);"
+
+// OR IGNORE, so rows copied by a batch whose delete never finished are simply skipped.
+#define COPY_LOG_ROWS_TO_ARCHIVE \
+    "INSERT OR IGNORE INTO " SCHEMA_ARCHIVE "." TABLE_LOG \
+        " (" COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ") " \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG \
+    " FROM main." TABLE_LOG \
+    " WHERE " COLUMN_ID_LOG " <= ?3 AND " COLUMN_DATETIME_LOG " >= ?1 AND " COLUMN_DATETIME_LOG " < ?2;"
+
+// Only rows that are safely in the archive file are deleted.
+#define DELETE_ARCHIVED_LOG_ROWS \
+    "DELETE FROM main." TABLE_LOG \
+    " WHERE " COLUMN_ID_LOG " <= ?3 AND " COLUMN_DATETIME_LOG " >= ?1 AND " COLUMN_DATETIME_LOG " < ?2" \
+    " AND EXISTS (SELECT 1 FROM " SCHEMA_ARCHIVE "." TABLE_LOG " AS archived" \
+                " WHERE archived." COLUMN_ID_LOG " = main." TABLE_LOG "." COLUMN_ID_LOG ");"
+
+
+
+
+///////////////////
+// EXPORT CURSOR //
+///////////////////
+
+// clock_export remembers how far each named export has got, so the next run only reads the rows after it.
+// Row IDs of committed log rows only grow: SQLite has one writer at a time, and since schema version 7
+// the log table has AUTOINCREMENT, so IDs of deleted or archived rows are never handed out again.
+// file and file_size are the export file and its size after the last saved batch. A run that was interrupted
+// after writing a batch but before saving the cursor left extra rows in the file, the next run cuts them off.
+
+#define TABLE_EXPORT_CURSOR "export_cursor"
+#define COLUMN_NAME_EXPORT_CURSOR "name"
+#define COLUMN_LAST_LOG_ID_EXPORT_CURSOR "last_log_id"
+#define COLUMN_FILE_EXPORT_CURSOR "file"
+#define COLUMN_FILE_SIZE_EXPORT_CURSOR "file_size"
+
+#define CREATE_TABLE_EXPORT_CURSOR \
+    "CREATE TABLE IF NOT EXISTS " TABLE_EXPORT_CURSOR " (" \
+        COLUMN_NAME_EXPORT_CURSOR " TEXT PRIMARY KEY, " \
+        COLUMN_LAST_LOG_ID_EXPORT_CURSOR " INTEGER NOT NULL, " \
+        COLUMN_FILE_EXPORT_CURSOR " TEXT NOT NULL, " \
+        COLUMN_FILE_SIZE_EXPORT_CURSOR " INTEGER NOT NULL) STRICT;"
+
+#define SELECT_EXPORT_CURSOR \
+    "SELECT " COLUMN_LAST_LOG_ID_EXPORT_CURSOR ", " COLUMN_FILE_EXPORT_CURSOR ", " COLUMN_FILE_SIZE_EXPORT_CURSOR \
+    " FROM " TABLE_EXPORT_CURSOR \
+    " WHERE " COLUMN_NAME_EXPORT_CURSOR " = ?;"
+
+#define SAVE_EXPORT_CURSOR \
+    "INSERT INTO " TABLE_EXPORT_CURSOR \
+        " (" COLUMN_NAME_EXPORT_CURSOR ", " COLUMN_LAST_LOG_ID_EXPORT_CURSOR ", " \
+        COLUMN_FILE_EXPORT_CURSOR ", " COLUMN_FILE_SIZE_EXPORT_CURSOR ") " \
+    "VALUES (?, ?, ?, ?) " \
+    "ON CONFLICT (" COLUMN_NAME_EXPORT_CURSOR ") DO UPDATE SET " \
+        COLUMN_LAST_LOG_ID_EXPORT_CURSOR " = excluded." COLUMN_LAST_LOG_ID_EXPORT_CURSOR ", " \
+        COLUMN_FILE_EXPORT_CURSOR " = excluded." COLUMN_FILE_EXPORT_CURSOR ", " \
+        COLUMN_FILE_SIZE_EXPORT_CURSOR " = excluded." COLUMN_FILE_SIZE_EXPORT_CURSOR ";"
+
+#define DELETE_EXPORT_CURSOR \
+    "DELETE FROM " TABLE_EXPORT_CURSOR " WHERE " COLUMN_NAME_EXPORT_CURSOR " = ?;"
+
+// The next rows to export, read straight from the primary key, so a run costs the new rows only.
+#define SELECT_LOG_ROWS_AFTER_ID \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG \
+    " FROM " TABLE_LOG \
+    " WHERE " COLUMN_ID_LOG " > ?" \
+    " ORDER BY " COLUMN_ID_LOG " LIMIT ?;"
+
+// Where a new clock event journal starts. The largest ID ever handed out, even if that row has been deleted
+// or archived since, see AUTOINCREMENT LOG. 0 before the first row.
+#define SELECT_LATEST_LOG_ID \
+    "SELECT IFNULL((SELECT seq FROM " TABLE_SQLITE_SEQUENCE " WHERE name = '" TABLE_LOG "'), 0);"
+
+// Makes new log rows get IDs after ?, when something outside the database has already used the IDs up to it.
+// Schema version 7 always creates the sequence row, so changes() is 0 only if the schema is broken.
+#define ADVANCE_LOG_ID_SEQUENCE \
+    "UPDATE " TABLE_SQLITE_SEQUENCE " SET seq = MAX(seq, ?) WHERE name = '" TABLE_LOG "';"
+
+// Largest log row ID that every export cursor has passed. The archiver leaves newer rows in the log,
+// so an export never misses rows that were moved to an archive file. With no cursors, every row can be archived.
+#define SELECT_EXPORTED_LOG_ID_LIMIT \
+    "(SELECT IFNULL(MIN(" COLUMN_LAST_LOG_ID_EXPORT_CURSOR "), 9223372036854775807) FROM main." TABLE_EXPORT_CURSOR ")"
+
+
+
+///////////////////////
+// AUTOINCREMENT LOG //
+///////////////////////
+
+// Schema version 7 adds AUTOINCREMENT to log.id. Without it a new row gets the largest ID + 1, so deleting
+// the newest rows, or archiving every row, hands out IDs again that export cursors, the journal and the archive
+// files have already seen. With AUTOINCREMENT the largest ID ever used is kept in sqlite_sequence.
+// The table is rebuilt like in schema version 5. The view is dropped first, since renaming a table fails
+// while a view refers to a table that doesn't exist.
+
+#define TABLE_SQLITE_SEQUENCE "sqlite_sequence"
+
+#define CREATE_TABLE_LOG_AUTOINCREMENT_REBUILD \
+    "CREATE TABLE " TABLE_LOG_REBUILD " (" \
+        COLUMN_ID_LOG " INTEGER PRIMARY KEY AUTOINCREMENT, " \
+        COLUMN_USER_ID_LOG " INTEGER NOT NULL, " \
+        COLUMN_DATETIME_LOG " INTEGER NOT NULL, " \
+        COLUMN_STATUS_LOG " INTEGER NOT NULL, " \
+        "FOREIGN KEY (" COLUMN_USER_ID_LOG ") " \
+            "REFERENCES " TABLE_USER " (" COLUMN_ID_USER ")) STRICT;"
+
+#define COPY_LOG_TO_AUTOINCREMENT_REBUILD \
+    "INSERT INTO " TABLE_LOG_REBUILD \
+        " (" COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ") " \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG \
+    " FROM " TABLE_LOG ";"
+
+// IDs an export cursor has already passed may be gone from the log, so new rows start after them too.
+// The sequence row is renamed along with the table.
+#define SET_LOG_REBUILD_SEQUENCE \
+    "DELETE FROM " TABLE_SQLITE_SEQUENCE " WHERE name = '" TABLE_LOG_REBUILD "'; " \
+    "INSERT INTO " TABLE_SQLITE_SEQUENCE " (name, seq) " \
+    "SELECT '" TABLE_LOG_REBUILD "', MAX(" \
+        "(SELECT IFNULL(MAX(" COLUMN_ID_LOG "), 0) FROM " TABLE_LOG_REBUILD "), " \
+        "(SELECT IFNULL(MAX(" COLUMN_LAST_LOG_ID_EXPORT_CURSOR "), 0) FROM " TABLE_EXPORT_CURSOR "));"
+
+#define DROP_VIEW_LOG_READABLE "DROP VIEW IF EXISTS " VIEW_LOG_READABLE ";"
+
+
+
+/////////////
+// REPORTS //
+/////////////
+
+// clock_report reads main.log and the attached archive files as if they were one table.
+// The statements are compound SELECTs with one part per file, %s in the part formats is the schema name.
+// Every part is a search of the file's (user_id, datetime, status) index, so nothing is sorted in memory.
+
+// Next user ID with log rows after ?1, in any of the files. Each part is a single index seek.
+#define SELECT_NEXT_LOG_USER_ID_START "SELECT MIN(" COLUMN_USER_ID_LOG ") FROM ("
+#define SELECT_NEXT_LOG_USER_ID_PART_FORMAT \
+    "SELECT MIN(" COLUMN_USER_ID_LOG ") AS " COLUMN_USER_ID_LOG " FROM %s." TABLE_LOG \
+    " WHERE " COLUMN_USER_ID_LOG " > ?1"
+#define SELECT_NEXT_LOG_USER_ID_SEPARATOR " UNION ALL "
+#define SELECT_NEXT_LOG_USER_ID_END ");"
+
+// One page of the log rows of user ?1 between ?2 and ?3, continuing after the row (?4, ?5, ?6).
+// The rows are in index order, so the last row of a page is where the next page starts.
+// UNION instead of UNION ALL drops a row that is in two files, left there by an interrupted archive batch.
+// ?7 is the page size.
+#define SELECT_USERS_LOG_PAGE_START ""
+#define SELECT_USERS_LOG_PAGE_PART_FORMAT \
+    "SELECT " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ", " COLUMN_ID_LOG " FROM %s." TABLE_LOG \
+    " WHERE " COLUMN_USER_ID_LOG " = ?1 AND " COLUMN_DATETIME_LOG " >= ?2 AND " COLUMN_DATETIME_LOG " < ?3" \
+    " AND (" COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG ", " COLUMN_ID_LOG ") > (?4, ?5, ?6)"
+#define SELECT_USERS_LOG_PAGE_SEPARATOR " UNION "
+#define SELECT_USERS_LOG_PAGE_END " ORDER BY 1, 2, 3 LIMIT ?7;"
+
+
+
+/////////////////
+// MAINTENANCE //
+/////////////////
+
+// Run by maintenance.c in short slices while the keypad is idle.
+
+// 0 turns off the checkpoints SQLite runs on commit once the WAL is this many pages long.
+#define DISABLE_WAL_AUTOCHECKPOINT "PRAGMA wal_autocheckpoint = 0;"
+// Keeps PRAGMA optimize from reading whole tables when it decides to run ANALYZE.
+#define SET_ANALYSIS_LIMIT "PRAGMA analysis_limit = 400;"
+#define OPTIMIZE_DATABASE "PRAGMA optimize;"
+// 2 is INCREMENTAL.
+#define SELECT_AUTO_VACUUM "PRAGMA auto_vacuum;"
+#define AUTO_VACUUM_INCREMENTAL 2
+#define SELECT_FREELIST_COUNT "PRAGMA freelist_count;"
+// Pages can't be bound either, the number is formatted in with snprintf().
+#define INCREMENTAL_VACUUM_FORMAT "PRAGMA incremental_vacuum(%d);"
+// Returns the single row "ok", or at most 10 rows describing what's wrong.
+#define QUICK_CHECK_DATABASE "PRAGMA quick_check(10);"
+#define QUICK_CHECK_OK "ok"
+
+
+
+///////////
+// ADMIN //
+///////////
+
+// Used by clock_admin. Every value is bound, nothing typed by the admin is pasted into SQL.
+// The triggers on the user and log tables keep user_change and user_status up to date as usual.
+
+// clock_admin batch runs every line inside a savepoint, so a failed line is undone without losing the lines
+// before it in the same transaction.
+#define SAVEPOINT_ADMIN_LINE "SAVEPOINT admin_line;"
+#define RELEASE_ADMIN_LINE "RELEASE admin_line;"
+#define ROLLBACK_ADMIN_LINE "ROLLBACK TO admin_line; RELEASE admin_line;"
+
+// NULL keeps a column as it is. changes() is 0 if there is no such user.
+#define UPDATE_USER_ROW_BY_ID \
+    "UPDATE " TABLE_USER " SET " \
+        COLUMN_FIRST_NAME_USER " = IFNULL(?2, " COLUMN_FIRST_NAME_USER "), " \
+        COLUMN_LAST_NAME_USER " = IFNULL(?3, " COLUMN_LAST_NAME_USER "), " \
+        COLUMN_PIN_USER " = IFNULL(?4, " COLUMN_PIN_USER ") " \
+    "WHERE " COLUMN_ID_USER " = ?1;"
+
+#define DELETE_USER_ROW_BY_ID \
+    "DELETE FROM " TABLE_USER " WHERE " COLUMN_ID_USER " = ?;"
+
+// The delete trigger keeps the last known status of a user with no rows left, so it's removed separately.
+#define DELETE_USER_STATUS_BY_USER_ID \
+    "DELETE FROM " TABLE_USER_STATUS " WHERE " COLUMN_USER_ID_USER_STATUS " = ?;"
+
+// Foreign keys aren't enforced, so a user with log rows is only removed together with them.
+#define SELECT_USER_HAS_LOG_ROWS \
+    "SELECT EXISTS (SELECT 1 FROM " TABLE_LOG " WHERE " COLUMN_USER_ID_LOG " = ?);"
+
+#define DELETE_LOG_ROWS_BY_USER_ID \
+    "DELETE FROM " TABLE_LOG " WHERE " COLUMN_USER_ID_LOG " = ?;"
+
+// NULL keeps a column as it is. changes() is 0 if there is no such row, archived rows included.
+#define UPDATE_LOG_ROW_BY_ID \
+    "UPDATE " TABLE_LOG " SET " \
+        COLUMN_DATETIME_LOG " = IFNULL(?2, " COLUMN_DATETIME_LOG "), " \
+        COLUMN_STATUS_LOG " = IFNULL(?3, " COLUMN_STATUS_LOG ") " \
+    "WHERE " COLUMN_ID_LOG " = ?1;"
+
+#define DELETE_LOG_ROW_BY_ID \
+    "DELETE FROM " TABLE_LOG " WHERE " COLUMN_ID_LOG " = ?;"
+
+// One page of users with their current status, after user ID ?1. With ?2 set to a status, only users with that
+// status, like the users who are in right now. Status is NULL for users who have never clocked in. ?3 is the page size.
+#define SELECT_USER_ROWS_AFTER_ID \
+    "SELECT " TABLE_USER "." COLUMN_ID_USER ", " COLUMN_FIRST_NAME_USER ", " COLUMN_LAST_NAME_USER ", " \
+              TABLE_USER_STATUS "." COLUMN_STATUS_USER_STATUS ", " TABLE_USER_STATUS "." COLUMN_SINCE_USER_STATUS \
+    " FROM " TABLE_USER \
+    " LEFT JOIN " TABLE_USER_STATUS " ON " TABLE_USER_STATUS "." COLUMN_USER_ID_USER_STATUS " = " TABLE_USER "." COLUMN_ID_USER \
+    " WHERE " TABLE_USER "." COLUMN_ID_USER " > ?1" \
+    " AND (?2 IS NULL OR " TABLE_USER_STATUS "." COLUMN_STATUS_USER_STATUS " = ?2)" \
+    " ORDER BY " TABLE_USER "." COLUMN_ID_USER " LIMIT ?3;"
+
+// The latest log rows of a user, newest first, straight from the (user_id, datetime, status) index.
+#define SELECT_USERS_LATEST_LOG_ROWS \
+    "SELECT " COLUMN_ID_LOG ", " COLUMN_USER_ID_LOG ", " COLUMN_DATETIME_LOG ", " COLUMN_STATUS_LOG \
+    " FROM " TABLE_LOG \
+    " WHERE " COLUMN_USER_ID_LOG " = ?" \
+    " ORDER BY " COLUMN_DATETIME_LOG " DESC LIMIT ?;"
+
+
+
+///////////
+// SPOOL //
+///////////
+
+// Tells whether a spooled clock event was already saved, by a replay that committed but didn't get to mark
+// the event replayed before a power cut. Found straight from the (user_id, datetime, status) index.
+#define SELECT_LOG_ROW_ID_BY_EVENT \
+    "SELECT " COLUMN_ID_LOG " FROM " TABLE_LOG \
+    " WHERE " COLUMN_USER_ID_LOG " = ?1 AND " COLUMN_DATETIME_LOG " = ?2 AND " COLUMN_STATUS_LOG " = ?3 LIMIT 1;"
+
+
+
+#endif // DATABASE_SQL_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+/**
+ * @file gpio_backend.h
+ * @author Selkamies
+ *
+ * @brief The GPIO backends, chosen when the program starts. gpio_functions.c and gpio_init.c go through
+ * the active backend, so the program runs with pigpio on a Raspberry Pi, with the kernel's GPIO character
+ * device through libgpiod, or with the simulated keypad on any Linux machine.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef GPIO_BACKEND_H
+#define GPIO_BACKEND_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t.
+
+#include "gpio_config.h"        // struct GPIOConfig.
+
+
+
+/**
+ * @brief Function called by the backend's own thread when the level of a GPIO pin changes.
+ *
+ * @param pinNumber The pin number of the GPIO pin.
+ * @param level 0 or 1 for the new level. Other values aren't level changes and should be ignored.
+ * @param tick Time of the change in microseconds, see getGPIOTick(). Wraps around about every 72 minutes.
+ * @param data Pointer given to setGPIOPinAlert().
+ */
+typedef void (*GPIOAlertFunction)(int pinNumber, int level, uint32_t tick, void *data);
+
+/**
+ * @brief Direction of a GPIO pin.
+ */
+enum GPIOPinMode
+{
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT
+};
+
+/**
+ * @brief Pull resistor of a GPIO pin.
+ */
+enum GPIOPinPull
+{
+    GPIO_PULL_NONE,
+    GPIO_PULL_UP,
+    GPIO_PULL_DOWN
+};
+
+/**
+ * @brief Operations every GPIO backend has. Levels are the raw pin levels, 0 or 1.
+ * The bank operations cover pins 0-31 with one call, backends without a bank register loop through the pins.
+ */
+struct GPIOBackend
+{
+    /** @brief Name used for BACKEND in config.ini. */
+    const char *name;
+    /** @brief Starts the backend. Returns false if it can't be used. */
+    bool (*initialize)(const struct GPIOConfig *gpioConfig);
+    /** @brief Stops the backend and releases the pins. */
+    void (*cleanup)(void);
+    /** @brief Sets the direction of the pin. */
+    void (*setMode)(int pinNumber, enum GPIOPinMode mode);
+    /** @brief Sets the pull resistor of the pin. */
+    void (*setPull)(int pinNumber, enum GPIOPinPull pull);
+    /** @brief Returns the level of the pin. */
+    int (*read)(int pinNumber);
+    /** @brief Drives an output pin to the level. */
+    void (*write)(int pinNumber, int level);
+    /** @brief Returns the levels of pins 0-31, bit n for pin n. */
+    uint32_t (*readBank)(void);
+    /** @brief Drives the output pins in the mask high. */
+    void (*setBank)(uint32_t pinMask);
+    /** @brief Drives the output pins in the mask low. */
+    void (*clearBank)(uint32_t pinMask);
+    /** @brief Registers a function to call when the level of the pin changes, NULL to remove it. Returns false if it can't. */
+    bool (*setAlert)(int pinNumber, GPIOAlertFunction function, void *data);
+    /** @brief Returns the clock the alert ticks use, in microseconds. */
+    uint32_t (*getTick)(void);
+    /** @brief Sleeps for the given time. */
+    void (*sleep)(double seconds);
+    /** @brief Tells the backend which pins form the keypad matrix, once they are set up. NULL if the backend doesn't care. */
+    void (*setKeypadPins)(const int *rowPins, int rowCount, const int *columnPins, int columnCount);
+};
+
+
+
+/**
+ * @brief The active backend, set by initializeGPIOLibrary(). Not changed while the program runs.
+ */
+extern const struct GPIOBackend *gpioBackend;
+
+/** @brief Uses the pigpio library, needs root. Only built if pigpio was found. */
+extern const struct GPIOBackend pigpioGPIOBackend;
+/** @brief Uses the kernel's GPIO character device through libgpiod v2. Only built if libgpiod was found. */
+extern const struct GPIOBackend gpiodGPIOBackend;
+/** @brief In-process pins with a keypad matrix, see gpio_simulator.h. Always built. */
+extern const struct GPIOBackend simulatedGPIOBackend;
+
+
+
+/**
+ * @brief Finds a backend that was built into the program by its name.
+ *
+ * @param name Name of the backend, like "pigpio".
+ *
+ * @return const struct GPIOBackend* The backend, or NULL if there is no backend with that name.
+ */
+const struct GPIOBackend *findGPIOBackend(const char *name);
+
+
+
+#endif // GPIO_BACKEND_H
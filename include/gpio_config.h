@@ -0,0 +1,43 @@
+/**
+ * @file gpio_config.h
+ * @author Selkamies
+ *
+ * @brief Defines GPIOConfig struct, which holds the GPIO backend selection read from config.ini.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef GPIO_CONFIG_H
+#define GPIO_CONFIG_H
+
+
+
+/** @brief Longest GPIO backend name, including the null terminator. */
+#define GPIO_BACKEND_NAME_LENGTH 16
+/** @brief Longest GPIO chip or script path, including the null terminator. */
+#define GPIO_PATH_LENGTH 64
+
+
+
+/**
+ * @brief Struct holding the variables needed to choose and start the GPIO backend.
+ * The upper case members are read from the [GPIO] section of config.ini.
+ */
+struct GPIOConfig
+{
+    /** @brief Name of the GPIO backend: "pigpio", "gpiod" or "simulated". */
+    char BACKEND[GPIO_BACKEND_NAME_LENGTH];
+    /** @brief GPIO character device used by the gpiod backend. */
+    char GPIOD_CHIP[GPIO_PATH_LENGTH];
+    /** @brief Key press script the simulated backend plays, empty for none. Relative to the executable location. */
+    char SIMULATOR_SCRIPT[GPIO_PATH_LENGTH];
+};
+
+
+
+#endif // GPIO_CONFIG_H
@@ -2,10 +2,10 @@
  * @file gpio_functions.h
  * @author Selkamies
  * 
- * @brief Handles all the GPIO pin operations required by keypad using pigpio.
+ * @brief Handles all the GPIO pin operations required by keypad, through the active GPIO backend.
  * 
  * @date Created 2023-11-13
- * @date Updated 2023-12-07
+ * @date Updated 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
@@ -17,6 +17,13 @@
 
 
 
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t.
+
+#include "gpio_backend.h"       // GPIOAlertFunction.
+
+
+
 // Forward declaration.
 struct KeypadConfig;
 
@@ -39,16 +46,58 @@ void turnGPIOPinOff(const int pinNumber);
 /**
  * @brief Checks if the GPIO pin is on.
  * 
- * @param pinNumber GPIO pin number for pigpio.
- * @return true If gpioRead(pinNumber) = 0.
- * @return false If gpioRead(pinNumber) = 1.
+ * @param pinNumber The pin number for the GPIO pin.
+ * @return true If the pin reads 0.
+ * @return false If the pin reads 1.
  */
 bool isGPIOPinOn(const int pinNumber);
 
+/**
+ * @brief Turns on every GPIO pin in the mask with one register write. Only the first bank, pins 0-31.
+ * 
+ * @param pinMask Bit (1 << pinNumber) set for every GPIO pin to turn on.
+ */
+void turnGPIOPinsOn(const uint32_t pinMask);
+
+/**
+ * @brief Turns off every GPIO pin in the mask with one register write. Only the first bank, pins 0-31.
+ * 
+ * @param pinMask Bit (1 << pinNumber) set for every GPIO pin to turn off.
+ */
+void turnGPIOPinsOff(const uint32_t pinMask);
+
+/**
+ * @brief Checks which GPIO pins in the mask are on with one register read. Only the first bank, pins 0-31.
+ * 
+ * @param pinMask Bit (1 << pinNumber) set for every GPIO pin to check.
+ * @return uint32_t The bits of the pins in pinMask that are on, like isGPIOPinOn() (read 0).
+ */
+uint32_t getGPIOPinsOn(const uint32_t pinMask);
+
+/**
+ * @brief Registers a function to call whenever the level of the GPIO pin changes.
+ * 
+ * @param pinNumber The pin number for the GPIO pin.
+ * @param function Function to call, or NULL to stop calling the registered one.
+ * @param data Pointer passed to the function.
+ * 
+ * @return true If the function was registered or removed.
+ * @return false If the backend refused, for example because of a bad pin number, or has no edge alerts.
+ */
+bool setGPIOPinAlert(const int pinNumber, GPIOAlertFunction function, void *data);
+
+/**
+ * @brief Returns the GPIO library's current tick, the same clock as the ticks given to alert functions.
+ * 
+ * @return uint32_t Microseconds since the library was initialized, wrapping around.
+ */
+uint32_t getGPIOTick();
+
 
 
 /**
- * @brief Set the keypad GPIO pins to correct starting states.
+ * @brief Set the keypad GPIO pins to correct starting states, and the pin masks for bank access if every pin is in the first bank.
+ * Tells the backend which pins form the keypad, the simulated backend wires its keys between them.
  * 
  * @param keypadPins Struct with the GPIO pin numbers of keypad rows and columns.
  * @param config Struct holding keypad config info, like the number of rows and columns in the keypad.
@@ -2,10 +2,11 @@
  * @file gpio_init.h
  * @author Selkamies
  * 
- * @brief Manages the pigpio library initialization. pigpio handles the GPIO pins of Raspberry Pi.
+ * @brief Chooses and starts the GPIO backend. pigpio handles the GPIO pins of Raspberry Pi,
+ * libgpiod uses the kernel's GPIO character device and the simulated backend runs anywhere.
  * 
  * @date Created 2023-11-13
- * @date Modified 2023-11-23
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
@@ -18,6 +19,15 @@
 #include <signal.h>     // sig_atomic_t, signal() and SIGINT used by pigpio.
 #include <stdbool.h>
 
+#include "gpio_config.h"    // struct GPIOConfig.
+
+
+
+/** @brief GPIO backend used if config.ini doesn't choose one. */
+#define GPIO_DEFAULT_BACKEND "pigpio"
+/** @brief GPIO chip used by the gpiod backend if config.ini doesn't choose one. */
+#define GPIO_DEFAULT_GPIOD_CHIP "/dev/gpiochip0"
+
 
 
 /**
@@ -33,22 +43,31 @@ extern volatile sig_atomic_t signal_received;
 void signalHandler(int signo);
 
 /**
- * @brief Initializes the pigpio connection, so that we can use the GPIO pins.
+ * @brief Sets the default GPIO settings, used for the values config.ini doesn't have.
+ * 
+ * @param gpioConfig Struct holding the GPIO backend settings.
+ */
+void setGPIODefaults(struct GPIOConfig *gpioConfig);
+
+/**
+ * @brief Starts the GPIO backend chosen in config.ini, so that we can use the GPIO pins.
+ * 
+ * @param gpioConfig Struct holding the GPIO backend settings.
  * 
- * @return true If pigpio was initialized successfully.
- * @return false If pigpio was not initialized.
+ * @return true If the backend was initialized successfully.
+ * @return false If the backend isn't built into the program or could not be initialized.
  */
-bool initializeGPIOLibrary();
+bool initializeGPIOLibrary(const struct GPIOConfig *gpioConfig);
 
 /**
- * @brief Uses pigpio's time_sleep() to sleep.
+ * @brief Sleeps with the GPIO backend's sleep, pigpio's time_sleep() for pigpio.
  * 
  * @param seconds Duration in seconds, how long to sleep.
  */
 void sleepGPIOLibrary(double seconds);
 
 /**
- * @brief Terminates pigpio gracefully.
+ * @brief Stops the GPIO backend gracefully.
  */
 void cleanupGPIOLibrary();
 
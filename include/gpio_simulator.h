@@ -0,0 +1,46 @@
+/**
+ * @file gpio_simulator.h
+ * @author Selkamies
+ *
+ * @brief The simulated GPIO backend. Its pins live in memory and a keypad matrix is wired between the
+ * keypad row and column pins, so the program runs and can be timed on any Linux machine.
+ * A pressed key connects its row and column pin: a column input reads the level of a row output
+ * through every pressed key in it, and its pull resistor otherwise. Level changes call the alert
+ * functions right away, from the thread that caused them.
+ *
+ * Keys are pressed with pressSimulatedKey(), or by a script set with SIMULATOR_SCRIPT in config.ini.
+ * The script is played in its own thread once the keypad pins are set up. Each line is
+ *
+ *     <seconds> press|release <row> <column>
+ *
+ * where seconds counts from the start of the script. Empty lines and lines starting with # are skipped.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef GPIO_SIMULATOR_H
+#define GPIO_SIMULATOR_H
+
+
+
+#include <stdbool.h>
+
+
+
+/**
+ * @brief Presses or releases a key of the simulated keypad, and calls the alert functions of the pins that changed.
+ *
+ * @param row Row of the key, from 0.
+ * @param column Column of the key, from 0.
+ * @param pressed true to press the key, false to release it.
+ */
+void pressSimulatedKey(const int row, const int column, const bool pressed);
+
+
+
+#endif // GPIO_SIMULATOR_H
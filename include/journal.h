@@ -0,0 +1,190 @@
+/**
+ * @file journal.h
+ * @author Selkamies
+ *
+ * @brief Append-only journal of saved log rows, for replicating them upstream with clock_shipper.
+ *
+ * The journal is a folder of segment files of JOURNAL_SEGMENT_RECORDS fixed-size records each.
+ * The record with sequence number S is at index (S - 1) % JOURNAL_SEGMENT_RECORDS of segment
+ * (S - 1) / JOURNAL_SEGMENT_RECORDS, so a reader finds any record without an index.
+ * A slot whose sequence number or CRC doesn't match hasn't been written yet.
+ *
+ * @date Created  2024-01-19
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+
+
+#include <stdbool.h>
+#include <stddef.h>             // size_t.
+#include <stdint.h>             // uint32_t, uint64_t, int64_t.
+
+
+
+// Forward declarations.
+struct JournalConfig;
+struct DatabaseConfig;
+
+
+
+/** @brief Records per segment file. Segments are JOURNAL_SEGMENT_RECORDS * JOURNAL_RECORD_SIZE bytes, 2.5 MiB. */
+#define JOURNAL_SEGMENT_RECORDS 65536
+/** @brief Size of a record in bytes. Part of the upstream format, never change it. */
+#define JOURNAL_RECORD_SIZE 40
+/** @brief Segment file names start with this and end with JOURNAL_SEGMENT_NAME_SUFFIX. */
+#define JOURNAL_SEGMENT_NAME_PREFIX "journal_"
+#define JOURNAL_SEGMENT_NAME_SUFFIX ".bin"
+/** @brief Segment file path, with the journal folder and the segment index. */
+#define JOURNAL_SEGMENT_FILE_FORMAT "%s/" JOURNAL_SEGMENT_NAME_PREFIX "%010llu" JOURNAL_SEGMENT_NAME_SUFFIX
+/** @brief Longest segment file name, without the null terminator. The index has at most 20 digits. */
+#define JOURNAL_SEGMENT_NAME_LENGTH (sizeof(JOURNAL_SEGMENT_NAME_PREFIX) - 1 + 20 + sizeof(JOURNAL_SEGMENT_NAME_SUFFIX) - 1)
+/** @brief Longest path of a file in the journal folder, including the null terminator. */
+#define JOURNAL_PATH_LENGTH 4096
+/** @brief Longest journal folder path, so that every file in it fits in JOURNAL_PATH_LENGTH with the '/'. */
+#define JOURNAL_MAX_DIRECTORY_LENGTH (JOURNAL_PATH_LENGTH - JOURNAL_SEGMENT_NAME_LENGTH - 2)
+/** @brief File in the journal folder holding the sequence number of the last record acknowledged upstream. */
+#define JOURNAL_ACK_FILE_NAME "shipped"
+
+/**
+ * @brief One saved log row. Little-endian, as written by the Raspberry Pi.
+ * Upstream can tell records apart by terminalID and logID, a record may be delivered more than once.
+ */
+struct JournalRecord
+{
+    /** @brief 1 for the first record ever written, then one more for every record. */
+    uint64_t sequence;
+    /** @brief ID of the row in the terminal's log table. */
+    int64_t logID;
+    /** @brief Time of the clock event in microseconds since the Unix epoch. */
+    int64_t timestamp;
+    /** @brief TERMINAL_ID from config.ini. */
+    uint32_t terminalID;
+    int32_t userID;
+    /** @brief LOG_STATUS_IN or LOG_STATUS_OUT. */
+    int32_t status;
+    /** @brief CRC-32 of all the fields above. */
+    uint32_t crc;
+};
+
+_Static_assert(sizeof(struct JournalRecord) == JOURNAL_RECORD_SIZE, "Journal records must be 40 bytes.");
+
+
+
+/**
+ * @brief Sets the journal settings used if config.ini has no [JOURNAL] section. The journal is off by default.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ */
+void setJournalDefaults(struct JournalConfig *journalConfig);
+
+/**
+ * @brief Maps the latest segment and finds where to continue. Log rows saved since the latest record,
+ * for example just before a power cut, are written to the journal first. Has to be called before the
+ * log writer thread is started.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param databaseConfig Struct holding the database connection, used for catching up.
+ *
+ * @return true If the journal is ready.
+ * @return false If it's disabled or couldn't be opened. Nothing is written to it then.
+ */
+bool initializeJournal(struct JournalConfig *journalConfig, struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Appends a saved log row to the journal. Only a copy to the mapped file, never waits for the disk.
+ * Call only after the row's transaction has been committed. Safe to call from the log writer thread.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param logID ID of the log row.
+ * @param userID User ID of the row.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the row in microseconds since the Unix epoch.
+ *
+ * @return true If the record was appended, or the journal is disabled.
+ * @return false If the next segment couldn't be created. The row is written after the next start.
+ */
+bool appendJournalRecord(struct JournalConfig *journalConfig, const int64_t logID, const int userID, const int status,
+                         const int64_t timestamp);
+
+/**
+ * @brief Flushes and unmaps the segment. Has to be called after cleanupLogWriter().
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ */
+void cleanupJournal(struct JournalConfig *journalConfig);
+
+/**
+ * @brief Checks that a slot holds the record with the sequence number and that its CRC matches.
+ *
+ * @param record The slot.
+ * @param sequence Sequence number the slot should have.
+ *
+ * @return true If the record has been completely written.
+ * @return false If the slot is empty, half-written or from an older run.
+ */
+bool isValidJournalRecord(const struct JournalRecord *record, const uint64_t sequence);
+
+/**
+ * @brief Calculates the CRC-32 of some bytes. Also used for the records of the spool file.
+ *
+ * @param bytes The bytes.
+ * @param length Number of bytes.
+ *
+ * @return uint32_t CRC-32, the same as zlib's crc32().
+ */
+uint32_t calculateCRC32(const void *bytes, const size_t length);
+
+/**
+ * @brief Formats the path of a segment file.
+ *
+ * @param buffer Buffer the path is written to.
+ * @param size Size of the buffer.
+ * @param directory The journal folder.
+ * @param segmentIndex Index of the segment.
+ */
+void formatJournalSegmentPath(char *buffer, const size_t size, const char *directory, const uint64_t segmentIndex);
+
+/**
+ * @brief Reads the segment index from the name of a file in the journal folder.
+ *
+ * @param fileName Name of the file, without the folder.
+ * @param segmentIndex Pointer to the index.
+ *
+ * @return true If the file is a segment file.
+ * @return false If it's something else, like the ack file.
+ */
+bool parseJournalSegmentName(const char *fileName, uint64_t *segmentIndex);
+
+/**
+ * @brief Reads the sequence number of the last record acknowledged upstream.
+ *
+ * @param directory The journal folder.
+ * @param sequence Pointer to the sequence number. 0 if nothing has been acknowledged.
+ *
+ * @return true If the file was read.
+ * @return false If there is no file yet.
+ */
+bool readJournalAck(const char *directory, uint64_t *sequence);
+
+/**
+ * @brief Saves the sequence number of the last record acknowledged upstream.
+ * Written to a temporary file and renamed over the old one, so a crash leaves one or the other.
+ *
+ * @param directory The journal folder.
+ * @param sequence The sequence number.
+ *
+ * @return true If the file was saved.
+ * @return false If something went wrong.
+ */
+bool saveJournalAck(const char *directory, const uint64_t sequence);
+
+
+
+#endif // JOURNAL_H
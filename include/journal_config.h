@@ -0,0 +1,65 @@
+/**
+ * @file journal_config.h
+ * @author Selkamies
+ *
+ * @brief Defines JournalConfig struct, which holds basically all data used by journal.c.
+ *
+ * @date Created  2024-01-19
+ * @date Modified 2024-01-19
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef JOURNAL_CONFIG_H
+#define JOURNAL_CONFIG_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // uint64_t, int64_t.
+#include <pthread.h>            // pthread_mutex_t.
+
+
+
+/** @brief Longest journal folder path, including the null terminator. */
+#define JOURNAL_DIRECTORY_LENGTH 64
+
+
+
+// Forward declaration.
+struct JournalRecord;
+
+
+
+/**
+ * @brief Struct holding all the variables needed by journal.c.
+ * The upper case members are read from the [JOURNAL] section of config.ini.
+ */
+struct JournalConfig
+{
+    /** @brief Whether saved log rows are written to the journal at all. */
+    bool ENABLED;
+    /** @brief Identifies this terminal upstream. Written to every record. */
+    int TERMINAL_ID;
+    /** @brief Folder of the segment files, relative to the executable location. */
+    char DIRECTORY[JOURNAL_DIRECTORY_LENGTH];
+
+    /** @brief Whether a segment is mapped and records can be appended. */
+    bool open;
+    /** @brief The log writer thread and the main loop can both append. */
+    pthread_mutex_t lock;
+    /** @brief The mapped segment file, JOURNAL_SEGMENT_RECORDS records long. */
+    struct JournalRecord *segment;
+    /** @brief Index of the mapped segment. */
+    uint64_t segmentIndex;
+    /** @brief Sequence number the next record gets. */
+    uint64_t nextSequence;
+    /** @brief ID of the latest log row written to the journal. */
+    int64_t lastLogID;
+};
+
+
+
+#endif // JOURNAL_CONFIG_H
@@ -3,10 +3,10 @@
  * @author Selkamies
  * 
  * @brief Handles the input from a keypad attached to Raspberry Pi 4. 
- * This file contains the logic, all GPIO pin handling by pigpio is in keypad_gpio.h.
+ * This file contains the logic, all GPIO pin handling is in gpio_functions.h.
  * 
  * @date Created  2023-11-13
- * @date Modified 2023-12-07
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
@@ -18,17 +18,64 @@
 
 
 
+#include <stdbool.h>
+
+
+
 // Forward declarations.
 struct ConfigData;
 struct KeypadConfig;
 
 
 
+/**
+ * @brief Sets the keypad settings that config.ini may leave out to their defaults, before config.ini is read.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+void setKeypadDefaults(struct KeypadConfig *keypadConfig);
+
 /**
  * @brief Updates the keypad status and handles key presses if necessary.
+ * With EDGE_TRIGGERED the matrix is scanned right after an edge, and polled only while a key is down.
+ * With SCAN_THREAD the scan thread does the scanning, and this only handles the key events it has queued.
  */
 void updateKeypad(struct ConfigData *configData);
 
+/**
+ * @brief Sleeps until the scan thread queues key events, or until an edge on a keypad column if the main loop
+ * scans the keypad itself. Returns when the time is up at the latest.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * @param seconds Longest time to sleep.
+ * 
+ * @return true If there's a scan thread or edge alerts, whether they woke us or not.
+ * @return false If the main loop polls the keypad. Returns right away, the caller has to sleep itself.
+ */
+bool waitForKeypadInput(struct KeypadConfig *keypadConfig, const double seconds);
+
+/**
+ * @brief Checks whether nobody is using the keypad: no keys down and no PIN being entered.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return true If the keypad is idle.
+ * @return false If it's in use.
+ */
+bool isKeypadIdle(const struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Checks whether any keypad key is down, with one read of every column while all rows are off.
+ * Doesn't touch the keypad state, so the press is still handled by the next updateKeypad().
+ * Fast enough to call while the database is busy with maintenance.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return true If a key is down.
+ * @return false If no key is down.
+ */
+bool isAnyKeypadKeyDown(const struct KeypadConfig *keypadConfig);
+
 
 
 /**
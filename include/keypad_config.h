@@ -5,7 +5,7 @@
  * @brief Defines KeypadConfig struct, which holds basically all data used by the keypad.c.
  * 
  * @date Created  2023-12-07
- * @date Modified 2023-12-18
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  * 
@@ -20,6 +20,66 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>             // uint32_t, int64_t.
+#include <stdatomic.h>          // atomic_bool, atomic_uint, atomic_ulong.
+#include <semaphore.h>          // sem_t.
+#include <pthread.h>            // pthread_t.
+
+#include "keypad_debounce.h"    // struct KeyDebounceState, struct KeyDebounceTiming.
+
+
+
+/** @brief Most rows a keypad can have. The whole matrix fits in one uint64_t. */
+#define KEYPAD_MAX_ROWS 8
+/** @brief Most columns a keypad can have. */
+#define KEYPAD_MAX_COLUMNS 8
+/** @brief Most keys a keypad can have. */
+#define KEYPAD_MAX_KEYS (KEYPAD_MAX_ROWS * KEYPAD_MAX_COLUMNS)
+/** @brief Index of a key in the key arrays, and its bit in the key masks. A row's keys are one byte of the mask. */
+#define KEYPAD_KEY_INDEX(row, column) ((row) * KEYPAD_MAX_COLUMNS + (column))
+
+/** @brief Number of key events the keypad event queue can hold. Has to be a power of two. */
+#define KEYPAD_EVENT_QUEUE_CAPACITY 64
+
+
+
+/**
+ * @brief A debounced key press or release.
+ */
+struct KeypadEvent
+{
+    /** @brief The key, from [KEYPAD_KEYS]. */
+    char key;
+    /** @brief Row of the key. */
+    int row;
+    /** @brief Column of the key. */
+    int column;
+    /** @brief true for a press, false for a release. */
+    bool pressed;
+    /** @brief When the key first read the new state, in monotonic nanoseconds. */
+    int64_t time;
+    /** @brief Whether the key was pressed while no other key was down, so the press isn't ambiguous. Only for presses. */
+    bool alone;
+};
+
+/**
+ * @brief Single producer, single consumer ring buffer of key events. The scan is the only producer and the PIN
+ * handling is the only consumer, so a slow clock event never makes the scan miss a key.
+ * head and tail only ever grow, the slot of an event is its sequence number modulo capacity.
+ */
+struct KeypadEventQueue
+{
+    /** @brief The events. A slot is free again once tail has passed it. */
+    struct KeypadEvent events[KEYPAD_EVENT_QUEUE_CAPACITY];
+    /** @brief Sequence number of the next event to queue. Written by the scan only. */
+    atomic_ulong head;
+    /** @brief Sequence number of the next event to handle. Written by the PIN handling only. */
+    atomic_ulong tail;
+    /** @brief Number of events dropped because the queue was full. Written by the scan only. */
+    atomic_ulong droppedCount;
+    /** @brief Most events that have been waiting in the queue at once. Written by the scan only. */
+    atomic_ulong maxDepth;
+};
 
 
 
@@ -28,19 +88,24 @@
  */
 struct KeypadState
 {
-    /** @brief Holds the keys in the keypad, in the corresponding positions. */
-    char **keys;
-    /** @brief State of keys (pressed or not) during previous check. 
-     * Used to check for changes, so that we only register button press once. */
-    bool **keysPressedPreviously;
-    /** @brief Current keypad key that is pressed. */
-    char keyPressed;
-    /** @brief Whether exactly one keypad key is pressed during a keypad update. */
-    bool exactlyOneKeyPressed;
-    /** @brief Whether any keypad key is pressed during a keypad update. */
-    bool anyKeysPressed;
-    /** @brief Whether no keypad keys were pressed during a previous keypad update. */
-    bool noKeysPressedPreviously;
+    /** @brief Holds the keys in the keypad, at KEYPAD_KEY_INDEX(row, column). */
+    char keys[KEYPAD_MAX_KEYS];
+    /** @brief Debounce state of every key, at KEYPAD_KEY_INDEX(row, column). */
+    struct KeyDebounceState keyStates[KEYPAD_MAX_KEYS];
+    /** @brief Keys that read pressed in the latest scan, one bit per key at KEYPAD_KEY_INDEX(row, column). */
+    uint64_t keysRead;
+    /** @brief Keys that are pressed after debouncing. Used to check for changes, so that we only register button press once. */
+    uint64_t keysDown;
+    /** @brief Keys that read differently from their debounced state. */
+    uint64_t keysSettling;
+    /** @brief Presses and releases found by the latest scan, before they're queued. Room for one per key. */
+    struct KeypadEvent scanEvents[KEYPAD_MAX_KEYS];
+    /** @brief Number of events in scanEvents. */
+    int scanEventCount;
+    /** @brief Whether any keypad key is pressed during a keypad update. Read by the main loop while the scan thread writes it. */
+    atomic_bool anyKeysPressed;
+    /** @brief Whether any key reads differently from its debounced state, so the keypad has to be scanned again soon. */
+    atomic_bool anyKeysSettling;
     /** @brief Time when last keypad update was done. */
     double lastUpdateTime;
     /** @brief Key used to start waiting for PIN for clocking IN. */
@@ -68,15 +133,77 @@ struct PINState
     int status;
 };
 
+/**
+ * @brief Edges seen on the column pins while all rows are driven low. Written by the GPIO backend's alert thread
+ * and read by the main loop. Level changes caused by the scan itself are ignored by their tick.
+ */
+struct KeypadEdgeState
+{
+    /** @brief Whether the alert functions are registered. If not, the keypad is polled. */
+    bool running;
+    /** @brief Set by an edge, cleared by the scan that handles it. */
+    atomic_bool edgePending;
+    /** @brief Whether a scan is toggling the rows right now. */
+    atomic_bool scanning;
+    /** @brief GPIO tick when the current or last scan started, in microseconds. */
+    atomic_uint scanStartTick;
+    /** @brief GPIO tick when the last scan had driven the rows low again, in microseconds. */
+    atomic_uint scanEndTick;
+    /** @brief Posted once per pending edge, so the main loop can sleep until a key is pressed. */
+    sem_t wakeup;
+};
+
+/**
+ * @brief How well the scan thread keeps its schedule. Written by the scan thread and read by the main loop.
+ * Jitter is how much later than its deadline the thread woke up. Wakeups by an edge have no deadline and aren't counted.
+ */
+struct KeypadScanStatistics
+{
+    /** @brief Number of scans started at a deadline. */
+    atomic_ulong scheduledScanCount;
+    /** @brief Number of times the thread woke up more than a whole interval late, so at least one scan was skipped. */
+    atomic_ulong lateCount;
+    /** @brief Sum of the jitter of all scheduled scans, in nanoseconds. */
+    atomic_ullong totalJitterNanoseconds;
+    /** @brief Largest jitter seen, in nanoseconds. */
+    atomic_ullong maxJitterNanoseconds;
+};
+
+/**
+ * @brief Thread that scans the keypad at fixed absolute deadlines, so input is sampled on time even while the main loop
+ * is busy with the database or audio.
+ */
+struct KeypadScanThread
+{
+    /** @brief The scan thread. */
+    pthread_t thread;
+    /** @brief Whether the scan thread was started. If not, the main loop scans the keypad. */
+    bool running;
+    /** @brief Set by cleanupKeypad() to tell the scan thread to stop. */
+    atomic_bool stopRequested;
+    /** @brief Posted after a scan queues events, so the main loop can sleep until there's something to handle. */
+    sem_t eventsQueued;
+    /** @brief How well the thread keeps its schedule. */
+    struct KeypadScanStatistics statistics;
+    /** @brief lateCount when the main loop last checked. */
+    unsigned long reportedLateCount;
+};
+
 /**
  * @brief Struct holding the pin numbers for all Raspberry Pi 4 GPIO pins used by the program.
  */
 struct KeypadGPIOPins
 {
     /** @brief GPIO pin numbers of the keypad rows. */
-    int *keypad_rows;
+    int keypad_rows[KEYPAD_MAX_ROWS];
     /** @brief GPIO pin numbers of the keypad columns. */
-    int *keypad_columns;
+    int keypad_columns[KEYPAD_MAX_COLUMNS];
+    /** @brief Whether every keypad pin is in the first GPIO bank, so the masks below can be used. Set at initialization. */
+    bool bankAccess;
+    /** @brief Bit of every row pin in the first GPIO bank, to turn all rows on or off with one write. */
+    uint32_t rowMask;
+    /** @brief Bit of every column pin in the first GPIO bank, to read all columns with one read. */
+    uint32_t columnMask;
 };
 
 
@@ -90,12 +217,26 @@ struct KeypadConfig
     int MAX_PIN_LENGTH;
     /** @brief Time in seconds after the PIN is reset if we don'g get more input. */
     int KEYPRESS_TIMEOUT;
-    /** @brief Number of rows in the keypad. */
+    /** @brief Number of rows in the keypad. At most KEYPAD_MAX_ROWS. */
     int KEYPAD_ROWS;
-    /** @brief Number of columns in the keypad. */
+    /** @brief Number of columns in the keypad. At most KEYPAD_MAX_COLUMNS. */
     int KEYPAD_COLUMNS;
     /** @brief Minimum time between keypad updates in seconds. */
     double UPDATE_INTERVAL_SECONDS;
+    /** @brief How long a key has to read pressed before the press counts, in milliseconds. */
+    int DEBOUNCE_PRESS_MILLISECONDS;
+    /** @brief How long a key has to read released before the release counts, in milliseconds. */
+    int DEBOUNCE_RELEASE_MILLISECONDS;
+    /** @brief Whether the rows are driven low while idle and the matrix is only scanned after an edge on a column. */
+    bool EDGE_TRIGGERED;
+    /** @brief Longest the main loop sleeps waiting for an edge while nothing else needs timing, in seconds. */
+    double IDLE_WAIT_SECONDS;
+    /** @brief Whether the keypad is scanned by its own thread, every UPDATE_INTERVAL_SECONDS. */
+    bool SCAN_THREAD;
+    /** @brief SCHED_FIFO priority of the scan thread, 1-99. 0 keeps the normal scheduling. */
+    int SCAN_THREAD_PRIORITY;
+    /** @brief CPU core the scan thread runs on. -1 lets the kernel choose. */
+    int SCAN_THREAD_CPU;
 
     /** @brief Struct holding the keys on the keypad and the previous state of the keypad keys. */
     struct KeypadState keypadState;
@@ -103,6 +244,16 @@ struct KeypadConfig
     struct PINState currentPINState;
     /** @brief Struct holding the pin numbers for all Raspberry Pi 4 GPIO pins used by the program. */
     struct KeypadGPIOPins pins;
+    /** @brief The debounce times in nanoseconds, converted at initialization. */
+    struct KeyDebounceTiming debounceTiming;
+    /** @brief Edges seen on the column pins, if EDGE_TRIGGERED. */
+    struct KeypadEdgeState edgeState;
+    /** @brief The scan thread, if SCAN_THREAD. */
+    struct KeypadScanThread scanThread;
+    /** @brief Key events waiting for the PIN handling. */
+    struct KeypadEventQueue eventQueue;
+    /** @brief droppedCount when the PIN handling last checked. */
+    unsigned long reportedDroppedCount;
 };
 
 
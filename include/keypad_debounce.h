@@ -0,0 +1,114 @@
+/**
+ * @file keypad_debounce.h
+ * @author Selkamies
+ *
+ * @brief Per-key debouncing, so a bouncing switch gives one press and one release.
+ * A key has to read the same for the whole debounce time before its state changes.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef KEYPAD_DEBOUNCE_H
+#define KEYPAD_DEBOUNCE_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // int64_t, uint8_t.
+
+
+
+/**
+ * @brief Debounced state of a key.
+ */
+enum KeyDebouncePhase
+{
+    /** @brief Released and reading released. */
+    KEY_PHASE_UP,
+    /** @brief Released, but reading pressed since changeTime. */
+    KEY_PHASE_PRESS_PENDING,
+    /** @brief Pressed and reading pressed. */
+    KEY_PHASE_DOWN,
+    /** @brief Pressed, but reading released since changeTime. */
+    KEY_PHASE_RELEASE_PENDING
+};
+
+/**
+ * @brief What a new sample of a key changed.
+ */
+enum KeyDebounceResult
+{
+    /** @brief The debounced state stayed the same. */
+    KEY_NO_CHANGE,
+    /** @brief The key has now been pressed for the whole press debounce time. */
+    KEY_PRESSED,
+    /** @brief The key has now been released for the whole release debounce time. */
+    KEY_RELEASED
+};
+
+/**
+ * @brief Debounce state of a single key. All zeros is a released key.
+ */
+struct KeyDebounceState
+{
+    /** @brief Time the key started reading differently from its debounced state, in monotonic nanoseconds. */
+    int64_t changeTime;
+    /** @brief enum KeyDebouncePhase. */
+    uint8_t phase;
+};
+
+/**
+ * @brief Debounce times, from the [KEYPAD] section of config.ini.
+ */
+struct KeyDebounceTiming
+{
+    /** @brief How long a key has to read pressed before it counts as pressed, in nanoseconds. 0 disables. */
+    int64_t pressNanoseconds;
+    /** @brief How long a key has to read released before it counts as released, in nanoseconds. 0 disables. */
+    int64_t releaseNanoseconds;
+};
+
+
+
+/**
+ * @brief Feeds a new sample of the key to its state machine.
+ *
+ * @param state Debounce state of the key.
+ * @param timing Debounce times.
+ * @param readPressed Whether the key reads pressed in this scan.
+ * @param sampleTime Time of the scan, in monotonic nanoseconds.
+ * @param eventTime Set to the time the key first read the new state, if the result is KEY_PRESSED or KEY_RELEASED.
+ *
+ * @return enum KeyDebounceResult Whether the key was pressed, released, or neither.
+ */
+enum KeyDebounceResult debounceKey(struct KeyDebounceState *state, const struct KeyDebounceTiming *timing,
+                                   const bool readPressed, const int64_t sampleTime, int64_t *eventTime);
+
+/**
+ * @brief Checks whether the key counts as pressed, including while a release is still being debounced.
+ *
+ * @param state Debounce state of the key.
+ *
+ * @return true If the key is pressed.
+ * @return false If it's released.
+ */
+bool isKeyDown(const struct KeyDebounceState *state);
+
+/**
+ * @brief Checks whether the key is reading differently from its debounced state, so it needs more samples.
+ *
+ * @param state Debounce state of the key.
+ *
+ * @return true If a press or a release is being debounced.
+ * @return false If the key is settled.
+ */
+bool isKeySettling(const struct KeyDebounceState *state);
+
+
+
+#endif // KEYPAD_DEBOUNCE_H
@@ -0,0 +1,89 @@
+/**
+ * @file log_writer.h
+ * @author Selkamies
+ *
+ * @brief Saves log rows in a separate thread, so the keypad, LEDs and sounds never wait for
+ * the database to write to the SD card.
+ *
+ * @date Created  2024-01-03
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+
+
+
+// Forward declarations.
+struct LogWriterConfig;
+struct JournalConfig;
+struct SpoolConfig;
+
+
+
+/**
+ * @brief Opens the writer thread's own database connection and starts the thread.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ * @param filePath Path with the database file name, relative to the executable location.
+ * @param journalConfig The clock event journal the saved rows are appended to. Has to be initialized first.
+ * @param spoolConfig The spool events go to when they can't be saved. Has to be initialized first.
+ *
+ * @return true If the writer thread was started.
+ * @return false If it wasn't. queueLogRow() then always returns false.
+ */
+bool initializeLogWriter(struct LogWriterConfig *logWriterConfig, const char *const filePath,
+                         struct JournalConfig *journalConfig, struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Queues a log row to be saved by the writer thread. Never waits for the database.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ * @param userID User ID of the user clocking in or out.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the clock event in microseconds since the Unix epoch.
+ *
+ * @return true If the row was queued.
+ * @return false If the queue is full or the writer thread isn't running. The caller has to save the row itself.
+ */
+bool queueLogRow(struct LogWriterConfig *logWriterConfig, const int userID, const int status, const int64_t timestamp);
+
+/**
+ * @brief Checks if the user has log rows that are queued but not saved yet, and returns the status of the latest one.
+ * The database doesn't know about queued rows yet, so this has to be checked before the database.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ * @param userID User ID of the user whose status we're looking for.
+ * @param status Pointer to the status we're looking to get.
+ *
+ * @return true If the user has a queued row and its status was returned.
+ * @return false If the user has no queued rows.
+ */
+bool selectQueuedLogStatus(struct LogWriterConfig *logWriterConfig, const int userID, int *status);
+
+/**
+ * @brief Reports log rows the writer thread has saved or failed to save since the last update.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ */
+void updateLogWriter(struct LogWriterConfig *logWriterConfig);
+
+/**
+ * @brief Saves whatever is still queued, stops the writer thread and closes its database connection.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ */
+void cleanupLogWriter(struct LogWriterConfig *logWriterConfig);
+
+
+
+#endif // LOG_WRITER_H
@@ -0,0 +1,114 @@
+/**
+ * @file log_writer_config.h
+ * @author Selkamies
+ *
+ * @brief Defines LogWriterConfig struct, which holds basically all data used by log_writer.c.
+ *
+ * @date Created  2024-01-03
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef LOG_WRITER_CONFIG_H
+#define LOG_WRITER_CONFIG_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+#include <stdatomic.h>          // atomic_ulong, atomic_bool.
+#include <pthread.h>            // pthread_t.
+#include <semaphore.h>          // sem_t.
+
+#include "database_config.h"    // struct DatabaseConfig.
+#include "journal_config.h"     // struct JournalConfig.
+#include "spool_config.h"       // struct SpoolConfig.
+
+
+
+/** @brief Number of clock events the queue can hold. Has to be a power of two. */
+#define LOG_WRITER_QUEUE_CAPACITY 64
+
+
+
+/**
+ * @brief A clock event waiting to be saved as a log row. The writer thread checks the user's
+ * status again in the same transaction as the insert.
+ */
+struct ClockEvent
+{
+    /** @brief User ID of the user clocking in or out. */
+    int userID;
+    /** @brief LOG_STATUS_IN or LOG_STATUS_OUT. */
+    int status;
+    /** @brief When the PIN was entered, in microseconds since the Unix epoch. Not when the row gets saved. */
+    int64_t timestamp;
+};
+
+/**
+ * @brief Single producer, single consumer ring buffer of clock events. The main loop is the only
+ * producer and the writer thread is the only consumer, so no locks are needed.
+ * head and tail only ever grow, the slot of an event is its sequence number modulo capacity.
+ */
+struct LogWriterQueue
+{
+    /** @brief The events. A slot is free again once tail has passed it. */
+    struct ClockEvent events[LOG_WRITER_QUEUE_CAPACITY];
+    /** @brief Sequence number of the next event to queue. Written by the main loop only. */
+    atomic_ulong head;
+    /** @brief Sequence number of the next event to save. Written by the writer thread only, after the event is committed. */
+    atomic_ulong tail;
+};
+
+/**
+ * @brief Counters the writer thread uses to report back to the main loop.
+ */
+struct LogWriterStatus
+{
+    /** @brief Number of events whose transaction was committed. */
+    atomic_ulong savedCount;
+    /** @brief Number of events that could not be saved, or spooled either. */
+    atomic_ulong failedCount;
+    /** @brief Number of events not saved because the user's status had changed meanwhile, for example on another terminal. */
+    atomic_ulong rejectedCount;
+};
+
+/**
+ * @brief Struct holding all the variables needed by log_writer.c.
+ */
+struct LogWriterConfig
+{
+    /** @brief Clock events waiting to be saved. */
+    struct LogWriterQueue queue;
+    /** @brief Counters written by the writer thread and read by the main loop. */
+    struct LogWriterStatus status;
+    /** @brief The writer thread's own database connection, so it never shares a connection with the main loop. */
+    struct DatabaseConfig databaseConfig;
+    /** @brief Journal the committed rows are appended to. Appending does nothing if the journal is disabled. */
+    struct JournalConfig *journalConfig;
+    /** @brief Spool the events go to when the database fails, or while older events are still waiting there. */
+    struct SpoolConfig *spoolConfig;
+    /** @brief The writer thread. */
+    pthread_t thread;
+    /** @brief Whether the writer thread was started. If not, log rows are saved right away by the main loop. */
+    bool running;
+    /** @brief Set by cleanupLogWriter() to tell the writer thread to save what's left in the queue and stop. */
+    atomic_bool stopRequested;
+    /** @brief Posted for every queued event, so the writer thread can sleep while there's nothing to do. */
+    sem_t wakeup;
+    /** @brief savedCount when the main loop last checked. */
+    unsigned long reportedSavedCount;
+    /** @brief failedCount when the main loop last checked. */
+    unsigned long reportedFailedCount;
+    /** @brief rejectedCount when the main loop last checked. */
+    unsigned long reportedRejectedCount;
+    /** @brief Number of times the queue was full and the main loop had to save the log row itself. */
+    unsigned long queueFullCount;
+};
+
+
+
+#endif // LOG_WRITER_CONFIG_H
@@ -0,0 +1,54 @@
+/**
+ * @file maintenance.h
+ * @author Selkamies
+ *
+ * @brief Runs database maintenance (checkpoints, PRAGMA optimize, incremental vacuum and quick checks)
+ * in short slices while nobody is using the keypad.
+ *
+ * @date Created  2024-01-21
+ * @date Modified 2024-01-21
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+
+
+// Forward declarations.
+struct MaintenanceConfig;
+struct DatabaseConfig;
+struct ConfigData;
+
+
+
+/**
+ * @brief Sets the maintenance settings used if config.ini has no [MAINTENANCE] section. Maintenance is on by default.
+ *
+ * @param maintenanceConfig Struct holding all the variables needed by maintenance.c.
+ */
+void setMaintenanceDefaults(struct MaintenanceConfig *maintenanceConfig);
+
+/**
+ * @brief Schedules the first run of every task. Called after config.ini has been read and the database opened.
+ * Turns off SQLite's own checkpoints on the main connection, so a commit on the main thread never runs one.
+ *
+ * @param maintenanceConfig Struct holding all the variables needed by maintenance.c.
+ * @param databaseConfig Struct holding the main database connection.
+ */
+void initializeMaintenance(struct MaintenanceConfig *maintenanceConfig, struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Runs one slice of the most urgent maintenance task that is due, if the keypad has been idle
+ * and the LED off for long enough. The slice stops as soon as a key is pressed, and the task goes on later.
+ *
+ * @param configData Struct holding data about basically all variables used by the program.
+ */
+void updateMaintenance(struct ConfigData *configData);
+
+
+
+#endif // MAINTENANCE_H
@@ -0,0 +1,69 @@
+/**
+ * @file maintenance_config.h
+ * @author Selkamies
+ *
+ * @brief Defines MaintenanceConfig struct, which holds basically all data used by maintenance.c.
+ *
+ * @date Created  2024-01-21
+ * @date Modified 2024-01-21
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef MAINTENANCE_CONFIG_H
+#define MAINTENANCE_CONFIG_H
+
+
+
+#include <stdbool.h>
+
+
+
+/**
+ * @brief Struct holding all the variables needed by maintenance.c.
+ * The upper case members are read from the [MAINTENANCE] section of config.ini.
+ */
+struct MaintenanceConfig
+{
+    /** @brief Whether database maintenance is run at all. */
+    bool ENABLED;
+    /** @brief How long the keypad has to be idle and the LED off before maintenance starts, in seconds. */
+    double IDLE_SECONDS;
+    /** @brief Longest a slice of maintenance may keep the main loop waiting, in seconds. */
+    double SLICE_SECONDS;
+    /** @brief Longest the quick check may run, in seconds. It can't be split into slices. */
+    double QUICK_CHECK_MAX_SECONDS;
+    /** @brief Minimum time between WAL checkpoints in seconds. */
+    double CHECKPOINT_INTERVAL_SECONDS;
+    /** @brief Minimum time between PRAGMA optimize runs in hours. */
+    double OPTIMIZE_INTERVAL_HOURS;
+    /** @brief Minimum time between looking for free pages to give back, in hours. */
+    double VACUUM_INTERVAL_HOURS;
+    /** @brief Most free pages given back in one slice. */
+    int VACUUM_PAGES_PER_SLICE;
+    /** @brief Minimum time between quick checks in hours. */
+    double QUICK_CHECK_INTERVAL_HOURS;
+
+    /** @brief When the keypad was last seen in use, or the LED on. */
+    double lastActivityTime;
+    /** @brief Earliest time of the next slice. */
+    double nextSliceTime;
+    /** @brief When the running slice has to stop. */
+    double sliceDeadline;
+    /** @brief Whether the running slice was stopped by a key press. */
+    bool stoppedByKeyPress;
+    /** @brief Earliest time of the next checkpoint. */
+    double nextCheckpointTime;
+    /** @brief Earliest time of the next PRAGMA optimize. */
+    double nextOptimizeTime;
+    /** @brief Earliest time of the next incremental vacuum slice. */
+    double nextVacuumTime;
+    /** @brief Earliest time of the next quick check. */
+    double nextQuickCheckTime;
+};
+
+
+
+#endif // MAINTENANCE_CONFIG_H
@@ -0,0 +1,87 @@
+/**
+ * @file pin_index.h
+ * @author Selkamies
+ *
+ * @brief In-memory hash table from PIN codes to user IDs, so that PIN validation doesn't need
+ * to query the database. Filled and kept up to date by database.c.
+ *
+ * @date Created  2023-12-28
+ * @date Modified 2023-12-28
+ *
+ * @copyright Copyright (c) 2023
+ */
+
+
+
+#ifndef PIN_INDEX_H
+#define PIN_INDEX_H
+
+
+
+#include <stdbool.h>
+
+
+
+/** @brief Longest PIN the index can hold. Longer PINs are looked up from the database instead. */
+#define PIN_INDEX_MAX_PIN_LENGTH 15
+
+
+
+// Forward declaration. The table is private to pin_index.c.
+struct PINIndex;
+
+
+
+/**
+ * @brief Allocates an empty index with room for at least expectedCount PINs.
+ * The whole table is a single allocation.
+ *
+ * @param expectedCount Number of PINs we're going to insert. Can be 0.
+ *
+ * @return struct PINIndex* The new index, or NULL if the allocation failed.
+ */
+struct PINIndex *createPINIndex(const int expectedCount);
+
+/**
+ * @brief Adds a PIN to the index, or changes the user ID of an existing PIN.
+ * Grows the index if it gets too full, which moves it to a new allocation.
+ *
+ * @param pinIndex Pointer to the index. Changed if the index had to grow.
+ * @param pin PIN code to add. Must be at most PIN_INDEX_MAX_PIN_LENGTH characters.
+ * @param userID User ID the PIN belongs to.
+ *
+ * @return true If the PIN was added.
+ * @return false If the PIN was too long or growing the index failed.
+ */
+bool insertPINIndex(struct PINIndex **pinIndex, const char *pin, const int userID);
+
+/**
+ * @brief Removes a PIN from the index. Does nothing if the PIN is not in the index.
+ *
+ * @param pinIndex The index.
+ * @param pin PIN code to remove.
+ */
+void removePINIndex(struct PINIndex *pinIndex, const char *pin);
+
+/**
+ * @brief Looks for the user ID of a PIN.
+ *
+ * @param pinIndex The index.
+ * @param pin PIN code to look for.
+ * @param userID Pointer to the user ID we're looking to get.
+ *
+ * @return true If the PIN was found and the user ID was returned.
+ * @return false If the PIN is not in the index.
+ */
+bool lookupPINIndex(const struct PINIndex *pinIndex, const char *pin, int *userID);
+
+/**
+ * @brief Frees the index.
+ *
+ * @param pinIndex The index. Can be NULL.
+ */
+void cleanupPINIndex(struct PINIndex *pinIndex);
+
+
+
+#endif // PIN_INDEX_H
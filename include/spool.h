@@ -0,0 +1,113 @@
+/**
+ * @file spool.h
+ * @author Selkamies
+ *
+ * @brief Keeps clock events that can't be saved to the database in a file, and saves them in order
+ * once the database works again.
+ *
+ * @date Created  2024-01-22
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+
+
+
+// Forward declarations.
+struct SpoolConfig;
+struct JournalConfig;
+
+
+
+/** @brief Events the spool file holds before it's full. The file is SPOOL_CAPACITY * 32 bytes and one more record, 128 KiB. */
+#define SPOOL_CAPACITY 4096
+/** @brief Spool file path if config.ini doesn't set one. */
+#define SPOOL_DEFAULT_FILE_PATH "spool.bin"
+
+
+
+/**
+ * @brief Sets the spool settings to their defaults, before config.ini is read.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ */
+void setSpoolDefaults(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Maps the spool file, creating it at its full size if it doesn't exist, and starts the spool thread.
+ * Events left in the file by the previous run are saved to the database first thing.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ * @param databaseFilePath Path with the database file name, relative to the executable location.
+ * @param journalConfig The clock event journal the replayed rows are appended to. Has to be initialized first.
+ *
+ * @return true If the spool is ready.
+ * @return false If it's disabled or something went wrong. Events are then lost if the database fails, as before.
+ */
+bool initializeSpool(struct SpoolConfig *spoolConfig, const char *const databaseFilePath,
+                     struct JournalConfig *journalConfig);
+
+/**
+ * @brief Spools a clock event. Only copies it to memory, the spool thread flushes it to the disk
+ * within SYNC_INTERVAL_MILLISECONDS.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ * @param userID User ID of the user clocking in or out.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the clock event in microseconds since the Unix epoch.
+ *
+ * @return true If the event was spooled.
+ * @return false If the spool is disabled or full.
+ */
+bool appendSpoolEvent(struct SpoolConfig *spoolConfig, const int userID, const int status, const int64_t timestamp);
+
+/**
+ * @brief Checks if there are spooled events that aren't in the database yet. Newer events have to be
+ * spooled too while there are, or they would be saved before the older ones.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ *
+ * @return true If there are events waiting in the spool.
+ * @return false If there are none.
+ */
+bool hasSpooledEvents(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Checks if the user has spooled events that aren't in the database yet, and returns the status of the latest one.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ * @param userID User ID of the user whose status we're looking for.
+ * @param status Pointer to the status we're looking to get.
+ *
+ * @return true If the user has a spooled event and its status was returned.
+ * @return false If the user has no spooled events.
+ */
+bool selectSpooledLogStatus(struct SpoolConfig *spoolConfig, const int userID, int *status);
+
+/**
+ * @brief Reports events spooled and saved from the spool since the last update.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ */
+void updateSpool(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Stops the spool thread, flushes the file and unmaps it. Events still in the spool are saved on the next start.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ */
+void cleanupSpool(struct SpoolConfig *spoolConfig);
+
+
+
+#endif // SPOOL_H
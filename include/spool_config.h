@@ -0,0 +1,116 @@
+/**
+ * @file spool_config.h
+ * @author Selkamies
+ *
+ * @brief Defines SpoolConfig struct, which holds basically all data used by spool.c.
+ *
+ * @date Created  2024-01-22
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#ifndef SPOOL_CONFIG_H
+#define SPOOL_CONFIG_H
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // uint64_t.
+#include <stdatomic.h>          // atomic_ulong.
+#include <pthread.h>            // pthread_t, pthread_mutex_t, pthread_cond_t.
+
+#include "database_config.h"    // struct DatabaseConfig.
+
+
+
+/** @brief Longest spool file path, including the null terminator. */
+#define SPOOL_FILE_PATH_LENGTH 64
+
+
+
+// Forward declarations. The file layout is private to spool.c.
+struct SpoolFile;
+struct JournalConfig;
+
+
+
+/**
+ * @brief Counters the spool thread uses to report back to the main loop.
+ */
+struct SpoolStatus
+{
+    /** @brief Number of spooled events saved to the database. */
+    atomic_ulong replayedCount;
+    /** @brief Number of spooled events not saved because the user's status had changed meanwhile. */
+    atomic_ulong rejectedCount;
+    /** @brief Number of spooled events found already saved, by a replay cut short before it was marked done. */
+    atomic_ulong duplicateCount;
+    /** @brief Number of spooled events lost, torn by a power cut before they reached the disk. */
+    atomic_ulong lostCount;
+};
+
+/**
+ * @brief Struct holding all the variables needed by spool.c.
+ * The upper case members are read from the [SPOOL] section of config.ini.
+ */
+struct SpoolConfig
+{
+    /** @brief Whether clock events that can't be saved to the database are spooled at all. */
+    bool ENABLED;
+    /** @brief Path of the spool file, relative to the executable location. */
+    char FILE_PATH[SPOOL_FILE_PATH_LENGTH];
+    /** @brief Longest a spooled event waits in memory before it's flushed to the disk, in milliseconds. */
+    int SYNC_INTERVAL_MILLISECONDS;
+    /** @brief Wait between attempts to save spooled events while the database is still failing, in seconds. */
+    double RETRY_SECONDS;
+
+    /** @brief Whether the file is mapped and the spool thread is running. */
+    bool open;
+    /** @brief The main loop, the log writer thread and the spool thread all use the spool. */
+    pthread_mutex_t lock;
+    /** @brief Signalled when an event is spooled or the spool thread is asked to stop. */
+    pthread_cond_t wakeup;
+    /** @brief Flushes spooled events to the disk and saves them to the database once it works again. */
+    pthread_t thread;
+    /** @brief Set by cleanupSpool() to stop the spool thread. Guarded by lock. */
+    bool stopRequested;
+    /** @brief The mapped spool file. */
+    struct SpoolFile *file;
+    /** @brief Sequence number the next spooled event gets. Guarded by lock. */
+    uint64_t nextSequence;
+    /** @brief Events up to this sequence number are in the database. Guarded by lock. */
+    uint64_t replayedSequence;
+    /** @brief Events before this sequence number are on the disk. Guarded by lock. */
+    uint64_t syncedSequence;
+    /** @brief The spool thread's own database connection. Opened once the database can be opened. */
+    struct DatabaseConfig databaseConfig;
+    /** @brief Path of the database file, for opening the connection. */
+    const char *databaseFilePath;
+    /** @brief Journal the replayed rows are appended to. Appending does nothing if the journal is disabled. */
+    struct JournalConfig *journalConfig;
+    /** @brief Counters written by the spool thread and read by the main loop. */
+    struct SpoolStatus status;
+    /** @brief Number of events spooled, written by whoever spooled them. */
+    atomic_ulong spooledCount;
+    /** @brief Number of events that didn't fit in a full spool. */
+    atomic_ulong fullCount;
+    /** @brief spooledCount when the main loop last checked. */
+    unsigned long reportedSpooledCount;
+    /** @brief fullCount when the main loop last checked. */
+    unsigned long reportedFullCount;
+    /** @brief replayedCount when the main loop last checked. */
+    unsigned long reportedReplayedCount;
+    /** @brief rejectedCount when the main loop last checked. */
+    unsigned long reportedRejectedCount;
+    /** @brief duplicateCount when the main loop last checked. */
+    unsigned long reportedDuplicateCount;
+    /** @brief lostCount when the main loop last checked. */
+    unsigned long reportedLostCount;
+};
+
+
+
+#endif // SPOOL_CONFIG_H
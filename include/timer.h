@@ -5,7 +5,7 @@
  * @brief Handles getting the current time from system.
  * 
  * @date Created  2023-12-05
- * @date Modified 2023-12-05
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
@@ -17,6 +17,10 @@
 
 
 
+#include <stdint.h>             // int64_t.
+
+
+
 /**
  * @brief Returns the current time in seconds + nanoseconds converted to seconds decimals.
  * 
@@ -24,6 +28,30 @@
  */
 double getCurrentTimeInSeconds();
 
+/**
+ * @brief Returns the current wall clock time in whole microseconds since the Unix epoch (UTC).
+ * Used as the timestamp of log rows. A double can't hold it exactly.
+ * 
+ * @return int64_t Microseconds since 1970-01-01 00:00:00 UTC.
+ */
+int64_t getCurrentTimeInMicroseconds();
+
+/**
+ * @brief Returns the time of a clock that never jumps, in nanoseconds. Only differences between two of these mean anything.
+ * Used for timing key presses, which must not be thrown off when the wall clock is set.
+ * 
+ * @return int64_t Nanoseconds from CLOCK_MONOTONIC.
+ */
+int64_t getMonotonicTimeInNanoseconds();
+
+/**
+ * @brief Sleeps for the given time, or until a signal interrupts it.
+ * Used by the GPIO backends that don't have a sleep of their own.
+ * 
+ * @param seconds Duration in seconds, how long to sleep.
+ */
+void sleepForSeconds(const double seconds);
+
 
 
 #endif // TIMER_H
\ No newline at end of file
@@ -0,0 +1,188 @@
+/**
+ * @file archive.c
+ * @author Selkamies
+ *
+ * @brief Moves the log rows of closed months from the database to one archive file per month,
+ * in small batches while nobody is using the keypad.
+ *
+ * Years of log rows make backups slow, and every page that stays in use is written to the SD card
+ * again and again. With the old months moved out, the database stays small enough to fit in the page cache.
+ * Reports attach the archive files they need with attachLogArchive().
+ *
+ * @date Created  2024-01-12
+ * @date Modified 2024-01-12
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
+
+#include "archive.h"
+#include "archive_config.h"     // struct ArchiveConfig.
+#include "config_data.h"        // struct ConfigData.
+#include "database.h"           // selectArchivableLogMonth(), openLogArchive(), archiveLogBatch(), closeLogArchive().
+#include "timer.h"              // getCurrentTimeInSeconds().
+
+
+
+/** @brief Wait between checks for a month to archive, when there's nothing to do or something went wrong. */
+#define ARCHIVE_CHECK_INTERVAL_SECONDS 60.0
+
+#define ARCHIVE_DEFAULT_KEEP_MONTHS 2
+#define ARCHIVE_DEFAULT_BATCH_SIZE 200
+#define ARCHIVE_DEFAULT_BATCH_INTERVAL_SECONDS 1.0
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Checks that nobody is pressing keys or entering a PIN, so a batch can't delay them.
+ *
+ * @param configData Struct holding data about basically all variables used by the program.
+ *
+ * @return true If the keypad is idle.
+ * @return false If it isn't.
+ */
+static bool keypadIsIdle(const struct ConfigData *configData);
+
+/**
+ * @brief Looks for the oldest month that can be archived and attaches its archive file.
+ *
+ * @param archiveConfig Struct holding all the variables needed by archive.c.
+ * @param databaseConfig Struct holding the database connection.
+ *
+ * @return true If a month is now being archived.
+ * @return false If there's nothing to archive, or the archive file couldn't be attached.
+ */
+static bool startArchivingMonth(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Detaches the archive file and reports how many rows were moved.
+ *
+ * @param archiveConfig Struct holding all the variables needed by archive.c.
+ * @param databaseConfig Struct holding the database connection.
+ */
+static void stopArchivingMonth(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+void setArchiveDefaults(struct ArchiveConfig *archiveConfig)
+{
+    archiveConfig->ENABLED = false;
+    archiveConfig->KEEP_MONTHS = ARCHIVE_DEFAULT_KEEP_MONTHS;
+    archiveConfig->BATCH_SIZE = ARCHIVE_DEFAULT_BATCH_SIZE;
+    archiveConfig->BATCH_INTERVAL_SECONDS = ARCHIVE_DEFAULT_BATCH_INTERVAL_SECONDS;
+}
+
+void initializeArchive(struct ArchiveConfig *archiveConfig)
+{
+    printf("Initializing log archive.\n");
+
+    archiveConfig->archiving = false;
+    archiveConfig->archivedCount = 0;
+    // Gives the program a moment to start before the first check.
+    archiveConfig->nextUpdateTime = getCurrentTimeInSeconds() + ARCHIVE_CHECK_INTERVAL_SECONDS;
+
+    if (archiveConfig->BATCH_SIZE < 1)
+    {
+        archiveConfig->BATCH_SIZE = ARCHIVE_DEFAULT_BATCH_SIZE;
+    }
+}
+
+void updateArchive(struct ConfigData *configData)
+{
+    // For readability.
+    struct ArchiveConfig *archiveConfig = &configData->archiveConfig;
+    struct DatabaseConfig *databaseConfig = &configData->databaseConfig;
+
+    double currentTime = getCurrentTimeInSeconds();
+
+    if (!archiveConfig->ENABLED || databaseConfig->database == NULL ||
+        currentTime < archiveConfig->nextUpdateTime || !keypadIsIdle(configData))
+    {
+        return;
+    }
+
+    if (!archiveConfig->archiving && !startArchivingMonth(archiveConfig, databaseConfig))
+    {
+        archiveConfig->nextUpdateTime = currentTime + ARCHIVE_CHECK_INTERVAL_SECONDS;
+
+        return;
+    }
+
+    int archivedCount = 0;
+
+    if (!archiveLogBatch(databaseConfig, &archiveConfig->month, archiveConfig->BATCH_SIZE, &archivedCount))
+    {
+        fprintf(stderr, "Archiving log rows of %04d-%02d failed, trying again later.\n",
+                archiveConfig->month.year, archiveConfig->month.month);
+        stopArchivingMonth(archiveConfig, databaseConfig);
+        archiveConfig->nextUpdateTime = currentTime + ARCHIVE_CHECK_INTERVAL_SECONDS;
+
+        return;
+    }
+
+    archiveConfig->archivedCount += archivedCount;
+
+    // The month is done. There may be another closed month waiting, so the next check isn't delayed.
+    if (archivedCount == 0)
+    {
+        stopArchivingMonth(archiveConfig, databaseConfig);
+    }
+
+    archiveConfig->nextUpdateTime = currentTime + archiveConfig->BATCH_INTERVAL_SECONDS;
+}
+
+void cleanupArchive(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig)
+{
+    if (archiveConfig->archiving)
+    {
+        stopArchivingMonth(archiveConfig, databaseConfig);
+    }
+}
+
+
+
+static bool keypadIsIdle(const struct ConfigData *configData)
+{
+    return !configData->keypadConfig.currentPINState.waitingForPINInput &&
+           !configData->keypadConfig.keypadState.anyKeysPressed;
+}
+
+static bool startArchivingMonth(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig)
+{
+    if (!selectArchivableLogMonth(databaseConfig, archiveConfig->KEEP_MONTHS, &archiveConfig->month))
+    {
+        return false;
+    }
+
+    if (!openLogArchive(databaseConfig, &archiveConfig->month))
+    {
+        fprintf(stderr, "Could not open the log archive of %04d-%02d.\n", archiveConfig->month.year, archiveConfig->month.month);
+
+        return false;
+    }
+
+    printf("Archiving log rows of %04d-%02d.\n", archiveConfig->month.year, archiveConfig->month.month);
+
+    archiveConfig->archiving = true;
+    archiveConfig->archivedCount = 0;
+
+    return true;
+}
+
+static void stopArchivingMonth(struct ArchiveConfig *archiveConfig, struct DatabaseConfig *databaseConfig)
+{
+    closeLogArchive(databaseConfig);
+
+    printf("Moved %lu log row(s) of %04d-%02d to the archive.\n",
+           archiveConfig->archivedCount, archiveConfig->month.year, archiveConfig->month.month);
+
+    archiveConfig->archiving = false;
+}
@@ -5,7 +5,7 @@
  * @brief Reads key-value pairs from config.ini and passes relevant values to other files.
  * 
  * @date Created 2023-11-14
- * @date Modified 2023-12-18
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  * 
@@ -15,12 +15,19 @@
 
 
 #include <stdio.h>              // printf(), snprintf().
-#include <stdlib.h>             // atoi(), strtod().
-#include <string.h>             // strcmp(), strstr(), sscanf().
+#include <stdlib.h>             // atoi(), atoll(), strtod().
+#include <string.h>             // strcmp(), strstr(), sscanf(), strlen(), memcpy().
 #include <stdbool.h>
 
 #include "config_handler.h"
 #include "config_data.h"        // struct ConfigData.
+#include "keypad.h"             // setKeypadDefaults().
+#include "database.h"           // setDatabaseProfile(), DATABASE_DEFAULT_PROFILE.
+#include "archive.h"            // setArchiveDefaults().
+#include "journal.h"            // setJournalDefaults().
+#include "maintenance.h"        // setMaintenanceDefaults().
+#include "spool.h"              // setSpoolDefaults().
+#include "gpio_init.h"          // setGPIODefaults().
 
 
 
@@ -39,12 +46,25 @@
 #define SECTION_LED "LED"
 #define SECTION_LED_GPIO "LED_GPIO_PIN_NUMBERS"
 #define SECTION_SOUNDS "SOUNDS"
+#define SECTION_DATABASE "DATABASE"
+#define SECTION_ARCHIVE "ARCHIVE"
+#define SECTION_JOURNAL "JOURNAL"
+#define SECTION_MAINTENANCE "MAINTENANCE"
+#define SECTION_SPOOL "SPOOL"
+#define SECTION_GPIO "GPIO"
 
 #define KEY_MAX_PIN_LENGTH "MAX_PIN_LENGTH"
 #define KEY_KEYPRESS_TIMEOUT "KEYPRESS_TIMEOUT"
 #define KEY_KEYPAD_ROWS "KEYPAD_ROWS"
 #define KEY_KEYPAD_COLUMNS "KEYPAD_COLUMNS"
 #define KEY_KEYPAD_UPDATE_INVERVAL "KEYPAD_UPDATE_INTERVAL_SECONDS"
+#define KEY_KEYPAD_EDGE_TRIGGERED "EDGE_TRIGGERED"
+#define KEY_KEYPAD_IDLE_WAIT "IDLE_WAIT_SECONDS"
+#define KEY_KEYPAD_DEBOUNCE_PRESS "DEBOUNCE_PRESS_MILLISECONDS"
+#define KEY_KEYPAD_DEBOUNCE_RELEASE "DEBOUNCE_RELEASE_MILLISECONDS"
+#define KEY_KEYPAD_SCAN_THREAD "SCAN_THREAD"
+#define KEY_KEYPAD_SCAN_THREAD_PRIORITY "SCAN_THREAD_PRIORITY"
+#define KEY_KEYPAD_SCAN_THREAD_CPU "SCAN_THREAD_CPU"
 
 #define KEY_PREFIX_KEY_KEYPAD_ROW_D_COLUMN_D "KEY_KEYPAD_ROW_"
 #define KEY_KEYPAD_KEY_ROW_D_COLUMN_D "KEY_KEYPAD_ROW_%d_COLUMN_%d"
@@ -63,6 +83,42 @@
 
 #define KEY_AUDIO_DEVICE_ID "AUDIO_DEVICE_ID"
 
+#define KEY_DATABASE_PROFILE "PROFILE"
+#define KEY_DATABASE_JOURNAL_MODE "JOURNAL_MODE"
+#define KEY_DATABASE_SYNCHRONOUS "SYNCHRONOUS"
+#define KEY_DATABASE_CACHE_SIZE "CACHE_SIZE"
+#define KEY_DATABASE_MMAP_SIZE "MMAP_SIZE"
+#define KEY_DATABASE_BUSY_TIMEOUT "BUSY_TIMEOUT"
+#define KEY_DATABASE_TEMP_STORE "TEMP_STORE"
+
+#define KEY_ARCHIVE_ENABLED "ENABLED"
+#define KEY_ARCHIVE_KEEP_MONTHS "KEEP_MONTHS"
+#define KEY_ARCHIVE_BATCH_SIZE "BATCH_SIZE"
+#define KEY_ARCHIVE_BATCH_INTERVAL "BATCH_INTERVAL_SECONDS"
+
+#define KEY_JOURNAL_ENABLED "ENABLED"
+#define KEY_JOURNAL_TERMINAL_ID "TERMINAL_ID"
+#define KEY_JOURNAL_DIRECTORY "DIRECTORY"
+
+#define KEY_MAINTENANCE_ENABLED "ENABLED"
+#define KEY_MAINTENANCE_IDLE "IDLE_SECONDS"
+#define KEY_MAINTENANCE_SLICE "SLICE_SECONDS"
+#define KEY_MAINTENANCE_QUICK_CHECK_MAX "QUICK_CHECK_MAX_SECONDS"
+#define KEY_MAINTENANCE_CHECKPOINT_INTERVAL "CHECKPOINT_INTERVAL_SECONDS"
+#define KEY_MAINTENANCE_OPTIMIZE_INTERVAL "OPTIMIZE_INTERVAL_HOURS"
+#define KEY_MAINTENANCE_VACUUM_INTERVAL "VACUUM_INTERVAL_HOURS"
+#define KEY_MAINTENANCE_VACUUM_PAGES "VACUUM_PAGES_PER_SLICE"
+#define KEY_MAINTENANCE_QUICK_CHECK_INTERVAL "QUICK_CHECK_INTERVAL_HOURS"
+
+#define KEY_SPOOL_ENABLED "ENABLED"
+#define KEY_SPOOL_FILE_PATH "FILE_PATH"
+#define KEY_SPOOL_SYNC_INTERVAL "SYNC_INTERVAL_MILLISECONDS"
+#define KEY_SPOOL_RETRY "RETRY_SECONDS"
+
+#define KEY_GPIO_BACKEND "BACKEND"
+#define KEY_GPIO_GPIOD_CHIP "GPIOD_CHIP"
+#define KEY_GPIO_SIMULATOR_SCRIPT "SIMULATOR_SCRIPT"
+
 
 
 const char *fileName = "../config/config.ini";
@@ -140,6 +196,71 @@ static void readLEDData(struct ConfigData *configData, const char *key, const ch
  */
 static void readSoundData(struct ConfigData *configData, const char *key, const char *value);
 
+/**
+ * @brief Reads the database config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: PROFILE
+ * @param value Value for the key as a string. Example: "sd-card-safe"
+ */
+static void readDatabaseData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Reads the archive config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: KEEP_MONTHS
+ * @param value Value for the key as a string. Example: "2"
+ */
+static void readArchiveData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Reads the journal config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: TERMINAL_ID
+ * @param value Value for the key as a string. Example: "1"
+ */
+static void readJournalData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Reads the maintenance config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: IDLE_SECONDS
+ * @param value Value for the key as a string. Example: "5.0"
+ */
+static void readMaintenanceData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Reads the spool config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: SYNC_INTERVAL_MILLISECONDS
+ * @param value Value for the key as a string. Example: "20"
+ */
+static void readSpoolData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Reads the GPIO config values read from config.ini to configData struct.
+ * 
+ * @param configData Struct holding all the config values that are read from config.ini.
+ * @param key Key name of the key-value pair. Example: BACKEND
+ * @param value Value for the key as a string. Example: "simulated"
+ */
+static void readGPIOData(struct ConfigData *configData, const char *key, const char *value);
+
+/**
+ * @brief Copies a text value to a setting. A value too long for the setting is rejected instead of cut short,
+ * since a cut path or name would silently point somewhere else. The setting then keeps its previous value.
+ * 
+ * @param destination Setting to copy to.
+ * @param size Size of the setting in bytes, with the terminating null.
+ * @param key Key name of the key-value pair, for the error message.
+ * @param value Value for the key as a string.
+ */
+static void copyConfigString(char *destination, const size_t size, const char *key, const char *value);
+
 #pragma endregion
 
 
@@ -148,6 +269,15 @@ void readConfigFile(struct ConfigData *configData)
 {
     printf("Reading config.ini.\n");
 
+    setKeypadDefaults(&configData->keypadConfig);
+    // Used if config.ini has no [DATABASE] section, and as the base for the values that are in it.
+    setDatabaseProfile(&configData->databaseConfig.settings, DATABASE_DEFAULT_PROFILE);
+    setArchiveDefaults(&configData->archiveConfig);
+    setJournalDefaults(&configData->journalConfig);
+    setMaintenanceDefaults(&configData->maintenanceConfig);
+    setSpoolDefaults(&configData->spoolConfig);
+    setGPIODefaults(&configData->gpioConfig);
+
     FILE *file = fopen(fileName, "r");
     if (!file) 
     {
@@ -244,6 +374,36 @@ static void setConfigValue(struct ConfigData *configData, const char *section, c
     {
         readSoundData(configData, key, value);
     }
+
+    else if (strcmp(section, SECTION_DATABASE) == 0)
+    {
+        readDatabaseData(configData, key, value);
+    }
+
+    else if (strcmp(section, SECTION_ARCHIVE) == 0)
+    {
+        readArchiveData(configData, key, value);
+    }
+
+    else if (strcmp(section, SECTION_JOURNAL) == 0)
+    {
+        readJournalData(configData, key, value);
+    }
+
+    else if (strcmp(section, SECTION_MAINTENANCE) == 0)
+    {
+        readMaintenanceData(configData, key, value);
+    }
+
+    else if (strcmp(section, SECTION_SPOOL) == 0)
+    {
+        readSpoolData(configData, key, value);
+    }
+
+    else if (strcmp(section, SECTION_GPIO) == 0)
+    {
+        readGPIOData(configData, key, value);
+    }
 }
 
 static void readKeypadData(struct ConfigData *configData, const char *key, const char *value)
@@ -265,13 +425,23 @@ static void readKeypadData(struct ConfigData *configData, const char *key, const
     else if (strcmp(key, KEY_KEYPAD_ROWS) == 0)
     {
         configData->keypadConfig.KEYPAD_ROWS = atoi(value);
-        configData->keypadConfig.pins.keypad_rows = calloc(configData->keypadConfig.KEYPAD_ROWS, sizeof(int));
+
+        if (configData->keypadConfig.KEYPAD_ROWS > KEYPAD_MAX_ROWS)
+        {
+            printf("\nERROR: KEYPAD_ROWS is %d, at most %d rows are supported!\n", configData->keypadConfig.KEYPAD_ROWS, KEYPAD_MAX_ROWS);
+            configData->keypadConfig.KEYPAD_ROWS = KEYPAD_MAX_ROWS;
+        }
     }
 
     else if (strcmp(key, KEY_KEYPAD_COLUMNS) == 0)
     {
         configData->keypadConfig.KEYPAD_COLUMNS = atoi(value);
-        configData->keypadConfig.pins.keypad_columns = calloc(configData->keypadConfig.KEYPAD_COLUMNS, sizeof(int));
+
+        if (configData->keypadConfig.KEYPAD_COLUMNS > KEYPAD_MAX_COLUMNS)
+        {
+            printf("\nERROR: KEYPAD_COLUMNS is %d, at most %d columns are supported!\n", configData->keypadConfig.KEYPAD_COLUMNS, KEYPAD_MAX_COLUMNS);
+            configData->keypadConfig.KEYPAD_COLUMNS = KEYPAD_MAX_COLUMNS;
+        }
     }
 
     else if (strcmp(key, KEY_KEYPAD_UPDATE_INVERVAL) == 0)
@@ -279,6 +449,41 @@ static void readKeypadData(struct ConfigData *configData, const char *key, const
         configData->keypadConfig.UPDATE_INTERVAL_SECONDS = strtod(value, NULL);
     }
 
+    else if (strcmp(key, KEY_KEYPAD_EDGE_TRIGGERED) == 0)
+    {
+        configData->keypadConfig.EDGE_TRIGGERED = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_IDLE_WAIT) == 0)
+    {
+        configData->keypadConfig.IDLE_WAIT_SECONDS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_DEBOUNCE_PRESS) == 0)
+    {
+        configData->keypadConfig.DEBOUNCE_PRESS_MILLISECONDS = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_DEBOUNCE_RELEASE) == 0)
+    {
+        configData->keypadConfig.DEBOUNCE_RELEASE_MILLISECONDS = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_SCAN_THREAD) == 0)
+    {
+        configData->keypadConfig.SCAN_THREAD = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_SCAN_THREAD_PRIORITY) == 0)
+    {
+        configData->keypadConfig.SCAN_THREAD_PRIORITY = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_KEYPAD_SCAN_THREAD_CPU) == 0)
+    {
+        configData->keypadConfig.SCAN_THREAD_CPU = atoi(value);
+    }
+
     ///////////////////
     // [KEYPAD_KEYS] //
     ///////////////////
@@ -291,21 +496,10 @@ static void readKeypadData(struct ConfigData *configData, const char *key, const
         int rowIndex, columnIndex;
 
         // Gets the row and column indexes from the key.
-        if (sscanf(key, KEY_KEYPAD_KEY_ROW_D_COLUMN_D, &rowIndex, &columnIndex) == 2)
+        if (sscanf(key, KEY_KEYPAD_KEY_ROW_D_COLUMN_D, &rowIndex, &columnIndex) == 2 &&
+            rowIndex >= 0 && rowIndex < KEYPAD_MAX_ROWS && columnIndex >= 0 && columnIndex < KEYPAD_MAX_COLUMNS)
         {
-            // Dynamically allocate memory for keys array if not already allocated.
-            if (configData->keypadConfig.keypadState.keys == NULL)
-            {
-                configData->keypadConfig.keypadState.keys = malloc(configData->keypadConfig.KEYPAD_ROWS * sizeof(char *));
-
-                for (int row = 0; row < configData->keypadConfig.KEYPAD_ROWS; row++)
-                {
-                    configData->keypadConfig.keypadState.keys[row] = malloc(configData->keypadConfig.KEYPAD_COLUMNS * sizeof(char));
-                }
-            }
-
-            // Store the key in the dynamically allocated keys array.
-            configData->keypadConfig.keypadState.keys[rowIndex][columnIndex] = value[0];
+            configData->keypadConfig.keypadState.keys[KEYPAD_KEY_INDEX(rowIndex, columnIndex)] = value[0];
         }
     }
 
@@ -328,7 +522,7 @@ static void readKeypadData(struct ConfigData *configData, const char *key, const
         int rowIndex;
 
         // Gets the row index from the key.
-        if (sscanf(key, KEY_KEYPAD_ROW_D, &rowIndex) == 1)
+        if (sscanf(key, KEY_KEYPAD_ROW_D, &rowIndex) == 1 && rowIndex >= 0 && rowIndex < KEYPAD_MAX_ROWS)
         {
             configData->keypadConfig.pins.keypad_rows[rowIndex] = atoi(value);
         }
@@ -339,7 +533,7 @@ static void readKeypadData(struct ConfigData *configData, const char *key, const
         int columnIndex;
 
         // Gets the column index from the key.
-        if (sscanf(key, KEY_KEYPAD_COLUMN_D, &columnIndex) == 1)
+        if (sscanf(key, KEY_KEYPAD_COLUMN_D, &columnIndex) == 1 && columnIndex >= 0 && columnIndex < KEYPAD_MAX_COLUMNS)
         {
             configData->keypadConfig.pins.keypad_columns[columnIndex] = atoi(value);
         }
@@ -385,3 +579,197 @@ static void readSoundData(struct ConfigData *configData, const char *key, const
         configData->soundsConfig.manualAudioDeviceID = atoi(value);
     }
 }
+
+static void readDatabaseData(struct ConfigData *configData, const char *key, const char *value)
+{
+    // For readability.
+    struct DatabaseSettings *settings = &configData->databaseConfig.settings;
+
+    // Sets all the settings, so it has to come before the keys that override them.
+    if (strcmp(key, KEY_DATABASE_PROFILE) == 0)
+    {
+        if (!setDatabaseProfile(settings, value))
+        {
+            fprintf(stderr, "Unknown database profile '%s', using '%s'.\n", value, DATABASE_DEFAULT_PROFILE);
+        }
+    }
+
+    else if (strcmp(key, KEY_DATABASE_JOURNAL_MODE) == 0)
+    {
+        copyConfigString(settings->journalMode, sizeof(settings->journalMode), key, value);
+    }
+
+    else if (strcmp(key, KEY_DATABASE_SYNCHRONOUS) == 0)
+    {
+        copyConfigString(settings->synchronous, sizeof(settings->synchronous), key, value);
+    }
+
+    else if (strcmp(key, KEY_DATABASE_CACHE_SIZE) == 0)
+    {
+        settings->cacheSize = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_DATABASE_MMAP_SIZE) == 0)
+    {
+        settings->mmapSize = atoll(value);
+    }
+
+    else if (strcmp(key, KEY_DATABASE_BUSY_TIMEOUT) == 0)
+    {
+        settings->busyTimeoutMilliseconds = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_DATABASE_TEMP_STORE) == 0)
+    {
+        copyConfigString(settings->tempStore, sizeof(settings->tempStore), key, value);
+    }
+}
+
+static void readArchiveData(struct ConfigData *configData, const char *key, const char *value)
+{
+    if (strcmp(key, KEY_ARCHIVE_ENABLED) == 0)
+    {
+        configData->archiveConfig.ENABLED = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_ARCHIVE_KEEP_MONTHS) == 0)
+    {
+        configData->archiveConfig.KEEP_MONTHS = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_ARCHIVE_BATCH_SIZE) == 0)
+    {
+        configData->archiveConfig.BATCH_SIZE = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_ARCHIVE_BATCH_INTERVAL) == 0)
+    {
+        configData->archiveConfig.BATCH_INTERVAL_SECONDS = strtod(value, NULL);
+    }
+}
+
+static void readJournalData(struct ConfigData *configData, const char *key, const char *value)
+{
+    if (strcmp(key, KEY_JOURNAL_ENABLED) == 0)
+    {
+        configData->journalConfig.ENABLED = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_JOURNAL_TERMINAL_ID) == 0)
+    {
+        configData->journalConfig.TERMINAL_ID = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_JOURNAL_DIRECTORY) == 0)
+    {
+        copyConfigString(configData->journalConfig.DIRECTORY, sizeof(configData->journalConfig.DIRECTORY), key, value);
+    }
+}
+
+static void readMaintenanceData(struct ConfigData *configData, const char *key, const char *value)
+{
+    // For readability.
+    struct MaintenanceConfig *maintenanceConfig = &configData->maintenanceConfig;
+
+    if (strcmp(key, KEY_MAINTENANCE_ENABLED) == 0)
+    {
+        maintenanceConfig->ENABLED = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_IDLE) == 0)
+    {
+        maintenanceConfig->IDLE_SECONDS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_SLICE) == 0)
+    {
+        maintenanceConfig->SLICE_SECONDS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_QUICK_CHECK_MAX) == 0)
+    {
+        maintenanceConfig->QUICK_CHECK_MAX_SECONDS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_CHECKPOINT_INTERVAL) == 0)
+    {
+        maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_OPTIMIZE_INTERVAL) == 0)
+    {
+        maintenanceConfig->OPTIMIZE_INTERVAL_HOURS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_VACUUM_INTERVAL) == 0)
+    {
+        maintenanceConfig->VACUUM_INTERVAL_HOURS = strtod(value, NULL);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_VACUUM_PAGES) == 0)
+    {
+        maintenanceConfig->VACUUM_PAGES_PER_SLICE = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_MAINTENANCE_QUICK_CHECK_INTERVAL) == 0)
+    {
+        maintenanceConfig->QUICK_CHECK_INTERVAL_HOURS = strtod(value, NULL);
+    }
+}
+
+static void readSpoolData(struct ConfigData *configData, const char *key, const char *value)
+{
+    if (strcmp(key, KEY_SPOOL_ENABLED) == 0)
+    {
+        configData->spoolConfig.ENABLED = atoi(value) != 0;
+    }
+
+    else if (strcmp(key, KEY_SPOOL_FILE_PATH) == 0)
+    {
+        copyConfigString(configData->spoolConfig.FILE_PATH, sizeof(configData->spoolConfig.FILE_PATH), key, value);
+    }
+
+    else if (strcmp(key, KEY_SPOOL_SYNC_INTERVAL) == 0)
+    {
+        configData->spoolConfig.SYNC_INTERVAL_MILLISECONDS = atoi(value);
+    }
+
+    else if (strcmp(key, KEY_SPOOL_RETRY) == 0)
+    {
+        configData->spoolConfig.RETRY_SECONDS = strtod(value, NULL);
+    }
+}
+
+static void readGPIOData(struct ConfigData *configData, const char *key, const char *value)
+{
+    if (strcmp(key, KEY_GPIO_BACKEND) == 0)
+    {
+        copyConfigString(configData->gpioConfig.BACKEND, sizeof(configData->gpioConfig.BACKEND), key, value);
+    }
+
+    else if (strcmp(key, KEY_GPIO_GPIOD_CHIP) == 0)
+    {
+        copyConfigString(configData->gpioConfig.GPIOD_CHIP, sizeof(configData->gpioConfig.GPIOD_CHIP), key, value);
+    }
+
+    else if (strcmp(key, KEY_GPIO_SIMULATOR_SCRIPT) == 0)
+    {
+        copyConfigString(configData->gpioConfig.SIMULATOR_SCRIPT, sizeof(configData->gpioConfig.SIMULATOR_SCRIPT), key, value);
+    }
+}
+
+static void copyConfigString(char *destination, const size_t size, const char *key, const char *value)
+{
+    size_t length = strlen(value);
+
+    if (length >= size)
+    {
+        fprintf(stderr, "Value '%s' of %s is too long, at most %zu characters. Keeping the previous value.\n",
+                value, key, size - 1);
+
+        return;
+    }
+
+    // Only the length is checked here, invalid values are caught where the settings are used.
+    memcpy(destination, value, length + 1);
+}
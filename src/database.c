@@ -5,21 +5,30 @@
  * @brief Database operations.
  * 
  * @date Created  2023-12-08
- * @date Modified 2023-12-15
+ * @date Modified 2024-01-22
  * 
  * @copyright Copyright (c) 2023
  */
 
 
 
-#include <stdio.h>               // stderr.
+#include <stdio.h>               // stderr, snprintf().
 #include <stdbool.h>
-#include <string.h>              // strcmp().
+#include <string.h>              // strcmp(), strlen().
+#include <strings.h>             // strcasecmp().
+#include <unistd.h>              // access().
 
 #include <sqlite3.h>             // sqlite3, sqlite3_stmt, sqlite3_prepare_v2(), etc.
 
 #include "database.h"            // DATABASE_FILEPATH, DATABASE_PATH, DATABASE_NAME.
 #include "database_sql.h"        // #defines for SQL statements, table and column names.
+#include "database_config.h"     // struct DatabaseConfig, struct DatabaseStatements, struct LogMonth, etc.
+#include "pin_index.h"           // createPINIndex(), insertPINIndex(), lookupPINIndex(), etc.
+
+
+
+/** @brief SQLite virtual machine instructions between calls to the maintenance stop check. Some tens of microseconds. */
+#define MAINTENANCE_PROGRESS_INSTRUCTIONS 1000
 
 
 
@@ -34,7 +43,7 @@ typedef void (*RowCallback)(sqlite3_stmt *statement, void *data);
 
 
 /**
- * @brief Executes a SELECT SQL statement.
+ * @brief Executes a SELECT SQL statement. The statement is reset afterwards, so it can be reused.
  * 
  * @param statement SQL statement in a format that SQLite uses.
  * @param callback Callback function for SELECT statements, for getting return values. Can be NULL.
@@ -46,7 +55,20 @@ typedef void (*RowCallback)(sqlite3_stmt *statement, void *data);
 static bool executeSelect(sqlite3_stmt *statement, RowCallback callback, void *data);
 
 /**
- * @brief Executes an INSERT SQL statement.
+ * @brief Like executeSelect(), but tells no rows apart from an error. The statement is reset afterwards.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param callback Callback function called for every row. Can be NULL.
+ * @param data Pointer passed to the callback. Can be NULL.
+ * @param rowCount Pointer to the number of rows returned.
+ * 
+ * @return true If the statement was executed successfully, even if it returned no rows.
+ * @return false If something went wrong with the statement.
+ */
+static bool executeQuery(sqlite3_stmt *statement, RowCallback callback, void *data, int *rowCount);
+
+/**
+ * @brief Executes an INSERT SQL statement. The statement is reset afterwards, so it can be reused.
  * 
  * @param statement SQL statement in a format that SQLite uses.
  * 
@@ -55,37 +77,156 @@ static bool executeSelect(sqlite3_stmt *statement, RowCallback callback, void *d
  */
 static bool executeInsert(sqlite3_stmt *statement);
 
+/**
+ * @brief Resets a prepared statement and clears its bindings, so that it can be run again.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ */
+static void resetStatement(sqlite3_stmt *statement);
+
+
+
+/**
+ * @brief Prepares all the statements in DatabaseStatements.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * 
+ * @return true If all the statements were prepared successfully.
+ * @return false If any of the statements could not be prepared.
+ */
+static bool prepareStatements(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Prepares a single statement that is kept until cleanupDatabase().
+ * 
+ * @param database SQLite database we're using.
+ * @param sql SQL statement as a string.
+ * @param statement Pointer to the prepared statement.
+ * 
+ * @return true If the statement was prepared successfully.
+ * @return false If something went wrong.
+ */
+static bool prepareStatement(sqlite3 *database, const char *sql, sqlite3_stmt **statement);
+
+/**
+ * @brief Applies databaseConfig->settings to the connection with PRAGMAs.
+ * 
+ * @param databaseConfig Struct holding the database connection and the settings.
+ */
+static void applyDatabaseSettings(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Checks whether a setting value is one of the allowed values. PRAGMA values can't be bound
+ * as parameters, so only known values are ever formatted into SQL.
+ * 
+ * @param value Value read from config.ini.
+ * @param allowedValues NULL terminated list of allowed values.
+ * 
+ * @return true If the value is allowed, case insensitively.
+ * @return false If it isn't.
+ */
+static bool isAllowedSettingValue(const char *value, const char *const *allowedValues);
+
+/**
+ * @brief Brings the database schema up to date by applying all the migrations newer than 
+ * the version stored in PRAGMA user_version. A new database is at version 0.
+ * 
+ * @param database SQLite database we're using.
+ * 
+ * @return true If the schema is up to date.
+ * @return false If a migration failed. The database is left at the last successfully applied version.
+ */
+static bool migrateDatabase(sqlite3 *database);
 
+/**
+ * @brief Applies a single migration and bumps PRAGMA user_version in one transaction.
+ * 
+ * @param database SQLite database we're using.
+ * @param version Schema version the migration brings the database to.
+ * 
+ * @return true If the migration was applied or another process had already applied it.
+ * @return false If something went wrong. The transaction is rolled back.
+ */
+static bool applyMigration(sqlite3 *database, const int version);
 
 /**
- * @brief Checks if a table already exists in the database.
+ * @brief Reads the schema version from PRAGMA user_version.
  * 
  * @param database SQLite database we're using.
- * @param tableName Name of the table to check.
+ * @param version Pointer to the version we're looking to get.
  * 
- * @return true If the table already exists.
- * @return false If the table doesn't exist.
+ * @return true If the version was read successfully.
+ * @return false If something went wrong.
  */
-static bool tableExists(sqlite3 **database, const char *tableName);
+static bool selectUserVersion(sqlite3 *database, int *version);
 
 /**
- * @brief Create all the tables in the database.
+ * @brief Runs SQL that doesn't return rows, like transaction control and PRAGMAs that set values.
  * 
  * @param database SQLite database we're using.
- * @return true If the tables were created successfully.
- * @return false If something went wrong when creating the tables.
+ * @param sql SQL statement(s) as a string.
+ * 
+ * @return true If the SQL was executed successfully.
+ * @return false If something went wrong.
+ */
+static bool executeSQL(sqlite3 *database, const char *sql);
+
+
+
+/**
+ * @brief Reads every user's PIN to a new in-memory PIN index. Also removes the user_change rows
+ * that the new index already contains.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * 
+ * @return true If the index was built.
+ * @return false If something went wrong. databaseConfig->pinIndex is left NULL.
+ */
+static bool buildPINIndex(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Applies the user changes made by other processes to the PIN index, if there are any.
+ * Checking is a single PRAGMA data_version when nothing has changed.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ */
+static void refreshPINIndex(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Callback function for buildPINIndex(), inserts a user's PIN to the index.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct DatabaseConfig holding the index.
  */
-static bool createTables(sqlite3 **database);
+static void buildPINIndexCallback(sqlite3_stmt *statement, void *data);
 
 /**
- * @brief Inserts test data to users table.
+ * @brief Callback function for refreshPINIndex(), applies a user_change row to the index.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct DatabaseConfig holding the index.
+ */
+static void refreshPINIndexCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Callback function for SELECTs of a single integer, like COUNT(*) and PRAGMAs.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the sqlite3_int64 we need back.
+ */
+static void selectInt64Callback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Runs a one-off SELECT of a single integer.
  * 
  * @param database SQLite database we're using.
+ * @param sql SQL statement as a string.
+ * @param value Pointer to the integer we're looking to get.
  * 
- * @return true If the insert was successful.
- * @return false If something went wrong with the insert.
+ * @return true If a value was selected.
+ * @return false If something went wrong or there were no rows.
  */
-static bool insertUserTestData(sqlite3 **database);
+static bool selectInt64(sqlite3 *database, const char *sql, sqlite3_int64 *value);
 
 
 
@@ -97,656 +238,1780 @@ static bool insertUserTestData(sqlite3 **database);
  */
 static void selectUserIDByPINCallback(sqlite3_stmt *statement, void *data);
 
+/**
+ * @brief Callback function for selectUsersLatestLogStatus(), used to get SELECT statement data.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the data we need back. In this case, status of the latest log row.
+ */
 static void selectUsersLatestLogStatusCallback(sqlite3_stmt *statement, void *data);
 
+/**
+ * @brief Callback function for SELECTs of a single int, like PRAGMA user_version and PRAGMA data_version.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the int we need back.
+ */
+static void selectIntCallback(sqlite3_stmt *statement, void *data);
+
+
+
+/**
+ * @brief Callback function for selectArchivableLogMonth(), used to get SELECT statement data.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct LogMonth we need back.
+ */
+static void selectArchivableLogMonthCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Runs one of the archive batch statements, with the month bounds and the row limit bound to ?1, ?2 and ?3.
+ * 
+ * @param database SQLite database we're using.
+ * @param sql SQL statement as a string.
+ * @param month The month being archived.
+ * @param limit Batch size or the ID of the last row in the batch, depending on the statement.
+ * @param value Pointer to the integer the statement SELECTs. NULL for statements that don't return rows.
+ * 
+ * @return true If the statement was executed successfully.
+ * @return false If something went wrong.
+ */
+static bool executeArchiveStatement(sqlite3 *database, const char *sql, const struct LogMonth *month,
+                                    const sqlite3_int64 limit, sqlite3_int64 *value);
+
+/**
+ * @brief Callback function for selectLogRowsAfterID() and selectUsersLatestLogRows(), used to get SELECT statement data.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct LogRowPage we need back.
+ */
+static void selectLogRowsAfterIDCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Callback function for selectUserRowsAfterID(), used to get SELECT statement data.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct UserRowPage we need back.
+ */
+static void selectUserRowsAfterIDCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Runs a cached UPDATE or DELETE statement that was prepared and bound by the caller.
+ * 
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param statement The statement.
+ * @param found Pointer to whether any row was changed.
+ * 
+ * @return true If the statement ran.
+ * @return false If something went wrong.
+ */
+static bool executeChange(struct DatabaseConfig *databaseConfig, sqlite3_stmt *statement, bool *found);
+
+/**
+ * @brief SQLite progress handler installed for maintenance slices. Asks the slice's stop check whether to go on.
+ * 
+ * @param data Pointer to the struct DatabaseConfig running the slice.
+ * 
+ * @return int Non-zero to stop the running statement with SQLITE_INTERRUPT.
+ */
+static int maintenanceProgressHandler(void *data);
+
+/**
+ * @brief Runs a maintenance statement. Being stopped or finding the database locked isn't an error,
+ * the statement is just tried again in a later slice.
+ * 
+ * @param database SQLite database we're using.
+ * @param sql SQL statement as a string.
+ * @param callback Called for every row. Can be NULL.
+ * @param data Passed to callback.
+ * @param stopped Pointer to whether the statement was stopped or the database was locked.
+ * 
+ * @return true If the statement finished.
+ * @return false If it was stopped or something went wrong.
+ */
+static bool executeMaintenanceSQL(sqlite3 *database, const char *sql, RowCallback callback, void *data, bool *stopped);
+
+/**
+ * @brief Callback function for quickCheckDatabase(), prints every problem found.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the bool telling whether the check passed.
+ */
+static void quickCheckCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Callback function for selectExportCursor(), used to get SELECT statement data.
+ * 
+ * @param statement SQL statement in a format that SQLite uses.
+ * @param data Pointer to the struct ExportCursor we need back.
+ */
+static void selectExportCursorCallback(sqlite3_stmt *statement, void *data);
+
+/**
+ * @brief Attaches a database file to the connection.
+ * 
+ * @param database SQLite database we're using.
+ * @param filePath Path of the file to attach.
+ * @param schemaName Name the file is attached as.
+ * 
+ * @return true If the file was attached.
+ * @return false If something went wrong.
+ */
+static bool attachDatabase(sqlite3 *database, const char *filePath, const char *schemaName);
+
+/**
+ * @brief Detaches a database file from the connection.
+ * 
+ * @param database SQLite database we're using.
+ * @param schemaName Name the file was attached as.
+ */
+static void detachDatabase(sqlite3 *database, const char *schemaName);
+
 #pragma endregion // FunctionDeclatarions
 
 
 
-bool openOrCreateDatabase(sqlite3 **database, const char *const filePath)
+/**
+ * @brief Rows selected by selectLogRowsAfterID(), filled by its callback.
+ */
+struct LogRowPage
 {
-    int returnCode = sqlite3_open_v2(filePath, database, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    struct LogRow *rows;
+    int maxRows;
+    int rowCount;
+};
 
-    // Something went wrong with opening or creating the database.
-    if (returnCode != SQLITE_OK) 
-    {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(*database));
+/**
+ * @brief Rows selected by selectUserRowsAfterID(), filled by its callback.
+ */
+struct UserRowPage
+{
+    struct UserRow *rows;
+    int maxRows;
+    int rowCount;
+};
+
+
+
+#pragma region Settings
+
+/**
+ * @brief A named set of database settings that can be chosen in config.ini.
+ */
+struct DatabaseProfile
+{
+    /** @brief Name used in config.ini. */
+    const char *name;
+    /** @brief The settings. */
+    struct DatabaseSettings settings;
+};
+
+/** @brief Built-in profiles. See setDatabaseProfile() in database.h. */
+static const struct DatabaseProfile databaseProfiles[] =
+{
+    // WAL turns every commit into one sequential append and one flush, instead of a rollback journal's several.
+    { "sd-card-safe", { "WAL", "FULL", -2000, 0, 2000, "DEFAULT" } },
+    // With WAL, NORMAL only flushes at checkpoints. Commits are no longer durable, but the database stays consistent.
+    { "fast", { "WAL", "NORMAL", -8000, 64 * 1024 * 1024, 2000, "MEMORY" } },
+    // Flushing a RAM disk does nothing useful.
+    { "ramdisk", { "MEMORY", "OFF", -8000, 64 * 1024 * 1024, 2000, "MEMORY" } },
+};
+
+static const char *const allowedJournalModes[] = { "DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF", NULL };
+static const char *const allowedSynchronousValues[] = { "OFF", "NORMAL", "FULL", "EXTRA", NULL };
+static const char *const allowedTempStoreValues[] = { "DEFAULT", "FILE", "MEMORY", NULL };
+
+#pragma endregion // Settings
 
-        return false;
-    }
 
-    if (!tableExists(database, TABLE_USER) && !tableExists(database, TABLE_LOG)) 
+
+#pragma region Migrations
+
+/**
+ * @brief Schema migrations in the order they are applied. Migration at index N brings the 
+ * schema to version N + 1. Never change or reorder a migration that has been released,
+ * add a new one to the end instead.
+ */
+static const char *const migrations[] =
+{
+    // Version 1: User and log tables, and test users for an empty database.
+    CREATE_TABLE_USER CREATE_TABLE_LOG INSERT_INTO_USER_TEST_ROWS,
+    // Version 2: Index for finding the latest log row of a user.
+    CREATE_INDEX_LOG_USER_ID_DATETIME,
+    // Version 3: Trigger maintained current status of every user.
+    CREATE_TABLE_USER_STATUS
+    CREATE_TRIGGER_LOG_INSERT_USER_STATUS
+    CREATE_TRIGGER_LOG_UPDATE_USER_STATUS
+    CREATE_TRIGGER_LOG_DELETE_USER_STATUS
+    BACKFILL_USER_STATUS,
+    // Version 4: Trigger maintained list of user changes, for keeping the in-memory PIN index up to date.
+    CREATE_TABLE_USER_CHANGE
+    CREATE_TRIGGER_USER_INSERT_USER_CHANGE
+    CREATE_TRIGGER_USER_UPDATE_USER_CHANGE
+    CREATE_TRIGGER_USER_DELETE_USER_CHANGE,
+    // Version 5: Log datetime and user status since as INTEGER microseconds, and a readable view of the log.
+    CREATE_TABLE_LOG_REBUILD
+    COPY_LOG_TO_REBUILD
+    CREATE_TABLE_USER_STATUS_REBUILD
+    COPY_USER_STATUS_TO_REBUILD
+    REPLACE_LOG_WITH_REBUILD
+    REPLACE_USER_STATUS_WITH_REBUILD
+    CREATE_INDEX_LOG_USER_ID_DATETIME
+    CREATE_TRIGGER_LOG_INSERT_USER_STATUS
+    CREATE_TRIGGER_LOG_UPDATE_USER_STATUS
+    CREATE_TRIGGER_LOG_DELETE_USER_STATUS
+    CREATE_VIEW_LOG_READABLE,
+    // Version 6: Export cursors, how far each incremental export of the log has got.
+    CREATE_TABLE_EXPORT_CURSOR,
+    // Version 7: AUTOINCREMENT log IDs, so IDs of deleted and archived rows are never used again.
+    DROP_VIEW_LOG_READABLE
+    CREATE_TABLE_LOG_AUTOINCREMENT_REBUILD
+    COPY_LOG_TO_AUTOINCREMENT_REBUILD
+    SET_LOG_REBUILD_SEQUENCE
+    REPLACE_LOG_WITH_REBUILD
+    CREATE_INDEX_LOG_USER_ID_DATETIME
+    CREATE_TRIGGER_LOG_INSERT_USER_STATUS
+    CREATE_TRIGGER_LOG_UPDATE_USER_STATUS
+    CREATE_TRIGGER_LOG_DELETE_USER_STATUS
+    CREATE_VIEW_LOG_READABLE,
+};
+
+/** @brief Schema version of a fully migrated database. */
+static const int latestSchemaVersion = sizeof(migrations) / sizeof(migrations[0]);
+
+#pragma endregion // Migrations
+
+
+
+bool setDatabaseProfile(struct DatabaseSettings *settings, const char *profileName)
+{
+    for (size_t index = 0; index < sizeof(databaseProfiles) / sizeof(databaseProfiles[0]); index++)
     {
-        createTables(database);
-        insertUserTestData(database);
+        if (strcasecmp(profileName, databaseProfiles[index].name) == 0)
+        {
+            *settings = databaseProfiles[index].settings;
+
+            return true;
+        }
     }
 
-    return true;
+    return false;
 }
 
-static bool tableExists(sqlite3 **database, const char *tableName)
-{;
-    sqlite3_stmt *statement;
-    int resultCode = sqlite3_prepare_v2(*database, SELECT_TABLE_EXISTS, -1, &statement, 0);
+void setDatabaseToolSettings(struct DatabaseSettings *settings)
+{
+    setDatabaseProfile(settings, DATABASE_DEFAULT_PROFILE);
+    // Empty keeps the journal mode the database file already has, see applyDatabaseSettings().
+    settings->journalMode[0] = '\0';
+}
 
-    if (resultCode != SQLITE_OK)
+bool openOrCreateDatabase(struct DatabaseConfig *databaseConfig, const char *const filePath)
+{
+    if (!openDatabaseConnection(databaseConfig, filePath))
     {
-        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*database));
         return false;
     }
 
-    sqlite3_bind_text(statement, 1, tableName, -1, SQLITE_STATIC);
+    // Not fatal, PINs are looked up with SQL without the index.
+    if (!buildPINIndex(databaseConfig))
+    {
+        fprintf(stderr, "Could not build PIN index, PINs are validated from the database.\n");
+    }
 
-    return executeSelect(statement, NULL, NULL);
+    return true;
 }
 
-static bool createTables(sqlite3 **database)
+bool openDatabaseConnection(struct DatabaseConfig *databaseConfig, const char *const filePath)
 {
-    int returnCode = sqlite3_exec(*database, CREATE_TABLE_USER, 0, 0, 0);
+    databaseConfig->database = NULL;
+    databaseConfig->statements = (struct DatabaseStatements){ 0 };
+    databaseConfig->pinIndex = NULL;
+    databaseConfig->maintenanceStopCheck = NULL;
+    databaseConfig->maintenanceStopCheckData = NULL;
 
+    int returnCode = sqlite3_open_v2(filePath, &databaseConfig->database, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+
+    // Something went wrong with opening or creating the database.
     if (returnCode != SQLITE_OK) 
     {
-        fprintf(stderr, "Cannot create table: %s\n", sqlite3_errmsg(*database));
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(databaseConfig->database));
+        cleanupDatabase(databaseConfig);
 
         return false;
     }
 
-    returnCode = sqlite3_exec(*database, CREATE_TABLE_LOG, 0, 0, 0);
+    applyDatabaseSettings(databaseConfig);
 
-    if (returnCode != SQLITE_OK) 
+    if (!migrateDatabase(databaseConfig->database))
     {
-        fprintf(stderr, "Cannot create table: %s\n", sqlite3_errmsg(*database));
-        
+        cleanupDatabase(databaseConfig);
+
         return false;
     }
 
-    printf("Tables created.\n");
+    // Statements can only be prepared once the tables they use exist.
+    if (!prepareStatements(databaseConfig))
+    {
+        cleanupDatabase(databaseConfig);
+
+        return false;
+    }
 
     return true;
 }
 
-static bool insertUserTestData(sqlite3 **database)
+void cleanupDatabase(struct DatabaseConfig *databaseConfig)
 {
-    sqlite3_stmt *statement;
-    int resultCode = sqlite3_prepare_v2(*database, INSERT_INTO_USER_TEST_ROWS, -1, &statement, 0);
+    // sqlite3_finalize() is a harmless no-op for NULL statements.
+    sqlite3_finalize(databaseConfig->statements.selectUserIDByPIN);
+    sqlite3_finalize(databaseConfig->statements.selectUsersLatestLogStatus);
+    sqlite3_finalize(databaseConfig->statements.insertLogRow);
+    sqlite3_finalize(databaseConfig->statements.selectDataVersion);
+    sqlite3_finalize(databaseConfig->statements.selectUserChangesAfterID);
+    sqlite3_finalize(databaseConfig->statements.beginImmediateTransaction);
+    sqlite3_finalize(databaseConfig->statements.commitTransaction);
+    sqlite3_finalize(databaseConfig->statements.rollbackTransaction);
+    sqlite3_finalize(databaseConfig->statements.insertUserRow);
+    sqlite3_finalize(databaseConfig->statements.upsertUserRow);
+    sqlite3_finalize(databaseConfig->statements.selectLogRowsAfterID);
+    sqlite3_finalize(databaseConfig->statements.saveExportCursor);
+    sqlite3_finalize(databaseConfig->statements.updateUserRow);
+    sqlite3_finalize(databaseConfig->statements.deleteUserRow);
+    sqlite3_finalize(databaseConfig->statements.deleteUserStatus);
+    sqlite3_finalize(databaseConfig->statements.selectUserHasLogRows);
+    sqlite3_finalize(databaseConfig->statements.deleteUsersLogRows);
+    sqlite3_finalize(databaseConfig->statements.updateLogRow);
+    sqlite3_finalize(databaseConfig->statements.deleteLogRow);
+    sqlite3_finalize(databaseConfig->statements.selectUserRowsAfterID);
+    sqlite3_finalize(databaseConfig->statements.selectUsersLatestLogRows);
+    sqlite3_finalize(databaseConfig->statements.selectLogRowIDByEvent);
+    databaseConfig->statements = (struct DatabaseStatements){ 0 };
+
+    cleanupPINIndex(databaseConfig->pinIndex);
+    databaseConfig->pinIndex = NULL;
+
+    // All statements have to be finalized before the connection can be closed.
+    sqlite3_close(databaseConfig->database);
+    databaseConfig->database = NULL;
+}
 
-    if (resultCode != SQLITE_OK) 
+static bool prepareStatements(struct DatabaseConfig *databaseConfig)
+{
+    // For readability.
+    sqlite3 *database = databaseConfig->database;
+    struct DatabaseStatements *statements = &databaseConfig->statements;
+
+    return prepareStatement(database, SELECT_USER_ID_BY_PIN, &statements->selectUserIDByPIN) &&
+           prepareStatement(database, SELECT_USER_STATUS_BY_USER_ID, &statements->selectUsersLatestLogStatus) &&
+           prepareStatement(database, INSERT_LOG_ROW, &statements->insertLogRow) &&
+           prepareStatement(database, SELECT_DATA_VERSION, &statements->selectDataVersion) &&
+           prepareStatement(database, SELECT_USER_CHANGES_AFTER_ID, &statements->selectUserChangesAfterID) &&
+           prepareStatement(database, BEGIN_IMMEDIATE_TRANSACTION, &statements->beginImmediateTransaction) &&
+           prepareStatement(database, COMMIT_TRANSACTION, &statements->commitTransaction) &&
+           prepareStatement(database, ROLLBACK_TRANSACTION, &statements->rollbackTransaction);
+}
+
+static bool prepareStatement(sqlite3 *database, const char *sql, sqlite3_stmt **statement)
+{
+    // Compiles the sql statement from string to a format (*statement) that SQLite uses.
+    // -1 (int nByte) tells to use the length of the entire string statement.
+    // SQLITE_PREPARE_PERSISTENT hints SQLite that the statement will be kept and reused many times.
+    // NULL (const char **psTail) is an output parameter.
+    int resultCode = sqlite3_prepare_v3(database, sql, -1, SQLITE_PREPARE_PERSISTENT, statement, NULL);
+
+    if (resultCode != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*database));
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
 
         return false;
     }
 
-    return executeInsert(statement);
+    return true;
 }
 
+static void applyDatabaseSettings(struct DatabaseConfig *databaseConfig)
+{
+    // For readability.
+    sqlite3 *database = databaseConfig->database;
+    const struct DatabaseSettings *settings = &databaseConfig->settings;
 
+    // Other connections (the log writer thread, admin tools) hold locks for short moments.
+    // Without a timeout, SQLite would fail right away instead of waiting for them.
+    sqlite3_busy_timeout(database, settings->busyTimeoutMilliseconds);
 
-static bool executeSelect(sqlite3_stmt *statement, RowCallback callback, void *data)
-{
-    // Execute the prepared statement.
-    int resultCode = sqlite3_step(statement);
+    // Longest PRAGMA is "PRAGMA journal_mode = " plus a setting value.
+    char sql[64];
 
-    // No rows returned.
-    if (resultCode == SQLITE_DONE)
-    {
-        //fprintf(stderr, "No rows in the result set.\n");
-        sqlite3_finalize(statement);
+    // Lets maintenance.c give the pages freed by archiving back to the file system. Does nothing on existing databases.
+    executeSQL(database, SET_AUTO_VACUUM_INCREMENTAL);
 
-        return false;
+    // Journal mode is stored in the database file for WAL, for the others it is per connection.
+    // Empty leaves it as it is, command line tools leave it to the device, see setDatabaseToolSettings().
+    if (settings->journalMode[0] == '\0')
+    {
+        // Nothing to set.
     }
 
-    // Execute the prepared statement row by row and handle callbacks for return values.
-    while (resultCode == SQLITE_ROW)
+    else if (isAllowedSettingValue(settings->journalMode, allowedJournalModes))
     {
-        if (callback)
-        {
-            // Callback function gets the statement and pointer to data we want back.
-            callback(statement, data);
-        }
-
-        // Fetch the next row.
-        resultCode = sqlite3_step(statement);
+        snprintf(sql, sizeof(sql), SET_JOURNAL_MODE_FORMAT, settings->journalMode);
+        executeSQL(database, sql);
     }
 
-    // Finalize the statement. This frees up memory/resources created for the statement.
-    sqlite3_finalize(statement);
-
-    return true;
-}
+    else
+    {
+        fprintf(stderr, "Unknown database journal mode '%s', using SQLite default.\n", settings->journalMode);
+    }
 
-static bool executeInsert(sqlite3_stmt *statement)
-{
-     // Execute the prepared statement.
-    int resultCode = sqlite3_step(statement);
+    if (isAllowedSettingValue(settings->synchronous, allowedSynchronousValues))
+    {
+        snprintf(sql, sizeof(sql), SET_SYNCHRONOUS_FORMAT, settings->synchronous);
+        executeSQL(database, sql);
+    }
 
-    // Check the result code to determine success or failure.
-    if (resultCode == SQLITE_DONE)
+    else
     {
-        //fprintf(stdout, "Insert successful.\n");
-        sqlite3_finalize(statement);
+        fprintf(stderr, "Unknown database synchronous setting '%s', using SQLite default.\n", settings->synchronous);
+    }
 
-        return true;
+    if (isAllowedSettingValue(settings->tempStore, allowedTempStoreValues))
+    {
+        snprintf(sql, sizeof(sql), SET_TEMP_STORE_FORMAT, settings->tempStore);
+        executeSQL(database, sql);
     }
 
     else
     {
-        fprintf(stderr, "Insert failed. SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
-        sqlite3_finalize(statement);
-
-        return false;
+        fprintf(stderr, "Unknown database temp store setting '%s', using SQLite default.\n", settings->tempStore);
     }
-}
 
+    snprintf(sql, sizeof(sql), SET_CACHE_SIZE_FORMAT, settings->cacheSize);
+    executeSQL(database, sql);
 
+    snprintf(sql, sizeof(sql), SET_MMAP_SIZE_FORMAT, settings->mmapSize);
+    executeSQL(database, sql);
+}
 
-bool selectUserIDByPIN(sqlite3 **database, const char *const pin, int *user_id_ptr)
+static bool isAllowedSettingValue(const char *value, const char *const *allowedValues)
 {
-    // SQL statement in a format that SQLite uses.
-    sqlite3_stmt *statement;
-
-    // Compiles the sql statement from string (SELECT_USER_ID_BY_PIN) to a format (*statement) that SQLite uses.
-    // -1 (int nByte) tells to use the length of the entire string statement.
-    // 0 (const char **psTail) is an output parameter.
-    int resultCode = sqlite3_prepare_v2(*database, SELECT_USER_ID_BY_PIN, -1, &statement, 0);
-
-    if (resultCode != SQLITE_OK)
+    for (const char *const *allowedValue = allowedValues; *allowedValue != NULL; allowedValue++)
+    {
+        if (strcasecmp(value, *allowedValue) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool migrateDatabase(sqlite3 *database)
+{
+    int version = 0;
+
+    // On every start after the first one this is the only thing we need to check.
+    if (!selectUserVersion(database, &version))
     {
-        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*database));
-
         return false;
     }
 
-    // Bind the pin value to the ? placeholder in the SQL statement.
-    // 1 is the number of ? to bind to, in this case the first and only one.
-    // -1 tells the function that the number of bytes should be determined automatically.
-    // SQLITE_STATIC tells the function not to delete the string paratemer (pin) afterwards.
-    sqlite3_bind_text(statement, 1, pin, -1, SQLITE_STATIC);
+    if (version > latestSchemaVersion)
+    {
+        fprintf(stderr, "Database schema version %d is newer than the supported version %d.\n", version, latestSchemaVersion);
 
-    // Pass the statement to a function that executes it. Since we're selecting something,
-    // we also pass a callback function and data pointer to get the values we want to select.
-    return executeSelect(statement, selectUserIDByPINCallback, user_id_ptr);
+        return false;
+    }
+
+    for (int nextVersion = version + 1; nextVersion <= latestSchemaVersion; nextVersion++)
+    {
+        if (!applyMigration(database, nextVersion))
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
-// Callback function for selectUserIDByPIN. Callback functions are needed for SELECT statements.
-static void selectUserIDByPINCallback(sqlite3_stmt *statement, void *data)
+static bool applyMigration(sqlite3 *database, const int version)
 {
-    // Cast the generic void pointer to int. This points to the same address as *data.
-    int *user_id_ptr = (int *)data;
+    if (!executeSQL(database, BEGIN_IMMEDIATE_TRANSACTION))
+    {
+        return false;
+    }
 
-    // Assigns the value to the pointer, which also changes original pointer passed as *data.
-    // The second parameter is the index of the bindable parameter in the statement.
-    *user_id_ptr = sqlite3_column_int(statement, 0);
+    // Another process may have migrated the database while we were waiting for the write lock.
+    int currentVersion = 0;
+
+    if (!selectUserVersion(database, &currentVersion))
+    {
+        executeSQL(database, ROLLBACK_TRANSACTION);
+
+        return false;
+    }
+
+    if (currentVersion >= version)
+    {
+        return executeSQL(database, COMMIT_TRANSACTION);
+    }
+
+    // PRAGMA user_version can't be bound with ?, so it is formatted to the string.
+    char setVersionSQL[sizeof(SET_USER_VERSION_FORMAT) + 16];
+    snprintf(setVersionSQL, sizeof(setVersionSQL), SET_USER_VERSION_FORMAT, version);
+
+    if (!executeSQL(database, migrations[version - 1]) ||
+        !executeSQL(database, setVersionSQL) ||
+        !executeSQL(database, COMMIT_TRANSACTION))
+    {
+        fprintf(stderr, "Database migration to version %d failed.\n", version);
+        executeSQL(database, ROLLBACK_TRANSACTION);
+
+        return false;
+    }
+
+    printf("Database migrated to version %d.\n", version);
+
+    return true;
 }
 
-bool insertLogRow(sqlite3 **database, const int user_id, const int status)
+static bool selectUserVersion(sqlite3 *database, int *version)
 {
     sqlite3_stmt *statement;
-    int resultCode = sqlite3_prepare_v2(*database, INSERT_LOG_ROW, -1, &statement, 0);
+    int resultCode = sqlite3_prepare_v2(database, SELECT_USER_VERSION, -1, &statement, 0);
 
-    if (resultCode != SQLITE_OK) 
+    if (resultCode != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*database));
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+
         return false;
     }
 
-    sqlite3_bind_int(statement, 1, user_id);
-    sqlite3_bind_int(statement, 2, status);
+    bool selected = executeSelect(statement, selectIntCallback, version);
+    sqlite3_finalize(statement);
 
-    return executeInsert(statement);
+    return selected;
+}
+
+static void selectIntCallback(sqlite3_stmt *statement, void *data)
+{
+    int *value = (int *)data;
+
+    *value = sqlite3_column_int(statement, 0);
+}
+
+static bool executeSQL(sqlite3 *database, const char *sql)
+{
+    char *errorMessage = NULL;
+    int resultCode = sqlite3_exec(database, sql, NULL, NULL, &errorMessage);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", errorMessage ? errorMessage : sqlite3_errmsg(database));
+        sqlite3_free(errorMessage);
+
+        return false;
+    }
+
+    return true;
 }
 
-bool selectUsersLatestLogStatus(sqlite3 **database, const int user_id, int *status_pointer)
+
+
+static bool buildPINIndex(struct DatabaseConfig *databaseConfig)
 {
+    // For readability.
+    sqlite3 *database = databaseConfig->database;
+
+    sqlite3_int64 dataVersion = 0;
+    sqlite3_int64 userCount = 0;
+    sqlite3_int64 lastUserChangeID = 0;
+
+    // Read the version first, so anything committed after it is caught by refreshPINIndex().
+    // The user_change ID and the users are read in the same transaction, so they match each other.
+    if (!selectInt64(database, SELECT_DATA_VERSION, &dataVersion) ||
+        !executeSQL(database, BEGIN_TRANSACTION))
+    {
+        return false;
+    }
+
+    if (!selectInt64(database, SELECT_USER_CHANGE_MAX_ID, &lastUserChangeID) ||
+        !selectInt64(database, SELECT_USER_COUNT, &userCount))
+    {
+        executeSQL(database, ROLLBACK_TRANSACTION);
+
+        return false;
+    }
+
+    databaseConfig->pinIndex = createPINIndex((int)userCount);
+
+    if (databaseConfig->pinIndex == NULL)
+    {
+        executeSQL(database, ROLLBACK_TRANSACTION);
+
+        return false;
+    }
+
     sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(database, SELECT_USER_ID_AND_PIN, -1, &statement, 0);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+        executeSQL(database, ROLLBACK_TRANSACTION);
+        cleanupPINIndex(databaseConfig->pinIndex);
+        databaseConfig->pinIndex = NULL;
+
+        return false;
+    }
+
+    // An empty user table is fine, so the return value of executeSelect() doesn't matter here.
+    executeSelect(statement, buildPINIndexCallback, databaseConfig);
+    sqlite3_finalize(statement);
+    executeSQL(database, COMMIT_TRANSACTION);
+
+    databaseConfig->dataVersion = (int)dataVersion;
+    databaseConfig->lastUserChangeID = lastUserChangeID;
+
+    // The index already has these changes, so they can go. Failing here only means they're kept a while longer.
+    resultCode = sqlite3_prepare_v2(database, DELETE_USER_CHANGES_BEFORE_ID, -1, &statement, 0);
+
+    if (resultCode == SQLITE_OK)
+    {
+        sqlite3_bind_int64(statement, 1, lastUserChangeID);
+        executeInsert(statement);
+        sqlite3_finalize(statement);
+    }
+
+    printf("PIN index built with %lld users.\n", (long long)userCount);
+
+    return true;
+}
+
+static void buildPINIndexCallback(sqlite3_stmt *statement, void *data)
+{
+    struct DatabaseConfig *databaseConfig = (struct DatabaseConfig *)data;
+
+    if (databaseConfig->pinIndex == NULL)
+    {
+        return;
+    }
+
+    int userID = sqlite3_column_int(statement, 0);
+    const char *pin = (const char *)sqlite3_column_text(statement, 1);
+
+    // PINs that are too long for the index are still found with SQL, see selectUserIDByPIN().
+    if (pin != NULL && strlen(pin) <= PIN_INDEX_MAX_PIN_LENGTH && !insertPINIndex(&databaseConfig->pinIndex, pin, userID))
+    {
+        cleanupPINIndex(databaseConfig->pinIndex);
+        databaseConfig->pinIndex = NULL;
+    }
+}
+
+static void refreshPINIndex(struct DatabaseConfig *databaseConfig)
+{
+    int dataVersion = databaseConfig->dataVersion;
+
+    if (!executeSelect(databaseConfig->statements.selectDataVersion, selectIntCallback, &dataVersion) ||
+        dataVersion == databaseConfig->dataVersion)
+    {
+        return;
+    }
+
+    databaseConfig->dataVersion = dataVersion;
+
+    // Something was committed by another process, but it may not have touched the user table at all.
+    sqlite3_stmt *statement = databaseConfig->statements.selectUserChangesAfterID;
+    sqlite3_bind_int64(statement, 1, databaseConfig->lastUserChangeID);
+    executeSelect(statement, refreshPINIndexCallback, databaseConfig);
+}
+
+static void refreshPINIndexCallback(sqlite3_stmt *statement, void *data)
+{
+    struct DatabaseConfig *databaseConfig = (struct DatabaseConfig *)data;
+
+    databaseConfig->lastUserChangeID = sqlite3_column_int64(statement, 0);
+
+    if (databaseConfig->pinIndex == NULL)
+    {
+        return;
+    }
+
+    int userID = sqlite3_column_int(statement, 1);
+    const char *oldPIN = (const char *)sqlite3_column_text(statement, 2);
+
+    if (oldPIN != NULL)
+    {
+        removePINIndex(databaseConfig->pinIndex, oldPIN);
+    }
+
+    // Column text has to be fetched after the previous one is used, it may be invalidated by the next call.
+    const char *newPIN = (const char *)sqlite3_column_text(statement, 3);
+
+    if (newPIN != NULL && strlen(newPIN) <= PIN_INDEX_MAX_PIN_LENGTH && !insertPINIndex(&databaseConfig->pinIndex, newPIN, userID))
+    {
+        // Out of memory. Without the index PINs are still looked up with SQL.
+        cleanupPINIndex(databaseConfig->pinIndex);
+        databaseConfig->pinIndex = NULL;
+    }
+}
 
-    int resultCode = sqlite3_prepare_v2(*database, SELECT_LOG_ROW_BY_USER_ID_LATEST, -1, &statement, 0);
+static bool selectInt64(sqlite3 *database, const char *sql, sqlite3_int64 *value)
+{
+    sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(database, sql, -1, &statement, 0);
 
     if (resultCode != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(*database));
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
 
         return false;
     }
 
-    sqlite3_bind_int(statement, 1, user_id);
+    bool selected = executeSelect(statement, selectInt64Callback, value);
+    sqlite3_finalize(statement);
 
-    return executeSelect(statement, selectUsersLatestLogStatusCallback, status_pointer);
+    return selected;
 }
 
-static void selectUsersLatestLogStatusCallback(sqlite3_stmt *statement, void *data)
+static void selectInt64Callback(sqlite3_stmt *statement, void *data)
 {
-    // Cast the generic void pointer to int. This points to the same address as *data.
-    int *status_pointer = (int *)data;
+    sqlite3_int64 *value = (sqlite3_int64 *)data;
 
-    // Assigns the value to the pointer, which also changes original pointer passed as *data.
-    *status_pointer = sqlite3_column_int(statement, 0);
+    *value = sqlite3_column_int64(statement, 0);
+}
+
+
+
+static bool executeSelect(sqlite3_stmt *statement, RowCallback callback, void *data)
+{
+    // Execute the prepared statement.
+    int resultCode = sqlite3_step(statement);
+
+    // No rows returned.
+    if (resultCode == SQLITE_DONE)
+    {
+        //fprintf(stderr, "No rows in the result set.\n");
+        resetStatement(statement);
+
+        return false;
+    }
+
+    // Execute the prepared statement row by row and handle callbacks for return values.
+    while (resultCode == SQLITE_ROW)
+    {
+        if (callback)
+        {
+            // Callback function gets the statement and pointer to data we want back.
+            callback(statement, data);
+        }
+
+        // Fetch the next row.
+        resultCode = sqlite3_step(statement);
+    }
+
+    if (resultCode != SQLITE_DONE)
+    {
+        fprintf(stderr, "Select failed. SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+        resetStatement(statement);
+
+        return false;
+    }
+
+    // Reset the statement instead of finalizing it, so that it can be run again without preparing it.
+    resetStatement(statement);
+
+    return true;
+}
+
+static bool executeQuery(sqlite3_stmt *statement, RowCallback callback, void *data, int *rowCount)
+{
+    int resultCode;
+    *rowCount = 0;
+
+    while ((resultCode = sqlite3_step(statement)) == SQLITE_ROW)
+    {
+        if (callback)
+        {
+            callback(statement, data);
+        }
+
+        (*rowCount)++;
+    }
+
+    if (resultCode != SQLITE_DONE)
+    {
+        fprintf(stderr, "Select failed. SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+        resetStatement(statement);
+
+        return false;
+    }
+
+    resetStatement(statement);
+
+    return true;
+}
+
+static bool executeInsert(sqlite3_stmt *statement)
+{
+     // Execute the prepared statement.
+    int resultCode = sqlite3_step(statement);
+
+    // Check the result code to determine success or failure.
+    if (resultCode == SQLITE_DONE)
+    {
+        //fprintf(stdout, "Insert successful.\n");
+        resetStatement(statement);
+
+        return true;
+    }
+
+    else
+    {
+        fprintf(stderr, "Insert failed. SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+        resetStatement(statement);
+
+        return false;
+    }
+}
+
+static void resetStatement(sqlite3_stmt *statement)
+{
+    sqlite3_reset(statement);
+    // Bindings survive sqlite3_reset(), clear them so no stale pointers (like PIN strings) are left behind.
+    sqlite3_clear_bindings(statement);
 }
 
 
 
+bool selectUserIDByPIN(struct DatabaseConfig *databaseConfig, const char *const pin, int *user_id_ptr)
+{
+    // The index holds every PIN short enough for it, so a miss there means the PIN doesn't exist.
+    if (databaseConfig->pinIndex != NULL && strlen(pin) <= PIN_INDEX_MAX_PIN_LENGTH)
+    {
+        refreshPINIndex(databaseConfig);
+
+        // The refresh drops the index if it runs out of memory.
+        if (databaseConfig->pinIndex != NULL)
+        {
+            return lookupPINIndex(databaseConfig->pinIndex, pin, user_id_ptr);
+        }
+    }
+
+    // Statement was prepared in openOrCreateDatabase(), see prepareStatements().
+    sqlite3_stmt *statement = databaseConfig->statements.selectUserIDByPIN;
+
+    // Bind the pin value to the ? placeholder in the SQL statement.
+    // 1 is the number of ? to bind to, in this case the first and only one.
+    // -1 tells the function that the number of bytes should be determined automatically.
+    // SQLITE_STATIC tells the function not to delete the string paratemer (pin) afterwards.
+    sqlite3_bind_text(statement, 1, pin, -1, SQLITE_STATIC);
 
+    // Pass the statement to a function that executes it. Since we're selecting something,
+    // we also pass a callback function and data pointer to get the values we want to select.
+    return executeSelect(statement, selectUserIDByPINCallback, user_id_ptr);
+}
 
-// TODO: Intellisense says sqlite3_callback is deprecated?
-// typedef int (*sqlite3_callback)(
-//    void*,    // Data provided in the 4th argument of sqlite3_exec()
-//    int,      // The number of columns in row */
-//    char**,   // An array of strings representing fields in the row
-//    char**    // An array of strings representing column names
-// );
-
-/* static int callback(void *data, int argc, char **argv, char **azColName){
-   int i;
-   fprintf(stderr, "%s: ", (const char*)data);
-   
-   for(i = 0; i<argc; i++){
-      printf("%s = %s\n", azColName[i], argv[i] ? argv[i] : "NULL");
-   }
-   
-   printf("\n");
-   return 0;
-} */
-
-/* int show_menu(){
-	int menu_choice;
-	
-printf("\n###############################################\n");
-printf("# Tietokanta olemassa nimella db_jaju\n");
-printf("#\n");
-printf("# kannassa USER ja LOG taulu  \n");
-printf("##################################################\n");
-printf("(1) lisaa USER tauluun rivi (oletusarvoilla) \n");
-printf("(2) lisaa LOG tauluun rivi (oletusarvoilla)\n");
-printf("----------------------------------------- \n");
-printf("(3) lisaa USER tauluun rivi (anna tiedot sarakkeisiin)\n");
-printf("(4) lisaa LOG tauluun rivi (anna tiedot sarakkeisiin)\n");
-printf("----------------------------------------- \n");
-printf("(5) nayta USER taulun kaikki rivit\n");
-printf("(6) nayta USER taulun user_id hakuna rfid_id\n");
-printf("(12) nayta USER taulun pin hakuna user_id\n");
-printf("(7) nayta LOG taulun kaikki rivit\n");
-printf("----------------------------------------- \n");
-printf("(8) paivita USER taulun user_id rivi (anna tiedot sarakkeisiin)\n");
-printf("(9) paivita LOG taulun log_id rivi (anna tiedot sarakkeisiin)\n");
-printf("----------------------------------------- \n");
-printf("(10) poista USER taulun user_id rivi\n");
-printf("(11) poista LOG taulun log_id rivi\n");
-printf("----------------------------------------- \n");
-printf("(0) Ohjelman lopetus\n");
-printf("----------------------------------------- \n");
-printf("Valitse toiminto numerolla (0-11) :");
-
-  scanf("%d", &menu_choice);
-  return menu_choice;
-} */
-
-/* int create_db(sqlite3 **db, char *db_name){
-   
-   char *zErrMsg = 0;
-   int rc=0;
-   //rc = sqlite3_open("jaju.db", db);
-   rc = sqlite3_open(db_name, db);
-  if( rc ) {
-	fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(*db));
-	return(0);
-  } else {
-	fprintf(stderr, "Opened database successfully\n");
-	return (1);
-  }
-  return rc;
-} */
-
-/* int create_table_user(sqlite3 **db){
-	char *zErrMsg = 0;
-	int rc=0;
-	char *sql;
-	// Create SQL statement 
-   sql = "CREATE TABLE IF NOT EXISTS USER (" \
-		"USER_ID INTEGER PRIMARY KEY AUTOINCREMENT, " \
-		"RFID_ID CHAR(20), " \
-		"NAME TEXT, " \
-		"PIN INTEGER);";
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, 0, &zErrMsg);
-   
-   if( rc != SQLITE_OK ){
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      	return(0);
-   } else {
-      fprintf(stdout, "Table created successfully\n");
-      	return(1);
-   }
-	return rc;
-} */
-
-/* int create_table_log(sqlite3 **db){
-	char *zErrMsg = 0;
-	int rc;
-	char *sql;
-	// Create SQL statement 
-   sql = "CREATE TABLE IF NOT EXISTS LOG (" \
-		"LOG_ID INTEGER PRIMARY KEY AUTOINCREMENT, " \
-		"USER_ID INTEGER NOT NULL," \
-		"STATUS INTEGER, "\
-		"LOG_TIME DATETIME DEFAULT CURRENT_TIMESTAMP);";
-		
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, 0, &zErrMsg);
-   
-   if( rc != SQLITE_OK ){
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Table created successfully\n");
-       return(1);
-   }
-	return rc;
-} */
-
-/* int insert_user_row(sqlite3 **db, char *rfid_id, char *name, int pin){
-	char *zErrMsg = 0;
-	int rc=0;
-	char sql[500];
-// Create SQL statement
-    sprintf(sql, "INSERT INTO USER (RFID_ID,NAME,PIN) "  \
-        "VALUES ('%s', '%s', %d ) ;" ,rfid_id,name, pin);
- 
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, 0, &zErrMsg);
-   
-   if( rc != SQLITE_OK ){
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Records created successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int insert_log_row(sqlite3 **db, int user_id, int status){
-	char *zErrMsg = 0;
-	int rc=0;
-	char sql[500];
-// Create SQL statement 
-     sprintf(sql, "INSERT INTO LOG (USER_ID, STATUS) VALUES (%d, %d);" ,user_id,status);
-   
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, 0, &zErrMsg);
-   
-   if( rc != SQLITE_OK ){
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Records created successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int show_table_user(sqlite3 **db){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-
-	char *sql;
-	// Create SQL statement
-   sql = "SELECT * from USER";
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-   
-      if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int show_table_log(sqlite3 **db){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-	char *sql;
-	// Create SQL statement
-   sql = "SELECT * from LOG";
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-   
-     if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int update_user_table_name(sqlite3 **db, int user_id, char *rfid_id, char *name, int pin){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-	// Create SQL statement 
-	char sql[500];
-	sprintf(sql, "UPDATE USER set RFID_ID = '%s', NAME = '%s', PIN = %d where USER_ID = %d;" ,rfid_id, name, pin, user_id);
-
-   
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-   
-     if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int update_log_row(sqlite3 **db, int user_id, int status, char *datetime, int log_id){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-	// Create SQL statement 
-	char sql[500];
-	sprintf(sql, "UPDATE LOG set USER_ID = %d , STATUS = %d ,  LOG_TIME = strftime('%s') where LOG_ID = %d;" ,user_id, status, datetime, log_id);   
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-   
-     if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int remove_user_row(sqlite3 **db, int user_id){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-	// Create SQL statement 
-	char sql[500];
-
-   sprintf(sql, "DELETE from USER where USER_ID=%d; " ,user_id );
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-     if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int remove_log_row(sqlite3 **db, int log_id){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-	// Create SQL statement 
-	char sql[500];
-
-   sprintf(sql, "DELETE from LOG where LOG_ID=%d; " ,log_id );
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-     if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-} */
-
-/* int select_user_id(sqlite3 **db, char *table, char *rfid_id){
-	char *zErrMsg = 0;
-	int rc;
-	const char* data = "Callback function called\n";
-
-
-	char sql[500];
-    sprintf(sql, "SELECT * from '%s' where RFID_ID='%s'; " ,table, rfid_id );
-
-   // Execute SQL statement
-   rc = sqlite3_exec(*db, sql, callback, (void*)data, &zErrMsg);
-   
-      if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-   } else {
-      fprintf(stdout, "Operation done successfully\n");
-      return(1);
-   }
-	return rc;
-	
-} */
-
-/* int select_userid_by_rfidid(sqlite3 **db, char *rfid_id, int *user_id_ptr){
-   
-    char *err_msg = 0;
-    sqlite3_stmt *res;
-    char *zErrMsg = 0;
-    int rc;
-    
-    char sql[500];
-	sprintf(sql, "SELECT USER_ID FROM USER WHERE RFID_ID='%s';" ,rfid_id);
-	
-	rc = sqlite3_prepare_v2(*db, sql, -1, &res, 0);
-	
-    int perke;
-	
-	if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-	} 
-	else {
-			while(1)
-			{
-			// fetch a row's status
-			rc = sqlite3_step(res);
-				if(rc == SQLITE_ROW) {
-					//some = (int)sqlite3_column_int(res, 0);
-						// or other type - sqlite3_column_text etc.
-					// ... fetch other columns, if there are any'
-					*user_id_ptr = (int)sqlite3_column_int(res, 0);
-					//if first result row
-					break;
-				}
-				else if(rc == SQLITE_DONE){
-					//loppu
-					break;
-				}
-				else {
-					sqlite3_finalize(res);
-					printf("some error encountered\n");
-					break;
-				}    
-			}
-			fprintf(stdout, "Operation done successfully\n");
-			return(1);
-	}
-	
-	return rc;	
-} */
-
-/* int select_pin_by_userid(sqlite3 **db, int user_id, int *pin_value){
-   
-    char *err_msg = 0;
-    sqlite3_stmt *res;
-    char *zErrMsg = 0;
-    int rc;
-    
-    char sql[500];
-	sprintf(sql, "SELECT PIN FROM USER WHERE USER_ID= %d ;" ,user_id);
-	
-	rc = sqlite3_prepare_v2(*db, sql, -1, &res, 0);
-	
-    int perke;
-	
-	if( rc != SQLITE_OK ) {
-      fprintf(stderr, "SQL error: %s\n", zErrMsg);
-      sqlite3_free(zErrMsg);
-      return(0);
-	} 
-	else {
-			while(1)
-			{
-			// fetch a row's status
-			rc = sqlite3_step(res);
-				if(rc == SQLITE_ROW) {
-					//some = (int)sqlite3_column_int(res, 0);
-						// or other type - sqlite3_column_text etc.
-					// ... fetch other columns, if there are any'
-					*pin_value = (int)sqlite3_column_int(res, 0);
-					//if first result row
-					break;
-				}
-				else if(rc == SQLITE_DONE){
-					//loppu
-					break;
-				}
-				else {
-					sqlite3_finalize(res);
-					printf("some error encountered\n");
-					break;
-				}    
-			}
-			fprintf(stdout, "Operation done successfully\n");
-			return(1);
-	}
-	
-	return rc;	
-} */
-
-/* void pause_ch(){
-	char ch;
-	while((getchar()) != '\n');
-		printf("\n\nEnter the Character to continue: ");
-							scanf("%c", &ch);
-	
-} */
+// Callback function for selectUserIDByPIN. Callback functions are needed for SELECT statements.
+static void selectUserIDByPINCallback(sqlite3_stmt *statement, void *data)
+{
+    // Cast the generic void pointer to int. This points to the same address as *data.
+    int *user_id_ptr = (int *)data;
 
+    // Assigns the value to the pointer, which also changes original pointer passed as *data.
+    // The second parameter is the index of the bindable parameter in the statement.
+    *user_id_ptr = sqlite3_column_int(statement, 0);
+}
+
+bool saveUserRow(struct DatabaseConfig *databaseConfig, const char *firstName, const char *lastName, const char *pin,
+                 const bool updateExisting, enum UserRowResult *result)
+{
+    sqlite3_stmt **statement = updateExisting ? &databaseConfig->statements.upsertUserRow
+                                              : &databaseConfig->statements.insertUserRow;
+
+    if (*statement == NULL &&
+        !prepareStatement(databaseConfig->database, updateExisting ? UPSERT_USER_ROW_BY_PIN : INSERT_USER_ROW_IF_NEW_PIN, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(*statement, 1, firstName, -1, SQLITE_STATIC);
+    sqlite3_bind_text(*statement, 2, lastName, -1, SQLITE_STATIC);
+    sqlite3_bind_text(*statement, 3, pin, -1, SQLITE_STATIC);
+
+    // An upsert that updates doesn't change the last insert rowid, an insert always does.
+    sqlite3_int64 lastInsertedID = sqlite3_last_insert_rowid(databaseConfig->database);
+
+    if (!executeInsert(*statement))
+    {
+        return false;
+    }
+
+    if (sqlite3_changes(databaseConfig->database) == 0)
+    {
+        *result = USER_ROW_SKIPPED;
+    }
+
+    else if (sqlite3_last_insert_rowid(databaseConfig->database) != lastInsertedID)
+    {
+        *result = USER_ROW_INSERTED;
+    }
+
+    else
+    {
+        *result = USER_ROW_UPDATED;
+    }
+
+    return true;
+}
+
+bool insertLogRow(struct DatabaseConfig *databaseConfig, const int user_id, const int status, const int64_t timestamp)
+{
+    sqlite3_stmt *statement = databaseConfig->statements.insertLogRow;
+
+    sqlite3_bind_int(statement, 1, user_id);
+    sqlite3_bind_int64(statement, 2, timestamp);
+    sqlite3_bind_int(statement, 3, status);
+
+    return executeInsert(statement);
+}
+
+bool selectUsersLatestLogStatus(struct DatabaseConfig *databaseConfig, const int user_id, int *status_pointer, bool *found)
+{
+    // Reads user_status instead of the log table. It is kept in sync with the latest log row by triggers.
+    sqlite3_stmt *statement = databaseConfig->statements.selectUsersLatestLogStatus;
+
+    sqlite3_bind_int(statement, 1, user_id);
+
+    // A failed read must not look like a user who has never clocked in, so no rows is told apart from an error.
+    int rowCount = 0;
+    bool selected = executeQuery(statement, selectUsersLatestLogStatusCallback, status_pointer, &rowCount);
+    *found = selected && rowCount > 0;
+
+    return selected;
+}
+
+static void selectUsersLatestLogStatusCallback(sqlite3_stmt *statement, void *data)
+{
+    // Cast the generic void pointer to int. This points to the same address as *data.
+    int *status_pointer = (int *)data;
+
+    // Assigns the value to the pointer, which also changes original pointer passed as *data.
+    *status_pointer = sqlite3_column_int(statement, 0);
+}
+
+bool isValidStatusChange(const bool previousStatusFound, const int previousStatus, const int requestedStatus)
+{
+    return ((!previousStatusFound && requestedStatus == LOG_STATUS_IN) ||
+            (previousStatusFound && requestedStatus != previousStatus));
+}
+
+bool recordClockEvent(struct DatabaseConfig *databaseConfig, const char *const pin, const int requestedStatus,
+                      const int64_t timestamp, struct ClockEventOutcome *outcome)
+{
+    *outcome = (struct ClockEventOutcome){ CLOCK_EVENT_DATABASE_ERROR, -1, LOG_STATUS_ERROR, 0 };
+
+    // Taking the write lock before reading anything means nobody can change the user between our reads and the insert.
+    if (!beginTransaction(databaseConfig))
+    {
+        return false;
+    }
+
+    if (!selectUserIDByPIN(databaseConfig, pin, &outcome->userID))
+    {
+        // A database error looks like a missing PIN here. Nothing was written either way.
+        outcome->result = CLOCK_EVENT_INVALID_PIN;
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    if (!recordUsersClockEvent(databaseConfig, outcome->userID, requestedStatus, timestamp, outcome) ||
+        !commitTransaction(databaseConfig))
+    {
+        outcome->result = CLOCK_EVENT_DATABASE_ERROR;
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    return outcome->result == CLOCK_EVENT_ACCEPTED;
+}
+
+bool recordUsersClockEvent(struct DatabaseConfig *databaseConfig, const int userID, const int requestedStatus,
+                           const int64_t timestamp, struct ClockEventOutcome *outcome)
+{
+    outcome->userID = userID;
+    outcome->previousStatus = LOG_STATUS_ERROR;
+    outcome->logID = 0;
+
+    bool previousStatusFound = false;
+
+    if (!selectUsersLatestLogStatus(databaseConfig, userID, &outcome->previousStatus, &previousStatusFound))
+    {
+        outcome->result = CLOCK_EVENT_DATABASE_ERROR;
+
+        return false;
+    }
+
+    if (!isValidStatusChange(previousStatusFound, outcome->previousStatus, requestedStatus))
+    {
+        outcome->result = CLOCK_EVENT_INVALID_STATUS;
+
+        return true;
+    }
+
+    if (!insertLogRow(databaseConfig, userID, requestedStatus, timestamp))
+    {
+        outcome->result = CLOCK_EVENT_DATABASE_ERROR;
+
+        return false;
+    }
+
+    outcome->logID = sqlite3_last_insert_rowid(databaseConfig->database);
+    outcome->result = CLOCK_EVENT_ACCEPTED;
+
+    return true;
+}
+
+bool beginTransaction(struct DatabaseConfig *databaseConfig)
+{
+    // Transaction control statements don't return rows, so they run just like inserts.
+    return executeInsert(databaseConfig->statements.beginImmediateTransaction);
+}
+
+bool commitTransaction(struct DatabaseConfig *databaseConfig)
+{
+    return executeInsert(databaseConfig->statements.commitTransaction);
+}
+
+void rollbackTransaction(struct DatabaseConfig *databaseConfig)
+{
+    // Rolling back fails harmlessly if SQLite already rolled the transaction back because of an error.
+    if (sqlite3_get_autocommit(databaseConfig->database) == 0)
+    {
+        executeInsert(databaseConfig->statements.rollbackTransaction);
+    }
+}
+
+
+
+bool selectArchivableLogMonth(struct DatabaseConfig *databaseConfig, const int keepMonths, struct LogMonth *month)
+{
+    // Date modifiers are plain text, so unlike PRAGMAs they can be bound.
+    char keepMonthsModifier[32];
+    snprintf(keepMonthsModifier, sizeof(keepMonthsModifier), "+%d months", keepMonths > 1 ? keepMonths : 1);
+
+    sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(databaseConfig->database, SELECT_ARCHIVABLE_LOG_MONTH, -1, &statement, 0);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+
+        return false;
+    }
+
+    sqlite3_bind_text(statement, 1, keepMonthsModifier, -1, SQLITE_STATIC);
+
+    // No rows means the log is empty or its oldest month is still kept.
+    bool selected = executeSelect(statement, selectArchivableLogMonthCallback, month);
+    sqlite3_finalize(statement);
+
+    return selected;
+}
+
+static void selectArchivableLogMonthCallback(sqlite3_stmt *statement, void *data)
+{
+    struct LogMonth *month = (struct LogMonth *)data;
+
+    month->year = sqlite3_column_int(statement, 0);
+    month->month = sqlite3_column_int(statement, 1);
+    month->start = sqlite3_column_int64(statement, 2);
+    month->end = sqlite3_column_int64(statement, 3);
+}
+
+bool openLogArchive(struct DatabaseConfig *databaseConfig, const struct LogMonth *month)
+{
+    char filePath[sizeof(LOG_ARCHIVE_FILEPATH_FORMAT) + 16];
+    snprintf(filePath, sizeof(filePath), LOG_ARCHIVE_FILEPATH_FORMAT, month->year, month->month);
+
+    if (!attachDatabase(databaseConfig->database, filePath, SCHEMA_ARCHIVE))
+    {
+        return false;
+    }
+
+    // The archive file gets the same index as the log table, so reports can read it the same way.
+    if (!executeSQL(databaseConfig->database, CREATE_TABLE_ARCHIVE_LOG CREATE_INDEX_ARCHIVE_LOG_USER_ID_DATETIME))
+    {
+        detachDatabase(databaseConfig->database, SCHEMA_ARCHIVE);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool archiveLogBatch(struct DatabaseConfig *databaseConfig, const struct LogMonth *month, const int batchSize,
+                     int *archivedCount)
+{
+    // For readability.
+    sqlite3 *database = databaseConfig->database;
+
+    *archivedCount = 0;
+    sqlite3_int64 lastID = 0;
+
+    if (!executeArchiveStatement(database, SELECT_ARCHIVE_BATCH_LAST_ID, month, batchSize, &lastID))
+    {
+        return false;
+    }
+
+    // The month has no rows left in the database.
+    if (lastID == 0)
+    {
+        return true;
+    }
+
+    // Each statement is its own transaction. A transaction that writes to a WAL database and an attached file
+    // isn't atomic across the two, so the archive file is committed before anything is deleted.
+    if (!executeArchiveStatement(database, COPY_LOG_ROWS_TO_ARCHIVE, month, lastID, NULL) ||
+        !executeArchiveStatement(database, DELETE_ARCHIVED_LOG_ROWS, month, lastID, NULL))
+    {
+        return false;
+    }
+
+    *archivedCount = sqlite3_changes(database);
+
+    return true;
+}
+
+void closeLogArchive(struct DatabaseConfig *databaseConfig)
+{
+    detachDatabase(databaseConfig->database, SCHEMA_ARCHIVE);
+}
+
+bool attachLogArchive(struct DatabaseConfig *databaseConfig, const int year, const int month, const char *schemaName)
+{
+    char filePath[sizeof(LOG_ARCHIVE_FILEPATH_FORMAT) + 16];
+    snprintf(filePath, sizeof(filePath), LOG_ARCHIVE_FILEPATH_FORMAT, year, month);
+
+    // ATTACH would create an empty file for a month that was never archived.
+    if (access(filePath, F_OK) != 0)
+    {
+        return false;
+    }
+
+    return attachDatabase(databaseConfig->database, filePath, schemaName);
+}
+
+void detachLogArchive(struct DatabaseConfig *databaseConfig, const char *schemaName)
+{
+    detachDatabase(databaseConfig->database, schemaName);
+}
+
+bool selectLogRowsAfterID(struct DatabaseConfig *databaseConfig, const int64_t afterID, struct LogRow *rows,
+                          const int maxRows, int *rowCount)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.selectLogRowsAfterID;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, SELECT_LOG_ROWS_AFTER_ID, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int64(*statement, 1, afterID);
+    sqlite3_bind_int(*statement, 2, maxRows);
+
+    struct LogRowPage page = { .rows = rows, .maxRows = maxRows, .rowCount = 0 };
+    int selectedCount = 0;
+
+    bool selected = executeQuery(*statement, selectLogRowsAfterIDCallback, &page, &selectedCount);
+    *rowCount = page.rowCount;
+
+    return selected;
+}
+
+static void selectLogRowsAfterIDCallback(sqlite3_stmt *statement, void *data)
+{
+    struct LogRowPage *page = (struct LogRowPage *)data;
+
+    // LIMIT keeps the rows within the array, this is just in case.
+    if (page->rowCount >= page->maxRows)
+    {
+        return;
+    }
+
+    struct LogRow *row = &page->rows[page->rowCount++];
+
+    row->id = sqlite3_column_int64(statement, 0);
+    row->userID = sqlite3_column_int(statement, 1);
+    row->datetime = sqlite3_column_int64(statement, 2);
+    row->status = sqlite3_column_int(statement, 3);
+}
+
+bool selectLatestLogID(struct DatabaseConfig *databaseConfig, int64_t *logID)
+{
+    sqlite3_int64 latestID = 0;
+    bool selected = selectInt64(databaseConfig->database, SELECT_LATEST_LOG_ID, &latestID);
+    *logID = latestID;
+
+    return selected;
+}
+
+bool advanceLatestLogID(struct DatabaseConfig *databaseConfig, const int64_t logID)
+{
+    sqlite3_stmt *statement;
+
+    // Only run when the journal is ahead of the database, so the statement isn't kept.
+    if (sqlite3_prepare_v2(databaseConfig->database, ADVANCE_LOG_ID_SEQUENCE, -1, &statement, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+
+        return false;
+    }
+
+    sqlite3_bind_int64(statement, 1, logID);
+
+    bool found = false;
+    bool advanced = executeChange(databaseConfig, statement, &found);
+    sqlite3_finalize(statement);
+
+    return advanced && found;
+}
+
+bool selectLogRowIDByEvent(struct DatabaseConfig *databaseConfig, const int userID, const int status,
+                           const int64_t timestamp, int64_t *logID)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.selectLogRowIDByEvent;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, SELECT_LOG_ROW_ID_BY_EVENT, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(*statement, 1, userID);
+    sqlite3_bind_int64(*statement, 2, timestamp);
+    sqlite3_bind_int(*statement, 3, status);
+
+    sqlite3_int64 foundID = 0;
+    int rowCount = 0;
+
+    bool selected = executeQuery(*statement, selectInt64Callback, &foundID, &rowCount);
+    *logID = foundID;
+
+    return selected;
+}
+
+bool selectExportCursor(struct DatabaseConfig *databaseConfig, const char *name, struct ExportCursor *cursor, bool *found)
+{
+    // A new cursor starts before the first log row.
+    *cursor = (struct ExportCursor){ 0 };
+    snprintf(cursor->name, sizeof(cursor->name), "%s", name);
+
+    sqlite3_stmt *statement;
+
+    if (sqlite3_prepare_v2(databaseConfig->database, SELECT_EXPORT_CURSOR, -1, &statement, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+
+        return false;
+    }
+
+    sqlite3_bind_text(statement, 1, name, -1, SQLITE_STATIC);
+
+    int rowCount = 0;
+    bool selected = executeQuery(statement, selectExportCursorCallback, cursor, &rowCount);
+    sqlite3_finalize(statement);
+
+    *found = rowCount > 0;
+
+    return selected;
+}
+
+static void selectExportCursorCallback(sqlite3_stmt *statement, void *data)
+{
+    struct ExportCursor *cursor = (struct ExportCursor *)data;
+
+    cursor->lastLogID = sqlite3_column_int64(statement, 0);
+    snprintf(cursor->file, sizeof(cursor->file), "%s", (const char *)sqlite3_column_text(statement, 1));
+    cursor->fileSize = sqlite3_column_int64(statement, 2);
+}
+
+bool saveExportCursor(struct DatabaseConfig *databaseConfig, const struct ExportCursor *cursor)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.saveExportCursor;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, SAVE_EXPORT_CURSOR, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_text(*statement, 1, cursor->name, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(*statement, 2, cursor->lastLogID);
+    sqlite3_bind_text(*statement, 3, cursor->file, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(*statement, 4, cursor->fileSize);
+
+    return executeInsert(*statement);
+}
+
+bool deleteExportCursor(struct DatabaseConfig *databaseConfig, const char *name, bool *found)
+{
+    sqlite3_stmt *statement;
+
+    if (sqlite3_prepare_v2(databaseConfig->database, DELETE_EXPORT_CURSOR, -1, &statement, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+
+        return false;
+    }
+
+    sqlite3_bind_text(statement, 1, name, -1, SQLITE_STATIC);
+
+    bool deleted = executeInsert(statement);
+    sqlite3_finalize(statement);
+
+    *found = deleted && sqlite3_changes(databaseConfig->database) > 0;
+
+    return deleted;
+}
+
+bool updateUserRow(struct DatabaseConfig *databaseConfig, const int userID, const char *firstName, const char *lastName,
+                   const char *pin, bool *found)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.updateUserRow;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, UPDATE_USER_ROW_BY_ID, statement))
+    {
+        return false;
+    }
+
+    // Binding a NULL string binds SQL NULL, which keeps the old value.
+    sqlite3_bind_int(*statement, 1, userID);
+    sqlite3_bind_text(*statement, 2, firstName, -1, SQLITE_STATIC);
+    sqlite3_bind_text(*statement, 3, lastName, -1, SQLITE_STATIC);
+    sqlite3_bind_text(*statement, 4, pin, -1, SQLITE_STATIC);
+
+    return executeChange(databaseConfig, *statement, found);
+}
+
+bool deleteUserRow(struct DatabaseConfig *databaseConfig, const int userID, const bool withLogRows, bool *found,
+                   bool *hasLogRows)
+{
+    struct DatabaseStatements *statements = &databaseConfig->statements;
+    *found = false;
+    *hasLogRows = false;
+
+    if (statements->selectUserHasLogRows == NULL &&
+        !prepareStatement(databaseConfig->database, SELECT_USER_HAS_LOG_ROWS, &statements->selectUserHasLogRows))
+    {
+        return false;
+    }
+
+    int exists = 0;
+    sqlite3_bind_int(statements->selectUserHasLogRows, 1, userID);
+
+    if (!executeSelect(statements->selectUserHasLogRows, selectIntCallback, &exists))
+    {
+        return false;
+    }
+
+    *hasLogRows = exists != 0;
+
+    if (*hasLogRows && !withLogRows)
+    {
+        // Nothing is deleted, but the caller still wants to know whether the user exists.
+        struct UserRow user;
+        int rowCount = 0;
+
+        if (!selectUserRowsAfterID(databaseConfig, userID - 1, false, &user, 1, &rowCount))
+        {
+            return false;
+        }
+
+        *found = rowCount == 1 && user.id == userID;
+
+        return true;
+    }
+
+    bool deletedRows = false;
+
+    if (*hasLogRows)
+    {
+        if (statements->deleteUsersLogRows == NULL &&
+            !prepareStatement(databaseConfig->database, DELETE_LOG_ROWS_BY_USER_ID, &statements->deleteUsersLogRows))
+        {
+            return false;
+        }
+
+        sqlite3_bind_int(statements->deleteUsersLogRows, 1, userID);
+
+        if (!executeChange(databaseConfig, statements->deleteUsersLogRows, &deletedRows))
+        {
+            return false;
+        }
+    }
+
+    if (statements->deleteUserStatus == NULL &&
+        !prepareStatement(databaseConfig->database, DELETE_USER_STATUS_BY_USER_ID, &statements->deleteUserStatus))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(statements->deleteUserStatus, 1, userID);
+
+    if (!executeChange(databaseConfig, statements->deleteUserStatus, &deletedRows))
+    {
+        return false;
+    }
+
+    if (statements->deleteUserRow == NULL &&
+        !prepareStatement(databaseConfig->database, DELETE_USER_ROW_BY_ID, &statements->deleteUserRow))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(statements->deleteUserRow, 1, userID);
+
+    return executeChange(databaseConfig, statements->deleteUserRow, found);
+}
+
+bool updateLogRow(struct DatabaseConfig *databaseConfig, const int64_t logID, const int64_t *timestamp, const int *status,
+                  bool *found)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.updateLogRow;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, UPDATE_LOG_ROW_BY_ID, statement))
+    {
+        return false;
+    }
+
+    // Unbound parameters are NULL, which keeps the old value.
+    sqlite3_bind_int64(*statement, 1, logID);
+
+    if (timestamp != NULL)
+    {
+        sqlite3_bind_int64(*statement, 2, *timestamp);
+    }
+
+    if (status != NULL)
+    {
+        sqlite3_bind_int(*statement, 3, *status);
+    }
+
+    return executeChange(databaseConfig, *statement, found);
+}
+
+bool deleteLogRow(struct DatabaseConfig *databaseConfig, const int64_t logID, bool *found)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.deleteLogRow;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, DELETE_LOG_ROW_BY_ID, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int64(*statement, 1, logID);
+
+    return executeChange(databaseConfig, *statement, found);
+}
+
+bool selectUserRowsAfterID(struct DatabaseConfig *databaseConfig, const int afterID, const bool presentOnly,
+                           struct UserRow *rows, const int maxRows, int *rowCount)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.selectUserRowsAfterID;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, SELECT_USER_ROWS_AFTER_ID, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(*statement, 1, afterID);
+
+    // Left unbound (NULL) to select every user.
+    if (presentOnly)
+    {
+        sqlite3_bind_int(*statement, 2, LOG_STATUS_IN);
+    }
+
+    sqlite3_bind_int(*statement, 3, maxRows);
+
+    struct UserRowPage page = { .rows = rows, .maxRows = maxRows, .rowCount = 0 };
+    int selectedCount = 0;
+
+    bool selected = executeQuery(*statement, selectUserRowsAfterIDCallback, &page, &selectedCount);
+    *rowCount = page.rowCount;
+
+    return selected;
+}
+
+static void selectUserRowsAfterIDCallback(sqlite3_stmt *statement, void *data)
+{
+    struct UserRowPage *page = (struct UserRowPage *)data;
+
+    // LIMIT keeps the rows within the array, this is just in case.
+    if (page->rowCount >= page->maxRows)
+    {
+        return;
+    }
+
+    struct UserRow *row = &page->rows[page->rowCount++];
+
+    row->id = sqlite3_column_int(statement, 0);
+    snprintf(row->firstName, sizeof(row->firstName), "%s", (const char *)sqlite3_column_text(statement, 1));
+    snprintf(row->lastName, sizeof(row->lastName), "%s", (const char *)sqlite3_column_text(statement, 2));
+
+    // NULL status means the user has never clocked in, sqlite3_column_int() reads NULL as 0.
+    row->status = sqlite3_column_int(statement, 3);
+    row->since = sqlite3_column_int64(statement, 4);
+}
+
+bool selectUsersLatestLogRows(struct DatabaseConfig *databaseConfig, const int userID, struct LogRow *rows,
+                              const int maxRows, int *rowCount)
+{
+    sqlite3_stmt **statement = &databaseConfig->statements.selectUsersLatestLogRows;
+
+    if (*statement == NULL && !prepareStatement(databaseConfig->database, SELECT_USERS_LATEST_LOG_ROWS, statement))
+    {
+        return false;
+    }
+
+    sqlite3_bind_int(*statement, 1, userID);
+    sqlite3_bind_int(*statement, 2, maxRows);
+
+    // Same columns as SELECT_LOG_ROWS_AFTER_ID, so the same callback reads them.
+    struct LogRowPage page = { .rows = rows, .maxRows = maxRows, .rowCount = 0 };
+    int selectedCount = 0;
+
+    bool selected = executeQuery(*statement, selectLogRowsAfterIDCallback, &page, &selectedCount);
+    *rowCount = page.rowCount;
+
+    return selected;
+}
+
+static bool executeChange(struct DatabaseConfig *databaseConfig, sqlite3_stmt *statement, bool *found)
+{
+    bool executed = executeInsert(statement);
+    *found = executed && sqlite3_changes(databaseConfig->database) > 0;
+
+    return executed;
+}
+
+void disableAutoCheckpoint(struct DatabaseConfig *databaseConfig)
+{
+    executeSQL(databaseConfig->database, DISABLE_WAL_AUTOCHECKPOINT);
+}
+
+void beginMaintenanceSlice(struct DatabaseConfig *databaseConfig, MaintenanceStopCheck stopCheck, void *data)
+{
+    databaseConfig->maintenanceStopCheck = stopCheck;
+    databaseConfig->maintenanceStopCheckData = data;
+
+    // Waiting for the log writer's lock would block the main loop, so a locked database just ends the slice.
+    sqlite3_busy_timeout(databaseConfig->database, 0);
+    sqlite3_progress_handler(databaseConfig->database, MAINTENANCE_PROGRESS_INSTRUCTIONS, maintenanceProgressHandler,
+                             databaseConfig);
+}
+
+void endMaintenanceSlice(struct DatabaseConfig *databaseConfig)
+{
+    sqlite3_progress_handler(databaseConfig->database, 0, NULL, NULL);
+    sqlite3_busy_timeout(databaseConfig->database, databaseConfig->settings.busyTimeoutMilliseconds);
+
+    databaseConfig->maintenanceStopCheck = NULL;
+    databaseConfig->maintenanceStopCheckData = NULL;
+}
+
+bool checkpointDatabase(struct DatabaseConfig *databaseConfig, int *walPages, bool *stopped)
+{
+    int checkpointedPages = 0;
+    *walPages = -1;
+    *stopped = false;
+
+    // PASSIVE copies the pages no reader still needs and never waits. The progress handler isn't called here.
+    int resultCode = sqlite3_wal_checkpoint_v2(databaseConfig->database, NULL, SQLITE_CHECKPOINT_PASSIVE,
+                                               walPages, &checkpointedPages);
+
+    if (resultCode == SQLITE_BUSY || resultCode == SQLITE_LOCKED)
+    {
+        *stopped = true;
+
+        return false;
+    }
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "Checkpoint failed. SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+
+        return false;
+    }
+
+    return true;
+}
+
+bool optimizeDatabase(struct DatabaseConfig *databaseConfig, bool *stopped)
+{
+    return executeMaintenanceSQL(databaseConfig->database, SET_ANALYSIS_LIMIT, NULL, NULL, stopped) &&
+           executeMaintenanceSQL(databaseConfig->database, OPTIMIZE_DATABASE, NULL, NULL, stopped);
+}
+
+bool vacuumFreePages(struct DatabaseConfig *databaseConfig, const int maxPages, int *freePages, bool *stopped)
+{
+    sqlite3_int64 autoVacuum = 0;
+    sqlite3_int64 freelistCount = 0;
+    *freePages = 0;
+    *stopped = false;
+
+    if (!selectInt64(databaseConfig->database, SELECT_AUTO_VACUUM, &autoVacuum))
+    {
+        return false;
+    }
+
+    // Databases created before incremental auto vacuum was turned on keep their free pages for new rows.
+    if (autoVacuum != AUTO_VACUUM_INCREMENTAL)
+    {
+        return true;
+    }
+
+    // Longest is "PRAGMA incremental_vacuum(" plus an int.
+    char sql[64];
+    snprintf(sql, sizeof(sql), INCREMENTAL_VACUUM_FORMAT, maxPages);
+
+    if (!executeMaintenanceSQL(databaseConfig->database, sql, NULL, NULL, stopped) ||
+        !selectInt64(databaseConfig->database, SELECT_FREELIST_COUNT, &freelistCount))
+    {
+        return false;
+    }
+
+    *freePages = (int)freelistCount;
+
+    return true;
+}
+
+bool quickCheckDatabase(struct DatabaseConfig *databaseConfig, bool *passed, bool *stopped)
+{
+    *passed = true;
+
+    return executeMaintenanceSQL(databaseConfig->database, QUICK_CHECK_DATABASE, quickCheckCallback, passed, stopped);
+}
+
+static void quickCheckCallback(sqlite3_stmt *statement, void *data)
+{
+    bool *passed = (bool *)data;
+    const char *result = (const char *)sqlite3_column_text(statement, 0);
+
+    if (result == NULL || strcmp(result, QUICK_CHECK_OK) != 0)
+    {
+        fprintf(stderr, "Database quick check: %s\n", result != NULL ? result : "no result");
+        *passed = false;
+    }
+}
+
+static int maintenanceProgressHandler(void *data)
+{
+    struct DatabaseConfig *databaseConfig = (struct DatabaseConfig *)data;
+
+    return databaseConfig->maintenanceStopCheck != NULL &&
+           databaseConfig->maintenanceStopCheck(databaseConfig->maintenanceStopCheckData);
+}
+
+static bool executeMaintenanceSQL(sqlite3 *database, const char *sql, RowCallback callback, void *data, bool *stopped)
+{
+    *stopped = false;
+
+    sqlite3_stmt *statement;
+
+    if (sqlite3_prepare_v2(database, sql, -1, &statement, 0) != SQLITE_OK)
+    {
+        // Preparing can find the schema locked too.
+        *stopped = sqlite3_errcode(database) == SQLITE_BUSY || sqlite3_errcode(database) == SQLITE_LOCKED;
+
+        if (!*stopped)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+        }
+
+        return false;
+    }
+
+    int resultCode;
+
+    while ((resultCode = sqlite3_step(statement)) == SQLITE_ROW)
+    {
+        if (callback)
+        {
+            callback(statement, data);
+        }
+    }
+
+    *stopped = resultCode == SQLITE_INTERRUPT || resultCode == SQLITE_BUSY || resultCode == SQLITE_LOCKED;
+
+    if (resultCode != SQLITE_DONE && !*stopped)
+    {
+        fprintf(stderr, "Maintenance failed. SQL error: %s\n", sqlite3_errmsg(database));
+    }
+
+    sqlite3_finalize(statement);
+
+    return resultCode == SQLITE_DONE;
+}
+
+static bool executeArchiveStatement(sqlite3 *database, const char *sql, const struct LogMonth *month,
+                                    const sqlite3_int64 limit, sqlite3_int64 *value)
+{
+    // Prepared for every batch, the statements can only be prepared while the archive file is attached.
+    sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(database, sql, -1, &statement, 0);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+
+        return false;
+    }
+
+    sqlite3_bind_int64(statement, 1, month->start);
+    sqlite3_bind_int64(statement, 2, month->end);
+    sqlite3_bind_int64(statement, 3, limit);
+
+    bool executed = value != NULL ? executeSelect(statement, selectInt64Callback, value) : executeInsert(statement);
+    sqlite3_finalize(statement);
+
+    return executed;
+}
+
+static bool attachDatabase(sqlite3 *database, const char *filePath, const char *schemaName)
+{
+    sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(database, ATTACH_DATABASE, -1, &statement, 0);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+
+        return false;
+    }
+
+    sqlite3_bind_text(statement, 1, filePath, -1, SQLITE_STATIC);
+    sqlite3_bind_text(statement, 2, schemaName, -1, SQLITE_STATIC);
+
+    bool attached = executeInsert(statement);
+    sqlite3_finalize(statement);
+
+    return attached;
+}
+
+static void detachDatabase(sqlite3 *database, const char *schemaName)
+{
+    sqlite3_stmt *statement;
+    int resultCode = sqlite3_prepare_v2(database, DETACH_DATABASE, -1, &statement, 0);
+
+    if (resultCode != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+
+        return;
+    }
+
+    sqlite3_bind_text(statement, 1, schemaName, -1, SQLITE_STATIC);
+    executeInsert(statement);
+    sqlite3_finalize(statement);
+}
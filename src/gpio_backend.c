@@ -0,0 +1,54 @@
+/**
+ * @file gpio_backend.c
+ * @author Selkamies
+ *
+ * @brief Lists the GPIO backends built into the program. CMake defines GPIO_BACKEND_PIGPIO and
+ * GPIO_BACKEND_GPIOD when it finds the libraries, the simulated backend is always there.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stddef.h>             // NULL.
+#include <string.h>             // strcmp().
+
+#include "gpio_backend.h"
+
+
+
+#pragma region Globals
+
+const struct GPIOBackend *gpioBackend = NULL;
+
+/** @brief Every backend built into the program. */
+static const struct GPIOBackend *const backends[] =
+{
+#ifdef GPIO_BACKEND_PIGPIO
+    &pigpioGPIOBackend,
+#endif
+#ifdef GPIO_BACKEND_GPIOD
+    &gpiodGPIOBackend,
+#endif
+    &simulatedGPIOBackend
+};
+
+#pragma endregion
+
+
+
+const struct GPIOBackend *findGPIOBackend(const char *name)
+{
+    for (size_t index = 0; index < sizeof(backends) / sizeof(backends[0]); index++)
+    {
+        if (strcmp(backends[index]->name, name) == 0)
+        {
+            return backends[index];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,824 @@
+/**
+ * @file gpio_backend_gpiod.c
+ * @author Selkamies
+ *
+ * @brief GPIO backend using the kernel's GPIO character device through libgpiod v2.
+ * Doesn't need root or a sampling thread, only access to the chip device, so it can be run against
+ * the gpio-sim kernel module on any Linux machine.
+ *
+ * A pin is its own line request until setKeypadPins() moves the keypad rows and columns into one
+ * request each, so a bank read or write of the keypad is one ioctl per request. Edge events are
+ * timestamped by the kernel and read by the edge thread, which sleeps in epoll_wait() on the line
+ * request file descriptors until there is an event.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t, uint64_t.
+#include <errno.h>              // errno, EINTR.
+#include <unistd.h>             // close(), write().
+#include <pthread.h>            // pthread_create(), pthread_join(), pthread_mutex_t.
+#include <sys/epoll.h>          // epoll_create1(), epoll_ctl(), epoll_wait().
+#include <sys/eventfd.h>        // eventfd().
+#include <gpiod.h>
+
+#include "gpio_backend.h"
+#include "timer.h"              // getMonotonicTimeInNanoseconds(), sleepForSeconds().
+
+
+
+#pragma region Globals
+
+/** @brief Highest line offset + 1 the backend handles. The Raspberry Pi's main chip has 58 lines. */
+#define GPIOD_MAX_LINES 64
+/** @brief Name the lines are requested with, shown by gpioinfo. */
+#define GPIOD_CONSUMER "clock_in"
+/** @brief Most edge events read from a request at a time. */
+#define GPIOD_EVENT_BUFFER_SIZE 16
+/** @brief epoll data of the edge thread's stop eventfd. The requests use their index. */
+#define GPIOD_STOP_EVENT UINT32_MAX
+
+/**
+ * @brief Settings of one line, kept so that its request can be reconfigured.
+ */
+struct GPIODLine
+{
+    /** @brief Direction of the line. */
+    enum GPIOPinMode mode;
+    /** @brief Pull resistor of the line. */
+    enum GPIOPinPull pull;
+    /** @brief Level the line was last driven to, it's given again when the line is reconfigured. */
+    int outputLevel;
+    /** @brief Index of the request the line is in, -1 until the line is first used. */
+    int request;
+    /** @brief Function to call on an edge, NULL for none. The line has edge detection while it's an input with one. */
+    GPIOAlertFunction alert;
+    /** @brief Pointer given to the alert function. */
+    void *alertData;
+};
+
+/**
+ * @brief One line request and the lines in it.
+ */
+struct GPIODRequest
+{
+    /** @brief The request, NULL once it's released. */
+    struct gpiod_line_request *request;
+    /** @brief Line offsets in the request. */
+    unsigned int offsets[GPIOD_MAX_LINES];
+    /** @brief Number of lines in the request. */
+    int lineCount;
+    /** @brief Whether the request's file descriptor is in the edge thread's epoll set. */
+    bool watched;
+};
+
+/**
+ * @brief The thread reading edge events.
+ */
+struct GPIODEdgeThread
+{
+    pthread_t thread;
+    /** @brief Whether the thread was started and hasn't been joined. */
+    bool running;
+    /** @brief The requests with edge detection, and stopFd. */
+    int epollFd;
+    /** @brief Written to stop the thread. */
+    int stopFd;
+    /** @brief Edge events read from a request. Only used by the thread. */
+    struct gpiod_edge_event_buffer *buffer;
+};
+
+/**
+ * @brief The open chip, its lines and requests.
+ */
+struct GPIODState
+{
+    /** @brief The GPIO chip, NULL when the backend isn't running. */
+    struct gpiod_chip *chip;
+    struct GPIODLine lines[GPIOD_MAX_LINES];
+    /** @brief Requests by index. Never more than one per line. */
+    struct GPIODRequest requests[GPIOD_MAX_LINES];
+    /** @brief Number of requests made, released ones included. */
+    int requestCount;
+    struct GPIODEdgeThread edgeThread;
+    /** @brief Held while requests are made or reconfigured, and while the edge thread reads events.
+     *  Reads and writes don't take it, they only happen while the requests stay as they are. */
+    pthread_mutex_t mutex;
+};
+
+static struct GPIODState gpiodState = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+#pragma endregion
+
+
+
+#pragma region FunctionDeclarations
+
+static bool initializeGPIOD(const struct GPIOConfig *gpioConfig);
+static void cleanupGPIOD(void);
+static void setGPIODMode(int pinNumber, enum GPIOPinMode mode);
+static void setGPIODPull(int pinNumber, enum GPIOPinPull pull);
+static int readGPIOD(int pinNumber);
+static void writeGPIOD(int pinNumber, int level);
+static uint32_t readGPIODBank(void);
+static void setGPIODBank(uint32_t pinMask);
+static void clearGPIODBank(uint32_t pinMask);
+static bool setGPIODAlert(int pinNumber, GPIOAlertFunction function, void *data);
+static uint32_t getGPIODTick(void);
+static void setGPIODKeypadPins(const int *rowPins, int rowCount, const int *columnPins, int columnCount);
+
+/**
+ * @brief Writes the levels of the output lines of every request that has lines in the mask, one ioctl per request.
+ *
+ * @param pinMask Bit (1 << pinNumber) set for every line to write.
+ * @param level Level to drive the lines to.
+ */
+static void writeGPIODBank(const uint32_t pinMask, const int level);
+
+/**
+ * @brief Makes a new request for the lines, with their current settings. The gpiodState mutex has to be locked.
+ *
+ * @param offsets Line offsets. None of them may be in a request.
+ * @param lineCount Number of lines.
+ *
+ * @return true If the lines were requested.
+ * @return false If the kernel refused, for example because another program has a line.
+ */
+static bool addGPIODRequest(const unsigned int *offsets, const int lineCount);
+
+/**
+ * @brief Requests or reconfigures the lines of a request with their current settings, and adds it to the
+ * edge thread's epoll set if a line has edge detection. The gpiodState mutex has to be locked.
+ *
+ * @param requestIndex Index of the request.
+ *
+ * @return true If the lines have the settings.
+ * @return false If the kernel refused.
+ */
+static bool configureGPIODRequest(const int requestIndex);
+
+/**
+ * @brief Releases a request. Its lines are left without one. The gpiodState mutex has to be locked.
+ *
+ * @param requestIndex Index of the request.
+ */
+static void releaseGPIODRequest(const int requestIndex);
+
+/**
+ * @brief Makes sure the line is in a request, as an input if it's new. The gpiodState mutex must not be locked.
+ *
+ * @param pinNumber Line offset of the pin on the chip.
+ *
+ * @return true If the line is in a request.
+ * @return false If it could not be requested.
+ */
+static bool ensureGPIODLine(const int pinNumber);
+
+/**
+ * @brief Applies a changed setting of the line to its request, or requests it. The gpiodState mutex must not be locked.
+ *
+ * @param pinNumber Line offset of the pin on the chip.
+ */
+static void updateGPIODLine(const int pinNumber);
+
+/**
+ * @brief Thread reading edge events from the requests in the epoll set and calling the alert functions.
+ *
+ * @param argument Unused.
+ *
+ * @return void* Always NULL.
+ */
+static void *gpiodEdgeThread(void *argument);
+
+/**
+ * @brief Checks that the pin is a line offset the backend handles.
+ *
+ * @param pinNumber Line offset of the pin on the chip.
+ *
+ * @return true If the backend is running and the pin is in range.
+ * @return false If not.
+ */
+static bool isGPIODLine(const int pinNumber);
+
+#pragma endregion
+
+
+
+const struct GPIOBackend gpiodGPIOBackend =
+{
+    .name = "gpiod",
+    .initialize = initializeGPIOD,
+    .cleanup = cleanupGPIOD,
+    .setMode = setGPIODMode,
+    .setPull = setGPIODPull,
+    .read = readGPIOD,
+    .write = writeGPIOD,
+    .readBank = readGPIODBank,
+    .setBank = setGPIODBank,
+    .clearBank = clearGPIODBank,
+    .setAlert = setGPIODAlert,
+    .getTick = getGPIODTick,
+    .sleep = sleepForSeconds,
+    .setKeypadPins = setGPIODKeypadPins
+};
+
+
+
+static bool initializeGPIOD(const struct GPIOConfig *gpioConfig)
+{
+    // For readability.
+    struct GPIODEdgeThread *edgeThread = &gpiodState.edgeThread;
+
+    printf("Initializing libgpiod, chip %s.\n", gpioConfig->GPIOD_CHIP);
+
+    gpiodState.chip = gpiod_chip_open(gpioConfig->GPIOD_CHIP);
+
+    if (gpiodState.chip == NULL)
+    {
+        fprintf(stderr, "Failed to open GPIO chip %s\n", gpioConfig->GPIOD_CHIP);
+
+        return false;
+    }
+
+    for (int pinNumber = 0; pinNumber < GPIOD_MAX_LINES; pinNumber++)
+    {
+        gpiodState.lines[pinNumber] = (struct GPIODLine){ .mode = GPIO_MODE_INPUT, .pull = GPIO_PULL_NONE, .request = -1 };
+    }
+
+    gpiodState.requestCount = 0;
+
+    edgeThread->running = false;
+    edgeThread->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    edgeThread->stopFd = eventfd(0, EFD_CLOEXEC);
+    edgeThread->buffer = gpiod_edge_event_buffer_new(GPIOD_EVENT_BUFFER_SIZE);
+
+    struct epoll_event stopEvent = { .events = EPOLLIN, .data.u32 = GPIOD_STOP_EVENT };
+
+    if (edgeThread->epollFd < 0 || edgeThread->stopFd < 0 || edgeThread->buffer == NULL ||
+        epoll_ctl(edgeThread->epollFd, EPOLL_CTL_ADD, edgeThread->stopFd, &stopEvent) != 0 ||
+        pthread_create(&edgeThread->thread, NULL, gpiodEdgeThread, NULL) != 0)
+    {
+        // The pins still work, the keypad is polled.
+        fprintf(stderr, "Could not start the GPIO edge thread, no edge alerts.\n");
+    }
+
+    else
+    {
+        edgeThread->running = true;
+    }
+
+    return true;
+}
+
+static void cleanupGPIOD(void)
+{
+    // For readability.
+    struct GPIODEdgeThread *edgeThread = &gpiodState.edgeThread;
+
+    if (gpiodState.chip == NULL)
+    {
+        return;
+    }
+
+    if (edgeThread->running)
+    {
+        uint64_t stop = 1;
+
+        if (write(edgeThread->stopFd, &stop, sizeof(stop)) == sizeof(stop))
+        {
+            pthread_join(edgeThread->thread, NULL);
+        }
+
+        edgeThread->running = false;
+    }
+
+    pthread_mutex_lock(&gpiodState.mutex);
+
+    for (int requestIndex = 0; requestIndex < gpiodState.requestCount; requestIndex++)
+    {
+        releaseGPIODRequest(requestIndex);
+    }
+
+    pthread_mutex_unlock(&gpiodState.mutex);
+
+    if (edgeThread->buffer != NULL)
+    {
+        gpiod_edge_event_buffer_free(edgeThread->buffer);
+        edgeThread->buffer = NULL;
+    }
+
+    if (edgeThread->epollFd >= 0)
+    {
+        close(edgeThread->epollFd);
+    }
+
+    if (edgeThread->stopFd >= 0)
+    {
+        close(edgeThread->stopFd);
+    }
+
+    gpiod_chip_close(gpiodState.chip);
+    gpiodState.chip = NULL;
+}
+
+static void setGPIODMode(int pinNumber, enum GPIOPinMode mode)
+{
+    if (!isGPIODLine(pinNumber))
+    {
+        return;
+    }
+
+    gpiodState.lines[pinNumber].mode = mode;
+    updateGPIODLine(pinNumber);
+}
+
+static void setGPIODPull(int pinNumber, enum GPIOPinPull pull)
+{
+    if (!isGPIODLine(pinNumber))
+    {
+        return;
+    }
+
+    gpiodState.lines[pinNumber].pull = pull;
+    updateGPIODLine(pinNumber);
+}
+
+static int readGPIOD(int pinNumber)
+{
+    // A pin that was never set up is read as it is, an input.
+    if (!isGPIODLine(pinNumber) || !ensureGPIODLine(pinNumber))
+    {
+        return 0;
+    }
+
+    struct gpiod_line_request *request = gpiodState.requests[gpiodState.lines[pinNumber].request].request;
+
+    return gpiod_line_request_get_value(request, pinNumber) == GPIOD_LINE_VALUE_ACTIVE;
+}
+
+static void writeGPIOD(int pinNumber, int level)
+{
+    if (!isGPIODLine(pinNumber))
+    {
+        return;
+    }
+
+    // For readability.
+    struct GPIODLine *line = &gpiodState.lines[pinNumber];
+
+    line->outputLevel = level ? 1 : 0;
+
+    // Like pigpio, writing to a pin makes it an output. The LED pins are only ever written to.
+    if (line->request < 0 || line->mode != GPIO_MODE_OUTPUT)
+    {
+        line->mode = GPIO_MODE_OUTPUT;
+        updateGPIODLine(pinNumber);
+
+        return;
+    }
+
+    gpiod_line_request_set_value(gpiodState.requests[line->request].request, pinNumber,
+                                 level ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+}
+
+static uint32_t readGPIODBank(void)
+{
+    uint32_t levels = 0;
+
+    // Only the requested lines, the others aren't used by the program. One ioctl per request.
+    for (int requestIndex = 0; requestIndex < gpiodState.requestCount; requestIndex++)
+    {
+        // For readability.
+        struct GPIODRequest *request = &gpiodState.requests[requestIndex];
+        enum gpiod_line_value values[GPIOD_MAX_LINES];
+
+        if (request->request == NULL || gpiod_line_request_get_values(request->request, values) != 0)
+        {
+            continue;
+        }
+
+        for (int index = 0; index < request->lineCount; index++)
+        {
+            if (request->offsets[index] < 32 && values[index] == GPIOD_LINE_VALUE_ACTIVE)
+            {
+                levels |= (uint32_t)1 << request->offsets[index];
+            }
+        }
+    }
+
+    return levels;
+}
+
+static void setGPIODBank(uint32_t pinMask)
+{
+    writeGPIODBank(pinMask, 1);
+}
+
+static void clearGPIODBank(uint32_t pinMask)
+{
+    writeGPIODBank(pinMask, 0);
+}
+
+static bool setGPIODAlert(int pinNumber, GPIOAlertFunction function, void *data)
+{
+    if (!isGPIODLine(pinNumber) || !ensureGPIODLine(pinNumber))
+    {
+        return false;
+    }
+
+    if (function != NULL && !gpiodState.edgeThread.running)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&gpiodState.mutex);
+
+    gpiodState.lines[pinNumber].alert = function;
+    gpiodState.lines[pinNumber].alertData = data;
+
+    // Turns the edge detection of the line on or off.
+    bool configured = configureGPIODRequest(gpiodState.lines[pinNumber].request);
+
+    if (!configured)
+    {
+        gpiodState.lines[pinNumber].alert = NULL;
+        gpiodState.lines[pinNumber].alertData = NULL;
+    }
+
+    pthread_mutex_unlock(&gpiodState.mutex);
+
+    return configured || function == NULL;
+}
+
+static uint32_t getGPIODTick(void)
+{
+    // Edge events are timestamped with CLOCK_MONOTONIC, so the ticks are comparable.
+    return (uint32_t)(getMonotonicTimeInNanoseconds() / 1000);
+}
+
+static void setGPIODKeypadPins(const int *rowPins, int rowCount, const int *columnPins, int columnCount)
+{
+    const int *groups[] = { rowPins, columnPins };
+    const int groupSizes[] = { rowCount, columnCount };
+
+    pthread_mutex_lock(&gpiodState.mutex);
+
+    for (int group = 0; group < 2; group++)
+    {
+        unsigned int offsets[GPIOD_MAX_LINES];
+        int lineCount = 0;
+
+        // The lines were requested one by one when they were set up. They keep their settings.
+        for (int index = 0; index < groupSizes[group]; index++)
+        {
+            int pinNumber = groups[group][index];
+
+            if (!isGPIODLine(pinNumber))
+            {
+                continue;
+            }
+
+            if (gpiodState.lines[pinNumber].request >= 0)
+            {
+                releaseGPIODRequest(gpiodState.lines[pinNumber].request);
+            }
+
+            offsets[lineCount++] = (unsigned int)pinNumber;
+        }
+
+        if (lineCount > 0 && !addGPIODRequest(offsets, lineCount))
+        {
+            fprintf(stderr, "Could not request the keypad %s as one request.\n", group == 0 ? "rows" : "columns");
+        }
+    }
+
+    pthread_mutex_unlock(&gpiodState.mutex);
+}
+
+static void writeGPIODBank(const uint32_t pinMask, const int level)
+{
+    for (int requestIndex = 0; requestIndex < gpiodState.requestCount; requestIndex++)
+    {
+        // For readability.
+        struct GPIODRequest *request = &gpiodState.requests[requestIndex];
+        unsigned int offsets[GPIOD_MAX_LINES];
+        enum gpiod_line_value values[GPIOD_MAX_LINES];
+        int lineCount = 0;
+
+        if (request->request == NULL)
+        {
+            continue;
+        }
+
+        for (int index = 0; index < request->lineCount; index++)
+        {
+            unsigned int offset = request->offsets[index];
+
+            if (offset >= 32 || !(pinMask & ((uint32_t)1 << offset)))
+            {
+                continue;
+            }
+
+            // Like the register write, only the level changes, not the mode. Inputs get it once they are outputs.
+            gpiodState.lines[offset].outputLevel = level;
+
+            if (gpiodState.lines[offset].mode == GPIO_MODE_OUTPUT)
+            {
+                offsets[lineCount] = offset;
+                values[lineCount] = level ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+                lineCount++;
+            }
+        }
+
+        if (lineCount > 0)
+        {
+            gpiod_line_request_set_values_subset(request->request, lineCount, offsets, values);
+        }
+    }
+}
+
+static bool addGPIODRequest(const unsigned int *offsets, const int lineCount)
+{
+    int requestIndex = gpiodState.requestCount;
+
+    if (requestIndex >= GPIOD_MAX_LINES)
+    {
+        fprintf(stderr, "Too many GPIO line requests.\n");
+
+        return false;
+    }
+
+    struct GPIODRequest *request = &gpiodState.requests[requestIndex];
+    request->request = NULL;
+    request->lineCount = lineCount;
+    request->watched = false;
+
+    for (int index = 0; index < lineCount; index++)
+    {
+        request->offsets[index] = offsets[index];
+    }
+
+    if (!configureGPIODRequest(requestIndex))
+    {
+        return false;
+    }
+
+    gpiodState.requestCount++;
+
+    for (int index = 0; index < lineCount; index++)
+    {
+        gpiodState.lines[offsets[index]].request = requestIndex;
+    }
+
+    return true;
+}
+
+static bool configureGPIODRequest(const int requestIndex)
+{
+    // For readability.
+    struct GPIODRequest *request = &gpiodState.requests[requestIndex];
+
+    struct gpiod_line_config *lineConfig = gpiod_line_config_new();
+    struct gpiod_request_config *requestConfig = gpiod_request_config_new();
+    bool configured = lineConfig != NULL && requestConfig != NULL;
+    bool edges = false;
+
+    for (int index = 0; configured && index < request->lineCount; index++)
+    {
+        unsigned int offset = request->offsets[index];
+        const struct GPIODLine *line = &gpiodState.lines[offset];
+        struct gpiod_line_settings *settings = gpiod_line_settings_new();
+
+        if (settings == NULL)
+        {
+            configured = false;
+
+            break;
+        }
+
+        if (line->mode == GPIO_MODE_OUTPUT)
+        {
+            gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+            gpiod_line_settings_set_output_value(settings, line->outputLevel ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+        }
+
+        else
+        {
+            gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+
+            // No kernel debounce: it would debounce the values the keypad scan reads too, and hide the
+            // short level changes the scan itself causes. The keys are debounced by keypad_debounce.c.
+            if (line->alert != NULL)
+            {
+                gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+                gpiod_line_settings_set_event_clock(settings, GPIOD_LINE_CLOCK_MONOTONIC);
+                edges = true;
+            }
+        }
+
+        switch (line->pull)
+        {
+            case GPIO_PULL_UP:
+                gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_UP);
+                break;
+
+            case GPIO_PULL_DOWN:
+                gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_DOWN);
+                break;
+
+            default:
+                gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_DISABLED);
+                break;
+        }
+
+        // The line config copies the settings.
+        configured = gpiod_line_config_add_line_settings(lineConfig, &offset, 1, settings) == 0;
+        gpiod_line_settings_free(settings);
+    }
+
+    if (configured)
+    {
+        gpiod_request_config_set_consumer(requestConfig, GPIOD_CONSUMER);
+
+        if (request->request != NULL)
+        {
+            configured = gpiod_line_request_reconfigure_lines(request->request, lineConfig) == 0;
+        }
+
+        else
+        {
+            request->request = gpiod_chip_request_lines(gpiodState.chip, requestConfig, lineConfig);
+            configured = request->request != NULL;
+        }
+    }
+
+    // The file descriptor only becomes readable with edge events, so it can stay in the set once it's there.
+    if (configured && edges && !request->watched && gpiodState.edgeThread.running)
+    {
+        struct epoll_event event = { .events = EPOLLIN, .data.u32 = (uint32_t)requestIndex };
+
+        request->watched = epoll_ctl(gpiodState.edgeThread.epollFd, EPOLL_CTL_ADD,
+                                     gpiod_line_request_get_fd(request->request), &event) == 0;
+        configured = request->watched;
+    }
+
+    if (!configured)
+    {
+        fprintf(stderr, "Could not request GPIO line %u%s.\n", request->offsets[0], request->lineCount > 1 ? " and others" : "");
+    }
+
+    // Not all of the free functions take NULL.
+    if (lineConfig != NULL)
+    {
+        gpiod_line_config_free(lineConfig);
+    }
+
+    if (requestConfig != NULL)
+    {
+        gpiod_request_config_free(requestConfig);
+    }
+
+    return configured;
+}
+
+static void releaseGPIODRequest(const int requestIndex)
+{
+    // For readability.
+    struct GPIODRequest *request = &gpiodState.requests[requestIndex];
+
+    if (request->request == NULL)
+    {
+        return;
+    }
+
+    if (request->watched)
+    {
+        epoll_ctl(gpiodState.edgeThread.epollFd, EPOLL_CTL_DEL, gpiod_line_request_get_fd(request->request), NULL);
+        request->watched = false;
+    }
+
+    gpiod_line_request_release(request->request);
+    request->request = NULL;
+
+    for (int index = 0; index < request->lineCount; index++)
+    {
+        gpiodState.lines[request->offsets[index]].request = -1;
+    }
+}
+
+static bool ensureGPIODLine(const int pinNumber)
+{
+    if (gpiodState.lines[pinNumber].request >= 0)
+    {
+        return true;
+    }
+
+    pthread_mutex_lock(&gpiodState.mutex);
+
+    unsigned int offset = (unsigned int)pinNumber;
+    bool requested = gpiodState.lines[pinNumber].request >= 0 || addGPIODRequest(&offset, 1);
+
+    pthread_mutex_unlock(&gpiodState.mutex);
+
+    return requested;
+}
+
+static void updateGPIODLine(const int pinNumber)
+{
+    pthread_mutex_lock(&gpiodState.mutex);
+
+    if (gpiodState.lines[pinNumber].request >= 0)
+    {
+        configureGPIODRequest(gpiodState.lines[pinNumber].request);
+    }
+
+    else
+    {
+        unsigned int offset = (unsigned int)pinNumber;
+        addGPIODRequest(&offset, 1);
+    }
+
+    pthread_mutex_unlock(&gpiodState.mutex);
+}
+
+static void *gpiodEdgeThread(void *argument)
+{
+    (void)argument;
+
+    // For readability.
+    struct GPIODEdgeThread *edgeThread = &gpiodState.edgeThread;
+
+    struct
+    {
+        GPIOAlertFunction function;
+        int pinNumber;
+        int level;
+        uint32_t tick;
+        void *data;
+    } alerts[GPIOD_EVENT_BUFFER_SIZE];
+
+    while (true)
+    {
+        struct epoll_event readyEvent;
+
+        // Sleeps in the kernel until a line request has edge events, or the thread is stopped.
+        int readyCount = epoll_wait(edgeThread->epollFd, &readyEvent, 1, -1);
+
+        if (readyCount < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (readyCount < 0 || readyEvent.data.u32 == GPIOD_STOP_EVENT)
+        {
+            break;
+        }
+
+        int alertCount = 0;
+
+        pthread_mutex_lock(&gpiodState.mutex);
+
+        struct gpiod_line_request *request = gpiodState.requests[readyEvent.data.u32].request;
+        int eventCount = request != NULL ?
+                         gpiod_line_request_read_edge_events(request, edgeThread->buffer, GPIOD_EVENT_BUFFER_SIZE) : 0;
+
+        for (int index = 0; index < eventCount; index++)
+        {
+            struct gpiod_edge_event *event = gpiod_edge_event_buffer_get_event(edgeThread->buffer, index);
+            unsigned int offset = gpiod_edge_event_get_line_offset(event);
+
+            if (offset >= GPIOD_MAX_LINES || gpiodState.lines[offset].alert == NULL)
+            {
+                continue;
+            }
+
+            alerts[alertCount].function = gpiodState.lines[offset].alert;
+            alerts[alertCount].pinNumber = (int)offset;
+            alerts[alertCount].level = gpiod_edge_event_get_event_type(event) == GPIOD_EDGE_EVENT_RISING_EDGE ? 1 : 0;
+            alerts[alertCount].tick = (uint32_t)(gpiod_edge_event_get_timestamp_ns(event) / 1000);
+            alerts[alertCount].data = gpiodState.lines[offset].alertData;
+            alertCount++;
+        }
+
+        pthread_mutex_unlock(&gpiodState.mutex);
+
+        for (int index = 0; index < alertCount; index++)
+        {
+            alerts[index].function(alerts[index].pinNumber, alerts[index].level, alerts[index].tick, alerts[index].data);
+        }
+    }
+
+    return NULL;
+}
+
+static bool isGPIODLine(const int pinNumber)
+{
+    return gpiodState.chip != NULL && pinNumber >= 0 && pinNumber < GPIOD_MAX_LINES;
+}
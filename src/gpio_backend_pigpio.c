@@ -0,0 +1,147 @@
+/**
+ * @file gpio_backend_pigpio.c
+ * @author Selkamies
+ *
+ * @brief GPIO backend using the pigpio library. pigpio handles the GPIO pins of Raspberry Pi
+ * through the GPIO registers, so the bank operations are single register reads and writes.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t.
+#include <pigpio.h>
+
+#include "gpio_backend.h"
+
+
+
+#pragma region FunctionDeclarations
+
+static bool initializePigpio(const struct GPIOConfig *gpioConfig);
+static void cleanupPigpio(void);
+static void setPigpioMode(int pinNumber, enum GPIOPinMode mode);
+static void setPigpioPull(int pinNumber, enum GPIOPinPull pull);
+static int readPigpio(int pinNumber);
+static void writePigpio(int pinNumber, int level);
+static uint32_t readPigpioBank(void);
+static void setPigpioBank(uint32_t pinMask);
+static void clearPigpioBank(uint32_t pinMask);
+static bool setPigpioAlert(int pinNumber, GPIOAlertFunction function, void *data);
+static uint32_t getPigpioTick(void);
+static void sleepPigpio(double seconds);
+
+#pragma endregion
+
+
+
+const struct GPIOBackend pigpioGPIOBackend =
+{
+    .name = "pigpio",
+    .initialize = initializePigpio,
+    .cleanup = cleanupPigpio,
+    .setMode = setPigpioMode,
+    .setPull = setPigpioPull,
+    .read = readPigpio,
+    .write = writePigpio,
+    .readBank = readPigpioBank,
+    .setBank = setPigpioBank,
+    .clearBank = clearPigpioBank,
+    .setAlert = setPigpioAlert,
+    .getTick = getPigpioTick,
+    .sleep = sleepPigpio,
+    .setKeypadPins = NULL
+};
+
+
+
+static bool initializePigpio(const struct GPIOConfig *gpioConfig)
+{
+    (void)gpioConfig;
+
+    printf("Initializing pigpio.\n");
+
+    if (gpioInitialise() < 0)
+    {
+        fprintf(stderr, "Failed to initialize pigpio\n");
+
+        return false;
+    }
+
+    return true;
+}
+
+static void cleanupPigpio(void)
+{
+    gpioTerminate();
+}
+
+static void setPigpioMode(int pinNumber, enum GPIOPinMode mode)
+{
+    gpioSetMode(pinNumber, mode == GPIO_MODE_OUTPUT ? PI_OUTPUT : PI_INPUT);
+}
+
+static void setPigpioPull(int pinNumber, enum GPIOPinPull pull)
+{
+    switch (pull)
+    {
+        case GPIO_PULL_UP:
+            gpioSetPullUpDown(pinNumber, PI_PUD_UP);
+            break;
+
+        case GPIO_PULL_DOWN:
+            gpioSetPullUpDown(pinNumber, PI_PUD_DOWN);
+            break;
+
+        default:
+            gpioSetPullUpDown(pinNumber, PI_PUD_OFF);
+            break;
+    }
+}
+
+static int readPigpio(int pinNumber)
+{
+    return gpioRead(pinNumber);
+}
+
+static void writePigpio(int pinNumber, int level)
+{
+    gpioWrite(pinNumber, level);
+}
+
+static uint32_t readPigpioBank(void)
+{
+    return gpioRead_Bits_0_31();
+}
+
+static void setPigpioBank(uint32_t pinMask)
+{
+    gpioWrite_Bits_0_31_Set(pinMask);
+}
+
+static void clearPigpioBank(uint32_t pinMask)
+{
+    gpioWrite_Bits_0_31_Clear(pinMask);
+}
+
+static bool setPigpioAlert(int pinNumber, GPIOAlertFunction function, void *data)
+{
+    // pigpio's gpioAlertFuncEx_t has the same signature.
+    return gpioSetAlertFuncEx(pinNumber, function, data) == 0;
+}
+
+static uint32_t getPigpioTick(void)
+{
+    return gpioTick();
+}
+
+static void sleepPigpio(double seconds)
+{
+    time_sleep(seconds);
+}
@@ -2,10 +2,10 @@
  * @file keypad_functions.c
  * @author Selkamies
  * 
- * @brief Handles all the GPIO pin operations required by keypad using pigpio.
+ * @brief Handles all the GPIO pin operations required by keypad, through the active GPIO backend.
  * 
  * @date Created 2023-11-13
- * @date Updated 2023-12-07
+ * @date Updated 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  * 
@@ -16,26 +16,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <pigpio.h>
-
+#include <stdint.h>             // uint32_t.
 #include "gpio_functions.h"
+#include "gpio_backend.h"       // gpioBackend.
 #include "keypad_config.h"
 
 
 
 void turnGPIOPinOn(const int pinNumber)
 {
-    gpioWrite(pinNumber, 1);
+    gpioBackend->write(pinNumber, 1);
 }
 
 void turnGPIOPinOff(const int pinNumber)
 {
-    gpioWrite(pinNumber, 0);
+    gpioBackend->write(pinNumber, 0);
 }
 
 bool isGPIOPinOn(const int pinNumber)
 {
-    if (gpioRead(pinNumber))
+    if (gpioBackend->read(pinNumber))
     {
         return false;
     }
@@ -46,6 +46,32 @@ bool isGPIOPinOn(const int pinNumber)
     }
 }
 
+void turnGPIOPinsOn(const uint32_t pinMask)
+{
+    gpioBackend->setBank(pinMask);
+}
+
+void turnGPIOPinsOff(const uint32_t pinMask)
+{
+    gpioBackend->clearBank(pinMask);
+}
+
+uint32_t getGPIOPinsOn(const uint32_t pinMask)
+{
+    // Read 0 is on, like in isGPIOPinOn().
+    return ~gpioBackend->readBank() & pinMask;
+}
+
+bool setGPIOPinAlert(const int pinNumber, GPIOAlertFunction function, void *data)
+{
+    return gpioBackend->setAlert(pinNumber, function, data);
+}
+
+uint32_t getGPIOTick()
+{
+    return gpioBackend->getTick();
+}
+
 void initializeKeypadGPIOPins(struct KeypadConfig *keypadConfig)
 {
     printf("Initializing keypad GPIO pins.\n");
@@ -53,15 +79,44 @@ void initializeKeypadGPIOPins(struct KeypadConfig *keypadConfig)
     // Keypad rows are set to output and pulldown state.
     for (int rowIndex = 0; rowIndex < keypadConfig->KEYPAD_ROWS; rowIndex++)
     {
-        gpioSetMode(keypadConfig->pins.keypad_rows[rowIndex], PI_OUTPUT);
-        gpioSetPullUpDown(keypadConfig->pins.keypad_rows[rowIndex], PI_PUD_DOWN);
+        gpioBackend->setMode(keypadConfig->pins.keypad_rows[rowIndex], GPIO_MODE_OUTPUT);
+        gpioBackend->setPull(keypadConfig->pins.keypad_rows[rowIndex], GPIO_PULL_DOWN);
     }
 
     // Keypad rows are set to input and pullup state.
     for (int columnIndex = 0; columnIndex < keypadConfig->KEYPAD_COLUMNS; columnIndex++)
     {
-        gpioSetMode(keypadConfig->pins.keypad_columns[columnIndex], PI_INPUT);
-        gpioSetPullUpDown(keypadConfig->pins.keypad_columns[columnIndex], PI_PUD_UP);
+        gpioBackend->setMode(keypadConfig->pins.keypad_columns[columnIndex], GPIO_MODE_INPUT);
+        gpioBackend->setPull(keypadConfig->pins.keypad_columns[columnIndex], GPIO_PULL_UP);
+    }
+
+    // For readability.
+    struct KeypadGPIOPins *pins = &keypadConfig->pins;
+
+    pins->bankAccess = true;
+    pins->rowMask = 0;
+    pins->columnMask = 0;
+
+    for (int rowIndex = 0; rowIndex < keypadConfig->KEYPAD_ROWS; rowIndex++)
+    {
+        pins->bankAccess = pins->bankAccess && pins->keypad_rows[rowIndex] >= 0 && pins->keypad_rows[rowIndex] < 32;
+        pins->rowMask |= pins->bankAccess ? (uint32_t)1 << pins->keypad_rows[rowIndex] : 0;
+    }
+
+    for (int columnIndex = 0; columnIndex < keypadConfig->KEYPAD_COLUMNS; columnIndex++)
+    {
+        pins->bankAccess = pins->bankAccess && pins->keypad_columns[columnIndex] >= 0 && pins->keypad_columns[columnIndex] < 32;
+        pins->columnMask |= pins->bankAccess ? (uint32_t)1 << pins->keypad_columns[columnIndex] : 0;
+    }
+
+    if (!pins->bankAccess)
+    {
+        printf("Keypad pins are not all in GPIO bank 0, reading them one at a time.\n");
+    }
+
+    if (gpioBackend->setKeypadPins != NULL)
+    {
+        gpioBackend->setKeypadPins(pins->keypad_rows, keypadConfig->KEYPAD_ROWS, pins->keypad_columns, keypadConfig->KEYPAD_COLUMNS);
     }
 }
 
@@ -71,17 +126,12 @@ void cleanupKeypadGPIOPins(struct KeypadConfig *keypadConfig)
 
     for (int rowIndex = 0; rowIndex < keypadConfig->KEYPAD_ROWS; rowIndex++)
     {
-        gpioSetMode(keypadConfig->pins.keypad_rows[rowIndex], PI_INPUT);
+        gpioBackend->setMode(keypadConfig->pins.keypad_rows[rowIndex], GPIO_MODE_INPUT);
     }
 
     for (int columnIndex = 0; columnIndex < keypadConfig->KEYPAD_COLUMNS; columnIndex++)
     {
-        gpioSetMode(keypadConfig->pins.keypad_columns[columnIndex], PI_INPUT);
+        gpioBackend->setMode(keypadConfig->pins.keypad_columns[columnIndex], GPIO_MODE_INPUT);
     }
-
-    free(keypadConfig->pins.keypad_rows);
-    free(keypadConfig->pins.keypad_columns);
-    keypadConfig->pins.keypad_rows = NULL;
-    keypadConfig->pins.keypad_columns = NULL;
 }
 
@@ -2,21 +2,23 @@
  * @file gpio_init.c
  * @author Selkamies
  * 
- * @brief Manages the pigpio library initialization. pigpio handles the GPIO pins of Raspberry Pi.
+ * @brief Chooses and starts the GPIO backend. pigpio handles the GPIO pins of Raspberry Pi,
+ * libgpiod uses the kernel's GPIO character device and the simulated backend runs anywhere.
  * 
  * @date Created 2023-11-13
- * @date Modified 2023-11-23
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
 
 
 
-#include <stdio.h>      // printf().
-#include <pigpio.h>     // gpioInitialize(), time_sleep(), gpioTerminate().
+#include <stdio.h>      // printf(), fprintf(), snprintf().
 #include <stdbool.h>
 
 #include "gpio_init.h"
+#include "gpio_backend.h"   // gpioBackend, findGPIOBackend().
+#include "gpio_config.h"    // struct GPIOConfig.
 
 
 
@@ -30,17 +32,31 @@ void signalHandler(int signo)
     }
 }
 
-bool initializeGPIOLibrary() 
+void setGPIODefaults(struct GPIOConfig *gpioConfig)
 {
-    printf("Initializing pigpio.\n");
+    snprintf(gpioConfig->BACKEND, sizeof(gpioConfig->BACKEND), "%s", GPIO_DEFAULT_BACKEND);
+    snprintf(gpioConfig->GPIOD_CHIP, sizeof(gpioConfig->GPIOD_CHIP), "%s", GPIO_DEFAULT_GPIOD_CHIP);
+    gpioConfig->SIMULATOR_SCRIPT[0] = '\0';
+}
+
+bool initializeGPIOLibrary(const struct GPIOConfig *gpioConfig) 
+{
+    const struct GPIOBackend *backend = findGPIOBackend(gpioConfig->BACKEND);
+
+    if (backend == NULL)
+    {
+        fprintf(stderr, "GPIO backend %s is not built into the program\n", gpioConfig->BACKEND);
+
+        return false;
+    }
 
-    if (gpioInitialise() < 0) 
+    if (!backend->initialize(gpioConfig)) 
     {
-        fprintf(stderr, "Failed to initialize pigpio\n");
-        // TODO: Exit program. 
         return false;
     }
 
+    gpioBackend = backend;
+
     // Set up signal handler
     signal(SIGINT, signalHandler);
 
@@ -49,10 +65,13 @@ bool initializeGPIOLibrary()
 
 void sleepGPIOLibrary(double seconds)
 {
-    time_sleep(seconds);
+    gpioBackend->sleep(seconds);
 }
 
 void cleanupGPIOLibrary()
 {
-    gpioTerminate();
-}
\ No newline at end of file
+    if (gpioBackend != NULL)
+    {
+        gpioBackend->cleanup();
+    }
+}
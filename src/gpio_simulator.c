@@ -0,0 +1,647 @@
+/**
+ * @file gpio_simulator.c
+ * @author Selkamies
+ *
+ * @brief The simulated GPIO backend, see gpio_simulator.h. Every operation holds the simulator mutex,
+ * because the scan thread, the main loop and the script thread all use the pins. The alert functions
+ * are called after the mutex is released.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), fopen(), fgets(), sscanf(), fclose().
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t, uint64_t, int64_t.
+#include <string.h>             // strcmp().
+#include <time.h>               // timespec, CLOCK_MONOTONIC.
+#include <pthread.h>            // pthread_create(), pthread_join(), pthread_mutex_t, pthread_cond_t.
+
+#include "gpio_simulator.h"
+#include "gpio_backend.h"
+#include "keypad_config.h"      // KEYPAD_MAX_ROWS, KEYPAD_MAX_COLUMNS, KEYPAD_KEY_INDEX().
+#include "timer.h"              // getMonotonicTimeInNanoseconds(), sleepForSeconds().
+
+
+
+#pragma region Globals
+
+/** @brief Number of simulated GPIO pins. */
+#define GPIO_SIMULATOR_PINS 64
+/** @brief Longest line in a simulator script. */
+#define GPIO_SIMULATOR_SCRIPT_LINE_LENGTH 128
+
+/**
+ * @brief State of the simulated pins.
+ */
+struct SimulatedPins
+{
+    /** @brief Direction of every pin. */
+    enum GPIOPinMode modes[GPIO_SIMULATOR_PINS];
+    /** @brief Pull resistor of every pin. */
+    enum GPIOPinPull pulls[GPIO_SIMULATOR_PINS];
+    /** @brief Level every pin is driven to, while it's an output. */
+    int outputLevels[GPIO_SIMULATOR_PINS];
+    /** @brief Level every pin with an alert function had when it was last checked. */
+    int alertLevels[GPIO_SIMULATOR_PINS];
+    /** @brief Alert function of every pin, NULL for none. */
+    GPIOAlertFunction alerts[GPIO_SIMULATOR_PINS];
+    /** @brief Pointer given to the alert function of every pin. */
+    void *alertData[GPIO_SIMULATOR_PINS];
+};
+
+/**
+ * @brief The simulated keypad matrix.
+ */
+struct SimulatedKeypad
+{
+    /** @brief Pin of every row, set by setKeypadPins(). */
+    int rowPins[KEYPAD_MAX_ROWS];
+    /** @brief Pin of every column, set by setKeypadPins(). */
+    int columnPins[KEYPAD_MAX_COLUMNS];
+    /** @brief Number of rows, 0 until the keypad pins are set. */
+    int rowCount;
+    /** @brief Number of columns, 0 until the keypad pins are set. */
+    int columnCount;
+    /** @brief Keys that are pressed, one bit per key at KEYPAD_KEY_INDEX(row, column). */
+    uint64_t keysPressed;
+};
+
+/**
+ * @brief The thread playing the key press script.
+ */
+struct SimulatorScript
+{
+    /** @brief The script file, NULL if there is no script or it's played already. */
+    FILE *file;
+    /** @brief The thread playing the script. */
+    pthread_t thread;
+    /** @brief Whether the thread was started and hasn't been joined. */
+    bool running;
+    /** @brief Set by cleanup to stop the script before its end. Protected by the simulator mutex. */
+    bool stopRequested;
+    /** @brief Signaled when stopRequested is set. Uses CLOCK_MONOTONIC. */
+    pthread_cond_t stopCondition;
+};
+
+/**
+ * @brief An alert function to call once the simulator mutex is released.
+ */
+struct SimulatedAlert
+{
+    GPIOAlertFunction function;
+    int pinNumber;
+    int level;
+    void *data;
+};
+
+/**
+ * @brief Everything the simulated backend has.
+ */
+struct GPIOSimulator
+{
+    /** @brief Protects the pins, the keypad and stopRequested. */
+    pthread_mutex_t mutex;
+    struct SimulatedPins pins;
+    struct SimulatedKeypad keypad;
+    struct SimulatorScript script;
+};
+
+static struct GPIOSimulator simulator = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+#pragma endregion
+
+
+
+#pragma region FunctionDeclarations
+
+static bool initializeSimulator(const struct GPIOConfig *gpioConfig);
+static void cleanupSimulator(void);
+static void setSimulatedMode(int pinNumber, enum GPIOPinMode mode);
+static void setSimulatedPull(int pinNumber, enum GPIOPinPull pull);
+static int readSimulated(int pinNumber);
+static void writeSimulated(int pinNumber, int level);
+static uint32_t readSimulatedBank(void);
+static void setSimulatedBank(uint32_t pinMask);
+static void clearSimulatedBank(uint32_t pinMask);
+static bool setSimulatedAlert(int pinNumber, GPIOAlertFunction function, void *data);
+static uint32_t getSimulatedTick(void);
+static void setSimulatedKeypadPins(const int *rowPins, int rowCount, const int *columnPins, int columnCount);
+
+/**
+ * @brief Works out the level of a pin: the level it's driven to if it's an output, otherwise the level of an output
+ * connected to it through a pressed key, and otherwise its pull resistor. A low output wins over a high one.
+ * The simulator mutex has to be locked.
+ *
+ * @param pinNumber The pin number of the GPIO pin.
+ *
+ * @return int 0 or 1.
+ */
+static int getSimulatedLevel(const int pinNumber);
+
+/**
+ * @brief Finds the pins with an alert function whose level has changed since they were last checked.
+ * The simulator mutex has to be locked.
+ *
+ * @param alerts Array of GPIO_SIMULATOR_PINS alerts to fill.
+ *
+ * @return int Number of alerts to call.
+ */
+static int collectSimulatedAlerts(struct SimulatedAlert *alerts);
+
+/**
+ * @brief Calls the alert functions collected by collectSimulatedAlerts(). The simulator mutex must not be locked.
+ *
+ * @param alerts The collected alerts.
+ * @param count Number of alerts.
+ */
+static void callSimulatedAlerts(const struct SimulatedAlert *alerts, const int count);
+
+/**
+ * @brief Unlocks the simulator mutex and calls the alert functions of the pins that changed while it was locked.
+ */
+static void unlockAndAlert(void);
+
+/**
+ * @brief Thread playing the key press script, line by line at the times in it.
+ *
+ * @param argument Unused.
+ *
+ * @return void* Always NULL.
+ */
+static void *playSimulatorScript(void *argument);
+
+/**
+ * @brief Checks that the pin is one of the simulated pins.
+ *
+ * @param pinNumber The pin number of the GPIO pin.
+ *
+ * @return true If the pin exists.
+ * @return false If not.
+ */
+static bool isSimulatedPin(const int pinNumber);
+
+#pragma endregion
+
+
+
+const struct GPIOBackend simulatedGPIOBackend =
+{
+    .name = "simulated",
+    .initialize = initializeSimulator,
+    .cleanup = cleanupSimulator,
+    .setMode = setSimulatedMode,
+    .setPull = setSimulatedPull,
+    .read = readSimulated,
+    .write = writeSimulated,
+    .readBank = readSimulatedBank,
+    .setBank = setSimulatedBank,
+    .clearBank = clearSimulatedBank,
+    .setAlert = setSimulatedAlert,
+    .getTick = getSimulatedTick,
+    .sleep = sleepForSeconds,
+    .setKeypadPins = setSimulatedKeypadPins
+};
+
+
+
+void pressSimulatedKey(const int row, const int column, const bool pressed)
+{
+    if (row < 0 || row >= KEYPAD_MAX_ROWS || column < 0 || column >= KEYPAD_MAX_COLUMNS)
+    {
+        fprintf(stderr, "No simulated key at row %d, column %d.\n", row, column);
+
+        return;
+    }
+
+    uint64_t keyBit = (uint64_t)1 << KEYPAD_KEY_INDEX(row, column);
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    if (pressed)
+    {
+        simulator.keypad.keysPressed |= keyBit;
+    }
+
+    else
+    {
+        simulator.keypad.keysPressed &= ~keyBit;
+    }
+
+    unlockAndAlert();
+}
+
+
+
+static bool initializeSimulator(const struct GPIOConfig *gpioConfig)
+{
+    printf("Initializing the simulated GPIO pins.\n");
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    for (int pinNumber = 0; pinNumber < GPIO_SIMULATOR_PINS; pinNumber++)
+    {
+        simulator.pins.modes[pinNumber] = GPIO_MODE_INPUT;
+        simulator.pins.pulls[pinNumber] = GPIO_PULL_NONE;
+        simulator.pins.outputLevels[pinNumber] = 0;
+        simulator.pins.alertLevels[pinNumber] = 0;
+        simulator.pins.alerts[pinNumber] = NULL;
+        simulator.pins.alertData[pinNumber] = NULL;
+    }
+
+    simulator.keypad.rowCount = 0;
+    simulator.keypad.columnCount = 0;
+    simulator.keypad.keysPressed = 0;
+    simulator.script.file = NULL;
+    simulator.script.running = false;
+    simulator.script.stopRequested = false;
+
+    pthread_mutex_unlock(&simulator.mutex);
+
+    // Opened now, so a wrong path is reported when the program starts.
+    if (gpioConfig->SIMULATOR_SCRIPT[0] != '\0')
+    {
+        simulator.script.file = fopen(gpioConfig->SIMULATOR_SCRIPT, "r");
+
+        if (simulator.script.file == NULL)
+        {
+            fprintf(stderr, "Could not open the simulator script %s, keys are only pressed by pressSimulatedKey().\n",
+                    gpioConfig->SIMULATOR_SCRIPT);
+        }
+    }
+
+    return true;
+}
+
+static void cleanupSimulator(void)
+{
+    if (simulator.script.running)
+    {
+        pthread_mutex_lock(&simulator.mutex);
+        simulator.script.stopRequested = true;
+        pthread_cond_signal(&simulator.script.stopCondition);
+        pthread_mutex_unlock(&simulator.mutex);
+
+        pthread_join(simulator.script.thread, NULL);
+        pthread_cond_destroy(&simulator.script.stopCondition);
+        simulator.script.running = false;
+    }
+
+    // Not played, the keypad pins were never set.
+    if (simulator.script.file != NULL)
+    {
+        fclose(simulator.script.file);
+        simulator.script.file = NULL;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    for (int pinNumber = 0; pinNumber < GPIO_SIMULATOR_PINS; pinNumber++)
+    {
+        simulator.pins.alerts[pinNumber] = NULL;
+    }
+
+    pthread_mutex_unlock(&simulator.mutex);
+}
+
+static void setSimulatedMode(int pinNumber, enum GPIOPinMode mode)
+{
+    if (!isSimulatedPin(pinNumber))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+    simulator.pins.modes[pinNumber] = mode;
+    unlockAndAlert();
+}
+
+static void setSimulatedPull(int pinNumber, enum GPIOPinPull pull)
+{
+    if (!isSimulatedPin(pinNumber))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+    simulator.pins.pulls[pinNumber] = pull;
+    unlockAndAlert();
+}
+
+static int readSimulated(int pinNumber)
+{
+    if (!isSimulatedPin(pinNumber))
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+    int level = getSimulatedLevel(pinNumber);
+    pthread_mutex_unlock(&simulator.mutex);
+
+    return level;
+}
+
+static void writeSimulated(int pinNumber, int level)
+{
+    if (!isSimulatedPin(pinNumber))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    // Like pigpio, writing to a pin makes it an output.
+    simulator.pins.modes[pinNumber] = GPIO_MODE_OUTPUT;
+    simulator.pins.outputLevels[pinNumber] = level ? 1 : 0;
+
+    unlockAndAlert();
+}
+
+static uint32_t readSimulatedBank(void)
+{
+    uint32_t levels = 0;
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++)
+    {
+        if (getSimulatedLevel(pinNumber))
+        {
+            levels |= (uint32_t)1 << pinNumber;
+        }
+    }
+
+    pthread_mutex_unlock(&simulator.mutex);
+
+    return levels;
+}
+
+static void setSimulatedBank(uint32_t pinMask)
+{
+    pthread_mutex_lock(&simulator.mutex);
+
+    // Like the register write, only the level changes, not the mode.
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++)
+    {
+        if (pinMask & ((uint32_t)1 << pinNumber))
+        {
+            simulator.pins.outputLevels[pinNumber] = 1;
+        }
+    }
+
+    unlockAndAlert();
+}
+
+static void clearSimulatedBank(uint32_t pinMask)
+{
+    pthread_mutex_lock(&simulator.mutex);
+
+    for (int pinNumber = 0; pinNumber < 32; pinNumber++)
+    {
+        if (pinMask & ((uint32_t)1 << pinNumber))
+        {
+            simulator.pins.outputLevels[pinNumber] = 0;
+        }
+    }
+
+    unlockAndAlert();
+}
+
+static bool setSimulatedAlert(int pinNumber, GPIOAlertFunction function, void *data)
+{
+    if (!isSimulatedPin(pinNumber))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&simulator.mutex);
+
+    simulator.pins.alerts[pinNumber] = function;
+    simulator.pins.alertData[pinNumber] = data;
+    // Only changes after this are alerted, like pigpio does.
+    simulator.pins.alertLevels[pinNumber] = getSimulatedLevel(pinNumber);
+
+    pthread_mutex_unlock(&simulator.mutex);
+
+    return true;
+}
+
+static uint32_t getSimulatedTick(void)
+{
+    return (uint32_t)(getMonotonicTimeInNanoseconds() / 1000);
+}
+
+static void setSimulatedKeypadPins(const int *rowPins, int rowCount, const int *columnPins, int columnCount)
+{
+    pthread_mutex_lock(&simulator.mutex);
+
+    simulator.keypad.rowCount = rowCount < KEYPAD_MAX_ROWS ? rowCount : KEYPAD_MAX_ROWS;
+    simulator.keypad.columnCount = columnCount < KEYPAD_MAX_COLUMNS ? columnCount : KEYPAD_MAX_COLUMNS;
+
+    for (int row = 0; row < simulator.keypad.rowCount; row++)
+    {
+        simulator.keypad.rowPins[row] = rowPins[row];
+    }
+
+    for (int column = 0; column < simulator.keypad.columnCount; column++)
+    {
+        simulator.keypad.columnPins[column] = columnPins[column];
+    }
+
+    unlockAndAlert();
+
+    printf("Simulated keypad has %d rows and %d columns.\n", simulator.keypad.rowCount, simulator.keypad.columnCount);
+
+    if (simulator.script.file == NULL || simulator.script.running)
+    {
+        return;
+    }
+
+    // The script's times count from when it's started, so it waits for the stop condition on the same clock.
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&simulator.script.stopCondition, &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+
+    if (pthread_create(&simulator.script.thread, NULL, playSimulatorScript, NULL) != 0)
+    {
+        fprintf(stderr, "Could not start the simulator script thread.\n");
+        pthread_cond_destroy(&simulator.script.stopCondition);
+
+        return;
+    }
+
+    simulator.script.running = true;
+}
+
+static int getSimulatedLevel(const int pinNumber)
+{
+    // For readability.
+    const struct SimulatedPins *pins = &simulator.pins;
+    const struct SimulatedKeypad *keypad = &simulator.keypad;
+
+    if (pins->modes[pinNumber] == GPIO_MODE_OUTPUT)
+    {
+        return pins->outputLevels[pinNumber];
+    }
+
+    int level = pins->pulls[pinNumber] == GPIO_PULL_UP ? 1 : 0;
+    uint64_t keysPressed = keypad->keysPressed;
+
+    while (keysPressed != 0)
+    {
+        int index = __builtin_ctzll(keysPressed);
+        keysPressed &= keysPressed - 1;
+
+        int row = index / KEYPAD_MAX_COLUMNS;
+        int column = index % KEYPAD_MAX_COLUMNS;
+
+        if (row >= keypad->rowCount || column >= keypad->columnCount)
+        {
+            continue;
+        }
+
+        int rowPin = keypad->rowPins[row];
+        int columnPin = keypad->columnPins[column];
+        int otherPin = pinNumber == columnPin ? rowPin : (pinNumber == rowPin ? columnPin : -1);
+
+        if (!isSimulatedPin(otherPin) || pins->modes[otherPin] != GPIO_MODE_OUTPUT)
+        {
+            continue;
+        }
+
+        if (pins->outputLevels[otherPin] == 0)
+        {
+            return 0;
+        }
+
+        level = 1;
+    }
+
+    return level;
+}
+
+static int collectSimulatedAlerts(struct SimulatedAlert *alerts)
+{
+    int count = 0;
+
+    for (int pinNumber = 0; pinNumber < GPIO_SIMULATOR_PINS; pinNumber++)
+    {
+        if (simulator.pins.alerts[pinNumber] == NULL)
+        {
+            continue;
+        }
+
+        int level = getSimulatedLevel(pinNumber);
+
+        if (level != simulator.pins.alertLevels[pinNumber])
+        {
+            simulator.pins.alertLevels[pinNumber] = level;
+            alerts[count++] = (struct SimulatedAlert)
+            {
+                .function = simulator.pins.alerts[pinNumber], .pinNumber = pinNumber,
+                .level = level, .data = simulator.pins.alertData[pinNumber]
+            };
+        }
+    }
+
+    return count;
+}
+
+static void callSimulatedAlerts(const struct SimulatedAlert *alerts, const int count)
+{
+    uint32_t tick = getSimulatedTick();
+
+    for (int index = 0; index < count; index++)
+    {
+        alerts[index].function(alerts[index].pinNumber, alerts[index].level, tick, alerts[index].data);
+    }
+}
+
+static void unlockAndAlert(void)
+{
+    struct SimulatedAlert alerts[GPIO_SIMULATOR_PINS];
+    int count = collectSimulatedAlerts(alerts);
+
+    pthread_mutex_unlock(&simulator.mutex);
+
+    callSimulatedAlerts(alerts, count);
+}
+
+static void *playSimulatorScript(void *argument)
+{
+    (void)argument;
+
+    int64_t startTime = getMonotonicTimeInNanoseconds();
+    char line[GPIO_SIMULATOR_SCRIPT_LINE_LENGTH];
+    int lineNumber = 0;
+    bool stopped = false;
+
+    printf("Playing the simulator script.\n");
+
+    while (!stopped && fgets(line, sizeof(line), simulator.script.file) != NULL)
+    {
+        lineNumber++;
+
+        double seconds;
+        char action[16];
+        int row, column;
+        char first;
+
+        // Empty lines and comments.
+        if (sscanf(line, " %c", &first) != 1 || first == '#')
+        {
+            continue;
+        }
+
+        if (sscanf(line, " %lf %15s %d %d", &seconds, action, &row, &column) != 4 ||
+            (strcmp(action, "press") != 0 && strcmp(action, "release") != 0))
+        {
+            fprintf(stderr, "Skipping line %d of the simulator script, it's not \"<seconds> press|release <row> <column>\".\n",
+                    lineNumber);
+
+            continue;
+        }
+
+        int64_t actionTime = startTime + (int64_t)(seconds * 1e9);
+        struct timespec deadline = { .tv_sec = actionTime / 1000000000, .tv_nsec = actionTime % 1000000000 };
+
+        pthread_mutex_lock(&simulator.mutex);
+
+        // Waits until the time of the line, or until cleanup stops the script.
+        while (!simulator.script.stopRequested && getMonotonicTimeInNanoseconds() < actionTime)
+        {
+            pthread_cond_timedwait(&simulator.script.stopCondition, &simulator.mutex, &deadline);
+        }
+
+        stopped = simulator.script.stopRequested;
+
+        pthread_mutex_unlock(&simulator.mutex);
+
+        if (!stopped)
+        {
+            pressSimulatedKey(row, column, strcmp(action, "press") == 0);
+        }
+    }
+
+    fclose(simulator.script.file);
+    simulator.script.file = NULL;
+
+    if (!stopped)
+    {
+        printf("Simulator script finished.\n");
+    }
+
+    return NULL;
+}
+
+static bool isSimulatedPin(const int pinNumber)
+{
+    return pinNumber >= 0 && pinNumber < GPIO_SIMULATOR_PINS;
+}
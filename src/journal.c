@@ -0,0 +1,582 @@
+/**
+ * @file journal.c
+ * @author Selkamies
+ *
+ * @brief Append-only journal of saved log rows, for replicating them upstream with clock_shipper.
+ *
+ * The current segment file is memory mapped, so appending a record is a copy to memory and never waits
+ * for the SD card. The kernel writes the pages back on its own. A power cut can lose the latest records,
+ * but never the log rows themselves: on the next start the rows after the latest record are read from
+ * the database and written to the journal again. The database stays the source of truth.
+ *
+ * @date Created  2024-01-19
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), snprintf(), fopen(), rename().
+#include <stdlib.h>             // strtoull().
+#include <string.h>             // strncmp(), strcmp().
+#include <stdbool.h>
+#include <stddef.h>             // offsetof().
+#include <errno.h>              // errno, EEXIST.
+#include <dirent.h>             // opendir(), readdir(), closedir().
+#include <fcntl.h>              // open().
+#include <unistd.h>             // ftruncate(), pread(), fsync(), close().
+#include <pthread.h>            // pthread_mutex_init(), pthread_mutex_lock(), etc.
+#include <sys/mman.h>           // mmap(), munmap(), msync().
+#include <sys/stat.h>           // mkdir().
+
+#include "journal.h"
+#include "journal_config.h"     // struct JournalConfig.
+#include "database.h"           // selectLogRowsAfterID(), selectLatestLogID(), advanceLatestLogID().
+#include "database_config.h"    // struct DatabaseConfig, struct LogRow.
+
+
+
+/** @brief Size of a segment file in bytes. */
+#define JOURNAL_SEGMENT_BYTES ((size_t)JOURNAL_SEGMENT_RECORDS * JOURNAL_RECORD_SIZE)
+/** @brief Folder of the segment files if config.ini doesn't set one. */
+#define JOURNAL_DEFAULT_DIRECTORY "journal"
+/** @brief Log rows read at once when catching up with the database. */
+#define JOURNAL_CATCH_UP_BATCH 256
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Maps a segment file, creating it full of empty slots if it doesn't exist. Unmaps the previous one.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param segmentIndex Index of the segment.
+ *
+ * @return true If the segment was mapped.
+ * @return false If something went wrong. No segment is mapped then.
+ */
+static bool mapSegment(struct JournalConfig *journalConfig, const uint64_t segmentIndex);
+
+/**
+ * @brief Finds the segment file with the largest index in the journal folder.
+ *
+ * @param directory The journal folder.
+ * @param segmentIndex Pointer to the index.
+ *
+ * @return true If there is at least one segment file.
+ * @return false If there are none.
+ */
+static bool findLatestSegment(const char *directory, uint64_t *segmentIndex);
+
+/**
+ * @brief Finds where the journal ends and the ID of the latest log row in it.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param ackedSequence Sequence number of the last record acknowledged upstream.
+ * @param lastLogIDFound Pointer to whether a record was found to take the log row ID from.
+ *
+ * @return true If the journal could be read.
+ * @return false If the latest segment couldn't be mapped.
+ */
+static bool findJournalEnd(struct JournalConfig *journalConfig, const uint64_t ackedSequence, bool *lastLogIDFound);
+
+/**
+ * @brief Writes the log rows saved after the latest record to the journal.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param databaseConfig Struct holding the database connection.
+ *
+ * @return true If the journal caught up.
+ * @return false If something went wrong.
+ */
+static bool catchUpJournal(struct JournalConfig *journalConfig, struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Writes the next record, moving to the next segment when the current one is full.
+ * The caller has to hold the lock, or be the only thread using the journal.
+ *
+ * @param journalConfig Struct holding all the variables needed by journal.c.
+ * @param logID ID of the log row.
+ * @param userID User ID of the row.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param timestamp Time of the row in microseconds since the Unix epoch.
+ *
+ * @return true If the record was written.
+ * @return false If the next segment couldn't be mapped.
+ */
+static bool writeRecord(struct JournalConfig *journalConfig, const int64_t logID, const int userID, const int status,
+                        const int64_t timestamp);
+
+/**
+ * @brief Calculates the CRC of a record, everything but the crc field itself.
+ *
+ * @param record The record.
+ *
+ * @return uint32_t CRC-32, the same as zlib's crc32().
+ */
+static uint32_t calculateRecordCRC(const struct JournalRecord *record);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+void setJournalDefaults(struct JournalConfig *journalConfig)
+{
+    journalConfig->ENABLED = false;
+    journalConfig->TERMINAL_ID = 1;
+    snprintf(journalConfig->DIRECTORY, sizeof(journalConfig->DIRECTORY), "%s", JOURNAL_DEFAULT_DIRECTORY);
+}
+
+bool initializeJournal(struct JournalConfig *journalConfig, struct DatabaseConfig *databaseConfig)
+{
+    journalConfig->open = false;
+    journalConfig->segment = NULL;
+
+    if (!journalConfig->ENABLED || databaseConfig->database == NULL)
+    {
+        return false;
+    }
+
+    printf("Initializing journal.\n");
+
+    if (mkdir(journalConfig->DIRECTORY, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Could not create the journal folder %s.\n", journalConfig->DIRECTORY);
+
+        return false;
+    }
+
+    uint64_t ackedSequence = 0;
+    bool lastLogIDFound = false;
+    readJournalAck(journalConfig->DIRECTORY, &ackedSequence);
+
+    if (!findJournalEnd(journalConfig, ackedSequence, &lastLogIDFound))
+    {
+        return false;
+    }
+
+    // Records after the end were lost, but clock_shipper had already sent them. Sequence numbers never go back,
+    // so the records written from now on are not mistaken for ones upstream already has.
+    if (ackedSequence >= journalConfig->nextSequence)
+    {
+        journalConfig->nextSequence = ackedSequence + 1;
+    }
+
+    int64_t latestLogID = 0;
+
+    if (!selectLatestLogID(databaseConfig, &latestLogID))
+    {
+        cleanupJournal(journalConfig);
+
+        return false;
+    }
+
+    // A new journal starts from the rows saved from now on, the old ones can be exported with clock_export.
+    if (!lastLogIDFound)
+    {
+        journalConfig->lastLogID = latestLogID;
+        printf("Journal starts after log row %lld.\n", (long long)journalConfig->lastLogID);
+    }
+    // The journal has rows the database never handed out, because the database was restored from a backup,
+    // or its log IDs were reused before schema version 7. Upstream tells records apart by their log ID,
+    // so new rows must not get the IDs it already has. The database skips them instead.
+    else if (journalConfig->lastLogID > latestLogID)
+    {
+        if (!advanceLatestLogID(databaseConfig, journalConfig->lastLogID))
+        {
+            fprintf(stderr, "Journal is ahead of the database at log row %lld, and the database could not skip "
+                            "the log IDs already in it.\n", (long long)journalConfig->lastLogID);
+            cleanupJournal(journalConfig);
+
+            return false;
+        }
+
+        printf("Journal is ahead of the database, new log rows start after log row %lld instead of %lld.\n",
+               (long long)journalConfig->lastLogID, (long long)latestLogID);
+    }
+
+    if (pthread_mutex_init(&journalConfig->lock, NULL) != 0)
+    {
+        cleanupJournal(journalConfig);
+
+        return false;
+    }
+
+    journalConfig->open = true;
+
+    // The log writer thread isn't running yet, so nothing else appends meanwhile.
+    if (!catchUpJournal(journalConfig, databaseConfig))
+    {
+        fprintf(stderr, "Could not catch up the journal with the database, it's disabled.\n");
+        cleanupJournal(journalConfig);
+
+        return false;
+    }
+
+    printf("Journal continues from record %llu.\n", (unsigned long long)journalConfig->nextSequence);
+
+    return true;
+}
+
+bool appendJournalRecord(struct JournalConfig *journalConfig, const int64_t logID, const int userID, const int status,
+                         const int64_t timestamp)
+{
+    if (!journalConfig->open)
+    {
+        return true;
+    }
+
+    pthread_mutex_lock(&journalConfig->lock);
+    bool written = writeRecord(journalConfig, logID, userID, status, timestamp);
+    pthread_mutex_unlock(&journalConfig->lock);
+
+    if (!written)
+    {
+        fprintf(stderr, "Could not write log row %lld to the journal.\n", (long long)logID);
+    }
+
+    return written;
+}
+
+void cleanupJournal(struct JournalConfig *journalConfig)
+{
+    if (journalConfig->segment != NULL)
+    {
+        msync(journalConfig->segment, JOURNAL_SEGMENT_BYTES, MS_SYNC);
+        munmap(journalConfig->segment, JOURNAL_SEGMENT_BYTES);
+        journalConfig->segment = NULL;
+    }
+
+    if (journalConfig->open)
+    {
+        pthread_mutex_destroy(&journalConfig->lock);
+        journalConfig->open = false;
+    }
+}
+
+bool isValidJournalRecord(const struct JournalRecord *record, const uint64_t sequence)
+{
+    return record->sequence == sequence && record->crc == calculateRecordCRC(record);
+}
+
+uint32_t calculateCRC32(const void *bytes, const size_t length)
+{
+    const uint8_t *byte = (const uint8_t *)bytes;
+    uint32_t crc = 0xFFFFFFFFu;
+
+    // Bitwise CRC-32, records are only a few dozen bytes so a lookup table isn't worth it.
+    for (size_t index = 0; index < length; index++)
+    {
+        crc ^= byte[index];
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+
+    return ~crc;
+}
+
+void formatJournalSegmentPath(char *buffer, const size_t size, const char *directory, const uint64_t segmentIndex)
+{
+    snprintf(buffer, size, JOURNAL_SEGMENT_FILE_FORMAT, directory, (unsigned long long)segmentIndex);
+}
+
+bool parseJournalSegmentName(const char *fileName, uint64_t *segmentIndex)
+{
+    size_t prefixLength = strlen(JOURNAL_SEGMENT_NAME_PREFIX);
+
+    if (strncmp(fileName, JOURNAL_SEGMENT_NAME_PREFIX, prefixLength) != 0 ||
+        fileName[prefixLength] < '0' || fileName[prefixLength] > '9')
+    {
+        return false;
+    }
+
+    char *end;
+    *segmentIndex = strtoull(fileName + prefixLength, &end, 10);
+
+    return strcmp(end, JOURNAL_SEGMENT_NAME_SUFFIX) == 0;
+}
+
+bool readJournalAck(const char *directory, uint64_t *sequence)
+{
+    char filePath[JOURNAL_PATH_LENGTH];
+    snprintf(filePath, sizeof(filePath), "%s/%s", directory, JOURNAL_ACK_FILE_NAME);
+
+    *sequence = 0;
+    FILE *file = fopen(filePath, "r");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    unsigned long long value = 0;
+    bool read = fscanf(file, "%llu", &value) == 1;
+    fclose(file);
+
+    if (read)
+    {
+        *sequence = (uint64_t)value;
+    }
+
+    return read;
+}
+
+bool saveJournalAck(const char *directory, const uint64_t sequence)
+{
+    char filePath[JOURNAL_PATH_LENGTH];
+    char temporaryPath[JOURNAL_PATH_LENGTH + 8];
+    snprintf(filePath, sizeof(filePath), "%s/%s", directory, JOURNAL_ACK_FILE_NAME);
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", filePath);
+
+    FILE *file = fopen(temporaryPath, "w");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool written = fprintf(file, "%llu\n", (unsigned long long)sequence) > 0 && fflush(file) == 0 &&
+                   fsync(fileno(file)) == 0;
+
+    if (fclose(file) != 0 || !written || rename(temporaryPath, filePath) != 0)
+    {
+        return false;
+    }
+
+    // The rename itself is only durable once the folder is flushed.
+    int directoryDescriptor = open(directory, O_RDONLY);
+
+    if (directoryDescriptor >= 0)
+    {
+        fsync(directoryDescriptor);
+        close(directoryDescriptor);
+    }
+
+    return true;
+}
+
+
+
+static bool mapSegment(struct JournalConfig *journalConfig, const uint64_t segmentIndex)
+{
+    if (journalConfig->segment != NULL)
+    {
+        munmap(journalConfig->segment, JOURNAL_SEGMENT_BYTES);
+        journalConfig->segment = NULL;
+    }
+
+    char filePath[JOURNAL_PATH_LENGTH];
+    formatJournalSegmentPath(filePath, sizeof(filePath), journalConfig->DIRECTORY, segmentIndex);
+
+    int fileDescriptor = open(filePath, O_RDWR | O_CREAT, 0644);
+
+    if (fileDescriptor < 0)
+    {
+        fprintf(stderr, "Could not open journal segment %s.\n", filePath);
+
+        return false;
+    }
+
+    // A new file grows to full size with zeros, which are empty slots. An existing one stays as it is.
+    void *segment = MAP_FAILED;
+
+    if (ftruncate(fileDescriptor, (off_t)JOURNAL_SEGMENT_BYTES) == 0)
+    {
+        segment = mmap(NULL, JOURNAL_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    }
+
+    // The mapping stays valid after the file is closed.
+    close(fileDescriptor);
+
+    if (segment == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map journal segment %s.\n", filePath);
+
+        return false;
+    }
+
+    journalConfig->segment = (struct JournalRecord *)segment;
+    journalConfig->segmentIndex = segmentIndex;
+
+    return true;
+}
+
+static bool findLatestSegment(const char *directory, uint64_t *segmentIndex)
+{
+    DIR *folder = opendir(directory);
+
+    if (folder == NULL)
+    {
+        return false;
+    }
+
+    bool found = false;
+    struct dirent *entry;
+
+    while ((entry = readdir(folder)) != NULL)
+    {
+        uint64_t index = 0;
+
+        if (parseJournalSegmentName(entry->d_name, &index) && (!found || index > *segmentIndex))
+        {
+            *segmentIndex = index;
+            found = true;
+        }
+    }
+
+    closedir(folder);
+
+    return found;
+}
+
+static bool findJournalEnd(struct JournalConfig *journalConfig, const uint64_t ackedSequence, bool *lastLogIDFound)
+{
+    uint64_t segmentIndex = 0;
+    *lastLogIDFound = false;
+
+    if (!findLatestSegment(journalConfig->DIRECTORY, &segmentIndex))
+    {
+        journalConfig->nextSequence = 1;
+
+        return mapSegment(journalConfig, 0);
+    }
+
+    if (!mapSegment(journalConfig, segmentIndex))
+    {
+        return false;
+    }
+
+    uint64_t firstSequence = segmentIndex * JOURNAL_SEGMENT_RECORDS + 1;
+    uint64_t slot = 0;
+
+    // Records are written in order, so the first slot after the acknowledged ones that isn't valid is the end.
+    // After a power cut the kernel may have written back later pages but not earlier ones, those are overwritten.
+    // Slots that were skipped over on an earlier start because they had been shipped already stay empty.
+    while (slot < JOURNAL_SEGMENT_RECORDS)
+    {
+        if (isValidJournalRecord(&journalConfig->segment[slot], firstSequence + slot))
+        {
+            journalConfig->lastLogID = journalConfig->segment[slot].logID;
+            *lastLogIDFound = true;
+        }
+        else if (firstSequence + slot > ackedSequence)
+        {
+            break;
+        }
+
+        slot++;
+    }
+
+    journalConfig->nextSequence = firstSequence + slot;
+
+    if (*lastLogIDFound)
+    {
+        return true;
+    }
+
+    // The latest segment is empty, the previous one may still have the latest record if it hasn't been shipped and removed.
+    if (segmentIndex > 0)
+    {
+        char filePath[JOURNAL_PATH_LENGTH];
+        formatJournalSegmentPath(filePath, sizeof(filePath), journalConfig->DIRECTORY, segmentIndex - 1);
+
+        int fileDescriptor = open(filePath, O_RDONLY);
+
+        if (fileDescriptor >= 0)
+        {
+            struct JournalRecord record;
+            off_t offset = (off_t)(JOURNAL_SEGMENT_RECORDS - 1) * JOURNAL_RECORD_SIZE;
+
+            if (pread(fileDescriptor, &record, sizeof(record), offset) == (ssize_t)sizeof(record) &&
+                isValidJournalRecord(&record, firstSequence - 1))
+            {
+                journalConfig->lastLogID = record.logID;
+                *lastLogIDFound = true;
+            }
+
+            close(fileDescriptor);
+        }
+    }
+
+    return true;
+}
+
+static bool catchUpJournal(struct JournalConfig *journalConfig, struct DatabaseConfig *databaseConfig)
+{
+    struct LogRow rows[JOURNAL_CATCH_UP_BATCH];
+    int rowCount = JOURNAL_CATCH_UP_BATCH;
+    unsigned long caughtUpCount = 0;
+
+    while (rowCount == JOURNAL_CATCH_UP_BATCH)
+    {
+        if (!selectLogRowsAfterID(databaseConfig, journalConfig->lastLogID, rows, JOURNAL_CATCH_UP_BATCH, &rowCount))
+        {
+            return false;
+        }
+
+        for (int index = 0; index < rowCount; index++)
+        {
+            if (!writeRecord(journalConfig, rows[index].id, rows[index].userID, rows[index].status, rows[index].datetime))
+            {
+                return false;
+            }
+        }
+
+        caughtUpCount += (unsigned long)rowCount;
+    }
+
+    if (caughtUpCount > 0)
+    {
+        printf("%lu log row(s) missing from the journal were added.\n", caughtUpCount);
+    }
+
+    return true;
+}
+
+static bool writeRecord(struct JournalConfig *journalConfig, const int64_t logID, const int userID, const int status,
+                        const int64_t timestamp)
+{
+    uint64_t sequence = journalConfig->nextSequence;
+    uint64_t segmentIndex = (sequence - 1) / JOURNAL_SEGMENT_RECORDS;
+
+    // Once every JOURNAL_SEGMENT_RECORDS records.
+    if (journalConfig->segment == NULL || segmentIndex != journalConfig->segmentIndex)
+    {
+        if (!mapSegment(journalConfig, segmentIndex))
+        {
+            return false;
+        }
+    }
+
+    struct JournalRecord record =
+    {
+        .sequence = sequence,
+        .logID = logID,
+        .timestamp = timestamp,
+        .terminalID = (uint32_t)journalConfig->TERMINAL_ID,
+        .userID = userID,
+        .status = status,
+    };
+    record.crc = calculateRecordCRC(&record);
+
+    // A reader that sees the slot half-written gets a CRC mismatch and tries again later.
+    journalConfig->segment[(sequence - 1) % JOURNAL_SEGMENT_RECORDS] = record;
+    journalConfig->nextSequence++;
+
+    if (logID > journalConfig->lastLogID)
+    {
+        journalConfig->lastLogID = logID;
+    }
+
+    return true;
+}
+
+static uint32_t calculateRecordCRC(const struct JournalRecord *record)
+{
+    return calculateCRC32(record, offsetof(struct JournalRecord, crc));
+}
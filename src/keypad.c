@@ -3,30 +3,56 @@
  * @author Selkamies
  * 
  * @brief Handles the input from a keypad attached to Raspberry Pi 4. 
- * This file contains the logic, all GPIO pin handling by pigpio is in keypad_gpio.c.
+ * This file contains the logic, all GPIO pin handling is in gpio_functions.c.
+ * 
+ * With EDGE_TRIGGERED every row is driven low while idle, so any key press changes the level of its column.
+ * The GPIO backend calls keypadEdgeAlert() for that edge and the main loop wakes up and scans the matrix right away,
+ * instead of polling it every UPDATE_INTERVAL_SECONDS. While a key is down the matrix is polled as before,
+ * because the scan itself toggles the columns and an edge during a scan can't be told apart from those.
+ * 
+ * The scan only queues debounced key events. The PIN handling takes them from the queue in order, so the
+ * scan doesn't need to know about PINs, and the queue is lock-free so the scan can run in another thread.
+ * 
+ * With SCAN_THREAD that's what happens: scanThread() scans at absolute deadlines on CLOCK_MONOTONIC, optionally
+ * at SCHED_FIFO priority and pinned to one core, so sampling stays on time while the main loop saves a clock event
+ * or plays a sound. With EDGE_TRIGGERED too, the thread sleeps until an edge whenever no key is down.
  * 
  * @date Created  2023-11-13
- * @date Modified 2023-12-20
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
 
 
 
+// pthread_attr_setaffinity_np() and CPU_SET() are GNU extensions.
+#define _GNU_SOURCE
+
 #include <stdio.h>              // printf()
 #include <stdbool.h>
 #include <stdlib.h>             // calloc()
-#include <string.h>             // strcmp()
+#include <string.h>             // strcmp(), memset()
+#include <stdint.h>             // uint32_t.
+#include <stdatomic.h>          // atomic_load(), atomic_store(), atomic_exchange(), atomic_fetch_add_explicit().
+#include <semaphore.h>          // sem_init(), sem_post(), sem_timedwait(), sem_destroy().
+#include <time.h>               // clock_gettime(), clock_nanosleep(), CLOCK_REALTIME, CLOCK_MONOTONIC.
+#include <pthread.h>            // pthread_create(), pthread_join(), pthread_attr_setschedpolicy(), etc.
+#include <sched.h>              // SCHED_FIFO, struct sched_param, cpu_set_t.
+#include <errno.h>              // EINTR, EPERM.
 
 #include "keypad.h"
-#include "gpio_functions.h"     // turnGPIOPinOff(), turnGPIOPinOn(), isGPIOPinOn().
+#include "gpio_functions.h"     // turnGPIOPinOff(), turnGPIOPinOn(), isGPIOPinOn(), turnGPIOPinsOff(), turnGPIOPinsOn(), getGPIOPinsOn(), setGPIOPinAlert(), getGPIOTick().
 #include "leds.h"               // turnLEDOn(), turnLEDsOff().
 #include "sounds.h"             // playSound().
-#include "timer.h"              // getCurrentTimeInSeconds().
-#include "database.h"           // selectUserIDByPIN(), insertLogRow().
+#include "timer.h"              // getCurrentTimeInSeconds(), getCurrentTimeInMicroseconds(), getMonotonicTimeInNanoseconds().
+#include "database.h"           // selectUserIDByPIN(), recordClockEvent(), struct ClockEventOutcome.
+#include "log_writer.h"         // queueLogRow(), selectQueuedLogStatus().
+#include "journal.h"            // appendJournalRecord().
+#include "spool.h"              // appendSpoolEvent(), hasSpooledEvents(), selectSpooledLogStatus().
 
 #include "config_data.h"        // struct ConfigData.
-#include "keypad_config.h"      // struct KeypadConfig, struct KeypadState, struct PINState.
+#include "keypad_config.h"      // struct KeypadConfig, struct KeypadState, struct PINState, struct KeypadEvent.
+#include "keypad_debounce.h"    // debounceKey(), isKeyDown(), isKeySettling().
 
 
 
@@ -34,29 +60,148 @@
 #define EMPTY_KEY '\0'
 /** @brief Default value used for timestamps when no time is recorded. */
 #define EMPTY_TIMESTAMP 0
+/** @brief Default for IDLE_WAIT_SECONDS. */
+#define KEYPAD_DEFAULT_IDLE_WAIT_SECONDS 0.5
+/** @brief Shortest time between scheduled scans of the scan thread, so a SCHED_FIFO thread can't take a whole core. */
+#define KEYPAD_MIN_SCAN_INTERVAL_NANOSECONDS 1000000
+/** @brief How often the scan thread checks for a stop request while it waits for an edge. */
+#define KEYPAD_SCAN_THREAD_STOP_CHECK_SECONDS 0.2
 
 
 
 #pragma region FunctionDeclarations
 
 /**
- * @brief Loops through the keypad and updates a struct holding data about it's current status,
- * like whether any keys are pressed, what key is pressed, etc.
+ * @brief Scans the keypad if an edge was seen or it's time to poll it. Used when there's no scan thread.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void scanKeypadIfDue(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Scans the keypad and queues the presses and releases found.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void scanKeypad(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief The scan thread. Scans the keypad every UPDATE_INTERVAL_SECONDS at absolute deadlines until asked to stop,
+ * or sleeps until an edge while no key is down, if EDGE_TRIGGERED.
+ * 
+ * @param argument Pointer to struct KeypadConfig.
+ * 
+ * @return void* Always NULL.
+ */
+static void *scanThread(void *argument);
+
+/**
+ * @brief Records how late the scan thread woke up for a deadline.
+ * 
+ * @param statistics How well the scan thread keeps its schedule.
+ * @param jitterNanoseconds How much later than the deadline the thread woke up.
+ * @param late Whether it was so late that a scan was skipped.
+ */
+static void recordScanJitter(struct KeypadScanStatistics *statistics, const int64_t jitterNanoseconds, const bool late);
+
+/**
+ * @brief Starts the scan thread, with real-time priority and on one core if those are set.
+ * Falls back to normal scheduling if we aren't allowed to use real-time priority.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return true If the thread was started.
+ * @return false If it wasn't. The main loop scans the keypad instead.
+ */
+static bool startScanThread(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Creates the scan thread.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * @param realTime Whether to use SCHED_FIFO with SCAN_THREAD_PRIORITY.
+ * 
+ * @return int 0, or the error from pthread_create().
+ */
+static int createScanThread(struct KeypadConfig *keypadConfig, const bool realTime);
+
+/**
+ * @brief Stops the scan thread and prints its statistics.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void stopScanThread(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Waits for a semaphore, but not for longer than the given time.
+ * 
+ * @param semaphore The semaphore.
+ * @param seconds Longest time to wait.
+ */
+static void waitForSemaphore(sem_t *semaphore, const double seconds);
+
+/**
+ * @brief Adds a key event to the queue. Never waits. If the queue is full the event is dropped and counted.
+ * 
+ * @param queue Key events waiting for the PIN handling.
+ * @param event The event to queue.
+ */
+static void queueKeypadEvent(struct KeypadEventQueue *queue, const struct KeypadEvent *event);
+
+/**
+ * @brief Takes the oldest key event from the queue.
+ * 
+ * @param queue Key events waiting for the PIN handling.
+ * @param event Pointer to the event we're looking to get.
+ * 
+ * @return true If an event was taken.
+ * @return false If the queue was empty.
+ */
+static bool takeKeypadEvent(struct KeypadEventQueue *queue, struct KeypadEvent *event);
+
+/**
+ * @brief Handles the queued key events in order, and reports events dropped since the last call.
+ * 
+ * @param configData Struct holding data about basically all variables used by the program.
+ */
+static void handleKeypadEvents(struct ConfigData *configData);
+
+/**
+ * @brief Reads the keypad and updates a struct holding data about it's current status: the keys read pressed,
+ * the keys pressed after debouncing, and the presses and releases in keypadState.scanEvents.
+ * Only the keys that read differently from their debounced state, or did in the previous scan, are debounced.
  * 
  * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
  */
 static void updateKeypadStatus(struct KeypadConfig *keypadConfig);
 
 /**
- * @brief Loops through the keypad keys and checks if they are pressed or not. Counts and returns
- * the number of keys currently pressed. If exactly one key is pressed, notes it in keypadState.keyPressed.
+ * @brief Loops through the keypad keys and checks if they are pressed or not.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return uint64_t The keys that read pressed, one bit per key at KEYPAD_KEY_INDEX(row, column).
+ */
+static uint64_t loopThroughKeys(const struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Turns off one keypad row and checks which columns are on, meaning which keys in that row are pressed.
+ * With bank access it's one write to turn the row off, one read for all columns and one write to turn the row back on.
  * 
  * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * @param row Index of the row.
  * 
- * @return int Number of keys currently pressed on the keypad. 0-2.
- * If the number gets above 1, we break the loop early and don't bother checking for the rest of the keys.
+ * @return uint8_t The keys in the row that read pressed, bit 0 for column 0.
  */
-static int loopThroughKeys(struct KeypadConfig *keypadConfig);
+static uint8_t readKeypadRow(const struct KeypadConfig *keypadConfig, const int row);
+
+/**
+ * @brief Handles a key press that came alone: starts waiting for a PIN, or stores the key to the PIN.
+ * 
+ * @param configData Struct holding data about basically all variables used by the program.
+ * @param key The pressed key.
+ */
+static void handleKeyPress(struct ConfigData *configData, const char key);
 
 /**
  * @brief Stores the pressed key to the current PIN under input.
@@ -74,17 +219,34 @@ static void storeKeyPress(struct ConfigData *configData, const char key);
 static void clearPIN(struct KeypadConfig *keypadConfig);
 
 /**
- * @brief Checks the full PIN for validity. Currently mock checks.
- * TODO: Check database for existing person that has the passed PIN.
+ * @brief Checks the full PIN and the user's status, and saves the clock event if it's accepted.
+ * If the log writer thread is running, the decision is made from memory and the event is queued,
+ * so the user gets feedback without waiting for the disk. The writer thread checks the status
+ * again when saving. Otherwise the event is checked and saved in one transaction right away.
+ * If the database fails, or older events are still waiting in the spool, the event is spooled instead.
+ * 
+ * @param configData Struct holding data about basically all variables used by the program.
+ * @param pin The PIN to check.
+ * @param requestedStatus LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param outcome Pointer to the outcome we're looking to get.
+ */
+static void processClockEvent(struct ConfigData *configData, const char *pin, const int requestedStatus,
+                              struct ClockEventOutcome *outcome);
+
+/**
+ * @brief Checks the PIN and the user's status without writing anything. Events still in the log writer queue
+ * or in the spool are newer than anything in the database, so they're checked first.
  * 
- * @param database Database we're using.
- * @param pin_input The PIN to check.
- * @param userIDPointer Pointer to the user ID of the matching PIN code, if any.
+ * @param configData Struct holding data about basically all variables used by the program.
+ * @param pin The PIN to check.
+ * @param requestedStatus LOG_STATUS_IN or LOG_STATUS_OUT.
+ * @param outcome Pointer to the outcome. Its result is only set if the event is rejected or can't be checked.
  * 
- * @return true If the PIN matches.
- * @return false If the PIN doesn't have a match.
+ * @return true If the event can be saved.
+ * @return false If it was rejected, or the user's status couldn't be read from the database.
  */
-static bool validPIN(sqlite3 **database, const char *pin_input, int *userIDPointer);
+static bool checkClockEvent(struct ConfigData *configData, const char *pin, const int requestedStatus,
+                            struct ClockEventOutcome *outcome);
 
 /**
  * @brief Checks if it has been too long since the last keypress.
@@ -131,232 +293,625 @@ static void timeoutPIN(struct ConfigData *configData);
  */
 static bool enoughTimeSinceLastKeypadUpdate(const double lastUpdateTime, const double updateInterval);
 
+/**
+ * @brief Sets every keypad row on or off.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * @param on Whether to turn the rows on or off.
+ */
+static void setKeypadRows(const struct KeypadConfig *keypadConfig, const bool on);
+
+/**
+ * @brief Checks every column once, without touching the rows.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return true If any column is on.
+ * @return false If no column is on.
+ */
+static bool isAnyKeypadColumnOn(const struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Called by the GPIO backend's alert thread when a column changes level. Marks an edge pending and wakes the main loop,
+ * unless the change happened during a scan.
+ * 
+ * @param pinNumber GPIO pin number of the column.
+ * @param level New level of the column.
+ * @param tick GPIO tick of the change.
+ * @param data Pointer to struct KeypadEdgeState.
+ */
+static void keypadEdgeAlert(int pinNumber, int level, uint32_t tick, void *data);
+
+/**
+ * @brief Marks an edge pending and wakes the main loop, if an edge wasn't pending already.
+ * 
+ * @param edgeState Edges seen on the column pins.
+ */
+static void signalKeypadEdge(struct KeypadEdgeState *edgeState);
+
+/**
+ * @brief Turns the rows on for a scan and starts ignoring the edges it causes.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void beginEdgeScan(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Drives the rows low again after a scan. A key pressed during the scan wasn't seen by it and its edge
+ * was ignored, so the columns are checked once more.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void endEdgeScan(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Drives the rows low and registers keypadEdgeAlert() for every column.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ * 
+ * @return true If the alerts are running.
+ * @return false If they couldn't be registered. The keypad is polled instead.
+ */
+static bool startEdgeAlerts(struct KeypadConfig *keypadConfig);
+
+/**
+ * @brief Removes the alert functions from the columns.
+ * 
+ * @param keypadConfig Struct holding configuration variables used by keypad and PIN reading.
+ */
+static void stopEdgeAlerts(struct KeypadConfig *keypadConfig);
+
 #pragma endregion // FunctionDeclarations
 
 
 
+void setKeypadDefaults(struct KeypadConfig *keypadConfig)
+{
+    // Keys config.ini doesn't set are never accepted.
+    memset(keypadConfig->keypadState.keys, EMPTY_KEY, sizeof(keypadConfig->keypadState.keys));
+
+    keypadConfig->EDGE_TRIGGERED = false;
+    keypadConfig->IDLE_WAIT_SECONDS = KEYPAD_DEFAULT_IDLE_WAIT_SECONDS;
+    keypadConfig->DEBOUNCE_PRESS_MILLISECONDS = 0;
+    keypadConfig->DEBOUNCE_RELEASE_MILLISECONDS = 0;
+    keypadConfig->SCAN_THREAD = false;
+    keypadConfig->SCAN_THREAD_PRIORITY = 0;
+    keypadConfig->SCAN_THREAD_CPU = -1;
+}
+
 void updateKeypad(struct ConfigData *configData)
 {
     // For readability.
     struct KeypadConfig *keypadConfig = &configData->keypadConfig;
-    struct KeypadState *keypadState = &keypadConfig->keypadState;
 
-    if (enoughTimeSinceLastKeypadUpdate(keypadState->lastUpdateTime, keypadConfig->UPDATE_INTERVAL_SECONDS))
+    // For readability.
+    struct KeypadScanThread *scanThread = &keypadConfig->scanThread;
+
+    if (!scanThread->running)
     {
-        updateKeypadStatus(keypadConfig);
+        scanKeypadIfDue(keypadConfig);
+    }
 
-        if (keypadState->exactlyOneKeyPressed && keypadState->noKeysPressedPreviously)
-        {
-            // Clocking IN or OUT key was pressed previously, and we are ready to read the PIN code.
-            if (keypadConfig->currentPINState.waitingForPINInput)
-            {
-                storeKeyPress(configData, keypadState->keyPressed);
-            }
-            
-            else if (keypadState->keyPressed == keypadState->clockInKey ||
-                     keypadState->keyPressed == keypadState->clockOutKey)
-            {
-                if (keypadState->keyPressed == keypadState->clockInKey)
-                {
-                    keypadConfig->currentPINState.status = LOG_STATUS_IN;
-
-                    printf("Waiting for clock IN.\n\n");
-                }
-
-                else if (keypadState->keyPressed == keypadState->clockOutKey)
-                {
-                    
-                    keypadConfig->currentPINState.status = LOG_STATUS_OUT;
-                    
-                    printf("Waiting for clock OUT.\n\n");
-                }
-
-                keypadConfig->currentPINState.waitingForPINInput = true;
-                startTimeoutTimer(&configData->keypadConfig.currentPINState);
-            }
-        }
+    handleKeypadEvents(configData);
 
-        keypadState->noKeysPressedPreviously = !keypadState->anyKeysPressed;
+    unsigned long lateCount = atomic_load_explicit(&scanThread->statistics.lateCount, memory_order_relaxed);
 
-        if (tooLongSinceLastKeypress(keypadConfig))
-        {
-            timeoutPIN(configData);
-        }
+    if (lateCount != scanThread->reportedLateCount)
+    {
+        fprintf(stderr, "Keypad scan thread woke up too late to scan on time %lu time(s). Largest delay so far: %llu us.\n",
+                lateCount - scanThread->reportedLateCount,
+                atomic_load_explicit(&scanThread->statistics.maxJitterNanoseconds, memory_order_relaxed) / 1000);
+        scanThread->reportedLateCount = lateCount;
+    }
 
-        keypadState->lastUpdateTime = getCurrentTimeInSeconds();
+    // Checked every round, the keypad may not be scanned for a long time with edge alerts.
+    if (tooLongSinceLastKeypress(keypadConfig))
+    {
+        timeoutPIN(configData);
     }
 } 
 
-static void updateKeypadStatus(struct KeypadConfig *keypadConfig)
+bool waitForKeypadInput(struct KeypadConfig *keypadConfig, const double seconds)
+{
+    // The scan thread wakes us once it has queued events. updateKeypad() checks the queue itself.
+    if (keypadConfig->scanThread.running)
+    {
+        waitForSemaphore(&keypadConfig->scanThread.eventsQueued, seconds);
+
+        return true;
+    }
+
+    // Woken by an edge. updateKeypad() checks for the edge itself.
+    if (keypadConfig->edgeState.running)
+    {
+        waitForSemaphore(&keypadConfig->edgeState.wakeup, seconds);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool isKeypadIdle(const struct KeypadConfig *keypadConfig)
+{
+    return !keypadConfig->currentPINState.waitingForPINInput &&
+           !keypadConfig->keypadState.anyKeysPressed &&
+           !keypadConfig->keypadState.anyKeysSettling;
+}
+
+bool isAnyKeypadKeyDown(const struct KeypadConfig *keypadConfig)
+{
+    // The scan thread owns the GPIO pins, its latest scan is at most an interval old.
+    // Queued events are key presses that haven't been handled yet.
+    if (keypadConfig->scanThread.running)
+    {
+        return keypadConfig->keypadState.anyKeysPressed || keypadConfig->keypadState.anyKeysSettling ||
+               atomic_load(&keypadConfig->edgeState.edgePending) ||
+               atomic_load(&keypadConfig->eventQueue.head) != atomic_load(&keypadConfig->eventQueue.tail);
+    }
+
+    // The rows are already low between scans, an edge not handled yet counts too.
+    if (keypadConfig->edgeState.running)
+    {
+        return atomic_load(&keypadConfig->edgeState.edgePending) || isAnyKeypadColumnOn(keypadConfig);
+    }
+
+    // With every row off, a pressed key anywhere turns its column on.
+    setKeypadRows(keypadConfig, false);
+    bool anyKeyDown = isAnyKeypadColumnOn(keypadConfig);
+    setKeypadRows(keypadConfig, true);
+
+    return anyKeyDown;
+}
+
+static void scanKeypadIfDue(struct KeypadConfig *keypadConfig)
+{
+    // For readability.
+    struct KeypadState *keypadState = &keypadConfig->keypadState;
+    struct KeypadEdgeState *edgeState = &keypadConfig->edgeState;
+
+    // An edge is handled right away. Without edge alerts, or while a key is down or settling, the keypad is polled.
+    bool edgeSeen = edgeState->running && atomic_exchange(&edgeState->edgePending, false);
+    bool pollKeypad = !edgeState->running || keypadState->anyKeysPressed || keypadState->anyKeysSettling;
+
+    if (edgeSeen || 
+        (pollKeypad && enoughTimeSinceLastKeypadUpdate(keypadState->lastUpdateTime, keypadConfig->UPDATE_INTERVAL_SECONDS)))
+    {
+        scanKeypad(keypadConfig);
+    }
+}
+
+static void scanKeypad(struct KeypadConfig *keypadConfig)
 {
     // For readability.
     struct KeypadState *keypadState = &keypadConfig->keypadState;
 
-    // Number of keys that are pressed/down this update.
-    int keysNowPressedCount = loopThroughKeys(keypadConfig);
+    uint64_t keysDownBefore = keypadState->keysDown;
 
-    if (keysNowPressedCount == 0)
+    if (keypadConfig->edgeState.running)
     {
-        //printf("No keys pressed.\n");
-        keypadState->keyPressed = EMPTY_KEY;
-        keypadState->anyKeysPressed = false;
-        keypadState->exactlyOneKeyPressed = false; 
+        beginEdgeScan(keypadConfig);
+        updateKeypadStatus(keypadConfig);
+        endEdgeScan(keypadConfig);
     }
 
-    else if (keysNowPressedCount == 1)
+    else
     {
-        //printf("Exactly one key pressed.\n");
-        keypadState->anyKeysPressed = true;
-        keypadState->exactlyOneKeyPressed = true;
+        updateKeypadStatus(keypadConfig);
     }
 
-    else if (keysNowPressedCount > 1)
+    // Only a key pressed while no other key is down is accepted, we don't accept ambigious input.
+    // Then the press of that key is the only press event of this scan.
+    bool pressIsAlone = keysDownBefore == 0 && __builtin_popcountll(keypadState->keysDown) == 1;
+
+    for (int index = 0; index < keypadState->scanEventCount; index++)
     {
-        //printf("Too many keys pressed.\n");
-        keypadState->anyKeysPressed = true;
-        keypadState->exactlyOneKeyPressed = false;
-        // This isn't necessary, but we should probably do it just in case.
-        keypadState->keyPressed = EMPTY_KEY;
+        struct KeypadEvent *event = &keypadState->scanEvents[index];
+
+        event->alone = event->pressed && pressIsAlone;
+        queueKeypadEvent(&keypadConfig->eventQueue, event);
     }
+
+    keypadState->lastUpdateTime = getCurrentTimeInSeconds();
 }
 
-static int loopThroughKeys(struct KeypadConfig *keypadConfig)
+static void queueKeypadEvent(struct KeypadEventQueue *queue, const struct KeypadEvent *event)
 {
-    int keysNowPressedCount = 0;
+    // Only the scan writes head. Acquire on tail, so the PIN handling is done with the slot we're about to reuse.
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
 
-    for (int row = 0; row < keypadConfig->KEYPAD_ROWS; row++)
+    // The newest events are dropped, the PIN handling can't make sense of a press without the ones before it anyway.
+    if (head - tail >= KEYPAD_EVENT_QUEUE_CAPACITY)
     {
-        // Disable the current row to check if any key in this row is pressed.
-        turnGPIOPinOff(keypadConfig->pins.keypad_rows[row]);
+        atomic_fetch_add_explicit(&queue->droppedCount, 1, memory_order_relaxed);
 
-        // Check every column pin to see if a key in this row is pressed.
-        for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
-        {
-            // Row off and column on means that they key in the intersection is pressed.
-            bool keyNowPressed = isGPIOPinOn(keypadConfig->pins.keypad_columns[column]);
+        return;
+    }
 
-            if (keyNowPressed)
-            {
-                keypadConfig->keypadState.keyPressed = keypadConfig->keypadState.keys[row][column];
-                keysNowPressedCount++;
+    queue->events[head % KEYPAD_EVENT_QUEUE_CAPACITY] = *event;
 
-                // More than one key is pressed down at the same time, we don't accept ambigious input.
-                if (keysNowPressedCount > 1)
-                {
-                    // TODO: Is this necessary?
-                    turnGPIOPinOn(keypadConfig->pins.keypad_rows[row]);
+    if (head + 1 - tail > atomic_load_explicit(&queue->maxDepth, memory_order_relaxed))
+    {
+        atomic_store_explicit(&queue->maxDepth, head + 1 - tail, memory_order_relaxed);
+    }
 
-                    return keysNowPressedCount;
-                }
-            }
+    // Release, so the PIN handling sees the event before it sees the new head.
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
 
-            keypadConfig->keypadState.keysPressedPreviously[row][column] = keyNowPressed;
-        }
+static bool takeKeypadEvent(struct KeypadEventQueue *queue, struct KeypadEvent *event)
+{
+    // Only the PIN handling writes tail. Acquire on head, so the event is complete before we read it.
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_acquire);
 
-        // Enable the current row to check the next one.
-        turnGPIOPinOn(keypadConfig->pins.keypad_rows[row]);
+    if (head == tail)
+    {
+        return false;
     }
 
-    return keysNowPressedCount;
+    *event = queue->events[tail % KEYPAD_EVENT_QUEUE_CAPACITY];
+
+    // Release, so the scan doesn't reuse the slot before we've copied the event.
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+
+    return true;
 }
 
-static void storeKeyPress(struct ConfigData *configData, const char key)
+static void handleKeypadEvents(struct ConfigData *configData)
 {
     // For readability.
-    struct PINState *currentPINState = &configData->keypadConfig.currentPINState;
-
-    // If the there's a led still on, turn it off when we get the first input.
-    turnLEDsOff(&configData->LEDConfigData);
+    struct KeypadConfig *keypadConfig = &configData->keypadConfig;
+    struct KeypadEventQueue *queue = &keypadConfig->eventQueue;
 
-    // Save the pressed key and record the time.
-    currentPINState->keyPresses[currentPINState->nextPressIndex] = key;
-    startTimeoutTimer(&configData->keypadConfig.currentPINState);
+    struct KeypadEvent event;
 
-    printf("Character %d / %d of PIN entered. Character %c. ", currentPINState->nextPressIndex + 1, 
-                                                               configData->keypadConfig.MAX_PIN_LENGTH, key);
-    printf("PIN: %s\n", currentPINState->keyPresses);
+    // Presses made while a clock event was being saved wait here, and are handled in order.
+    while (takeKeypadEvent(queue, &event))
+    {
+        if (event.pressed && event.alone)
+        {
+            handleKeyPress(configData, event.key);
+        }
+    }
 
-    currentPINState->nextPressIndex++;
+    unsigned long droppedCount = atomic_load_explicit(&queue->droppedCount, memory_order_relaxed);
 
-    // If the next key press index would be at the pin length, we just received the last key for the PIN (by length).
-    // Check the pin for validity and clear the saved pin.
-    if (currentPINState->nextPressIndex >= configData->keypadConfig.MAX_PIN_LENGTH)
+    if (droppedCount != keypadConfig->reportedDroppedCount)
     {
-        int userIDOfPIN = -1;
+        fprintf(stderr, "Keypad event queue was full, %lu key event(s) dropped. Deepest queue so far: %lu events.\n",
+                droppedCount - keypadConfig->reportedDroppedCount,
+                atomic_load_explicit(&queue->maxDepth, memory_order_relaxed));
+        keypadConfig->reportedDroppedCount = droppedCount;
+    }
+}
 
-        if (validPIN(configData->database, currentPINState->keyPresses, &userIDOfPIN))
-        {
-            int userPreviousStatus = -1;
-            bool previousStatusFound = selectUsersLatestLogStatus(configData->database, userIDOfPIN, &userPreviousStatus);
+static void updateKeypadStatus(struct KeypadConfig *keypadConfig)
+{
+    // For readability.
+    struct KeypadState *keypadState = &keypadConfig->keypadState;
 
-            // No previous status and IN -> ok.
-            // No previous status and OUT -> fail.
-            // Previous status and different -> ok.
-            // Previous status and same -> fail.
-            bool validAttempt = ((!previousStatusFound && currentPINState->status == LOG_STATUS_IN) ||
-                                  (previousStatusFound && currentPINState->status != userPreviousStatus));
+    // One time for the whole scan, it only takes microseconds.
+    int64_t sampleTime = getMonotonicTimeInNanoseconds();
+    keypadState->keysRead = loopThroughKeys(keypadConfig);
 
-            if (validAttempt)
-            {
-                printf("\nCORRECT PIN! - '%s' - User ID: %d \n\n", currentPINState->keyPresses, userIDOfPIN);
+    // A settled key that reads the same as before can't change, so usually there's nothing to debounce at all.
+    uint64_t keysToDebounce = (keypadState->keysRead ^ keypadState->keysDown) | keypadState->keysSettling;
 
-                turnLEDOn(&configData->LEDConfigData, false, true, false);      // Green light.
-                playSound(&configData->soundsConfig, SOUND_BEEP_SUCCESS);
+    keypadState->scanEventCount = 0;
 
-                insertLogRow(configData->database, userIDOfPIN, currentPINState->status);
-            }
+    // Lowest bit first, so the events are in row order like the scan.
+    while (keysToDebounce != 0)
+    {
+        int index = __builtin_ctzll(keysToDebounce);
+        uint64_t keyBit = (uint64_t)1 << index;
+        keysToDebounce &= keysToDebounce - 1;
 
-            // User is trying to log in or out twice in a row, or is trying to log out with no previous logs.
-            else
+        struct KeyDebounceState *keyState = &keypadState->keyStates[index];
+        int64_t eventTime;
+
+        enum KeyDebounceResult result = debounceKey(keyState, &keypadConfig->debounceTiming,
+                                                    (keypadState->keysRead & keyBit) != 0, sampleTime, &eventTime);
+
+        if (result != KEY_NO_CHANGE)
+        {
+            keypadState->keysDown ^= keyBit;
+            keypadState->scanEvents[keypadState->scanEventCount++] = (struct KeypadEvent)
             {
-                printf("\nCORRECT PIN, but REJECTED! - %s \n\n", currentPINState->keyPresses);
+                .key = keypadState->keys[index], .row = index / KEYPAD_MAX_COLUMNS, .column = index % KEYPAD_MAX_COLUMNS,
+                .pressed = result == KEY_PRESSED, .time = eventTime
+            };
+        }
 
-                turnLEDOn(&configData->LEDConfigData, true, false, false);      // Red light.
-                playSound(&configData->soundsConfig, SOUND_BEEP_ERROR);
-            }
+        if (isKeySettling(keyState))
+        {
+            keypadState->keysSettling |= keyBit;
         }
 
         else
         {
-            printf("\nPIN REJECTED! - %s \n\n", currentPINState->keyPresses);
-
-            turnLEDOn(&configData->LEDConfigData, true, false, false);      // Red light.
-            playSound(&configData->soundsConfig, SOUND_BEEP_ERROR);
+            keypadState->keysSettling &= ~keyBit;
         }
-
-        clearPIN(&configData->keypadConfig);
-        stopTimeoutTimer(currentPINState);
-        currentPINState->waitingForPINInput = false;
     }
 
-    else
-    {
-        playSound(&configData->soundsConfig, SOUND_BEEP_NORMAL);
-    }
+    keypadState->anyKeysPressed = keypadState->keysDown != 0;
+    keypadState->anyKeysSettling = keypadState->keysSettling != 0;
 }
 
-static void clearPIN(struct KeypadConfig *keypadConfig)
+static uint64_t loopThroughKeys(const struct KeypadConfig *keypadConfig)
 {
-    //currentPINState.lastKeyPressTime = EMPTY_TIMESTAMP;
-    keypadConfig->currentPINState.nextPressIndex = 0;
+    uint64_t keysRead = 0;
 
-    for (int pinIndex = 0; pinIndex < keypadConfig->MAX_PIN_LENGTH; pinIndex++)
+    // Every key is read, even when more than one is down, so every debounce state machine gets its sample.
+    // A row's keys are one byte of the mask.
+    for (int row = 0; row < keypadConfig->KEYPAD_ROWS; row++)
     {
-        keypadConfig->currentPINState.keyPresses[pinIndex] = EMPTY_KEY;
+        keysRead |= (uint64_t)readKeypadRow(keypadConfig, row) << KEYPAD_KEY_INDEX(row, 0);
     }
+
+    return keysRead;
 }
 
-static bool validPIN(sqlite3 **database, const char *pin_input, int *userIDPointer)
+static uint8_t readKeypadRow(const struct KeypadConfig *keypadConfig, const int row)
 {
-    if (selectUserIDByPIN(database, pin_input, userIDPointer))
-    {
-        return true;
-    }
+    // For readability.
+    const struct KeypadGPIOPins *pins = &keypadConfig->pins;
 
-    else
+    uint8_t columnsOn = 0;
+
+    if (pins->bankAccess)
     {
+        uint32_t rowBit = (uint32_t)1 << pins->keypad_rows[row];
+
+        // Disable the current row, read every column at once and enable the row again.
+        turnGPIOPinsOff(rowBit);
+        uint32_t columnPinsOn = getGPIOPinsOn(pins->columnMask);
+        turnGPIOPinsOn(rowBit);
+
+        // Usually no key in the row is pressed.
+        if (columnPinsOn == 0)
+        {
+            return 0;
+        }
+
+        for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
+        {
+            if (columnPinsOn & ((uint32_t)1 << pins->keypad_columns[column]))
+            {
+                columnsOn |= (uint8_t)(1 << column);
+            }
+        }
+
+        return columnsOn;
+    }
+
+    // Disable the current row to check if any key in this row is pressed.
+    turnGPIOPinOff(pins->keypad_rows[row]);
+
+    // Check every column pin to see if a key in this row is pressed.
+    for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
+    {
+        // Row off and column on means that they key in the intersection is pressed.
+        if (isGPIOPinOn(pins->keypad_columns[column]))
+        {
+            columnsOn |= (uint8_t)(1 << column);
+        }
+    }
+
+    // Enable the current row to check the next one.
+    turnGPIOPinOn(pins->keypad_rows[row]);
+
+    return columnsOn;
+}
+
+static void handleKeyPress(struct ConfigData *configData, const char key)
+{
+    // For readability.
+    struct KeypadConfig *keypadConfig = &configData->keypadConfig;
+    struct KeypadState *keypadState = &keypadConfig->keypadState;
+
+    // Clocking IN or OUT key was pressed previously, and we are ready to read the PIN code.
+    if (keypadConfig->currentPINState.waitingForPINInput)
+    {
+        storeKeyPress(configData, key);
+    }
+    
+    else if (key == keypadState->clockInKey || key == keypadState->clockOutKey)
+    {
+        if (key == keypadState->clockInKey)
+        {
+            keypadConfig->currentPINState.status = LOG_STATUS_IN;
+
+            printf("Waiting for clock IN.\n\n");
+        }
+
+        else if (key == keypadState->clockOutKey)
+        {
+            
+            keypadConfig->currentPINState.status = LOG_STATUS_OUT;
+            
+            printf("Waiting for clock OUT.\n\n");
+        }
+
+        keypadConfig->currentPINState.waitingForPINInput = true;
+        startTimeoutTimer(&configData->keypadConfig.currentPINState);
+    }
+}
+
+static void storeKeyPress(struct ConfigData *configData, const char key)
+{
+    // For readability.
+    struct PINState *currentPINState = &configData->keypadConfig.currentPINState;
+
+    // If the there's a led still on, turn it off when we get the first input.
+    turnLEDsOff(&configData->LEDConfigData);
+
+    // Save the pressed key and record the time.
+    currentPINState->keyPresses[currentPINState->nextPressIndex] = key;
+    startTimeoutTimer(&configData->keypadConfig.currentPINState);
+
+    printf("Character %d / %d of PIN entered. Character %c. ", currentPINState->nextPressIndex + 1, 
+                                                               configData->keypadConfig.MAX_PIN_LENGTH, key);
+    printf("PIN: %s\n", currentPINState->keyPresses);
+
+    currentPINState->nextPressIndex++;
+
+    // If the next key press index would be at the pin length, we just received the last key for the PIN (by length).
+    // Check the pin for validity and clear the saved pin.
+    if (currentPINState->nextPressIndex >= configData->keypadConfig.MAX_PIN_LENGTH)
+    {
+        struct ClockEventOutcome outcome;
+
+        processClockEvent(configData, currentPINState->keyPresses, currentPINState->status, &outcome);
+
+        switch (outcome.result)
+        {
+            case CLOCK_EVENT_ACCEPTED:
+                printf("\nCORRECT PIN! - '%s' - User ID: %d \n\n", currentPINState->keyPresses, outcome.userID);
+
+                turnLEDOn(&configData->LEDConfigData, false, true, false);      // Green light.
+                playSound(&configData->soundsConfig, SOUND_BEEP_SUCCESS);
+                break;
+
+            // User is trying to log in or out twice in a row, or is trying to log out with no previous logs.
+            case CLOCK_EVENT_INVALID_STATUS:
+                printf("\nCORRECT PIN, but REJECTED! - %s \n\n", currentPINState->keyPresses);
+
+                turnLEDOn(&configData->LEDConfigData, true, false, false);      // Red light.
+                playSound(&configData->soundsConfig, SOUND_BEEP_ERROR);
+                break;
+
+            case CLOCK_EVENT_INVALID_PIN:
+                printf("\nPIN REJECTED! - %s \n\n", currentPINState->keyPresses);
+
+                turnLEDOn(&configData->LEDConfigData, true, false, false);      // Red light.
+                playSound(&configData->soundsConfig, SOUND_BEEP_ERROR);
+                break;
+
+            case CLOCK_EVENT_DATABASE_ERROR:
+            default:
+                printf("\nDATABASE ERROR, clock event not saved! - %s \n\n", currentPINState->keyPresses);
+
+                turnLEDOn(&configData->LEDConfigData, true, false, false);      // Red light.
+                playSound(&configData->soundsConfig, SOUND_BEEP_ERROR);
+                break;
+        }
+
+        clearPIN(&configData->keypadConfig);
+        stopTimeoutTimer(currentPINState);
+        currentPINState->waitingForPINInput = false;
+    }
+
+    else
+    {
+        playSound(&configData->soundsConfig, SOUND_BEEP_NORMAL);
+    }
+}
+
+static void clearPIN(struct KeypadConfig *keypadConfig)
+{
+    //currentPINState.lastKeyPressTime = EMPTY_TIMESTAMP;
+    keypadConfig->currentPINState.nextPressIndex = 0;
+
+    for (int pinIndex = 0; pinIndex < keypadConfig->MAX_PIN_LENGTH; pinIndex++)
+    {
+        keypadConfig->currentPINState.keyPresses[pinIndex] = EMPTY_KEY;
+    }
+}
+
+static void processClockEvent(struct ConfigData *configData, const char *pin, const int requestedStatus,
+                              struct ClockEventOutcome *outcome)
+{
+    // For readability.
+    struct DatabaseConfig *databaseConfig = &configData->databaseConfig;
+    struct LogWriterConfig *logWriterConfig = &configData->logWriterConfig;
+    struct SpoolConfig *spoolConfig = &configData->spoolConfig;
+
+    // The row gets the time the PIN was entered, however long saving it takes.
+    int64_t timestamp = getCurrentTimeInMicroseconds();
+    // Older events are still waiting in the spool, saving this one first would put them out of order.
+    bool spooling = hasSpooledEvents(spoolConfig);
+
+    if (logWriterConfig->running || spooling)
+    {
+        if (!checkClockEvent(configData, pin, requestedStatus, outcome))
+        {
+            return;
+        }
+
+        // The writer thread spools the events itself while the spool isn't empty, after the ones already queued.
+        if (logWriterConfig->running ? queueLogRow(logWriterConfig, outcome->userID, requestedStatus, timestamp)
+                                     : appendSpoolEvent(spoolConfig, outcome->userID, requestedStatus, timestamp))
+        {
+            outcome->result = CLOCK_EVENT_ACCEPTED;
+
+            return;
+        }
+
+        // Saving right away would put the event before the ones waiting in the queue or in the spool.
+        if (spooling)
+        {
+            outcome->result = CLOCK_EVENT_DATABASE_ERROR;
+
+            return;
+        }
+    }
+
+    // The writer thread isn't running or its queue is full, so check and save the event right away.
+    if (recordClockEvent(databaseConfig, pin, requestedStatus, timestamp, outcome))
+    {
+        appendJournalRecord(&configData->journalConfig, outcome->logID, outcome->userID, requestedStatus, timestamp);
+
+        return;
+    }
+
+    // The database failed, so the event is spooled and saved once it works again.
+    if (outcome->result == CLOCK_EVENT_DATABASE_ERROR && checkClockEvent(configData, pin, requestedStatus, outcome) &&
+        appendSpoolEvent(spoolConfig, outcome->userID, requestedStatus, timestamp))
+    {
+        outcome->result = CLOCK_EVENT_ACCEPTED;
+    }
+}
+
+static bool checkClockEvent(struct ConfigData *configData, const char *pin, const int requestedStatus,
+                            struct ClockEventOutcome *outcome)
+{
+    // For readability.
+    struct DatabaseConfig *databaseConfig = &configData->databaseConfig;
+
+    outcome->userID = -1;
+    outcome->previousStatus = LOG_STATUS_ERROR;
+    outcome->logID = 0;
+
+    if (!selectUserIDByPIN(databaseConfig, pin, &outcome->userID))
+    {
+        outcome->result = CLOCK_EVENT_INVALID_PIN;
+
         return false;
     }
+
+    bool previousStatusFound =
+        selectQueuedLogStatus(&configData->logWriterConfig, outcome->userID, &outcome->previousStatus) ||
+        selectSpooledLogStatus(&configData->spoolConfig, outcome->userID, &outcome->previousStatus);
+
+    // Without a status the event can't be checked, and guessing "never clocked in" would let the wrong event through.
+    if (!previousStatusFound &&
+        !selectUsersLatestLogStatus(databaseConfig, outcome->userID, &outcome->previousStatus, &previousStatusFound))
+    {
+        outcome->result = CLOCK_EVENT_DATABASE_ERROR;
+
+        return false;
+    }
+
+    if (!isValidStatusChange(previousStatusFound, outcome->previousStatus, requestedStatus))
+    {
+        outcome->result = CLOCK_EVENT_INVALID_STATUS;
+
+        return false;
+    }
+
+    return true;
 }
 
 static void startTimeoutTimer(struct PINState *currentPINState)
@@ -423,6 +978,401 @@ static bool enoughTimeSinceLastKeypadUpdate(const double lastUpdateTime, const d
     }
 }
 
+static void setKeypadRows(const struct KeypadConfig *keypadConfig, const bool on)
+{
+    if (keypadConfig->pins.bankAccess)
+    {
+        if (on)
+        {
+            turnGPIOPinsOn(keypadConfig->pins.rowMask);
+        }
+
+        else
+        {
+            turnGPIOPinsOff(keypadConfig->pins.rowMask);
+        }
+
+        return;
+    }
+
+    for (int row = 0; row < keypadConfig->KEYPAD_ROWS; row++)
+    {
+        if (on)
+        {
+            turnGPIOPinOn(keypadConfig->pins.keypad_rows[row]);
+        }
+
+        else
+        {
+            turnGPIOPinOff(keypadConfig->pins.keypad_rows[row]);
+        }
+    }
+}
+
+static bool isAnyKeypadColumnOn(const struct KeypadConfig *keypadConfig)
+{
+    if (keypadConfig->pins.bankAccess)
+    {
+        return getGPIOPinsOn(keypadConfig->pins.columnMask) != 0;
+    }
+
+    for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
+    {
+        if (isGPIOPinOn(keypadConfig->pins.keypad_columns[column]))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void keypadEdgeAlert(int pinNumber, int level, uint32_t tick, void *data)
+{
+    (void)pinNumber;
+
+    struct KeypadEdgeState *edgeState = (struct KeypadEdgeState *)data;
+
+    // Watchdog timeouts aren't level changes.
+    if (level != 0 && level != 1)
+    {
+        return;
+    }
+
+    // Alerts arrive a little late, so the scan window is checked by the tick of the change, not by the time of the call.
+    // Unsigned differences keep working when the tick wraps around.
+    uint32_t sinceScanStart = tick - atomic_load(&edgeState->scanStartTick);
+    bool afterScanStart = sinceScanStart < UINT32_MAX / 2;
+
+    if (afterScanStart && (atomic_load(&edgeState->scanning) ||
+                           sinceScanStart <= atomic_load(&edgeState->scanEndTick) - atomic_load(&edgeState->scanStartTick)))
+    {
+        return;
+    }
+
+    signalKeypadEdge(edgeState);
+}
+
+static void signalKeypadEdge(struct KeypadEdgeState *edgeState)
+{
+    // One wakeup per pending edge, so a bouncing key doesn't pile up posts.
+    if (!atomic_exchange(&edgeState->edgePending, true))
+    {
+        sem_post(&edgeState->wakeup);
+    }
+}
+
+static void beginEdgeScan(struct KeypadConfig *keypadConfig)
+{
+    atomic_store(&keypadConfig->edgeState.scanStartTick, getGPIOTick());
+    atomic_store(&keypadConfig->edgeState.scanning, true);
+
+    // loopThroughKeys() turns off one row at a time, the others have to be on.
+    setKeypadRows(keypadConfig, true);
+}
+
+static void endEdgeScan(struct KeypadConfig *keypadConfig)
+{
+    setKeypadRows(keypadConfig, false);
+
+    atomic_store(&keypadConfig->edgeState.scanEndTick, getGPIOTick());
+    atomic_store(&keypadConfig->edgeState.scanning, false);
+
+    // Keys that are down or settling are polled anyway. Edges after this read are no longer ignored.
+    if (!keypadConfig->keypadState.anyKeysPressed && !keypadConfig->keypadState.anyKeysSettling &&
+        isAnyKeypadColumnOn(keypadConfig))
+    {
+        signalKeypadEdge(&keypadConfig->edgeState);
+    }
+}
+
+static bool startEdgeAlerts(struct KeypadConfig *keypadConfig)
+{
+    // For readability.
+    struct KeypadEdgeState *edgeState = &keypadConfig->edgeState;
+
+    edgeState->running = false;
+
+    if (!keypadConfig->EDGE_TRIGGERED)
+    {
+        return false;
+    }
+
+    if (sem_init(&edgeState->wakeup, 0, 0) != 0)
+    {
+        fprintf(stderr, "Could not create the keypad wakeup semaphore, polling the keypad.\n");
+
+        return false;
+    }
+
+    uint32_t tick = getGPIOTick();
+    atomic_init(&edgeState->edgePending, false);
+    atomic_init(&edgeState->scanning, false);
+    atomic_init(&edgeState->scanStartTick, tick);
+    atomic_init(&edgeState->scanEndTick, tick);
+
+    setKeypadRows(keypadConfig, false);
+
+    for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
+    {
+        if (!setGPIOPinAlert(keypadConfig->pins.keypad_columns[column], keypadEdgeAlert, edgeState))
+        {
+            fprintf(stderr, "Could not register an edge alert for GPIO %d, polling the keypad.\n",
+                    keypadConfig->pins.keypad_columns[column]);
+
+            for (int registered = 0; registered < column; registered++)
+            {
+                setGPIOPinAlert(keypadConfig->pins.keypad_columns[registered], NULL, NULL);
+            }
+
+            setKeypadRows(keypadConfig, true);
+            sem_destroy(&edgeState->wakeup);
+
+            return false;
+        }
+    }
+
+    edgeState->running = true;
+
+    // A key may already be down, its edge came before the alerts were registered.
+    if (isAnyKeypadColumnOn(keypadConfig))
+    {
+        signalKeypadEdge(edgeState);
+    }
+
+    printf("Keypad is scanned on edges.\n");
+
+    return true;
+}
+
+static void stopEdgeAlerts(struct KeypadConfig *keypadConfig)
+{
+    if (!keypadConfig->edgeState.running)
+    {
+        return;
+    }
+
+    for (int column = 0; column < keypadConfig->KEYPAD_COLUMNS; column++)
+    {
+        setGPIOPinAlert(keypadConfig->pins.keypad_columns[column], NULL, NULL);
+    }
+
+    keypadConfig->edgeState.running = false;
+    sem_destroy(&keypadConfig->edgeState.wakeup);
+}
+
+static void *scanThread(void *argument)
+{
+    struct KeypadConfig *keypadConfig = (struct KeypadConfig *)argument;
+    struct KeypadState *keypadState = &keypadConfig->keypadState;
+    struct KeypadEdgeState *edgeState = &keypadConfig->edgeState;
+    struct KeypadScanThread *scanThread = &keypadConfig->scanThread;
+
+    int64_t interval = (int64_t)(keypadConfig->UPDATE_INTERVAL_SECONDS * 1e9);
+    interval = interval < KEYPAD_MIN_SCAN_INTERVAL_NANOSECONDS ? KEYPAD_MIN_SCAN_INTERVAL_NANOSECONDS : interval;
+
+    int64_t deadline = getMonotonicTimeInNanoseconds();
+
+    while (!atomic_load(&scanThread->stopRequested))
+    {
+        // Nothing to poll, sleep in the kernel until a key changes a column.
+        if (edgeState->running && !keypadState->anyKeysPressed && !keypadState->anyKeysSettling)
+        {
+            if (!atomic_exchange(&edgeState->edgePending, false))
+            {
+                waitForSemaphore(&edgeState->wakeup, KEYPAD_SCAN_THREAD_STOP_CHECK_SECONDS);
+
+                continue;
+            }
+
+            // The schedule starts again from the edge.
+            deadline = getMonotonicTimeInNanoseconds();
+        }
+
+        else
+        {
+            // Absolute deadlines, so the time the scan takes doesn't add up over the scans.
+            deadline += interval;
+
+            struct timespec wakeupTime = { .tv_sec = deadline / 1000000000, .tv_nsec = deadline % 1000000000 };
+
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeupTime, NULL) == EINTR)
+            {
+                // Interrupted by a signal, keep sleeping until the deadline.
+            }
+
+            int64_t jitter = getMonotonicTimeInNanoseconds() - deadline;
+            bool late = jitter >= interval;
+
+            recordScanJitter(&scanThread->statistics, jitter, late);
+
+            // Skipped scans aren't made up for, the schedule continues from now.
+            if (late)
+            {
+                deadline += (jitter / interval) * interval;
+            }
+
+            // An edge during a poll was caused by the scan or is seen by the next one.
+            if (edgeState->running)
+            {
+                atomic_store(&edgeState->edgePending, false);
+            }
+        }
+
+        unsigned long head = atomic_load_explicit(&keypadConfig->eventQueue.head, memory_order_relaxed);
+
+        scanKeypad(keypadConfig);
+
+        if (atomic_load_explicit(&keypadConfig->eventQueue.head, memory_order_relaxed) != head)
+        {
+            sem_post(&scanThread->eventsQueued);
+        }
+    }
+
+    return NULL;
+}
+
+static void recordScanJitter(struct KeypadScanStatistics *statistics, const int64_t jitterNanoseconds, const bool late)
+{
+    // Only this thread writes the statistics, the main loop only reads them.
+    unsigned long long jitter = jitterNanoseconds > 0 ? (unsigned long long)jitterNanoseconds : 0;
+
+    atomic_fetch_add_explicit(&statistics->scheduledScanCount, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&statistics->totalJitterNanoseconds, jitter, memory_order_relaxed);
+
+    if (jitter > atomic_load_explicit(&statistics->maxJitterNanoseconds, memory_order_relaxed))
+    {
+        atomic_store_explicit(&statistics->maxJitterNanoseconds, jitter, memory_order_relaxed);
+    }
+
+    if (late)
+    {
+        atomic_fetch_add_explicit(&statistics->lateCount, 1, memory_order_relaxed);
+    }
+}
+
+static bool startScanThread(struct KeypadConfig *keypadConfig)
+{
+    // For readability.
+    struct KeypadScanThread *scanThread = &keypadConfig->scanThread;
+
+    scanThread->running = false;
+    scanThread->reportedLateCount = 0;
+    atomic_init(&scanThread->stopRequested, false);
+    atomic_init(&scanThread->statistics.scheduledScanCount, 0);
+    atomic_init(&scanThread->statistics.lateCount, 0);
+    atomic_init(&scanThread->statistics.totalJitterNanoseconds, 0);
+    atomic_init(&scanThread->statistics.maxJitterNanoseconds, 0);
+
+    if (!keypadConfig->SCAN_THREAD)
+    {
+        return false;
+    }
+
+    if (sem_init(&scanThread->eventsQueued, 0, 0) != 0)
+    {
+        fprintf(stderr, "Could not create the keypad event semaphore, the main loop scans the keypad.\n");
+
+        return false;
+    }
+
+    bool realTime = keypadConfig->SCAN_THREAD_PRIORITY > 0;
+    int result = createScanThread(keypadConfig, realTime);
+
+    // Real-time priority needs root or CAP_SYS_NICE. Scanning in a thread still helps without it.
+    if (result == EPERM && realTime)
+    {
+        fprintf(stderr, "Not allowed to use real-time priority, the keypad scan thread runs at normal priority.\n");
+        realTime = false;
+        result = createScanThread(keypadConfig, realTime);
+    }
+
+    if (result != 0)
+    {
+        fprintf(stderr, "Could not start the keypad scan thread (error %d), the main loop scans the keypad.\n", result);
+        sem_destroy(&scanThread->eventsQueued);
+
+        return false;
+    }
+
+    scanThread->running = true;
+
+    printf("Keypad is scanned by its own thread%s.\n", realTime ? " at real-time priority" : "");
+
+    return true;
+}
+
+static int createScanThread(struct KeypadConfig *keypadConfig, const bool realTime)
+{
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+
+    if (realTime)
+    {
+        struct sched_param parameters = { .sched_priority = keypadConfig->SCAN_THREAD_PRIORITY };
+
+        // Without PTHREAD_EXPLICIT_SCHED the thread would inherit the main thread's scheduling instead.
+        pthread_attr_setinheritsched(&attributes, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attributes, SCHED_FIFO);
+        pthread_attr_setschedparam(&attributes, &parameters);
+    }
+
+    if (keypadConfig->SCAN_THREAD_CPU >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(keypadConfig->SCAN_THREAD_CPU, &cpus);
+
+        pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+    }
+
+    int result = pthread_create(&keypadConfig->scanThread.thread, &attributes, scanThread, keypadConfig);
+
+    pthread_attr_destroy(&attributes);
+
+    return result;
+}
+
+static void stopScanThread(struct KeypadConfig *keypadConfig)
+{
+    // For readability.
+    struct KeypadScanThread *scanThread = &keypadConfig->scanThread;
+    struct KeypadScanStatistics *statistics = &scanThread->statistics;
+
+    if (!scanThread->running)
+    {
+        return;
+    }
+
+    atomic_store(&scanThread->stopRequested, true);
+    pthread_join(scanThread->thread, NULL);
+    scanThread->running = false;
+    sem_destroy(&scanThread->eventsQueued);
+
+    unsigned long scanCount = atomic_load(&statistics->scheduledScanCount);
+
+    if (scanCount > 0)
+    {
+        printf("Keypad scan thread: %lu scheduled scans, jitter mean %llu us, max %llu us, %lu late.\n", scanCount,
+               atomic_load(&statistics->totalJitterNanoseconds) / scanCount / 1000,
+               atomic_load(&statistics->maxJitterNanoseconds) / 1000, atomic_load(&statistics->lateCount));
+    }
+}
+
+static void waitForSemaphore(sem_t *semaphore, const double seconds)
+{
+    // sem_timedwait() only takes a wall clock deadline.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    long long nanoseconds = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += nanoseconds / 1000000000;
+    deadline.tv_nsec = nanoseconds % 1000000000;
+
+    // Returns when posted, at the deadline, or when interrupted by CTRL-C.
+    sem_timedwait(semaphore, &deadline);
+}
+
 
 
 void initializeKeypad(struct KeypadConfig *keypadConfig)
@@ -442,7 +1392,8 @@ void initializeKeypad(struct KeypadConfig *keypadConfig)
     stopTimeoutTimer(&keypadConfig->currentPINState);
 
     // Initializes the array holding the characters used in the current PIN.
-    keypadConfig->currentPINState.keyPresses = calloc(keypadConfig->MAX_PIN_LENGTH, sizeof(char));
+    // One extra character for the null terminator, the PIN is used as a string.
+    keypadConfig->currentPINState.keyPresses = calloc(keypadConfig->MAX_PIN_LENGTH + 1, sizeof(char));
 
     if (keypadConfig->currentPINState.keyPresses == NULL) 
     {
@@ -458,42 +1409,39 @@ void initializeKeypad(struct KeypadConfig *keypadConfig)
     // KeypadState //
     /////////////////
 
-    keypadConfig->keypadState.keysPressedPreviously = calloc(keypadConfig->KEYPAD_ROWS, sizeof(bool*));
-    keypadConfig->keypadState.noKeysPressedPreviously = false;
-    keypadConfig->keypadState.keyPressed = EMPTY_KEY;
-    keypadConfig->keypadState.exactlyOneKeyPressed = false;
+    // Initializes all keys as released.
+    memset(keypadConfig->keypadState.keyStates, 0, sizeof(keypadConfig->keypadState.keyStates));
+    keypadConfig->keypadState.keysRead = 0;
+    keypadConfig->keypadState.keysDown = 0;
+    keypadConfig->keypadState.keysSettling = 0;
+    keypadConfig->keypadState.scanEventCount = 0;
     keypadConfig->keypadState.anyKeysPressed = false;
+    keypadConfig->keypadState.anyKeysSettling = false;
     keypadConfig->keypadState.lastUpdateTime = getCurrentTimeInSeconds();
 
-    for (int index = 0; index < keypadConfig->KEYPAD_ROWS; index++) 
-    {
-        // Initializes all pressed states to 0 (false).
-        keypadConfig->keypadState.keysPressedPreviously[index] = calloc(keypadConfig->KEYPAD_COLUMNS, sizeof(bool));
+    keypadConfig->debounceTiming.pressNanoseconds = (int64_t)keypadConfig->DEBOUNCE_PRESS_MILLISECONDS * 1000000;
+    keypadConfig->debounceTiming.releaseNanoseconds = (int64_t)keypadConfig->DEBOUNCE_RELEASE_MILLISECONDS * 1000000;
 
-        if (keypadConfig->keypadState.keysPressedPreviously[index] == NULL) 
-        {
-            printf("\nERROR: Memory allocation failure in keypad.c, initializeKeyboard(), keypadState.keysPressedPreviously[%d]!\n", index);
-        }
-    }
+    atomic_init(&keypadConfig->eventQueue.head, 0);
+    atomic_init(&keypadConfig->eventQueue.tail, 0);
+    atomic_init(&keypadConfig->eventQueue.droppedCount, 0);
+    atomic_init(&keypadConfig->eventQueue.maxDepth, 0);
+    keypadConfig->reportedDroppedCount = 0;
+
+    startEdgeAlerts(keypadConfig);
+    // After the edge alerts, the thread checks whether they're running.
+    startScanThread(keypadConfig);
 }
 
 void cleanupKeypad(struct KeypadConfig *keypadConfig)
 {
+    // Before anything it uses is freed.
+    stopScanThread(keypadConfig);
+
     free(keypadConfig->currentPINState.keyPresses);
     keypadConfig->currentPINState.keyPresses = NULL;
 
-    for (int index = 0; index < keypadConfig->KEYPAD_ROWS; index++)
-    {
-        free(keypadConfig->keypadState.keys[index]);
-        free(keypadConfig->keypadState.keysPressedPreviously[index]);
-        keypadConfig->keypadState.keys[index] = NULL;
-        keypadConfig->keypadState.keysPressedPreviously[index] = NULL;
-    }
-
-    free(keypadConfig->keypadState.keys);
-    free(keypadConfig->keypadState.keysPressedPreviously);
-    keypadConfig->keypadState.keys = NULL;
-    keypadConfig->keypadState.keysPressedPreviously = NULL;
-
+    // Before the pins are reset, so the reset doesn't trigger alerts.
+    stopEdgeAlerts(keypadConfig);
     cleanupKeypadGPIOPins(keypadConfig);
 }
@@ -0,0 +1,102 @@
+/**
+ * @file keypad_debounce.c
+ * @author Selkamies
+ *
+ * @brief Per-key debouncing, so a bouncing switch gives one press and one release.
+ * A key has to read the same for the whole debounce time before its state changes.
+ *
+ * Each key is a four-state machine. A reading that differs from the debounced state starts a pending
+ * phase, and a reading that agrees with it again cancels the pending phase. The change is only accepted
+ * once the key has read the new state for the whole debounce time, and the event gets the time of the
+ * first reading, so debouncing doesn't delay the timestamps.
+ *
+ * @date Created  2024-01-23
+ * @date Modified 2024-01-23
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+
+#include "keypad_debounce.h"
+
+
+
+enum KeyDebounceResult debounceKey(struct KeyDebounceState *state, const struct KeyDebounceTiming *timing,
+                                   const bool readPressed, const int64_t sampleTime, int64_t *eventTime)
+{
+    switch (state->phase)
+    {
+        case KEY_PHASE_UP:
+            if (!readPressed)
+            {
+                return KEY_NO_CHANGE;
+            }
+
+            state->phase = KEY_PHASE_PRESS_PENDING;
+            state->changeTime = sampleTime;
+            // The press may already be long enough, if debouncing is disabled.
+            // fall through
+
+        case KEY_PHASE_PRESS_PENDING:
+            if (!readPressed)
+            {
+                // A bounce.
+                state->phase = KEY_PHASE_UP;
+
+                return KEY_NO_CHANGE;
+            }
+
+            if (sampleTime - state->changeTime < timing->pressNanoseconds)
+            {
+                return KEY_NO_CHANGE;
+            }
+
+            state->phase = KEY_PHASE_DOWN;
+            *eventTime = state->changeTime;
+
+            return KEY_PRESSED;
+
+        case KEY_PHASE_DOWN:
+            if (readPressed)
+            {
+                return KEY_NO_CHANGE;
+            }
+
+            state->phase = KEY_PHASE_RELEASE_PENDING;
+            state->changeTime = sampleTime;
+            // fall through
+
+        case KEY_PHASE_RELEASE_PENDING:
+        default:
+            if (readPressed)
+            {
+                state->phase = KEY_PHASE_DOWN;
+
+                return KEY_NO_CHANGE;
+            }
+
+            if (sampleTime - state->changeTime < timing->releaseNanoseconds)
+            {
+                return KEY_NO_CHANGE;
+            }
+
+            state->phase = KEY_PHASE_UP;
+            *eventTime = state->changeTime;
+
+            return KEY_RELEASED;
+    }
+}
+
+bool isKeyDown(const struct KeyDebounceState *state)
+{
+    return state->phase == KEY_PHASE_DOWN || state->phase == KEY_PHASE_RELEASE_PENDING;
+}
+
+bool isKeySettling(const struct KeyDebounceState *state)
+{
+    return state->phase == KEY_PHASE_PRESS_PENDING || state->phase == KEY_PHASE_RELEASE_PENDING;
+}
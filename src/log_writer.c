@@ -0,0 +1,431 @@
+/**
+ * @file log_writer.c
+ * @author Selkamies
+ *
+ * @brief Saves log rows in a separate thread, so the keypad, LEDs and sounds never wait for
+ * the database to write to the SD card.
+ *
+ * The main loop queues clock events to a lock-free ring buffer and the writer thread saves them
+ * with its own database connection. Each event's status check is repeated inside the writer's
+ * BEGIN IMMEDIATE transaction, so a status changed by another terminal meanwhile is caught.
+ * Events that pile up while a commit is being written are saved together in the next transaction,
+ * so a burst of users costs one disk flush instead of one per user.
+ * Committed rows are appended to the clock event journal, if it's enabled, by this thread too.
+ * Events that still can't be saved after a few attempts go to the spool, and so do the events after them
+ * until the spool has saved them all, so events are always saved in the order they happened.
+ *
+ * @date Created  2024-01-03
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
+#include <stdatomic.h>          // atomic_load_explicit(), atomic_store_explicit(), etc.
+#include <pthread.h>            // pthread_create(), pthread_join().
+#include <semaphore.h>          // sem_init(), sem_post(), sem_wait(), sem_destroy().
+#include <time.h>               // nanosleep().
+
+#include "log_writer.h"
+#include "log_writer_config.h"  // struct LogWriterConfig, struct LogWriterQueue, struct ClockEvent.
+#include "database.h"           // openDatabaseConnection(), recordUsersClockEvent(), beginTransaction(), etc.
+#include "journal.h"            // appendJournalRecord().
+#include "spool.h"              // appendSpoolEvent(), hasSpooledEvents().
+
+
+
+/** @brief Most events saved in one transaction. Keeps a single transaction from holding the write lock for long. */
+#define LOG_WRITER_MAX_BATCH 16
+/** @brief How many times a batch is tried before its events are spooled. */
+#define LOG_WRITER_MAX_ATTEMPTS 5
+/** @brief Wait before retrying a failed batch. Grows with every attempt. */
+#define LOG_WRITER_RETRY_DELAY_MILLISECONDS 100
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief The writer thread. Sleeps until events are queued and saves them until asked to stop.
+ *
+ * @param argument Pointer to struct LogWriterConfig.
+ *
+ * @return void* Always NULL.
+ */
+static void *writerThread(void *argument);
+
+/**
+ * @brief Saves the next batch of queued events, retrying a few times if the database is busy.
+ * Spools the batch if it still can't be saved.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ *
+ * @return true If there were events in the queue.
+ * @return false If the queue was empty.
+ */
+static bool saveQueuedRows(struct LogWriterConfig *logWriterConfig);
+
+/**
+ * @brief Saves events in one transaction.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ * @param firstSequence Sequence number of the first event to save.
+ * @param count Number of events to save.
+ * @param rejectedCount Pointer to the number of events rejected by the status check. Set when the transaction is committed.
+ *
+ * @return true If the transaction was committed.
+ * @return false If something went wrong. The transaction is rolled back.
+ */
+static bool saveBatch(struct LogWriterConfig *logWriterConfig, const unsigned long firstSequence, const unsigned long count,
+                      unsigned long *rejectedCount);
+
+/**
+ * @brief Spools events that can't be saved to the database now.
+ *
+ * @param logWriterConfig Struct holding all the variables needed by log_writer.c.
+ * @param firstSequence Sequence number of the first event to spool.
+ * @param count Number of events to spool.
+ *
+ * @return unsigned long Number of events that didn't fit in the spool, or all of them if the spool is disabled.
+ */
+static unsigned long spoolBatch(struct LogWriterConfig *logWriterConfig, const unsigned long firstSequence,
+                                const unsigned long count);
+
+/**
+ * @brief Sleeps for a number of milliseconds.
+ *
+ * @param milliseconds How long to sleep.
+ */
+static void sleepMilliseconds(const long milliseconds);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+bool initializeLogWriter(struct LogWriterConfig *logWriterConfig, const char *const filePath,
+                         struct JournalConfig *journalConfig, struct SpoolConfig *spoolConfig)
+{
+    printf("Initializing log writer.\n");
+
+    logWriterConfig->running = false;
+    logWriterConfig->journalConfig = journalConfig;
+    logWriterConfig->spoolConfig = spoolConfig;
+    atomic_init(&logWriterConfig->queue.head, 0);
+    atomic_init(&logWriterConfig->queue.tail, 0);
+    atomic_init(&logWriterConfig->status.savedCount, 0);
+    atomic_init(&logWriterConfig->status.failedCount, 0);
+    atomic_init(&logWriterConfig->status.rejectedCount, 0);
+    atomic_init(&logWriterConfig->stopRequested, false);
+    logWriterConfig->reportedSavedCount = 0;
+    logWriterConfig->reportedFailedCount = 0;
+    logWriterConfig->reportedRejectedCount = 0;
+    logWriterConfig->queueFullCount = 0;
+
+    if (!openDatabaseConnection(&logWriterConfig->databaseConfig, filePath))
+    {
+        fprintf(stderr, "Log writer could not open the database, log rows are saved by the main loop.\n");
+
+        return false;
+    }
+
+    if (sem_init(&logWriterConfig->wakeup, 0, 0) != 0)
+    {
+        cleanupDatabase(&logWriterConfig->databaseConfig);
+
+        return false;
+    }
+
+    if (pthread_create(&logWriterConfig->thread, NULL, writerThread, logWriterConfig) != 0)
+    {
+        fprintf(stderr, "Could not start the log writer thread, log rows are saved by the main loop.\n");
+        sem_destroy(&logWriterConfig->wakeup);
+        cleanupDatabase(&logWriterConfig->databaseConfig);
+
+        return false;
+    }
+
+    logWriterConfig->running = true;
+
+    return true;
+}
+
+bool queueLogRow(struct LogWriterConfig *logWriterConfig, const int userID, const int status, const int64_t timestamp)
+{
+    if (!logWriterConfig->running)
+    {
+        return false;
+    }
+
+    // For readability.
+    struct LogWriterQueue *queue = &logWriterConfig->queue;
+
+    // Only this thread writes head. Acquire on tail, so the writer thread is done with the slot we're about to reuse.
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail >= LOG_WRITER_QUEUE_CAPACITY)
+    {
+        logWriterConfig->queueFullCount++;
+        fprintf(stderr, "Log writer queue is full (%lu times so far), saving the log row directly.\n",
+                logWriterConfig->queueFullCount);
+
+        return false;
+    }
+
+    queue->events[head % LOG_WRITER_QUEUE_CAPACITY] = (struct ClockEvent){ .userID = userID, .status = status, .timestamp = timestamp };
+
+    // Release, so the writer thread sees the event before it sees the new head.
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    sem_post(&logWriterConfig->wakeup);
+
+    return true;
+}
+
+bool selectQueuedLogStatus(struct LogWriterConfig *logWriterConfig, const int userID, int *status)
+{
+    if (!logWriterConfig->running)
+    {
+        return false;
+    }
+
+    // For readability.
+    struct LogWriterQueue *queue = &logWriterConfig->queue;
+
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    // Newest first. Events the writer thread saves meanwhile are still intact, only this thread overwrites slots.
+    // An event saved before we read tail is already in the database, where the caller looks next.
+    for (unsigned long sequence = head; sequence > tail; sequence--)
+    {
+        const struct ClockEvent *event = &queue->events[(sequence - 1) % LOG_WRITER_QUEUE_CAPACITY];
+
+        if (event->userID == userID)
+        {
+            *status = event->status;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void updateLogWriter(struct LogWriterConfig *logWriterConfig)
+{
+    if (!logWriterConfig->running)
+    {
+        return;
+    }
+
+    unsigned long savedCount = atomic_load_explicit(&logWriterConfig->status.savedCount, memory_order_relaxed);
+    unsigned long failedCount = atomic_load_explicit(&logWriterConfig->status.failedCount, memory_order_relaxed);
+    unsigned long rejectedCount = atomic_load_explicit(&logWriterConfig->status.rejectedCount, memory_order_relaxed);
+
+    if (savedCount != logWriterConfig->reportedSavedCount)
+    {
+        printf("%lu log row(s) saved to the database.\n", savedCount - logWriterConfig->reportedSavedCount);
+        logWriterConfig->reportedSavedCount = savedCount;
+    }
+
+    if (failedCount != logWriterConfig->reportedFailedCount)
+    {
+        fprintf(stderr, "ERROR: %lu log row(s) could not be saved to the database!\n",
+                failedCount - logWriterConfig->reportedFailedCount);
+        logWriterConfig->reportedFailedCount = failedCount;
+    }
+
+    if (rejectedCount != logWriterConfig->reportedRejectedCount)
+    {
+        fprintf(stderr, "%lu clock event(s) not saved, the user's status had already changed in the database.\n",
+                rejectedCount - logWriterConfig->reportedRejectedCount);
+        logWriterConfig->reportedRejectedCount = rejectedCount;
+    }
+}
+
+void cleanupLogWriter(struct LogWriterConfig *logWriterConfig)
+{
+    if (!logWriterConfig->running)
+    {
+        return;
+    }
+
+    printf("Stopping log writer.\n");
+
+    atomic_store(&logWriterConfig->stopRequested, true);
+    sem_post(&logWriterConfig->wakeup);
+    pthread_join(logWriterConfig->thread, NULL);
+
+    // Report the rows saved during shutdown.
+    updateLogWriter(logWriterConfig);
+
+    sem_destroy(&logWriterConfig->wakeup);
+    cleanupDatabase(&logWriterConfig->databaseConfig);
+    logWriterConfig->running = false;
+}
+
+
+
+static void *writerThread(void *argument)
+{
+    struct LogWriterConfig *logWriterConfig = (struct LogWriterConfig *)argument;
+
+    while (true)
+    {
+        // Also returns early on signals, which is harmless, the queue is just checked again.
+        sem_wait(&logWriterConfig->wakeup);
+
+        while (saveQueuedRows(logWriterConfig))
+        {
+            // Keep saving until the queue is empty.
+        }
+
+        // The main loop has stopped queueing before asking us to stop, so the queue is empty for good.
+        if (atomic_load(&logWriterConfig->stopRequested))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static bool saveQueuedRows(struct LogWriterConfig *logWriterConfig)
+{
+    // For readability.
+    struct LogWriterQueue *queue = &logWriterConfig->queue;
+
+    // Only this thread writes tail. Acquire on head, so we see the events the main loop queued before it.
+    unsigned long tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (head == tail)
+    {
+        return false;
+    }
+
+    unsigned long count = head - tail;
+
+    if (count > LOG_WRITER_MAX_BATCH)
+    {
+        count = LOG_WRITER_MAX_BATCH;
+    }
+
+    bool saved = false;
+    unsigned long rejectedCount = 0;
+    // Saving these before the older events still in the spool would put them out of order.
+    int attempts = hasSpooledEvents(logWriterConfig->spoolConfig) ? 0 : LOG_WRITER_MAX_ATTEMPTS;
+
+    for (int attempt = 1; attempt <= attempts && !saved; attempt++)
+    {
+        saved = saveBatch(logWriterConfig, tail, count, &rejectedCount);
+
+        if (!saved && attempt < attempts)
+        {
+            sleepMilliseconds(LOG_WRITER_RETRY_DELAY_MILLISECONDS * attempt);
+        }
+    }
+
+    if (saved)
+    {
+        atomic_fetch_add_explicit(&logWriterConfig->status.savedCount, count - rejectedCount, memory_order_relaxed);
+        atomic_fetch_add_explicit(&logWriterConfig->status.rejectedCount, rejectedCount, memory_order_relaxed);
+    }
+
+    else
+    {
+        // The spool reports the events it takes itself.
+        unsigned long failedCount = spoolBatch(logWriterConfig, tail, count);
+        atomic_fetch_add_explicit(&logWriterConfig->status.failedCount, failedCount, memory_order_relaxed);
+    }
+
+    // Release, so the main loop only reuses the slots after we're done reading them.
+    // Moving tail only after the commit keeps the events visible to selectQueuedLogStatus() until they're in the database.
+    atomic_store_explicit(&queue->tail, tail + count, memory_order_release);
+
+    return true;
+}
+
+static bool saveBatch(struct LogWriterConfig *logWriterConfig, const unsigned long firstSequence, const unsigned long count,
+                      unsigned long *rejectedCount)
+{
+    // For readability.
+    struct DatabaseConfig *databaseConfig = &logWriterConfig->databaseConfig;
+
+    if (!beginTransaction(databaseConfig))
+    {
+        return false;
+    }
+
+    unsigned long rejectedInBatch = 0;
+    // Log row IDs of the batch, 0 for rejected events. Only journaled once the rows are committed for sure.
+    int64_t logIDs[LOG_WRITER_MAX_BATCH];
+
+    for (unsigned long index = 0; index < count; index++)
+    {
+        const struct ClockEvent *event = &logWriterConfig->queue.events[(firstSequence + index) % LOG_WRITER_QUEUE_CAPACITY];
+        struct ClockEventOutcome outcome;
+
+        if (!recordUsersClockEvent(databaseConfig, event->userID, event->status, event->timestamp, &outcome))
+        {
+            rollbackTransaction(databaseConfig);
+
+            return false;
+        }
+
+        logIDs[index] = outcome.logID;
+
+        if (outcome.result != CLOCK_EVENT_ACCEPTED)
+        {
+            rejectedInBatch++;
+        }
+    }
+
+    if (!commitTransaction(databaseConfig))
+    {
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    *rejectedCount = rejectedInBatch;
+
+    for (unsigned long index = 0; index < count; index++)
+    {
+        const struct ClockEvent *event = &logWriterConfig->queue.events[(firstSequence + index) % LOG_WRITER_QUEUE_CAPACITY];
+
+        if (logIDs[index] != 0)
+        {
+            appendJournalRecord(logWriterConfig->journalConfig, logIDs[index], event->userID, event->status, event->timestamp);
+        }
+    }
+
+    return true;
+}
+
+static unsigned long spoolBatch(struct LogWriterConfig *logWriterConfig, const unsigned long firstSequence,
+                                const unsigned long count)
+{
+    unsigned long failedCount = 0;
+
+    for (unsigned long index = 0; index < count; index++)
+    {
+        const struct ClockEvent *event = &logWriterConfig->queue.events[(firstSequence + index) % LOG_WRITER_QUEUE_CAPACITY];
+
+        if (!appendSpoolEvent(logWriterConfig->spoolConfig, event->userID, event->status, event->timestamp))
+        {
+            failedCount++;
+        }
+    }
+
+    return failedCount;
+}
+
+static void sleepMilliseconds(const long milliseconds)
+{
+    struct timespec duration = { .tv_sec = milliseconds / 1000, .tv_nsec = (milliseconds % 1000) * 1000000L };
+    nanosleep(&duration, NULL);
+}
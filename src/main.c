@@ -7,7 +7,7 @@
  * they were already marked as present or not. Users and logs are stored in a database.
  * 
  * @date Created  2023-11-13
- * @date Modified 2023-12-20
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  * 
@@ -18,12 +18,13 @@
 
 
 
-#include <stdio.h>              // printf().
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
 
 #include "gpio_init.h"          // initializeGPIOLibrary(), sleepGPIOLibrary(), cleanupGPIOLibrary().
 #include "config_handler.h"     // readConfigFile().
 
-#include "keypad.h"             // initializeKeypad(), updatekeypad(), cleanupKeypad().
+#include "keypad.h"             // initializeKeypad(), updatekeypad(), waitForKeypadInput(), cleanupKeypad().
 #include "leds.h"               // initializeLeds(), updateLED(), cleanupLEDs().
 #include "sounds.h"             // initializeSounds(), cleanupSounds().
 
@@ -31,8 +32,51 @@
 #include "keypad_config.h"      // struct KeypadConfig.
 #include "leds_config.h"        // struct LEDConfig.
 #include "sounds_config.h"      // struct SoundsConfig.
+#include "database_config.h"    // struct DatabaseConfig.
 
-#include "database.h"           // openOrCreateDatabase(), DATABASE_FILEPATH.
+#include "database.h"           // openOrCreateDatabase(), cleanupDatabase(), DATABASE_FILEPATH.
+#include "log_writer.h"         // initializeLogWriter(), updateLogWriter(), cleanupLogWriter().
+#include "archive.h"            // initializeArchive(), updateArchive(), cleanupArchive().
+#include "journal.h"            // initializeJournal(), cleanupJournal().
+#include "maintenance.h"        // initializeMaintenance(), updateMaintenance().
+#include "spool.h"              // initializeSpool(), updateSpool(), cleanupSpool().
+
+
+
+/** @brief How long the main loop sleeps between rounds while something needs timing, in seconds. */
+#define MAIN_LOOP_SLEEP_SECONDS 0.01
+
+
+
+/**
+ * @brief Chooses how long the main loop may sleep. With edge alerts or a scan thread a key press wakes it anyway,
+ * so it only has to wake up often while a PIN is being entered, a key is down or the LED is on.
+ * 
+ * @param configData Struct holding data about basically all variables used by the program.
+ * 
+ * @return double Longest time to sleep, in seconds.
+ */
+static double mainLoopWaitTime(const struct ConfigData *configData)
+{
+    // For readability.
+    const struct KeypadConfig *keypadConfig = &configData->keypadConfig;
+
+    // Without edge alerts or a scan thread only polling in the main loop sees a key press.
+    if ((keypadConfig->edgeState.running || keypadConfig->scanThread.running) && isKeypadIdle(keypadConfig) &&
+        !configData->LEDConfigData.LEDCurrentStatus.LEDIsOn)
+    {
+        return keypadConfig->IDLE_WAIT_SECONDS;
+    }
+
+    // Keys being debounced are sampled at the keypad update interval, if it's shorter.
+    if ((keypadConfig->keypadState.anyKeysPressed || keypadConfig->keypadState.anyKeysSettling) &&
+        keypadConfig->UPDATE_INTERVAL_SECONDS < MAIN_LOOP_SLEEP_SECONDS)
+    {
+        return keypadConfig->UPDATE_INTERVAL_SECONDS;
+    }
+
+    return MAIN_LOOP_SLEEP_SECONDS;
+}
 
 
 
@@ -49,43 +93,73 @@ void mainLoop(struct ConfigData *configData)
     {
         updateKeypad(configData);
         updateLED(&configData->LEDConfigData);
-
-        sleepGPIOLibrary(0.01);
+        updateLogWriter(&configData->logWriterConfig);
+        updateSpool(&configData->spoolConfig);
+        updateArchive(configData);
+        updateMaintenance(configData);
+
+        double waitTime = mainLoopWaitTime(configData);
+
+        // Returns early on a key press, if the keypad is scanned on edges or by its own thread.
+        if (!waitForKeypadInput(&configData->keypadConfig, waitTime))
+        {
+            sleepGPIOLibrary(waitTime);
+        }
     }
 }
 
 
 
 /**
- * @brief Read files, set up variables, start pigpio.
+ * @brief Read files, set up variables, start the GPIO backend.
+ * 
+ * @return true If the GPIO backend was started and the rest could be set up.
+ * @return false If the GPIO backend could not be started. Nothing else has been set up then.
  */
-void initialize(struct ConfigData *configData)
+bool initialize(struct ConfigData *configData)
 {
-    if (!initializeGPIOLibrary())
+    // The GPIO backend is chosen in config.ini.
+    readConfigFile(configData);
+
+    if (!initializeGPIOLibrary(&configData->gpioConfig))
     {
-        return;
+        return false;
     }
 
-    readConfigFile(configData);
-
-    sqlite3 *database = NULL;
-    configData->database = &database;
     const char *const filePath = DATABASE_FILEPATH;
-    openOrCreateDatabase(configData->database, filePath);
+    openOrCreateDatabase(&configData->databaseConfig, filePath);
+    // Catches up with the database before the log writer thread starts appending.
+    initializeJournal(&configData->journalConfig, &configData->databaseConfig);
+    // Opened after the main connection, which has already created or migrated the database.
+    configData->spoolConfig.databaseConfig.settings = configData->databaseConfig.settings;
+    initializeSpool(&configData->spoolConfig, filePath, &configData->journalConfig);
+    configData->logWriterConfig.databaseConfig.settings = configData->databaseConfig.settings;
+    initializeLogWriter(&configData->logWriterConfig, filePath, &configData->journalConfig, &configData->spoolConfig);
+    initializeArchive(&configData->archiveConfig);
+    initializeMaintenance(&configData->maintenanceConfig, &configData->databaseConfig);
 
     initializeKeypad(&configData->keypadConfig);
     initializeLeds(&configData->LEDConfigData);
     initializeSounds(&configData->soundsConfig);
+
+    return true;
 }
 
 /**
- * @brief Freeing memory, turning off leds.
+ * @brief Freeing memory, turning off leds, closing the database.
  */
 void cleanup(struct ConfigData *configData)
 {
     cleanupKeypad(&configData->keypadConfig);
     cleanupLEDs(&configData->LEDConfigData);
     cleanupSounds(&configData->soundsConfig);
+    // Saves the log rows that are still queued before closing the database.
+    cleanupLogWriter(&configData->logWriterConfig);
+    // After the log writer, which may still spool its last events.
+    cleanupSpool(&configData->spoolConfig);
+    cleanupJournal(&configData->journalConfig);
+    cleanupArchive(&configData->archiveConfig, &configData->databaseConfig);
+    cleanupDatabase(&configData->databaseConfig);
 
     cleanupGPIOLibrary();
 }
@@ -97,10 +171,17 @@ int main()
     printf("\nProgram starting.\n");
 
     // Struct holding basically all variables used by the program.
-    struct ConfigData configData;
-    configData.keypadConfig.keypadState.keys = NULL;
+    // Zeroed, so the threads and flags that were never started read as stopped.
+    struct ConfigData configData = { 0 };
+
+    // Without GPIO pins there is no keypad to read, so there is nothing to run.
+    if (!initialize(&configData))
+    {
+        fprintf(stderr, "Could not start the GPIO backend, exiting.\n");
+
+        return 1;
+    }
 
-    initialize(&configData);
     mainLoop(&configData);
     cleanup(&configData);
 
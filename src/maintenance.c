@@ -0,0 +1,349 @@
+/**
+ * @file maintenance.c
+ * @author Selkamies
+ *
+ * @brief Runs database maintenance (checkpoints, PRAGMA optimize, incremental vacuum and quick checks)
+ * in short slices while nobody is using the keypad.
+ *
+ * Run inline, any of these could keep the main loop busy for long enough that a key press is missed
+ * in the middle of a PIN. Here they only start once the keypad has been idle and the LED off for IDLE_SECONDS,
+ * one slice per main loop round. Every slice is time-boxed, and checks the keypad every few thousand
+ * SQLite instructions. A key press stops the slice right away, and the interrupted task is tried again
+ * once the keypad is idle again. The key press itself is handled by the next updateKeypad() as usual.
+ *
+ * @date Created  2024-01-21
+ * @date Modified 2024-01-21
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf().
+#include <stdbool.h>
+
+#include "maintenance.h"
+#include "maintenance_config.h" // struct MaintenanceConfig.
+#include "config_data.h"        // struct ConfigData.
+#include "database.h"           // beginMaintenanceSlice(), checkpointDatabase(), optimizeDatabase(), etc.
+#include "keypad.h"             // isAnyKeypadKeyDown().
+#include "timer.h"              // getCurrentTimeInSeconds().
+
+
+
+/** @brief Wait before trying a task again after it ran out of time or found the database locked. */
+#define MAINTENANCE_RETRY_SECONDS 60.0
+#define SECONDS_PER_HOUR 3600.0
+
+#define MAINTENANCE_DEFAULT_IDLE_SECONDS 5.0
+#define MAINTENANCE_DEFAULT_SLICE_SECONDS 0.05
+#define MAINTENANCE_DEFAULT_QUICK_CHECK_MAX_SECONDS 5.0
+#define MAINTENANCE_DEFAULT_CHECKPOINT_INTERVAL_SECONDS 60.0
+#define MAINTENANCE_DEFAULT_OPTIMIZE_INTERVAL_HOURS 24.0
+#define MAINTENANCE_DEFAULT_VACUUM_INTERVAL_HOURS 1.0
+#define MAINTENANCE_DEFAULT_VACUUM_PAGES_PER_SLICE 64
+#define MAINTENANCE_DEFAULT_QUICK_CHECK_INTERVAL_HOURS 24.0
+
+
+
+/**
+ * @brief Maintenance tasks, most urgent first.
+ */
+enum MaintenanceTask
+{
+    MAINTENANCE_TASK_NONE,
+    /** @brief Copies the WAL back to the database file, so it doesn't grow and reads stay fast. */
+    MAINTENANCE_TASK_CHECKPOINT,
+    /** @brief Gives free pages, like the ones left by archiving, back to the file system. */
+    MAINTENANCE_TASK_VACUUM,
+    /** @brief Keeps the query planner statistics up to date. */
+    MAINTENANCE_TASK_OPTIMIZE,
+    /** @brief Reads the whole database looking for corruption. */
+    MAINTENANCE_TASK_QUICK_CHECK
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Checks that nobody is pressing keys or entering a PIN, and that the LED showing the last result is off.
+ *
+ * @param configData Struct holding data about basically all variables used by the program.
+ *
+ * @return true If the terminal is idle.
+ * @return false If it isn't.
+ */
+static bool terminalIsIdle(const struct ConfigData *configData);
+
+/**
+ * @brief Finds the most urgent task that is due.
+ *
+ * @param maintenanceConfig Struct holding all the variables needed by maintenance.c.
+ * @param currentTime Current time in seconds.
+ *
+ * @return The task, or MAINTENANCE_TASK_NONE if nothing is due.
+ */
+static enum MaintenanceTask selectDueTask(const struct MaintenanceConfig *maintenanceConfig, const double currentTime);
+
+/**
+ * @brief Runs one slice of a task and schedules its next run.
+ *
+ * @param configData Struct holding data about basically all variables used by the program.
+ * @param task The task.
+ * @param currentTime Time the slice started, in seconds.
+ */
+static void runMaintenanceTask(struct ConfigData *configData, const enum MaintenanceTask task, const double currentTime);
+
+/**
+ * @brief Sets when a task runs next.
+ *
+ * @param maintenanceConfig Struct holding all the variables needed by maintenance.c.
+ * @param nextTime Pointer to the next run time of the task.
+ * @param stopped Whether the slice was stopped, or found the database locked.
+ * @param currentTime Time the slice started, in seconds.
+ * @param intervalSeconds Time between runs of the task.
+ */
+static void scheduleTask(const struct MaintenanceConfig *maintenanceConfig, double *nextTime, const bool stopped,
+                         const double currentTime, const double intervalSeconds);
+
+/**
+ * @brief Stop check of a maintenance slice, called by the database every few thousand instructions.
+ *
+ * @param data Pointer to the struct ConfigData.
+ *
+ * @return true If a key is down or the slice is out of time.
+ * @return false If the slice can go on.
+ */
+static bool shouldStopSlice(void *data);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+void setMaintenanceDefaults(struct MaintenanceConfig *maintenanceConfig)
+{
+    maintenanceConfig->ENABLED = true;
+    maintenanceConfig->IDLE_SECONDS = MAINTENANCE_DEFAULT_IDLE_SECONDS;
+    maintenanceConfig->SLICE_SECONDS = MAINTENANCE_DEFAULT_SLICE_SECONDS;
+    maintenanceConfig->QUICK_CHECK_MAX_SECONDS = MAINTENANCE_DEFAULT_QUICK_CHECK_MAX_SECONDS;
+    maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS = MAINTENANCE_DEFAULT_CHECKPOINT_INTERVAL_SECONDS;
+    maintenanceConfig->OPTIMIZE_INTERVAL_HOURS = MAINTENANCE_DEFAULT_OPTIMIZE_INTERVAL_HOURS;
+    maintenanceConfig->VACUUM_INTERVAL_HOURS = MAINTENANCE_DEFAULT_VACUUM_INTERVAL_HOURS;
+    maintenanceConfig->VACUUM_PAGES_PER_SLICE = MAINTENANCE_DEFAULT_VACUUM_PAGES_PER_SLICE;
+    maintenanceConfig->QUICK_CHECK_INTERVAL_HOURS = MAINTENANCE_DEFAULT_QUICK_CHECK_INTERVAL_HOURS;
+}
+
+void initializeMaintenance(struct MaintenanceConfig *maintenanceConfig, struct DatabaseConfig *databaseConfig)
+{
+    printf("Initializing database maintenance.\n");
+
+    if (maintenanceConfig->SLICE_SECONDS <= 0.0)
+    {
+        maintenanceConfig->SLICE_SECONDS = MAINTENANCE_DEFAULT_SLICE_SECONDS;
+    }
+
+    if (maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS <= 0.0)
+    {
+        maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS = MAINTENANCE_DEFAULT_CHECKPOINT_INTERVAL_SECONDS;
+    }
+
+    if (maintenanceConfig->VACUUM_PAGES_PER_SLICE < 1)
+    {
+        maintenanceConfig->VACUUM_PAGES_PER_SLICE = MAINTENANCE_DEFAULT_VACUUM_PAGES_PER_SLICE;
+    }
+
+    double currentTime = getCurrentTimeInSeconds();
+
+    maintenanceConfig->lastActivityTime = currentTime;
+    maintenanceConfig->nextSliceTime = currentTime;
+    maintenanceConfig->stoppedByKeyPress = false;
+    maintenanceConfig->nextCheckpointTime = currentTime + maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS;
+    // The rest run the first time the terminal is idle, their last run may have been long ago.
+    maintenanceConfig->nextOptimizeTime = currentTime;
+    maintenanceConfig->nextVacuumTime = currentTime;
+    maintenanceConfig->nextQuickCheckTime = currentTime;
+
+    // The log writer thread's own connection still checkpoints on commit, that doesn't block the main loop.
+    if (maintenanceConfig->ENABLED && databaseConfig->database != NULL)
+    {
+        disableAutoCheckpoint(databaseConfig);
+    }
+}
+
+void updateMaintenance(struct ConfigData *configData)
+{
+    // For readability.
+    struct MaintenanceConfig *maintenanceConfig = &configData->maintenanceConfig;
+
+    double currentTime = getCurrentTimeInSeconds();
+
+    if (!maintenanceConfig->ENABLED || configData->databaseConfig.database == NULL)
+    {
+        return;
+    }
+
+    if (!terminalIsIdle(configData))
+    {
+        maintenanceConfig->lastActivityTime = currentTime;
+
+        return;
+    }
+
+    if (currentTime - maintenanceConfig->lastActivityTime < maintenanceConfig->IDLE_SECONDS ||
+        currentTime < maintenanceConfig->nextSliceTime)
+    {
+        return;
+    }
+
+    enum MaintenanceTask task = selectDueTask(maintenanceConfig, currentTime);
+
+    if (task == MAINTENANCE_TASK_NONE)
+    {
+        return;
+    }
+
+    runMaintenanceTask(configData, task, currentTime);
+
+    // The main loop gets at least as much time as the slice took before the next one.
+    double endTime = getCurrentTimeInSeconds();
+    maintenanceConfig->nextSliceTime = endTime + (endTime - currentTime);
+
+    // The user has started entering something, wait until they're done.
+    if (maintenanceConfig->stoppedByKeyPress)
+    {
+        maintenanceConfig->lastActivityTime = endTime;
+    }
+}
+
+
+
+static bool terminalIsIdle(const struct ConfigData *configData)
+{
+    return !configData->keypadConfig.currentPINState.waitingForPINInput &&
+           !configData->keypadConfig.keypadState.anyKeysPressed &&
+           !configData->LEDConfigData.LEDCurrentStatus.LEDIsOn;
+}
+
+static enum MaintenanceTask selectDueTask(const struct MaintenanceConfig *maintenanceConfig, const double currentTime)
+{
+    if (currentTime >= maintenanceConfig->nextCheckpointTime)  return MAINTENANCE_TASK_CHECKPOINT;
+    if (currentTime >= maintenanceConfig->nextVacuumTime)      return MAINTENANCE_TASK_VACUUM;
+    if (currentTime >= maintenanceConfig->nextOptimizeTime)    return MAINTENANCE_TASK_OPTIMIZE;
+    if (currentTime >= maintenanceConfig->nextQuickCheckTime)  return MAINTENANCE_TASK_QUICK_CHECK;
+
+    return MAINTENANCE_TASK_NONE;
+}
+
+static void runMaintenanceTask(struct ConfigData *configData, const enum MaintenanceTask task, const double currentTime)
+{
+    // For readability.
+    struct MaintenanceConfig *maintenanceConfig = &configData->maintenanceConfig;
+    struct DatabaseConfig *databaseConfig = &configData->databaseConfig;
+
+    bool stopped = false;
+    bool finished = false;
+
+    // The quick check can't be continued where it stopped, so it gets one longer slice. A key press still stops it.
+    maintenanceConfig->sliceDeadline = currentTime + (task == MAINTENANCE_TASK_QUICK_CHECK ?
+                                                      maintenanceConfig->QUICK_CHECK_MAX_SECONDS :
+                                                      maintenanceConfig->SLICE_SECONDS);
+    maintenanceConfig->stoppedByKeyPress = false;
+
+    beginMaintenanceSlice(databaseConfig, shouldStopSlice, configData);
+
+    switch (task)
+    {
+        case MAINTENANCE_TASK_CHECKPOINT:
+        {
+            int walPages = 0;
+            finished = checkpointDatabase(databaseConfig, &walPages, &stopped);
+            scheduleTask(maintenanceConfig, &maintenanceConfig->nextCheckpointTime, stopped, currentTime,
+                         maintenanceConfig->CHECKPOINT_INTERVAL_SECONDS);
+            break;
+        }
+
+        case MAINTENANCE_TASK_VACUUM:
+        {
+            int freePages = 0;
+            finished = vacuumFreePages(databaseConfig, maintenanceConfig->VACUUM_PAGES_PER_SLICE, &freePages, &stopped);
+            scheduleTask(maintenanceConfig, &maintenanceConfig->nextVacuumTime, stopped, currentTime,
+                         maintenanceConfig->VACUUM_INTERVAL_HOURS * SECONDS_PER_HOUR);
+
+            // Pages left over are given back in the next slices.
+            if (finished && freePages > 0)
+            {
+                maintenanceConfig->nextVacuumTime = currentTime;
+            }
+
+            break;
+        }
+
+        case MAINTENANCE_TASK_OPTIMIZE:
+            finished = optimizeDatabase(databaseConfig, &stopped);
+            scheduleTask(maintenanceConfig, &maintenanceConfig->nextOptimizeTime, stopped, currentTime,
+                         maintenanceConfig->OPTIMIZE_INTERVAL_HOURS * SECONDS_PER_HOUR);
+            break;
+
+        case MAINTENANCE_TASK_QUICK_CHECK:
+        {
+            bool passed = false;
+            finished = quickCheckDatabase(databaseConfig, &passed, &stopped);
+            scheduleTask(maintenanceConfig, &maintenanceConfig->nextQuickCheckTime, stopped, currentTime,
+                         maintenanceConfig->QUICK_CHECK_INTERVAL_HOURS * SECONDS_PER_HOUR);
+
+            if (finished && !passed)
+            {
+                fprintf(stderr, "Database quick check found problems, restore database.db from a backup.\n");
+            }
+
+            else if (finished)
+            {
+                printf("Database quick check passed in %.2f seconds.\n", getCurrentTimeInSeconds() - currentTime);
+            }
+
+            break;
+        }
+
+        case MAINTENANCE_TASK_NONE:
+        default:
+            break;
+    }
+
+    endMaintenanceSlice(databaseConfig);
+}
+
+static void scheduleTask(const struct MaintenanceConfig *maintenanceConfig, double *nextTime, const bool stopped,
+                         const double currentTime, const double intervalSeconds)
+{
+    // Stopped by a key press, the task is still due and runs again once the keypad is idle.
+    if (stopped && maintenanceConfig->stoppedByKeyPress)
+    {
+        return;
+    }
+
+    // Out of time or locked by another connection, other tasks get their turn first.
+    if (stopped)
+    {
+        *nextTime = currentTime + MAINTENANCE_RETRY_SECONDS;
+
+        return;
+    }
+
+    // Finished, or failed with the error printed. Either way not again before the interval.
+    *nextTime = currentTime + intervalSeconds;
+}
+
+static bool shouldStopSlice(void *data)
+{
+    struct ConfigData *configData = (struct ConfigData *)data;
+
+    if (isAnyKeypadKeyDown(&configData->keypadConfig))
+    {
+        configData->maintenanceConfig.stoppedByKeyPress = true;
+
+        return true;
+    }
+
+    return getCurrentTimeInSeconds() >= configData->maintenanceConfig.sliceDeadline;
+}
@@ -0,0 +1,305 @@
+/**
+ * @file pin_index.c
+ * @author Selkamies
+ *
+ * @brief In-memory hash table from PIN codes to user IDs, so that PIN validation doesn't need
+ * to query the database. Filled and kept up to date by database.c.
+ *
+ * The table uses open addressing with linear probing. The header and all the slots are in one
+ * allocation, and the PINs are stored inside the slots, so a lookup touches one or two cache lines.
+ *
+ * @date Created  2023-12-28
+ * @date Modified 2023-12-28
+ *
+ * @copyright Copyright (c) 2023
+ */
+
+
+
+#include <stdbool.h>
+#include <stdint.h>             // uint8_t, uint32_t.
+#include <stdlib.h>             // calloc(), free().
+#include <string.h>             // strlen(), strcmp(), memcpy().
+
+#include "pin_index.h"
+
+
+
+/** @brief Smallest number of slots in a table. Has to be a power of two. */
+#define MINIMUM_CAPACITY 64
+
+/** @brief Slot has never been used. Lookups can stop here. */
+#define SLOT_EMPTY 0
+/** @brief Slot holds a PIN. */
+#define SLOT_USED 1
+/** @brief Slot held a PIN that was removed. Lookups have to continue past it. */
+#define SLOT_DELETED 2
+
+
+
+/**
+ * @brief A single PIN and the user it belongs to.
+ */
+struct PINIndexSlot
+{
+    /** @brief Full hash of the PIN, compared before the PIN itself. */
+    uint32_t hash;
+    /** @brief User ID of the PIN. */
+    int userID;
+    /** @brief SLOT_EMPTY, SLOT_USED or SLOT_DELETED. */
+    uint8_t state;
+    /** @brief The PIN as a null terminated string. */
+    char pin[PIN_INDEX_MAX_PIN_LENGTH + 1];
+};
+
+/**
+ * @brief Hash table header followed by the slots, in one allocation.
+ */
+struct PINIndex
+{
+    /** @brief Number of slots. Always a power of two, so the hash can be masked instead of divided. */
+    uint32_t capacity;
+    /** @brief Number of slots holding a PIN. */
+    uint32_t count;
+    /** @brief Number of removed slots. They slow down lookups, so they count towards the load. */
+    uint32_t deleted;
+    /** @brief The slots. */
+    struct PINIndexSlot slots[];
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief 32-bit FNV-1a hash of a string.
+ *
+ * @param pin String to hash.
+ *
+ * @return uint32_t The hash.
+ */
+static uint32_t hashPIN(const char *pin);
+
+/**
+ * @brief Finds the slot of a PIN.
+ *
+ * @param pinIndex The index.
+ * @param pin PIN to look for.
+ * @param hash Hash of the PIN.
+ *
+ * @return struct PINIndexSlot* The slot holding the PIN, or NULL if the PIN is not in the index.
+ */
+static struct PINIndexSlot *findSlot(const struct PINIndex *pinIndex, const char *pin, const uint32_t hash);
+
+/**
+ * @brief Copies all the PINs to a new table of the given size and frees the old one.
+ * Also gets rid of the removed slots.
+ *
+ * @param pinIndex Pointer to the index. Changed to the new table on success.
+ * @param capacity Number of slots in the new table. Has to be a power of two.
+ *
+ * @return true If the new table was allocated.
+ * @return false If the allocation failed. The old table is kept.
+ */
+static bool resizePINIndex(struct PINIndex **pinIndex, const uint32_t capacity);
+
+/**
+ * @brief Smallest power of two capacity that keeps the table at most half full with count PINs.
+ *
+ * @param count Number of PINs.
+ *
+ * @return uint32_t Number of slots.
+ */
+static uint32_t capacityForCount(const uint32_t count);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+struct PINIndex *createPINIndex(const int expectedCount)
+{
+    uint32_t capacity = capacityForCount(expectedCount > 0 ? (uint32_t)expectedCount : 0);
+
+    // calloc() leaves every slot as SLOT_EMPTY.
+    struct PINIndex *pinIndex = calloc(1, sizeof(struct PINIndex) + capacity * sizeof(struct PINIndexSlot));
+
+    if (pinIndex == NULL)
+    {
+        return NULL;
+    }
+
+    pinIndex->capacity = capacity;
+
+    return pinIndex;
+}
+
+bool insertPINIndex(struct PINIndex **pinIndex, const char *pin, const int userID)
+{
+    size_t pinLength = strlen(pin);
+
+    if (pinLength > PIN_INDEX_MAX_PIN_LENGTH)
+    {
+        return false;
+    }
+
+    uint32_t hash = hashPIN(pin);
+    struct PINIndexSlot *existingSlot = findSlot(*pinIndex, pin, hash);
+
+    if (existingSlot != NULL)
+    {
+        existingSlot->userID = userID;
+
+        return true;
+    }
+
+    // Keep used and removed slots at most half of the table, so probe sequences stay short.
+    if (((*pinIndex)->count + (*pinIndex)->deleted + 1) * 2 > (*pinIndex)->capacity)
+    {
+        if (!resizePINIndex(pinIndex, capacityForCount((*pinIndex)->count + 1)))
+        {
+            return false;
+        }
+    }
+
+    struct PINIndex *table = *pinIndex;
+    uint32_t mask = table->capacity - 1;
+    uint32_t slotIndex = hash & mask;
+
+    // The PIN isn't in the table, so the first free slot on its probe sequence is where it goes.
+    while (table->slots[slotIndex].state == SLOT_USED)
+    {
+        slotIndex = (slotIndex + 1) & mask;
+    }
+
+    struct PINIndexSlot *slot = &table->slots[slotIndex];
+
+    if (slot->state == SLOT_DELETED)
+    {
+        table->deleted--;
+    }
+
+    slot->hash = hash;
+    slot->userID = userID;
+    slot->state = SLOT_USED;
+    memcpy(slot->pin, pin, pinLength + 1);
+    table->count++;
+
+    return true;
+}
+
+void removePINIndex(struct PINIndex *pinIndex, const char *pin)
+{
+    struct PINIndexSlot *slot = findSlot(pinIndex, pin, hashPIN(pin));
+
+    if (slot != NULL)
+    {
+        // The slot can't be emptied, or lookups of PINs further on the same probe sequence would stop here.
+        slot->state = SLOT_DELETED;
+        pinIndex->count--;
+        pinIndex->deleted++;
+    }
+}
+
+bool lookupPINIndex(const struct PINIndex *pinIndex, const char *pin, int *userID)
+{
+    struct PINIndexSlot *slot = findSlot(pinIndex, pin, hashPIN(pin));
+
+    if (slot == NULL)
+    {
+        return false;
+    }
+
+    *userID = slot->userID;
+
+    return true;
+}
+
+void cleanupPINIndex(struct PINIndex *pinIndex)
+{
+    free(pinIndex);
+}
+
+
+
+static uint32_t hashPIN(const char *pin)
+{
+    uint32_t hash = 2166136261u;
+
+    for (const unsigned char *character = (const unsigned char *)pin; *character != '\0'; character++)
+    {
+        hash ^= *character;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static struct PINIndexSlot *findSlot(const struct PINIndex *pinIndex, const char *pin, const uint32_t hash)
+{
+    uint32_t mask = pinIndex->capacity - 1;
+    uint32_t slotIndex = hash & mask;
+
+    // The table is never full, so there's always an empty slot that ends the loop.
+    while (pinIndex->slots[slotIndex].state != SLOT_EMPTY)
+    {
+        const struct PINIndexSlot *slot = &pinIndex->slots[slotIndex];
+
+        if (slot->state == SLOT_USED && slot->hash == hash && strcmp(slot->pin, pin) == 0)
+        {
+            return (struct PINIndexSlot *)slot;
+        }
+
+        slotIndex = (slotIndex + 1) & mask;
+    }
+
+    return NULL;
+}
+
+static bool resizePINIndex(struct PINIndex **pinIndex, const uint32_t capacity)
+{
+    struct PINIndex *oldTable = *pinIndex;
+    struct PINIndex *newTable = calloc(1, sizeof(struct PINIndex) + capacity * sizeof(struct PINIndexSlot));
+
+    if (newTable == NULL)
+    {
+        return false;
+    }
+
+    newTable->capacity = capacity;
+    uint32_t mask = capacity - 1;
+
+    for (uint32_t oldIndex = 0; oldIndex < oldTable->capacity; oldIndex++)
+    {
+        if (oldTable->slots[oldIndex].state != SLOT_USED)
+        {
+            continue;
+        }
+
+        uint32_t slotIndex = oldTable->slots[oldIndex].hash & mask;
+
+        while (newTable->slots[slotIndex].state == SLOT_USED)
+        {
+            slotIndex = (slotIndex + 1) & mask;
+        }
+
+        newTable->slots[slotIndex] = oldTable->slots[oldIndex];
+        newTable->count++;
+    }
+
+    free(oldTable);
+    *pinIndex = newTable;
+
+    return true;
+}
+
+static uint32_t capacityForCount(const uint32_t count)
+{
+    uint32_t capacity = MINIMUM_CAPACITY;
+
+    while (capacity < count * 2 + 1)
+    {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
@@ -0,0 +1,790 @@
+/**
+ * @file spool.c
+ * @author Selkamies
+ *
+ * @brief Keeps clock events that can't be saved to the database in a file, and saves them in order
+ * once the database works again.
+ *
+ * When the database is locked for too long, the disk is full or the file is damaged, the clock event
+ * would otherwise be lost. Spooling one is a copy to the mapped spool file under a mutex, it never waits
+ * for the disk. The spool thread flushes the file once SYNC_INTERVAL_MILLISECONDS has passed since the first
+ * unflushed event, so a burst of events costs one flush, and every event is on the disk within that time.
+ * The file is written full of zeros when it's created, so spooling never needs a free block, even on a full disk.
+ *
+ * The spool thread keeps trying to save the spooled events with its own database connection, oldest first,
+ * repeating the status check of each. Events are only marked saved after the commit. If the power is cut in
+ * between, the events are found in the log table on the next start and not saved twice.
+ *
+ * @date Created  2024-01-22
+ * @date Modified 2024-01-22
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), snprintf().
+#include <stdbool.h>
+#include <stdint.h>             // uint32_t, uint64_t, int64_t.
+#include <stddef.h>             // offsetof().
+#include <stdatomic.h>          // atomic_init(), atomic_load_explicit(), atomic_fetch_add_explicit().
+#include <fcntl.h>              // open().
+#include <unistd.h>             // pwrite(), fsync(), close().
+#include <time.h>               // clock_gettime(), nanosleep().
+#include <pthread.h>            // pthread_create(), pthread_mutex_lock(), pthread_cond_timedwait(), etc.
+#include <sys/mman.h>           // mmap(), munmap(), msync(), mlock().
+#include <sys/stat.h>           // fstat().
+
+#include "spool.h"
+#include "spool_config.h"       // struct SpoolConfig.
+#include "database.h"           // openDatabaseConnection(), recordUsersClockEvent(), selectLogRowIDByEvent(), etc.
+#include "journal.h"            // appendJournalRecord(), calculateCRC32().
+
+
+
+/** @brief Size of the header and of every record in the spool file, in bytes. */
+#define SPOOL_RECORD_SIZE 32
+/** @brief Marks a header that has been written, "SPL1". */
+#define SPOOL_HEADER_MAGIC 0x314C5053u
+/** @brief Most spooled events saved in one transaction. */
+#define SPOOL_REPLAY_BATCH 16
+
+#define SPOOL_DEFAULT_SYNC_INTERVAL_MILLISECONDS 20
+#define SPOOL_DEFAULT_RETRY_SECONDS 5.0
+
+
+
+/**
+ * @brief First record of the spool file. Only changed by the spool thread, after a replay is committed.
+ */
+struct SpoolHeader
+{
+    /** @brief Events up to this sequence number are in the database. */
+    uint64_t replayedSequence;
+    /** @brief SPOOL_HEADER_MAGIC. */
+    uint32_t magic;
+    uint8_t reserved[16];
+    /** @brief CRC-32 of all the fields above. */
+    uint32_t crc;
+};
+
+/**
+ * @brief A spooled clock event. The event with sequence number S is in slot (S - 1) % SPOOL_CAPACITY.
+ */
+struct SpoolRecord
+{
+    /** @brief 1 for the first event ever spooled, then one more for every event. */
+    uint64_t sequence;
+    /** @brief Time of the clock event in microseconds since the Unix epoch. */
+    int64_t timestamp;
+    int32_t userID;
+    /** @brief LOG_STATUS_IN or LOG_STATUS_OUT. */
+    int32_t status;
+    uint32_t reserved;
+    /** @brief CRC-32 of all the fields above. */
+    uint32_t crc;
+};
+
+/**
+ * @brief Layout of the whole spool file.
+ */
+struct SpoolFile
+{
+    struct SpoolHeader header;
+    struct SpoolRecord records[SPOOL_CAPACITY];
+};
+
+_Static_assert(sizeof(struct SpoolHeader) == SPOOL_RECORD_SIZE, "The spool header must be 32 bytes.");
+_Static_assert(sizeof(struct SpoolRecord) == SPOOL_RECORD_SIZE, "Spool records must be 32 bytes.");
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Maps the spool file, creating it full of zeros if it doesn't exist.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ *
+ * @return true If the file was mapped.
+ * @return false If something went wrong.
+ */
+static bool mapSpoolFile(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Writes zeros to the whole file and flushes them, so every block of it is allocated and written.
+ *
+ * @param fileDescriptor The spool file.
+ *
+ * @return true If the file was filled.
+ * @return false If the disk is full or something else went wrong.
+ */
+static bool fillSpoolFile(const int fileDescriptor);
+
+/**
+ * @brief Finds the events the previous run left in the spool, and the sequence number of the next one.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ */
+static void recoverSpool(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief The spool thread. Flushes spooled events to the disk and saves them to the database until asked to stop.
+ *
+ * @param argument Pointer to struct SpoolConfig.
+ *
+ * @return void* Always NULL.
+ */
+static void *spoolThread(void *argument);
+
+/**
+ * @brief Saves the oldest spooled events in one transaction and marks them saved.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ *
+ * @return true If the events were saved, or found to be saved already.
+ * @return false If the database still fails. The events stay in the spool.
+ */
+static bool replaySpooledEvents(struct SpoolConfig *spoolConfig);
+
+/**
+ * @brief Writes the replayed sequence number to the header and flushes it.
+ *
+ * @param spoolConfig Struct holding all the variables needed by spool.c.
+ * @param replayedSequence Events up to this sequence number are in the database.
+ */
+static void saveReplayedSequence(struct SpoolConfig *spoolConfig, const uint64_t replayedSequence);
+
+/**
+ * @brief Checks that a slot holds the event with the sequence number and that its CRC matches.
+ *
+ * @param record The slot.
+ * @param sequence Sequence number the slot should have.
+ *
+ * @return true If the event has been completely written.
+ * @return false If the slot is empty, torn or holds an older event.
+ */
+static bool isValidSpoolRecord(const struct SpoolRecord *record, const uint64_t sequence);
+
+/**
+ * @brief Moves a point in time forward.
+ *
+ * @param time Pointer to the time.
+ * @param seconds How much to move it.
+ */
+static void addSeconds(struct timespec *time, const double seconds);
+
+/**
+ * @brief Sleeps for a number of milliseconds.
+ *
+ * @param milliseconds How long to sleep.
+ */
+static void sleepMilliseconds(const long milliseconds);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+void setSpoolDefaults(struct SpoolConfig *spoolConfig)
+{
+    spoolConfig->ENABLED = true;
+    snprintf(spoolConfig->FILE_PATH, sizeof(spoolConfig->FILE_PATH), "%s", SPOOL_DEFAULT_FILE_PATH);
+    spoolConfig->SYNC_INTERVAL_MILLISECONDS = SPOOL_DEFAULT_SYNC_INTERVAL_MILLISECONDS;
+    spoolConfig->RETRY_SECONDS = SPOOL_DEFAULT_RETRY_SECONDS;
+}
+
+bool initializeSpool(struct SpoolConfig *spoolConfig, const char *const databaseFilePath,
+                     struct JournalConfig *journalConfig)
+{
+    spoolConfig->open = false;
+    spoolConfig->file = NULL;
+    spoolConfig->databaseConfig.database = NULL;
+
+    if (!spoolConfig->ENABLED)
+    {
+        return false;
+    }
+
+    printf("Initializing spool.\n");
+
+    if (spoolConfig->SYNC_INTERVAL_MILLISECONDS < 1)
+    {
+        spoolConfig->SYNC_INTERVAL_MILLISECONDS = SPOOL_DEFAULT_SYNC_INTERVAL_MILLISECONDS;
+    }
+
+    if (spoolConfig->RETRY_SECONDS <= 0.0)
+    {
+        spoolConfig->RETRY_SECONDS = SPOOL_DEFAULT_RETRY_SECONDS;
+    }
+
+    spoolConfig->databaseFilePath = databaseFilePath;
+    spoolConfig->journalConfig = journalConfig;
+    spoolConfig->stopRequested = false;
+    atomic_init(&spoolConfig->spooledCount, 0);
+    atomic_init(&spoolConfig->fullCount, 0);
+    atomic_init(&spoolConfig->status.replayedCount, 0);
+    atomic_init(&spoolConfig->status.rejectedCount, 0);
+    atomic_init(&spoolConfig->status.duplicateCount, 0);
+    atomic_init(&spoolConfig->status.lostCount, 0);
+    spoolConfig->reportedSpooledCount = 0;
+    spoolConfig->reportedFullCount = 0;
+    spoolConfig->reportedReplayedCount = 0;
+    spoolConfig->reportedRejectedCount = 0;
+    spoolConfig->reportedDuplicateCount = 0;
+    spoolConfig->reportedLostCount = 0;
+
+    if (!mapSpoolFile(spoolConfig))
+    {
+        return false;
+    }
+
+    recoverSpool(spoolConfig);
+
+    // The spool thread sleeps on the monotonic clock, so setting the system time doesn't delay a retry.
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+
+    bool initialized = pthread_mutex_init(&spoolConfig->lock, NULL) == 0 &&
+                       pthread_cond_init(&spoolConfig->wakeup, &conditionAttributes) == 0;
+    pthread_condattr_destroy(&conditionAttributes);
+
+    if (!initialized || pthread_create(&spoolConfig->thread, NULL, spoolThread, spoolConfig) != 0)
+    {
+        fprintf(stderr, "Could not start the spool thread, the spool is disabled.\n");
+        munmap(spoolConfig->file, sizeof(struct SpoolFile));
+        spoolConfig->file = NULL;
+
+        return false;
+    }
+
+    spoolConfig->open = true;
+
+    uint64_t pendingCount = spoolConfig->nextSequence - 1 - spoolConfig->replayedSequence;
+
+    if (pendingCount > 0)
+    {
+        printf("%llu clock event(s) left in the spool are saved to the database.\n", (unsigned long long)pendingCount);
+    }
+
+    return true;
+}
+
+bool appendSpoolEvent(struct SpoolConfig *spoolConfig, const int userID, const int status, const int64_t timestamp)
+{
+    if (!spoolConfig->open)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&spoolConfig->lock);
+
+    uint64_t sequence = spoolConfig->nextSequence;
+
+    // The slot is still holding an event that isn't in the database.
+    if (sequence - 1 - spoolConfig->replayedSequence >= SPOOL_CAPACITY)
+    {
+        pthread_mutex_unlock(&spoolConfig->lock);
+        atomic_fetch_add_explicit(&spoolConfig->fullCount, 1, memory_order_relaxed);
+
+        return false;
+    }
+
+    struct SpoolRecord record =
+    {
+        .sequence = sequence,
+        .timestamp = timestamp,
+        .userID = userID,
+        .status = status,
+    };
+    record.crc = calculateCRC32(&record, offsetof(struct SpoolRecord, crc));
+
+    // Only memory is written here, the spool thread flushes it.
+    spoolConfig->file->records[(sequence - 1) % SPOOL_CAPACITY] = record;
+    spoolConfig->nextSequence++;
+
+    pthread_cond_signal(&spoolConfig->wakeup);
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    atomic_fetch_add_explicit(&spoolConfig->spooledCount, 1, memory_order_relaxed);
+
+    return true;
+}
+
+bool hasSpooledEvents(struct SpoolConfig *spoolConfig)
+{
+    if (!spoolConfig->open)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&spoolConfig->lock);
+    bool pending = spoolConfig->nextSequence - 1 > spoolConfig->replayedSequence;
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    return pending;
+}
+
+bool selectSpooledLogStatus(struct SpoolConfig *spoolConfig, const int userID, int *status)
+{
+    if (!spoolConfig->open)
+    {
+        return false;
+    }
+
+    bool found = false;
+
+    pthread_mutex_lock(&spoolConfig->lock);
+
+    // Newest first. Events being replayed stay here until they're committed, so none fall between here and the database.
+    for (uint64_t sequence = spoolConfig->nextSequence - 1; sequence > spoolConfig->replayedSequence; sequence--)
+    {
+        const struct SpoolRecord *record = &spoolConfig->file->records[(sequence - 1) % SPOOL_CAPACITY];
+
+        if (record->userID == userID && isValidSpoolRecord(record, sequence))
+        {
+            *status = record->status;
+            found = true;
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    return found;
+}
+
+void updateSpool(struct SpoolConfig *spoolConfig)
+{
+    if (!spoolConfig->open)
+    {
+        return;
+    }
+
+    unsigned long spooledCount = atomic_load_explicit(&spoolConfig->spooledCount, memory_order_relaxed);
+    unsigned long fullCount = atomic_load_explicit(&spoolConfig->fullCount, memory_order_relaxed);
+    unsigned long replayedCount = atomic_load_explicit(&spoolConfig->status.replayedCount, memory_order_relaxed);
+    unsigned long rejectedCount = atomic_load_explicit(&spoolConfig->status.rejectedCount, memory_order_relaxed);
+    unsigned long duplicateCount = atomic_load_explicit(&spoolConfig->status.duplicateCount, memory_order_relaxed);
+    unsigned long lostCount = atomic_load_explicit(&spoolConfig->status.lostCount, memory_order_relaxed);
+
+    if (spooledCount != spoolConfig->reportedSpooledCount)
+    {
+        fprintf(stderr, "%lu clock event(s) spooled, they're saved once the database works again.\n",
+                spooledCount - spoolConfig->reportedSpooledCount);
+        spoolConfig->reportedSpooledCount = spooledCount;
+    }
+
+    if (fullCount != spoolConfig->reportedFullCount)
+    {
+        fprintf(stderr, "ERROR: The spool is full, %lu clock event(s) could not be saved!\n",
+                fullCount - spoolConfig->reportedFullCount);
+        spoolConfig->reportedFullCount = fullCount;
+    }
+
+    if (replayedCount != spoolConfig->reportedReplayedCount)
+    {
+        printf("%lu spooled clock event(s) saved to the database.\n", replayedCount - spoolConfig->reportedReplayedCount);
+        spoolConfig->reportedReplayedCount = replayedCount;
+    }
+
+    if (rejectedCount != spoolConfig->reportedRejectedCount)
+    {
+        fprintf(stderr, "%lu spooled clock event(s) not saved, the user's status had already changed in the database.\n",
+                rejectedCount - spoolConfig->reportedRejectedCount);
+        spoolConfig->reportedRejectedCount = rejectedCount;
+    }
+
+    if (duplicateCount != spoolConfig->reportedDuplicateCount)
+    {
+        printf("%lu spooled clock event(s) were already in the database.\n",
+               duplicateCount - spoolConfig->reportedDuplicateCount);
+        spoolConfig->reportedDuplicateCount = duplicateCount;
+    }
+
+    if (lostCount != spoolConfig->reportedLostCount)
+    {
+        fprintf(stderr, "ERROR: %lu spooled clock event(s) were lost in a power cut!\n",
+                lostCount - spoolConfig->reportedLostCount);
+        spoolConfig->reportedLostCount = lostCount;
+    }
+}
+
+void cleanupSpool(struct SpoolConfig *spoolConfig)
+{
+    if (!spoolConfig->open)
+    {
+        return;
+    }
+
+    printf("Stopping spool.\n");
+
+    pthread_mutex_lock(&spoolConfig->lock);
+    spoolConfig->stopRequested = true;
+    pthread_cond_signal(&spoolConfig->wakeup);
+    pthread_mutex_unlock(&spoolConfig->lock);
+    pthread_join(spoolConfig->thread, NULL);
+
+    // Report the events replayed during shutdown.
+    updateSpool(spoolConfig);
+
+    msync(spoolConfig->file, sizeof(struct SpoolFile), MS_SYNC);
+    munmap(spoolConfig->file, sizeof(struct SpoolFile));
+    spoolConfig->file = NULL;
+
+    pthread_cond_destroy(&spoolConfig->wakeup);
+    pthread_mutex_destroy(&spoolConfig->lock);
+
+    if (spoolConfig->databaseConfig.database != NULL)
+    {
+        cleanupDatabase(&spoolConfig->databaseConfig);
+    }
+
+    spoolConfig->open = false;
+}
+
+
+
+static bool mapSpoolFile(struct SpoolConfig *spoolConfig)
+{
+    int fileDescriptor = open(spoolConfig->FILE_PATH, O_RDWR | O_CREAT, 0644);
+
+    if (fileDescriptor < 0)
+    {
+        fprintf(stderr, "Could not open the spool file %s.\n", spoolConfig->FILE_PATH);
+
+        return false;
+    }
+
+    struct stat fileStatus;
+    bool ready = fstat(fileDescriptor, &fileStatus) == 0;
+
+    // A new file. An existing one of the wrong size is left alone, it may still hold events.
+    if (ready && fileStatus.st_size == 0)
+    {
+        ready = fillSpoolFile(fileDescriptor);
+    }
+
+    else if (ready && fileStatus.st_size != (off_t)sizeof(struct SpoolFile))
+    {
+        fprintf(stderr, "The spool file %s is %lld bytes instead of %zu, move it away to start a new one.\n",
+                spoolConfig->FILE_PATH, (long long)fileStatus.st_size, sizeof(struct SpoolFile));
+        ready = false;
+    }
+
+    void *file = MAP_FAILED;
+
+    if (ready)
+    {
+        file = mmap(NULL, sizeof(struct SpoolFile), PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    }
+
+    // The mapping stays valid after the file is closed.
+    close(fileDescriptor);
+
+    if (file == MAP_FAILED)
+    {
+        fprintf(stderr, "Could not map the spool file %s, the spool is disabled.\n", spoolConfig->FILE_PATH);
+
+        return false;
+    }
+
+    // Keeps the pages in memory, so spooling an event never waits for the SD card to read one back.
+    // Fails without the permission to lock memory, which only makes spooling a little slower at times.
+    mlock(file, sizeof(struct SpoolFile));
+
+    spoolConfig->file = (struct SpoolFile *)file;
+
+    return true;
+}
+
+static bool fillSpoolFile(const int fileDescriptor)
+{
+    // Just setting the size would leave holes, and filling a hole needs a free block when the event is flushed.
+    static const uint8_t zeros[4096];
+
+    for (size_t offset = 0; offset < sizeof(struct SpoolFile); offset += sizeof(zeros))
+    {
+        size_t length = sizeof(struct SpoolFile) - offset < sizeof(zeros) ? sizeof(struct SpoolFile) - offset : sizeof(zeros);
+
+        if (pwrite(fileDescriptor, zeros, length, (off_t)offset) != (ssize_t)length)
+        {
+            fprintf(stderr, "Could not create the spool file, the disk may be full.\n");
+
+            return false;
+        }
+    }
+
+    return fsync(fileDescriptor) == 0;
+}
+
+static void recoverSpool(struct SpoolConfig *spoolConfig)
+{
+    // For readability.
+    struct SpoolFile *file = spoolConfig->file;
+
+    bool headerValid = file->header.magic == SPOOL_HEADER_MAGIC &&
+                       file->header.crc == calculateCRC32(&file->header, offsetof(struct SpoolHeader, crc));
+    uint64_t oldestSequence = 0;
+    uint64_t latestSequence = 0;
+
+    for (size_t slot = 0; slot < SPOOL_CAPACITY; slot++)
+    {
+        const struct SpoolRecord *record = &file->records[slot];
+
+        if (record->sequence == 0 || !isValidSpoolRecord(record, record->sequence) ||
+            (record->sequence - 1) % SPOOL_CAPACITY != slot)
+        {
+            continue;
+        }
+
+        if (oldestSequence == 0 || record->sequence < oldestSequence)
+        {
+            oldestSequence = record->sequence;
+        }
+
+        if (record->sequence > latestSequence)
+        {
+            latestSequence = record->sequence;
+        }
+    }
+
+    if (headerValid)
+    {
+        spoolConfig->replayedSequence = file->header.replayedSequence;
+    }
+
+    // Never written, or torn by a power cut. Saving every event in the file again is safe, the ones already
+    // in the database are found there.
+    else
+    {
+        spoolConfig->replayedSequence = oldestSequence > 0 ? oldestSequence - 1 : 0;
+    }
+
+    spoolConfig->nextSequence = (latestSequence > spoolConfig->replayedSequence ? latestSequence
+                                                                                : spoolConfig->replayedSequence) + 1;
+    spoolConfig->syncedSequence = spoolConfig->nextSequence;
+}
+
+static void *spoolThread(void *argument)
+{
+    struct SpoolConfig *spoolConfig = (struct SpoolConfig *)argument;
+
+    struct timespec nextReplayTime;
+    clock_gettime(CLOCK_MONOTONIC, &nextReplayTime);
+
+    pthread_mutex_lock(&spoolConfig->lock);
+
+    while (!spoolConfig->stopRequested)
+    {
+        bool pending = spoolConfig->nextSequence - 1 > spoolConfig->replayedSequence;
+
+        if (spoolConfig->syncedSequence < spoolConfig->nextSequence)
+        {
+            pthread_mutex_unlock(&spoolConfig->lock);
+
+            // Events spooled meanwhile are flushed together with the first one.
+            sleepMilliseconds(spoolConfig->SYNC_INTERVAL_MILLISECONDS);
+
+            pthread_mutex_lock(&spoolConfig->lock);
+            uint64_t syncedSequence = spoolConfig->nextSequence;
+            pthread_mutex_unlock(&spoolConfig->lock);
+
+            // Only the pages that changed are written.
+            msync(spoolConfig->file, sizeof(struct SpoolFile), MS_SYNC);
+
+            pthread_mutex_lock(&spoolConfig->lock);
+            spoolConfig->syncedSequence = syncedSequence;
+
+            continue;
+        }
+
+        struct timespec currentTime;
+        clock_gettime(CLOCK_MONOTONIC, &currentTime);
+
+        bool replayDue = currentTime.tv_sec > nextReplayTime.tv_sec ||
+                         (currentTime.tv_sec == nextReplayTime.tv_sec && currentTime.tv_nsec >= nextReplayTime.tv_nsec);
+
+        if (pending && replayDue)
+        {
+            pthread_mutex_unlock(&spoolConfig->lock);
+            bool replayed = replaySpooledEvents(spoolConfig);
+            pthread_mutex_lock(&spoolConfig->lock);
+
+            // The database is still failing, give it a moment.
+            if (!replayed)
+            {
+                nextReplayTime = currentTime;
+                addSeconds(&nextReplayTime, spoolConfig->RETRY_SECONDS);
+            }
+
+            continue;
+        }
+
+        if (pending)
+        {
+            pthread_cond_timedwait(&spoolConfig->wakeup, &spoolConfig->lock, &nextReplayTime);
+        }
+
+        else
+        {
+            pthread_cond_wait(&spoolConfig->wakeup, &spoolConfig->lock);
+        }
+    }
+
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    return NULL;
+}
+
+static bool replaySpooledEvents(struct SpoolConfig *spoolConfig)
+{
+    // For readability.
+    struct DatabaseConfig *databaseConfig = &spoolConfig->databaseConfig;
+
+    // The database may not have opened at all when the events were spooled.
+    if (databaseConfig->database == NULL && !openDatabaseConnection(databaseConfig, spoolConfig->databaseFilePath))
+    {
+        return false;
+    }
+
+    struct SpoolRecord records[SPOOL_REPLAY_BATCH];
+
+    // The slots can't be reused until replayedSequence moves past them, so a copy is safe to read without the lock.
+    pthread_mutex_lock(&spoolConfig->lock);
+
+    uint64_t firstSequence = spoolConfig->replayedSequence + 1;
+    uint64_t count = spoolConfig->nextSequence - firstSequence;
+
+    if (count > SPOOL_REPLAY_BATCH)
+    {
+        count = SPOOL_REPLAY_BATCH;
+    }
+
+    for (uint64_t index = 0; index < count; index++)
+    {
+        records[index] = spoolConfig->file->records[(firstSequence + index - 1) % SPOOL_CAPACITY];
+    }
+
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    if (!beginTransaction(databaseConfig))
+    {
+        return false;
+    }
+
+    unsigned long rejectedCount = 0;
+    unsigned long duplicateCount = 0;
+    unsigned long lostCount = 0;
+    // Log row IDs of the batch, 0 for events that weren't saved. Only journaled once the rows are committed for sure.
+    int64_t logIDs[SPOOL_REPLAY_BATCH];
+
+    for (uint64_t index = 0; index < count; index++)
+    {
+        const struct SpoolRecord *record = &records[index];
+        int64_t existingLogID = 0;
+        logIDs[index] = 0;
+
+        if (!isValidSpoolRecord(record, firstSequence + index))
+        {
+            lostCount++;
+
+            continue;
+        }
+
+        if (!selectLogRowIDByEvent(databaseConfig, record->userID, record->status, record->timestamp, &existingLogID))
+        {
+            rollbackTransaction(databaseConfig);
+
+            return false;
+        }
+
+        if (existingLogID != 0)
+        {
+            duplicateCount++;
+
+            continue;
+        }
+
+        struct ClockEventOutcome outcome;
+
+        if (!recordUsersClockEvent(databaseConfig, record->userID, record->status, record->timestamp, &outcome))
+        {
+            rollbackTransaction(databaseConfig);
+
+            return false;
+        }
+
+        if (outcome.result == CLOCK_EVENT_ACCEPTED)
+        {
+            logIDs[index] = outcome.logID;
+        }
+
+        else
+        {
+            rejectedCount++;
+        }
+    }
+
+    if (!commitTransaction(databaseConfig))
+    {
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    for (uint64_t index = 0; index < count; index++)
+    {
+        if (logIDs[index] != 0)
+        {
+            appendJournalRecord(spoolConfig->journalConfig, logIDs[index], records[index].userID, records[index].status,
+                                records[index].timestamp);
+        }
+    }
+
+    saveReplayedSequence(spoolConfig, firstSequence + count - 1);
+
+    unsigned long savedCount = (unsigned long)count - rejectedCount - duplicateCount - lostCount;
+
+    atomic_fetch_add_explicit(&spoolConfig->status.replayedCount, savedCount, memory_order_relaxed);
+    atomic_fetch_add_explicit(&spoolConfig->status.rejectedCount, rejectedCount, memory_order_relaxed);
+    atomic_fetch_add_explicit(&spoolConfig->status.duplicateCount, duplicateCount, memory_order_relaxed);
+    atomic_fetch_add_explicit(&spoolConfig->status.lostCount, lostCount, memory_order_relaxed);
+
+    return true;
+}
+
+static void saveReplayedSequence(struct SpoolConfig *spoolConfig, const uint64_t replayedSequence)
+{
+    struct SpoolHeader header = { .replayedSequence = replayedSequence, .magic = SPOOL_HEADER_MAGIC };
+    header.crc = calculateCRC32(&header, offsetof(struct SpoolHeader, crc));
+
+    pthread_mutex_lock(&spoolConfig->lock);
+    spoolConfig->file->header = header;
+    spoolConfig->replayedSequence = replayedSequence;
+    pthread_mutex_unlock(&spoolConfig->lock);
+
+    // Flushed without the lock, so spooling doesn't wait for it. If this doesn't reach the disk,
+    // the events are replayed again on the next start and found in the database.
+    msync(spoolConfig->file, sizeof(struct SpoolHeader), MS_SYNC);
+}
+
+static bool isValidSpoolRecord(const struct SpoolRecord *record, const uint64_t sequence)
+{
+    return record->sequence == sequence && record->crc == calculateCRC32(record, offsetof(struct SpoolRecord, crc));
+}
+
+static void addSeconds(struct timespec *time, const double seconds)
+{
+    long long nanoseconds = (long long)time->tv_nsec + (long long)(seconds * 1000000000.0);
+
+    time->tv_sec += (time_t)(nanoseconds / 1000000000LL);
+    time->tv_nsec = (long)(nanoseconds % 1000000000LL);
+}
+
+static void sleepMilliseconds(const long milliseconds)
+{
+    struct timespec duration = { .tv_sec = milliseconds / 1000, .tv_nsec = (milliseconds % 1000) * 1000000L };
+    nanosleep(&duration, NULL);
+}
@@ -5,14 +5,17 @@
  * @brief Handles getting the current time from system.
  * 
  * @date Created  2023-12-05
- * @date Modified 2023-12-05
+ * @date Modified 2024-01-23
  * 
  * @copyright Copyright (c) 2023
  */
 
 
 
-#include <time.h>               // timespec, clock_gettime(), CLOCK_REALTIME.
+#include <stdint.h>             // int64_t.
+#include <time.h>               // timespec, clock_gettime(), nanosleep(), CLOCK_REALTIME, CLOCK_MONOTONIC.
+
+#include "timer.h"
 
 
 
@@ -23,4 +26,36 @@ double getCurrentTimeInSeconds()
 
     // Adds up the amount of seconds (whole number) and amount of nanoseconds converted to seconds (double).
     return currentTime.tv_sec + (currentTime.tv_nsec / 1e9);
+}
+
+int64_t getCurrentTimeInMicroseconds()
+{
+    struct timespec currentTime;
+    clock_gettime(CLOCK_REALTIME, &currentTime);
+
+    // Multiplied as 64-bit, a 32-bit time_t * 1000000 would overflow.
+    return (int64_t)currentTime.tv_sec * 1000000 + currentTime.tv_nsec / 1000;
+}
+
+int64_t getMonotonicTimeInNanoseconds()
+{
+    struct timespec currentTime;
+    clock_gettime(CLOCK_MONOTONIC, &currentTime);
+
+    return (int64_t)currentTime.tv_sec * 1000000000 + currentTime.tv_nsec;
+}
+
+void sleepForSeconds(const double seconds)
+{
+    if (seconds <= 0)
+    {
+        return;
+    }
+
+    struct timespec duration;
+    duration.tv_sec = (time_t)seconds;
+    duration.tv_nsec = (long)((seconds - duration.tv_sec) * 1e9);
+
+    // Interrupted by a signal, like SIGINT, it returns early so the signal is handled right away.
+    nanosleep(&duration, NULL);
 }
\ No newline at end of file
@@ -0,0 +1,1067 @@
+/**
+ * @file clock_admin.c
+ * @author Selkamies
+ *
+ * @brief Command line tool for managing users and correcting log rows on the device itself.
+ *
+ * Usage: clock_admin [--database FILE] COMMAND [ARGUMENTS]
+ *        clock_admin [--database FILE] batch < COMMANDS
+ *
+ * Every value is bound to a cached prepared statement, nothing typed is pasted into SQL.
+ * Each command runs in its own short BEGIN IMMEDIATE transaction, and the database is in WAL mode,
+ * so clock_in keeps reading and writing while the tool runs and waits at most for one short commit.
+ *
+ * batch reads one command per line from standard input. Lines are committed together, at most
+ * BATCH_COMMIT_LINES lines or BATCH_COMMIT_SECONDS at a time, and right away whenever no more input
+ * is waiting, so the write lock is never held while waiting for input. A line that fails is undone
+ * on its own and reported with its line number, and the lines after it still run.
+ *
+ * Log rows that have been archived are no longer in the database and can't be corrected.
+ * Corrections aren't sent to the clock event journal, only new rows are, the next time clock_in starts.
+ * PINs are secrets and are never printed.
+ *
+ * @date Created  2024-01-21
+ * @date Modified 2024-01-21
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), fgets().
+#include <stdlib.h>             // strtol(), strtoll().
+#include <string.h>             // strcmp(), strlen(), strchr().
+#include <strings.h>            // strcasecmp().
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+#include <ctype.h>              // isspace().
+#include <limits.h>             // INT_MAX.
+#include <time.h>               // localtime_r(), mktime(), strftime().
+#include <poll.h>               // poll().
+
+#include <sqlite3.h>            // sqlite3_last_insert_rowid(), sqlite3_exec().
+
+#include "database.h"           // openDatabaseConnection(), updateUserRow(), deleteLogRow(), etc.
+#include "database_sql.h"       // SAVEPOINT_ADMIN_LINE, RELEASE_ADMIN_LINE, ROLLBACK_ADMIN_LINE.
+#include "database_config.h"    // struct DatabaseConfig, struct UserRow, struct LogRow.
+#include "timer.h"              // getCurrentTimeInSeconds(), getCurrentTimeInMicroseconds().
+
+
+
+/** @brief Users read per query by user-list and present. */
+#define LIST_PAGE_SIZE 100
+/** @brief Log rows printed by log-list if --limit is not given. */
+#define DEFAULT_LOG_LIST_LIMIT 20
+/** @brief Most log rows printed by log-list. */
+#define MAX_LOG_LIST_LIMIT 1000
+/** @brief Most batch lines committed in one transaction. */
+#define BATCH_COMMIT_LINES 100
+/** @brief Longest a batch transaction is kept open, in seconds. */
+#define BATCH_COMMIT_SECONDS 0.05
+/** @brief Longest batch line, including the newline and the null terminator. */
+#define BATCH_LINE_LENGTH 1024
+/** @brief Most words on a batch line, including the command. */
+#define BATCH_MAX_WORDS 16
+
+#define MICROSECONDS_PER_SECOND 1000000LL
+
+
+
+/**
+ * @brief Runs a command. arguments holds the words after the command name.
+ *
+ * @return true If the command succeeded.
+ * @return false If it failed. The error has been printed, and the caller rolls back its changes.
+ */
+typedef bool (*CommandFunction)(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+
+/**
+ * @brief A command of the tool.
+ */
+struct AdminCommand
+{
+    const char *name;
+    /** @brief Arguments, shown in the usage. */
+    const char *usage;
+    int minArgumentCount;
+    int maxArgumentCount;
+    /** @brief Whether the command writes, and has to run inside a transaction. */
+    bool writes;
+    CommandFunction run;
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Runs one command from the command line in its own transaction.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param argumentCount Number of words, including the command name.
+ * @param arguments The words.
+ *
+ * @return true If the command succeeded and was committed.
+ * @return false If it failed. Nothing was changed.
+ */
+static bool runCommand(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+
+/**
+ * @brief Runs commands read from standard input, one per line. Empty lines and lines starting with # are skipped.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ *
+ * @return true If every line succeeded.
+ * @return false If a line failed, or a commit failed.
+ */
+static bool runBatch(struct DatabaseConfig *databaseConfig);
+
+/**
+ * @brief Finds a command and checks its number of arguments.
+ *
+ * @param argumentCount Number of words, including the command name.
+ * @param arguments The words.
+ *
+ * @return The command, or NULL after printing why not.
+ */
+static const struct AdminCommand *findCommand(const int argumentCount, char **arguments);
+
+/**
+ * @brief Splits a line into words in place. Words are separated by whitespace, "double quotes" keep spaces in a word.
+ *
+ * @param line The line. Changed in place.
+ * @param words Array the words are saved to.
+ * @param maxWords Size of the words array.
+ * @param wordCount Pointer to the number of words.
+ *
+ * @return true If the line was split.
+ * @return false If it has too many words or an unclosed quote.
+ */
+static bool splitWords(char *line, char **words, const int maxWords, int *wordCount);
+
+/**
+ * @brief Checks whether standard input has more to read right away.
+ *
+ * @return true If there is input waiting, or its end has been reached.
+ * @return false If reading would wait.
+ */
+static bool isInputWaiting(void);
+
+static bool runUserAdd(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runUserEdit(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runUserRemove(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runUserList(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runPresent(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runLogAdd(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runLogEdit(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runLogRemove(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+static bool runLogList(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments);
+
+/**
+ * @brief Prints users page by page.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param presentOnly Whether only users who are clocked in are printed.
+ *
+ * @return true If every user was printed.
+ * @return false If something went wrong.
+ */
+static bool printUsers(struct DatabaseConfig *databaseConfig, const bool presentOnly);
+
+/**
+ * @brief Checks whether a user exists.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userID ID of the user.
+ * @param found Pointer to whether the user exists.
+ *
+ * @return true If the query succeeded.
+ * @return false If something went wrong.
+ */
+static bool userExists(struct DatabaseConfig *databaseConfig, const int userID, bool *found);
+
+/**
+ * @brief Checks that a name is not empty and fits in struct UserRow.
+ *
+ * @param name The name.
+ *
+ * @return true If the name is valid.
+ * @return false If it isn't. The error has been printed.
+ */
+static bool isValidName(const char *name);
+
+/**
+ * @brief Reads a positive ID.
+ *
+ * @param text The ID as text.
+ * @param maxValue Largest allowed ID.
+ * @param value Pointer to the ID.
+ *
+ * @return true If the text is a whole number from 1 to maxValue.
+ * @return false If it isn't. The error has been printed.
+ */
+static bool parseID(const char *text, const long long maxValue, long long *value);
+
+/**
+ * @brief Reads "in" or "out".
+ *
+ * @param text The status as text.
+ * @param status Pointer to LOG_STATUS_IN or LOG_STATUS_OUT.
+ *
+ * @return true If the text is a status.
+ * @return false If it isn't. The error has been printed.
+ */
+static bool parseStatus(const char *text, int *status);
+
+/**
+ * @brief Reads a local time like "2024-01-21 08:00" or "2024-01-21 08:00:30", or "now".
+ *
+ * @param text The time as text. A T between the date and the time works too.
+ * @param timestamp Pointer to the time in microseconds since the Unix epoch.
+ *
+ * @return true If the text is a valid time.
+ * @return false If it isn't. The error has been printed.
+ */
+static bool parseLocalTime(const char *text, int64_t *timestamp);
+
+/**
+ * @brief Formats a time as local time, like "2024-01-21 08:00:30".
+ *
+ * @param timestamp Microseconds since the Unix epoch.
+ * @param buffer Buffer the time is written to.
+ * @param size Size of the buffer.
+ */
+static void formatLocalTime(const int64_t timestamp, char *buffer, const size_t size);
+
+/**
+ * @brief Returns a status as text.
+ *
+ * @param status LOG_STATUS_IN, LOG_STATUS_OUT or LOG_STATUS_ERROR.
+ *
+ * @return "IN", "OUT" or "-".
+ */
+static const char *statusName(const int status);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+static const struct AdminCommand commands[] =
+{
+    { "user-add",    "FIRST LAST PIN",                                3, 3, true,  runUserAdd },
+    { "user-edit",   "USER_ID [--first NAME] [--last NAME] [--pin PIN]", 3, 7, true,  runUserEdit },
+    { "user-remove", "USER_ID [--with-log]",                          1, 2, true,  runUserRemove },
+    { "user-list",   "",                                              0, 0, false, runUserList },
+    { "present",     "",                                              0, 0, false, runPresent },
+    { "log-add",     "USER_ID in|out TIME",                           3, 3, true,  runLogAdd },
+    { "log-edit",    "LOG_ID [--time TIME] [--status in|out]",        3, 5, true,  runLogEdit },
+    { "log-remove",  "LOG_ID",                                        1, 1, true,  runLogRemove },
+    { "log-list",    "USER_ID [--limit N]",                           1, 3, false, runLogList }
+};
+
+static const int commandCount = sizeof(commands) / sizeof(commands[0]);
+
+
+
+int main(int argc, char **argv)
+{
+    const char *databasePath = DATABASE_FILEPATH;
+    int commandIndex = 1;
+
+    if (argc > 2 && strcmp(argv[1], "--database") == 0)
+    {
+        databasePath = argv[2];
+        commandIndex = 3;
+    }
+
+    if (commandIndex >= argc)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    bool batch = strcmp(argv[commandIndex], "batch") == 0;
+
+    if (batch ? commandIndex + 1 != argc : findCommand(argc - commandIndex, argv + commandIndex) == NULL)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    struct DatabaseConfig databaseConfig;
+    setDatabaseToolSettings(&databaseConfig.settings);
+
+    if (!openDatabaseConnection(&databaseConfig, databasePath))
+    {
+        return 1;
+    }
+
+    bool succeeded = batch ? runBatch(&databaseConfig) : runCommand(&databaseConfig, argc - commandIndex, argv + commandIndex);
+
+    cleanupDatabase(&databaseConfig);
+
+    return succeeded ? 0 : 1;
+}
+
+
+
+static bool runCommand(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    const struct AdminCommand *command = findCommand(argumentCount, arguments);
+
+    if (command == NULL)
+    {
+        return false;
+    }
+
+    if (!command->writes)
+    {
+        return command->run(databaseConfig, argumentCount - 1, arguments + 1);
+    }
+
+    if (!beginTransaction(databaseConfig))
+    {
+        return false;
+    }
+
+    if (!command->run(databaseConfig, argumentCount - 1, arguments + 1) || !commitTransaction(databaseConfig))
+    {
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool runBatch(struct DatabaseConfig *databaseConfig)
+{
+    char line[BATCH_LINE_LENGTH];
+    char *words[BATCH_MAX_WORDS];
+    unsigned long lineNumber = 0;
+    unsigned long succeededCount = 0;
+    unsigned long failedCount = 0;
+    bool inTransaction = false;
+    bool stopped = false;
+    int pendingLines = 0;
+    double transactionStartTime = 0.0;
+
+    while (!stopped && fgets(line, sizeof(line), stdin) != NULL)
+    {
+        lineNumber++;
+        size_t length = strlen(line);
+
+        if (length == sizeof(line) - 1 && line[length - 1] != '\n')
+        {
+            fprintf(stderr, "Line %lu: longer than %d characters, skipped.\n", lineNumber, BATCH_LINE_LENGTH - 2);
+            failedCount++;
+
+            // Skip the rest of the line.
+            int character;
+            while ((character = getchar()) != '\n' && character != EOF);
+
+            continue;
+        }
+
+        int wordCount = 0;
+
+        if (!splitWords(line, words, BATCH_MAX_WORDS, &wordCount))
+        {
+            fprintf(stderr, "Line %lu: more than %d words or an unclosed quote, skipped.\n", lineNumber, BATCH_MAX_WORDS);
+            failedCount++;
+
+            continue;
+        }
+
+        if (wordCount == 0 || words[0][0] == '#')
+        {
+            continue;
+        }
+
+        const struct AdminCommand *command = findCommand(wordCount, words);
+
+        if (command == NULL)
+        {
+            fprintf(stderr, "Line %lu: skipped.\n", lineNumber);
+            failedCount++;
+
+            continue;
+        }
+
+        if (command->writes && !inTransaction)
+        {
+            if (!beginTransaction(databaseConfig))
+            {
+                stopped = true;
+
+                break;
+            }
+
+            inTransaction = true;
+            transactionStartTime = getCurrentTimeInSeconds();
+        }
+
+        if (inTransaction && sqlite3_exec(databaseConfig->database, SAVEPOINT_ADMIN_LINE, NULL, NULL, NULL) != SQLITE_OK)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig->database));
+            stopped = true;
+
+            break;
+        }
+
+        bool succeeded = command->run(databaseConfig, wordCount - 1, words + 1);
+
+        if (inTransaction)
+        {
+            sqlite3_exec(databaseConfig->database, succeeded ? RELEASE_ADMIN_LINE : ROLLBACK_ADMIN_LINE, NULL, NULL, NULL);
+            pendingLines++;
+        }
+
+        if (succeeded)
+        {
+            succeededCount++;
+        }
+
+        else
+        {
+            fprintf(stderr, "Line %lu: %s failed, nothing on the line was changed.\n", lineNumber, command->name);
+            failedCount++;
+        }
+
+        // Never keep the write lock while waiting for more input, or for too long.
+        if (inTransaction && (pendingLines >= BATCH_COMMIT_LINES ||
+                              getCurrentTimeInSeconds() - transactionStartTime >= BATCH_COMMIT_SECONDS || !isInputWaiting()))
+        {
+            inTransaction = false;
+            pendingLines = 0;
+            stopped = !commitTransaction(databaseConfig);
+        }
+    }
+
+    // Whatever stopped the batch early, the lines not yet committed are not saved.
+    if (stopped || (inTransaction && !commitTransaction(databaseConfig)))
+    {
+        rollbackTransaction(databaseConfig);
+        fprintf(stderr, "Batch stopped at line %lu, lines since the last commit were not saved.\n", lineNumber);
+
+        return false;
+    }
+
+    printf("%lu line(s) succeeded, %lu failed.\n", succeededCount, failedCount);
+
+    return failedCount == 0;
+}
+
+static const struct AdminCommand *findCommand(const int argumentCount, char **arguments)
+{
+    for (int index = 0; index < commandCount; index++)
+    {
+        const struct AdminCommand *command = &commands[index];
+
+        if (strcmp(arguments[0], command->name) != 0)
+        {
+            continue;
+        }
+
+        if (argumentCount - 1 < command->minArgumentCount || argumentCount - 1 > command->maxArgumentCount)
+        {
+            fprintf(stderr, "Usage: %s %s\n", command->name, command->usage);
+
+            return NULL;
+        }
+
+        return command;
+    }
+
+    fprintf(stderr, "Unknown command: %s\n", arguments[0]);
+
+    return NULL;
+}
+
+static bool splitWords(char *line, char **words, const int maxWords, int *wordCount)
+{
+    char *read = line;
+    *wordCount = 0;
+
+    while (true)
+    {
+        while (isspace((unsigned char)*read))
+        {
+            read++;
+        }
+
+        if (*read == '\0')
+        {
+            return true;
+        }
+
+        if (*wordCount == maxWords)
+        {
+            return false;
+        }
+
+        if (*read == '"')
+        {
+            char *end = strchr(++read, '"');
+
+            if (end == NULL)
+            {
+                return false;
+            }
+
+            *end = '\0';
+            words[(*wordCount)++] = read;
+            read = end + 1;
+
+            continue;
+        }
+
+        words[(*wordCount)++] = read;
+
+        while (*read != '\0' && !isspace((unsigned char)*read))
+        {
+            read++;
+        }
+
+        if (*read != '\0')
+        {
+            *read++ = '\0';
+        }
+    }
+}
+
+static bool isInputWaiting(void)
+{
+    struct pollfd input = { .fd = fileno(stdin), .events = POLLIN };
+
+    // Lines already buffered by stdio don't show up here, then the batch just commits a little more often.
+    return poll(&input, 1, 0) > 0;
+}
+
+static bool runUserAdd(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    (void)argumentCount;
+
+    if (!isValidName(arguments[0]) || !isValidName(arguments[1]))
+    {
+        return false;
+    }
+
+    if (arguments[2][0] == '\0')
+    {
+        fprintf(stderr, "The PIN can't be empty.\n");
+
+        return false;
+    }
+
+    enum UserRowResult result;
+
+    if (!saveUserRow(databaseConfig, arguments[0], arguments[1], arguments[2], false, &result))
+    {
+        return false;
+    }
+
+    if (result != USER_ROW_INSERTED)
+    {
+        // The PIN itself is not printed, it's a secret.
+        fprintf(stderr, "Another user already has the PIN.\n");
+
+        return false;
+    }
+
+    printf("User %lld added.\n", (long long)sqlite3_last_insert_rowid(databaseConfig->database));
+
+    return true;
+}
+
+static bool runUserEdit(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    long long userID;
+    const char *firstName = NULL;
+    const char *lastName = NULL;
+    const char *pin = NULL;
+
+    if (!parseID(arguments[0], INT_MAX, &userID))
+    {
+        return false;
+    }
+
+    for (int index = 1; index < argumentCount; index += 2)
+    {
+        const char *value = index + 1 < argumentCount ? arguments[index + 1] : NULL;
+
+        if (value == NULL)
+        {
+            fprintf(stderr, "%s needs a value.\n", arguments[index]);
+
+            return false;
+        }
+
+        if (strcmp(arguments[index], "--first") == 0)      firstName = value;
+        else if (strcmp(arguments[index], "--last") == 0)  lastName = value;
+        else if (strcmp(arguments[index], "--pin") == 0)   pin = value;
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", arguments[index]);
+
+            return false;
+        }
+    }
+
+
+    if ((firstName != NULL && !isValidName(firstName)) || (lastName != NULL && !isValidName(lastName)))
+    {
+        return false;
+    }
+
+    if (pin != NULL && pin[0] == '\0')
+    {
+        fprintf(stderr, "The PIN can't be empty.\n");
+
+        return false;
+    }
+
+    bool found = false;
+
+    // A PIN another user has fails the UNIQUE constraint, and the error is printed by the update.
+    if (!updateUserRow(databaseConfig, (int)userID, firstName, lastName, pin, &found))
+    {
+        return false;
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "There is no user %lld.\n", userID);
+
+        return false;
+    }
+
+    printf("User %lld updated.\n", userID);
+
+    return true;
+}
+
+static bool runUserRemove(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    long long userID;
+    bool withLogRows = false;
+
+    if (!parseID(arguments[0], INT_MAX, &userID))
+    {
+        return false;
+    }
+
+    if (argumentCount == 2)
+    {
+        if (strcmp(arguments[1], "--with-log") != 0)
+        {
+            fprintf(stderr, "Unknown option: %s\n", arguments[1]);
+
+            return false;
+        }
+
+        withLogRows = true;
+    }
+
+    bool found = false;
+    bool hasLogRows = false;
+
+    if (!deleteUserRow(databaseConfig, (int)userID, withLogRows, &found, &hasLogRows))
+    {
+        return false;
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "There is no user %lld.\n", userID);
+
+        return false;
+    }
+
+    if (hasLogRows && !withLogRows)
+    {
+        fprintf(stderr, "User %lld has log rows. Remove them too with --with-log.\n", userID);
+
+        return false;
+    }
+
+    printf("User %lld removed%s.\n", userID, hasLogRows ? " with their log rows" : "");
+
+    return true;
+}
+
+static bool runUserList(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    (void)argumentCount;
+    (void)arguments;
+
+    return printUsers(databaseConfig, false);
+}
+
+static bool runPresent(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    (void)argumentCount;
+    (void)arguments;
+
+    return printUsers(databaseConfig, true);
+}
+
+static bool runLogAdd(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    (void)argumentCount;
+
+    long long userID;
+    int status;
+    int64_t timestamp;
+    bool found = false;
+
+    if (!parseID(arguments[0], INT_MAX, &userID) || !parseStatus(arguments[1], &status) ||
+        !parseLocalTime(arguments[2], &timestamp) || !userExists(databaseConfig, (int)userID, &found))
+    {
+        return false;
+    }
+
+    // Foreign keys aren't enforced, so the user is checked here.
+    if (!found)
+    {
+        fprintf(stderr, "There is no user %lld.\n", userID);
+
+        return false;
+    }
+
+    // Corrections aren't checked against the user's previous status, that's for the admin to decide.
+    if (!insertLogRow(databaseConfig, (int)userID, status, timestamp))
+    {
+        return false;
+    }
+
+    printf("Log row %lld added.\n", (long long)sqlite3_last_insert_rowid(databaseConfig->database));
+
+    return true;
+}
+
+static bool runLogEdit(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    long long logID;
+    int64_t timestamp;
+    int status;
+    bool hasTimestamp = false;
+    bool hasStatus = false;
+
+    if (!parseID(arguments[0], INT64_MAX, &logID))
+    {
+        return false;
+    }
+
+    for (int index = 1; index < argumentCount; index += 2)
+    {
+        const char *value = index + 1 < argumentCount ? arguments[index + 1] : NULL;
+
+        if (value == NULL)
+        {
+            fprintf(stderr, "%s needs a value.\n", arguments[index]);
+
+            return false;
+        }
+
+        else if (strcmp(arguments[index], "--time") == 0)
+        {
+            if (!parseLocalTime(value, &timestamp))
+            {
+                return false;
+            }
+
+            hasTimestamp = true;
+        }
+
+        else if (strcmp(arguments[index], "--status") == 0)
+        {
+            if (!parseStatus(value, &status))
+            {
+                return false;
+            }
+
+            hasStatus = true;
+        }
+
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", arguments[index]);
+
+            return false;
+        }
+    }
+
+    bool found = false;
+
+    if (!updateLogRow(databaseConfig, (int64_t)logID, hasTimestamp ? &timestamp : NULL, hasStatus ? &status : NULL, &found))
+    {
+        return false;
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "There is no log row %lld. Archived rows can't be corrected.\n", logID);
+
+        return false;
+    }
+
+    printf("Log row %lld updated.\n", logID);
+
+    return true;
+}
+
+static bool runLogRemove(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    (void)argumentCount;
+
+    long long logID;
+    bool found = false;
+
+    if (!parseID(arguments[0], INT64_MAX, &logID) || !deleteLogRow(databaseConfig, (int64_t)logID, &found))
+    {
+        return false;
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "There is no log row %lld. Archived rows can't be removed.\n", logID);
+
+        return false;
+    }
+
+    printf("Log row %lld removed.\n", logID);
+
+    return true;
+}
+
+static bool runLogList(struct DatabaseConfig *databaseConfig, const int argumentCount, char **arguments)
+{
+    long long userID;
+    long long limit = DEFAULT_LOG_LIST_LIMIT;
+
+    if (!parseID(arguments[0], INT_MAX, &userID))
+    {
+        return false;
+    }
+
+    if (argumentCount > 1 && (argumentCount != 3 || strcmp(arguments[1], "--limit") != 0))
+    {
+        fprintf(stderr, "Usage: log-list USER_ID [--limit N]\n");
+
+        return false;
+    }
+
+    if (argumentCount == 3 && !parseID(arguments[2], MAX_LOG_LIST_LIMIT, &limit))
+    {
+        return false;
+    }
+
+    struct LogRow rows[MAX_LOG_LIST_LIMIT];
+    int rowCount = 0;
+
+    if (!selectUsersLatestLogRows(databaseConfig, (int)userID, rows, (int)limit, &rowCount))
+    {
+        return false;
+    }
+
+    printf("log_id\tdatetime\tstatus\n");
+
+    for (int index = 0; index < rowCount; index++)
+    {
+        char datetime[sizeof("YYYY-MM-DD HH:MM:SS")];
+        formatLocalTime(rows[index].datetime, datetime, sizeof(datetime));
+
+        printf("%lld\t%s\t%s\n", (long long)rows[index].id, datetime, statusName(rows[index].status));
+    }
+
+    return true;
+}
+
+static bool printUsers(struct DatabaseConfig *databaseConfig, const bool presentOnly)
+{
+    struct UserRow rows[LIST_PAGE_SIZE];
+    int rowCount = LIST_PAGE_SIZE;
+    int lastID = 0;
+    unsigned long userCount = 0;
+
+    printf("user_id\tfirst_name\tlast_name\tstatus\tsince\n");
+
+    // Read in pages by ID, so a large user table is never held in memory or behind one long read.
+    while (rowCount == LIST_PAGE_SIZE)
+    {
+        if (!selectUserRowsAfterID(databaseConfig, lastID, presentOnly, rows, LIST_PAGE_SIZE, &rowCount))
+        {
+            return false;
+        }
+
+        for (int index = 0; index < rowCount; index++)
+        {
+            char since[sizeof("YYYY-MM-DD HH:MM:SS")] = "-";
+
+            if (rows[index].status != LOG_STATUS_ERROR)
+            {
+                formatLocalTime(rows[index].since, since, sizeof(since));
+            }
+
+            printf("%d\t%s\t%s\t%s\t%s\n", rows[index].id, rows[index].firstName, rows[index].lastName,
+                   statusName(rows[index].status), since);
+        }
+
+        if (rowCount > 0)
+        {
+            lastID = rows[rowCount - 1].id;
+        }
+
+        userCount += (unsigned long)rowCount;
+    }
+
+    fprintf(stderr, "%lu user(s)%s.\n", userCount, presentOnly ? " clocked in" : "");
+
+    return true;
+}
+
+static bool userExists(struct DatabaseConfig *databaseConfig, const int userID, bool *found)
+{
+    struct UserRow row;
+    int rowCount = 0;
+
+    if (!selectUserRowsAfterID(databaseConfig, userID - 1, false, &row, 1, &rowCount))
+    {
+        return false;
+    }
+
+    *found = rowCount == 1 && row.id == userID;
+
+    return true;
+}
+
+static bool isValidName(const char *name)
+{
+    if (name[0] == '\0' || strlen(name) >= USER_NAME_LENGTH)
+    {
+        fprintf(stderr, "Names have to be 1-%d characters long.\n", USER_NAME_LENGTH - 1);
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseID(const char *text, const long long maxValue, long long *value)
+{
+    char *end = NULL;
+    long long number = strtoll(text, &end, 10);
+
+    if (end == text || *end != '\0' || number < 1 || number > maxValue)
+    {
+        fprintf(stderr, "Not a valid number: %s\n", text);
+
+        return false;
+    }
+
+    *value = number;
+
+    return true;
+}
+
+static bool parseStatus(const char *text, int *status)
+{
+    if (strcasecmp(text, "in") == 0)
+    {
+        *status = LOG_STATUS_IN;
+    }
+
+    else if (strcasecmp(text, "out") == 0)
+    {
+        *status = LOG_STATUS_OUT;
+    }
+
+    else
+    {
+        fprintf(stderr, "The status has to be in or out, not %s.\n", text);
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseLocalTime(const char *text, int64_t *timestamp)
+{
+    if (strcmp(text, "now") == 0)
+    {
+        *timestamp = getCurrentTimeInMicroseconds();
+
+        return true;
+    }
+
+    int year, month, day, hour, minute, second = 0;
+    char separator;
+    int length = 0;
+    int secondsLength = 0;
+
+    bool parsed = sscanf(text, "%4d-%2d-%2d%c%2d:%2d%n", &year, &month, &day, &separator, &hour, &minute, &length) == 6 &&
+                  (separator == ' ' || separator == 'T');
+
+    // Seconds are optional.
+    if (parsed && text[length] != '\0')
+    {
+        parsed = sscanf(text + length, ":%2d%n", &second, &secondsLength) == 1 && text[length + secondsLength] == '\0';
+    }
+
+    struct tm date = { .tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day,
+                       .tm_hour = hour, .tm_min = minute, .tm_sec = second, .tm_isdst = -1 };
+    time_t seconds = parsed ? mktime(&date) : (time_t)-1;
+
+    // mktime() normalizes dates like 2024-02-30 and times skipped by DST, so a time it had to move wasn't a real one.
+    if (seconds == (time_t)-1 || date.tm_year != year - 1900 || date.tm_mon != month - 1 || date.tm_mday != day ||
+        date.tm_hour != hour || date.tm_min != minute || date.tm_sec != second)
+    {
+        fprintf(stderr, "Not a valid time: %s. Use \"YYYY-MM-DD HH:MM[:SS]\" or now.\n", text);
+
+        return false;
+    }
+
+    *timestamp = (int64_t)seconds * MICROSECONDS_PER_SECOND;
+
+    return true;
+}
+
+static void formatLocalTime(const int64_t timestamp, char *buffer, const size_t size)
+{
+    time_t seconds = (time_t)(timestamp / MICROSECONDS_PER_SECOND);
+    struct tm date;
+    localtime_r(&seconds, &date);
+    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &date);
+}
+
+static const char *statusName(const int status)
+{
+    return status == LOG_STATUS_IN ? "IN" : status == LOG_STATUS_OUT ? "OUT" : "-";
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s [--database FILE] COMMAND [ARGUMENTS]\n", programName);
+    fprintf(stderr, "       %s [--database FILE] batch < COMMANDS\n", programName);
+    fprintf(stderr, "Commands:\n");
+
+    for (int index = 0; index < commandCount; index++)
+    {
+        fprintf(stderr, "  %-12s %s\n", commands[index].name, commands[index].usage);
+    }
+
+    fprintf(stderr, "  %-12s %s\n", "batch", "Read commands from standard input, one per line.");
+    fprintf(stderr, "TIME is local time, \"YYYY-MM-DD HH:MM[:SS]\" or now.\n");
+    fprintf(stderr, "--database FILE Database file. Default %s.\n", DATABASE_FILEPATH);
+}
@@ -0,0 +1,614 @@
+/**
+ * @file clock_db_bench.c
+ * @author Selkamies
+ *
+ * @brief Command line tool that measures how the clock event queries of database.c scale with the data.
+ *
+ * Usage: clock_db_bench [--users N] [--log-rows N] [--samples N] [--inserts N] [--profile NAME] [--seed N]
+ *                       [--plan-only] [--database FILE]
+ *
+ * First the database is filled with synthetic users and log rows up to --users and --log-rows. Rows that are
+ * already there are kept, so a run with larger numbers grows the same file instead of starting over.
+ * Generated users have 8-digit PINs and their log rows alternate between IN and OUT, one second apart.
+ *
+ * Then every hot query is checked with EXPLAIN QUERY PLAN. A query that scans a whole table or index instead
+ * of searching it fails the run, whatever the latencies are.
+ *
+ * Finally the database is opened again the way clock_in opens it and selectUserIDByPIN() (with and without the
+ * in-memory PIN index), selectUsersLatestLogStatus() and insertLogRow() are timed one call at a time.
+ * p50, p99 and p99.9 latencies and the throughput are printed for each. Every insertLogRow() is its own
+ * transaction, like a clock event saved by the main loop, so it includes the disk flush of the profile.
+ * The inserted rows stay in the database.
+ *
+ * @date Created  2024-01-20
+ * @date Modified 2024-01-20
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), snprintf().
+#include <stdlib.h>             // atoll(), malloc(), free(), qsort().
+#include <string.h>             // strcmp(), strncmp().
+#include <stdbool.h>
+#include <stdint.h>             // int64_t, uint64_t.
+#include <time.h>               // clock_gettime().
+#include <sqlite3.h>            // sqlite3_prepare_v2(), sqlite3_step(), etc. for EXPLAIN QUERY PLAN.
+
+#include "database.h"           // openDatabaseConnection(), openOrCreateDatabase(), selectUserIDByPIN(), etc.
+#include "database_config.h"    // struct DatabaseConfig.
+#include "database_sql.h"       // The SQL of the hot queries.
+#include "timer.h"              // getCurrentTimeInSeconds(), getCurrentTimeInMicroseconds().
+
+
+
+#define DEFAULT_USER_COUNT 10000
+#define DEFAULT_LOG_ROW_COUNT 1000000
+/** @brief Calls timed per read operation if --samples is not given. */
+#define DEFAULT_SAMPLE_COUNT 100000
+/** @brief insertLogRow() calls timed if --inserts is not given. Each one flushes to disk, so there are fewer. */
+#define DEFAULT_INSERT_COUNT 1000
+#define MAX_USER_COUNT 1000000LL
+#define MAX_LOG_ROW_COUNT 50000000LL
+/** @brief Rows generated per transaction. */
+#define GENERATE_BATCH_SIZE 100000
+/** @brief Database file if --database is not given. Not database.db, so the real data is never touched. */
+#define DEFAULT_BENCH_DATABASE "bench.db"
+
+/** @brief Generated PINs are 8 digits. The multiplier is coprime with 10^8, so every user gets a different PIN. */
+#define GENERATED_PIN_MODULUS 100000000LL
+#define GENERATED_PIN_MULTIPLIER 48271LL
+#define GENERATED_PIN_LENGTH 8
+/** @brief Room for a formatted PIN, with some to spare so the compiler can tell it always fits. */
+#define GENERATED_PIN_BUFFER_LENGTH 16
+/** @brief Time of the first generated log row, 2024-01-01 00:00:00 UTC in microseconds. */
+#define GENERATED_LOG_START 1704067200000000LL
+#define MICROSECONDS_PER_SECOND 1000000LL
+
+
+
+/**
+ * @brief A query clock_in runs on every clock event or often enough that it must never scan.
+ */
+struct HotQuery
+{
+    /** @brief Name printed in the plan check. */
+    const char *name;
+    const char *sql;
+};
+
+/**
+ * @brief Latencies of one operation, in nanoseconds.
+ */
+struct LatencySamples
+{
+    int64_t *nanoseconds;
+    long count;
+    /** @brief Time from the first call to the end of the last one. */
+    int64_t totalNanoseconds;
+};
+
+
+
+/** @brief Checked by the plan check, in the order they are printed. */
+static const struct HotQuery hotQueries[] =
+{
+    { "selectUserIDByPIN", SELECT_USER_ID_BY_PIN },
+    { "selectUsersLatestLogStatus", SELECT_USER_STATUS_BY_USER_ID },
+    { "latest log row of a user", SELECT_LOG_ROW_BY_USER_ID_LATEST },
+    { "log_update/delete_user_status trigger", REFRESH_USER_STATUS("?") },
+    { "PIN index refresh", SELECT_USER_CHANGES_AFTER_ID },
+    { "selectLogRowsAfterID", SELECT_LOG_ROWS_AFTER_ID },
+};
+
+/** @brief State of the xorshift64 generator. Fixed by --seed, so runs pick the same users. */
+static uint64_t randomState = 1;
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Adds users and log rows until there are as many as asked for.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param userCount Users wanted in the database.
+ * @param logRowCount Log rows wanted in the database.
+ *
+ * @return true If the data was generated.
+ * @return false If something went wrong.
+ */
+static bool generateData(struct DatabaseConfig *databaseConfig, const long long userCount, const long long logRowCount);
+
+/**
+ * @brief Runs EXPLAIN QUERY PLAN for every hot query and prints the plans.
+ *
+ * @param database The database connection.
+ *
+ * @return true If no hot query scans a table or index.
+ * @return false If one does, or a plan couldn't be read.
+ */
+static bool checkQueryPlans(sqlite3 *database);
+
+/**
+ * @brief Times every operation and prints the results.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements. Has the PIN index.
+ * @param userCount Users in the database.
+ * @param sampleCount Calls timed per read operation.
+ * @param insertCount insertLogRow() calls timed.
+ *
+ * @return true If every call succeeded.
+ * @return false If something went wrong.
+ */
+static bool runBenchmarks(struct DatabaseConfig *databaseConfig, const long long userCount, const long sampleCount,
+                          const long insertCount);
+
+/**
+ * @brief Sorts the samples and prints their percentiles and the throughput.
+ *
+ * @param name Name of the operation.
+ * @param samples The samples.
+ */
+static void printLatencies(const char *name, struct LatencySamples *samples);
+
+/**
+ * @brief Formats the PIN of a generated user.
+ *
+ * @param buffer GENERATED_PIN_BUFFER_LENGTH characters.
+ * @param userNumber 0 for the first generated user, then one more for every user.
+ */
+static void formatGeneratedPIN(char *buffer, const long long userNumber);
+
+/**
+ * @brief Selects a single integer, like a count.
+ *
+ * @param database The database connection.
+ * @param sql The SELECT statement.
+ * @param value Pointer to the value we're looking to get.
+ *
+ * @return true If the value was selected.
+ * @return false If something went wrong.
+ */
+static bool selectCount(sqlite3 *database, const char *sql, long long *value);
+
+/**
+ * @brief Returns a monotonic time in nanoseconds, for timing calls.
+ *
+ * @return int64_t Nanoseconds since an unspecified point.
+ */
+static int64_t getMonotonicNanoseconds(void);
+
+/**
+ * @brief Returns a pseudo-random number from 0 to limit - 1.
+ *
+ * @param limit Upper bound, exclusive.
+ *
+ * @return long long The number.
+ */
+static long long randomBelow(const long long limit);
+
+/**
+ * @brief Compares two samples for qsort().
+ */
+static int compareSamples(const void *first, const void *second);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+int main(int argc, char **argv)
+{
+    const char *databasePath = DEFAULT_BENCH_DATABASE;
+    const char *profileName = DATABASE_DEFAULT_PROFILE;
+    long long userCount = DEFAULT_USER_COUNT;
+    long long logRowCount = DEFAULT_LOG_ROW_COUNT;
+    long long sampleCount = DEFAULT_SAMPLE_COUNT;
+    long long insertCount = DEFAULT_INSERT_COUNT;
+    long long seed = 1;
+    bool planOnly = false;
+    bool argumentsValid = true;
+
+    for (int index = 1; index < argc && argumentsValid; index++)
+    {
+        bool hasValue = index + 1 < argc;
+
+        if (strcmp(argv[index], "--users") == 0 && hasValue)             userCount = atoll(argv[++index]);
+        else if (strcmp(argv[index], "--log-rows") == 0 && hasValue)     logRowCount = atoll(argv[++index]);
+        else if (strcmp(argv[index], "--samples") == 0 && hasValue)      sampleCount = atoll(argv[++index]);
+        else if (strcmp(argv[index], "--inserts") == 0 && hasValue)      insertCount = atoll(argv[++index]);
+        else if (strcmp(argv[index], "--profile") == 0 && hasValue)      profileName = argv[++index];
+        else if (strcmp(argv[index], "--seed") == 0 && hasValue)         seed = atoll(argv[++index]);
+        else if (strcmp(argv[index], "--database") == 0 && hasValue)     databasePath = argv[++index];
+        else if (strcmp(argv[index], "--plan-only") == 0)                planOnly = true;
+        else                                                             argumentsValid = false;
+    }
+
+    if (!argumentsValid || userCount < 1 || userCount > MAX_USER_COUNT || logRowCount < 0 ||
+        logRowCount > MAX_LOG_ROW_COUNT || sampleCount < 1 || insertCount < 0 || seed == 0)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    randomState = (uint64_t)seed;
+
+    struct DatabaseConfig databaseConfig;
+
+    if (!setDatabaseProfile(&databaseConfig.settings, profileName))
+    {
+        fprintf(stderr, "Unknown database profile %s.\n", profileName);
+
+        return 1;
+    }
+
+    if (!openDatabaseConnection(&databaseConfig, databasePath))
+    {
+        return 1;
+    }
+
+    if (!planOnly && !generateData(&databaseConfig, userCount, logRowCount))
+    {
+        cleanupDatabase(&databaseConfig);
+
+        return 1;
+    }
+
+    // No ANALYZE, devices don't run it either, so these are the plans they get.
+    bool plansValid = checkQueryPlans(databaseConfig.database);
+    cleanupDatabase(&databaseConfig);
+
+    if (planOnly)
+    {
+        return plansValid ? 0 : 1;
+    }
+
+    // Opened again like clock_in opens it, with the PIN index built from the generated users.
+    if (!openOrCreateDatabase(&databaseConfig, databasePath))
+    {
+        return 1;
+    }
+
+    long long databaseUserCount = 0;
+    bool benchmarked = selectCount(databaseConfig.database, SELECT_USER_COUNT, &databaseUserCount) &&
+                       runBenchmarks(&databaseConfig, databaseUserCount, (long)sampleCount, (long)insertCount);
+
+    cleanupDatabase(&databaseConfig);
+
+    if (!plansValid)
+    {
+        fprintf(stderr, "FAILED: a hot query scans instead of searching, see the plans above.\n");
+    }
+
+    return benchmarked && plansValid ? 0 : 1;
+}
+
+
+
+static bool generateData(struct DatabaseConfig *databaseConfig, const long long userCount, const long long logRowCount)
+{
+    // For readability.
+    sqlite3 *database = databaseConfig->database;
+
+    long long existingUserCount = 0;
+    int64_t existingLogRowCount = 0;
+
+    // Log rows are only ever generated, so the latest ID is the count without counting 50 million rows.
+    if (!selectCount(database, SELECT_USER_COUNT, &existingUserCount) ||
+        !selectLatestLogID(databaseConfig, &existingLogRowCount))
+    {
+        return false;
+    }
+
+    double startTime = getCurrentTimeInSeconds();
+    long long userNumber = existingUserCount;
+    bool generated = true;
+
+    while (generated && userNumber < userCount)
+    {
+        generated = beginTransaction(databaseConfig);
+
+        for (long long batchEnd = userNumber + GENERATE_BATCH_SIZE; generated && userNumber < userCount &&
+             userNumber < batchEnd; userNumber++)
+        {
+            char pin[GENERATED_PIN_BUFFER_LENGTH];
+            char firstName[32];
+            formatGeneratedPIN(pin, userNumber);
+            snprintf(firstName, sizeof(firstName), "User%lld", userNumber);
+
+            enum UserRowResult result;
+            generated = saveUserRow(databaseConfig, firstName, "Bench", pin, false, &result);
+        }
+
+        generated = generated && commitTransaction(databaseConfig);
+    }
+
+    if (userNumber > existingUserCount)
+    {
+        printf("Generated %lld user(s) in %.1f seconds.\n", userNumber - existingUserCount,
+               getCurrentTimeInSeconds() - startTime);
+    }
+
+    // The users were added with increasing IDs from 1, so every ID up to the count exists.
+    long long usersInDatabase = userNumber > existingUserCount ? userNumber : existingUserCount;
+    long long rowNumber = (long long)existingLogRowCount;
+    startTime = getCurrentTimeInSeconds();
+
+    while (generated && rowNumber < logRowCount)
+    {
+        generated = beginTransaction(databaseConfig);
+
+        for (long long batchEnd = rowNumber + GENERATE_BATCH_SIZE; generated && rowNumber < logRowCount &&
+             rowNumber < batchEnd; rowNumber++)
+        {
+            // Every user in turn, first IN, then OUT on the next round.
+            int userID = (int)(rowNumber % usersInDatabase) + 1;
+            int status = (rowNumber / usersInDatabase) % 2 == 0 ? LOG_STATUS_IN : LOG_STATUS_OUT;
+
+            generated = insertLogRow(databaseConfig, userID, status, GENERATED_LOG_START + rowNumber * MICROSECONDS_PER_SECOND);
+        }
+
+        generated = generated && commitTransaction(databaseConfig);
+
+        if (generated && rowNumber % (10 * GENERATE_BATCH_SIZE) == 0)
+        {
+            printf("%lld log rows...\n", rowNumber);
+        }
+    }
+
+    if (rowNumber > (long long)existingLogRowCount)
+    {
+        double seconds = getCurrentTimeInSeconds() - startTime;
+        printf("Generated %lld log row(s) in %.1f seconds, %.0f rows per second.\n",
+               rowNumber - (long long)existingLogRowCount, seconds, (double)(rowNumber - existingLogRowCount) / seconds);
+    }
+
+    if (!generated)
+    {
+        rollbackTransaction(databaseConfig);
+        fprintf(stderr, "Could not generate the data.\n");
+    }
+
+    return generated;
+}
+
+static bool checkQueryPlans(sqlite3 *database)
+{
+    bool plansValid = true;
+
+    printf("\nQuery plans:\n");
+
+    for (size_t queryIndex = 0; queryIndex < sizeof(hotQueries) / sizeof(hotQueries[0]); queryIndex++)
+    {
+        char sql[4096];
+        snprintf(sql, sizeof(sql), "EXPLAIN QUERY PLAN %s", hotQueries[queryIndex].sql);
+
+        sqlite3_stmt *statement;
+
+        if (sqlite3_prepare_v2(database, sql, -1, &statement, 0) != SQLITE_OK)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+            plansValid = false;
+
+            continue;
+        }
+
+        printf("  %s\n", hotQueries[queryIndex].name);
+
+        // The fourth column is the detail, like "SEARCH user USING COVERING INDEX ... (pin=?)".
+        // SCAN reads every row of the table or index. Scanning a subquery's result, "SCAN (subquery-1)",
+        // or SCAN CONSTANT ROW of a VALUES or a SELECT without FROM is fine, the rows were searched already.
+        while (sqlite3_step(statement) == SQLITE_ROW)
+        {
+            const char *detail = (const char *)sqlite3_column_text(statement, 3);
+            bool scans = strncmp(detail, "SCAN ", 5) == 0 && strncmp(detail, "SCAN (", 6) != 0 &&
+                         strcmp(detail, "SCAN CONSTANT ROW") != 0;
+
+            printf("    %s%s\n", detail, scans ? "   <-- FULL SCAN" : "");
+            plansValid = plansValid && !scans;
+        }
+
+        sqlite3_finalize(statement);
+    }
+
+    printf("Query plan check %s.\n", plansValid ? "passed" : "FAILED");
+
+    return plansValid;
+}
+
+static bool runBenchmarks(struct DatabaseConfig *databaseConfig, const long long userCount, const long sampleCount,
+                          const long insertCount)
+{
+    long maxCount = sampleCount > insertCount ? sampleCount : insertCount;
+    struct LatencySamples samples = { .nanoseconds = malloc(sizeof(int64_t) * (size_t)maxCount) };
+
+    if (samples.nanoseconds == NULL)
+    {
+        return false;
+    }
+
+    // The three test users are first, generated users come after them, see generateData().
+    long long existingUserCount = userCount < 3 ? userCount : 3;
+    long long generatedUserCount = userCount - existingUserCount;
+    bool succeeded = generatedUserCount > 0;
+
+    printf("\n%-34s %9s %9s %9s %9s %9s %12s\n", "operation", "calls", "p50 us", "p99 us", "p99.9 us", "max us", "calls/s");
+
+    // With the index first, then with plain SQL, which is what a device gets if the index can't be built.
+    for (int pass = 0; pass < 2 && succeeded; pass++)
+    {
+        struct PINIndex *pinIndex = databaseConfig->pinIndex;
+
+        if (pass == 0 && pinIndex == NULL)
+        {
+            continue;
+        }
+
+        databaseConfig->pinIndex = pass == 0 ? pinIndex : NULL;
+        int64_t startTime = getMonotonicNanoseconds();
+
+        for (samples.count = 0; samples.count < sampleCount && succeeded; samples.count++)
+        {
+            char pin[GENERATED_PIN_BUFFER_LENGTH];
+            formatGeneratedPIN(pin, existingUserCount + randomBelow(generatedUserCount));
+            int userID = -1;
+
+            int64_t callStart = getMonotonicNanoseconds();
+            succeeded = selectUserIDByPIN(databaseConfig, pin, &userID);
+            samples.nanoseconds[samples.count] = getMonotonicNanoseconds() - callStart;
+        }
+
+        samples.totalNanoseconds = getMonotonicNanoseconds() - startTime;
+        databaseConfig->pinIndex = pinIndex;
+        printLatencies(pass == 0 ? "selectUserIDByPIN (PIN index)" : "selectUserIDByPIN (SQL)", &samples);
+    }
+
+    int64_t startTime = getMonotonicNanoseconds();
+
+    for (samples.count = 0; samples.count < sampleCount && succeeded; samples.count++)
+    {
+        int userID = (int)randomBelow(userCount) + 1;
+        int status = LOG_STATUS_ERROR;
+        bool found = false;
+
+        // A user without log rows isn't found, which is just as valid a lookup.
+        int64_t callStart = getMonotonicNanoseconds();
+        succeeded = selectUsersLatestLogStatus(databaseConfig, userID, &status, &found);
+        samples.nanoseconds[samples.count] = getMonotonicNanoseconds() - callStart;
+    }
+
+    samples.totalNanoseconds = getMonotonicNanoseconds() - startTime;
+    printLatencies("selectUsersLatestLogStatus", &samples);
+
+    startTime = getMonotonicNanoseconds();
+
+    for (samples.count = 0; samples.count < insertCount && succeeded; samples.count++)
+    {
+        int userID = (int)randomBelow(userCount) + 1;
+        int status = LOG_STATUS_OUT;
+        bool found = false;
+        selectUsersLatestLogStatus(databaseConfig, userID, &status, &found);
+
+        // Only the insert is timed, the status is read just to keep the user's rows alternating.
+        int64_t callStart = getMonotonicNanoseconds();
+        succeeded = insertLogRow(databaseConfig, userID, status == LOG_STATUS_IN ? LOG_STATUS_OUT : LOG_STATUS_IN,
+                                 getCurrentTimeInMicroseconds());
+        samples.nanoseconds[samples.count] = getMonotonicNanoseconds() - callStart;
+    }
+
+    samples.totalNanoseconds = getMonotonicNanoseconds() - startTime;
+
+    if (insertCount > 0)
+    {
+        printLatencies("insertLogRow (own transaction)", &samples);
+    }
+
+    free(samples.nanoseconds);
+
+    if (!succeeded)
+    {
+        fprintf(stderr, "A benchmarked call failed.\n");
+    }
+
+    return succeeded;
+}
+
+static void printLatencies(const char *name, struct LatencySamples *samples)
+{
+    if (samples->count == 0)
+    {
+        return;
+    }
+
+    qsort(samples->nanoseconds, (size_t)samples->count, sizeof(int64_t), compareSamples);
+
+    // For readability.
+    const int64_t *sorted = samples->nanoseconds;
+    long last = samples->count - 1;
+
+    printf("%-34s %9ld %9.1f %9.1f %9.1f %9.1f %12.0f\n", name, samples->count,
+           (double)sorted[last * 50 / 100] / 1000.0,
+           (double)sorted[last * 99 / 100] / 1000.0,
+           (double)sorted[last * 999 / 1000] / 1000.0,
+           (double)sorted[last] / 1000.0,
+           (double)samples->count * 1e9 / (double)samples->totalNanoseconds);
+}
+
+static void formatGeneratedPIN(char *buffer, const long long userNumber)
+{
+    long long pin = (userNumber * GENERATED_PIN_MULTIPLIER + 12345) % GENERATED_PIN_MODULUS;
+    snprintf(buffer, GENERATED_PIN_BUFFER_LENGTH, "%0*lld", GENERATED_PIN_LENGTH, pin);
+}
+
+static bool selectCount(sqlite3 *database, const char *sql, long long *value)
+{
+    sqlite3_stmt *statement;
+
+    if (sqlite3_prepare_v2(database, sql, -1, &statement, 0) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(database));
+
+        return false;
+    }
+
+    bool selected = sqlite3_step(statement) == SQLITE_ROW;
+
+    if (selected)
+    {
+        *value = sqlite3_column_int64(statement, 0);
+    }
+
+    sqlite3_finalize(statement);
+
+    return selected;
+}
+
+static int64_t getMonotonicNanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static long long randomBelow(const long long limit)
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+
+    return (long long)(randomState % (uint64_t)limit);
+}
+
+static int compareSamples(const void *first, const void *second)
+{
+    int64_t a = *(const int64_t *)first;
+    int64_t b = *(const int64_t *)second;
+
+    return (a > b) - (a < b);
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s [--users N] [--log-rows N] [--samples N] [--inserts N] [--profile NAME] [--seed N]\n"
+                    "          [--plan-only] [--database FILE]\n", programName);
+    fprintf(stderr, "  --users N       Users in the database, up to %lld. Default %d.\n", MAX_USER_COUNT, DEFAULT_USER_COUNT);
+    fprintf(stderr, "  --log-rows N    Log rows in the database, up to %lld. Default %d.\n", MAX_LOG_ROW_COUNT,
+            DEFAULT_LOG_ROW_COUNT);
+    fprintf(stderr, "  --samples N     Calls timed per read operation. Default %d.\n", DEFAULT_SAMPLE_COUNT);
+    fprintf(stderr, "  --inserts N     insertLogRow() calls timed, each is a transaction. Default %d.\n", DEFAULT_INSERT_COUNT);
+    fprintf(stderr, "  --profile NAME  Database profile from config.ini, like sd-card-safe. Default %s.\n",
+            DATABASE_DEFAULT_PROFILE);
+    fprintf(stderr, "  --seed N        Seed for picking users, not 0. Default 1.\n");
+    fprintf(stderr, "  --plan-only     Only check the query plans of an existing database.\n");
+    fprintf(stderr, "  --database FILE Database file, created if needed. Default %s.\n", DEFAULT_BENCH_DATABASE);
+}
@@ -0,0 +1,392 @@
+/**
+ * @file clock_export.c
+ * @author Selkamies
+ *
+ * @brief Command line tool that appends the log rows added since its last run to a CSV or NDJSON file.
+ *
+ * Usage: clock_export [--cursor NAME] [--format csv|ndjson] [--batch-size N] [--database FILE] OUTPUT
+ *        clock_export --forget [--cursor NAME] [--database FILE]
+ *
+ * Each export has a named cursor in the export_cursor table, holding the ID of the last exported log row.
+ * A run reads only the rows after it, in ID order and in batches, so a nightly sync costs the new rows
+ * instead of the whole log. Several exports can run side by side with different cursor names.
+ *
+ * Every batch is appended to OUTPUT and flushed to disk before the cursor is moved past it, together with
+ * the size of the file. If a run is interrupted between the two, the next run cuts the file back to the saved
+ * size and writes the batch again, so every row ends up in the file exactly once.
+ *
+ * The archiver keeps log rows that a cursor hasn't passed yet. --forget deletes a cursor that is no longer used.
+ *
+ * @date Created  2024-01-18
+ * @date Modified 2024-01-18
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), fopen(), fflush().
+#include <stdlib.h>             // atoi(), malloc(), free(), realpath().
+#include <string.h>             // strcmp(), strlen().
+#include <stdbool.h>
+#include <stdint.h>             // int64_t.
+#include <time.h>               // gmtime_r(), strftime().
+#include <unistd.h>             // fsync(), truncate().
+#include <sys/stat.h>           // stat().
+
+#include "database.h"           // openDatabaseConnection(), selectLogRowsAfterID(), selectExportCursor(), etc.
+#include "database_config.h"    // struct DatabaseConfig, struct LogRow, struct ExportCursor.
+#include "timer.h"              // getCurrentTimeInSeconds().
+
+
+
+/** @brief Name of the cursor if --cursor is not given. */
+#define DEFAULT_CURSOR_NAME "payroll"
+/** @brief Log rows read and written per batch if --batch-size is not given. */
+#define DEFAULT_BATCH_SIZE 1000
+
+#define MICROSECONDS_PER_SECOND 1000000LL
+
+
+
+/**
+ * @brief Format of the export file.
+ */
+enum ExportFormat
+{
+    /** @brief Comma separated values, with a header line at the start of the file. */
+    EXPORT_FORMAT_CSV,
+    /** @brief One JSON object per line. */
+    EXPORT_FORMAT_NDJSON
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Exports the rows after the cursor in batches, saving the cursor after each batch.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param cursor The cursor. Moved forward with every saved batch.
+ * @param file The export file, opened for appending.
+ * @param format Format of the export file.
+ * @param batchSize Rows per batch.
+ * @param exportedCount Pointer to the number of rows exported.
+ *
+ * @return true If every new row was exported.
+ * @return false If something went wrong. Batches saved before it stay exported.
+ */
+static bool exportRows(struct DatabaseConfig *databaseConfig, struct ExportCursor *cursor, FILE *file,
+                       const enum ExportFormat format, const int batchSize, unsigned long *exportedCount);
+
+/**
+ * @brief Cuts off rows that an interrupted run wrote to the cursor's file after its last saved batch.
+ *
+ * @param cursor The cursor.
+ *
+ * @return true If the file is as the cursor left it, or was cut back to it.
+ * @return false If the file could not be cut.
+ */
+static bool repairExportFile(const struct ExportCursor *cursor);
+
+/**
+ * @brief Writes one log row to the export file.
+ *
+ * @param file The export file.
+ * @param format Format of the export file.
+ * @param row The row.
+ */
+static void writeLogRow(FILE *file, const enum ExportFormat format, const struct LogRow *row);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+int main(int argc, char **argv)
+{
+    const char *databasePath = DATABASE_FILEPATH;
+    const char *cursorName = DEFAULT_CURSOR_NAME;
+    const char *outputPath = NULL;
+    enum ExportFormat format = EXPORT_FORMAT_CSV;
+    int batchSize = DEFAULT_BATCH_SIZE;
+    bool forget = false;
+    bool argumentsValid = true;
+
+    for (int index = 1; index < argc && argumentsValid; index++)
+    {
+        bool hasValue = index + 1 < argc;
+
+        if (strcmp(argv[index], "--cursor") == 0 && hasValue)
+        {
+            cursorName = argv[++index];
+        }
+
+        else if (strcmp(argv[index], "--format") == 0 && hasValue)
+        {
+            const char *formatName = argv[++index];
+
+            if (strcmp(formatName, "csv") == 0)         format = EXPORT_FORMAT_CSV;
+            else if (strcmp(formatName, "ndjson") == 0) format = EXPORT_FORMAT_NDJSON;
+            else                                        argumentsValid = false;
+        }
+
+        else if (strcmp(argv[index], "--batch-size") == 0 && hasValue)
+        {
+            batchSize = atoi(argv[++index]);
+        }
+
+        else if (strcmp(argv[index], "--database") == 0 && hasValue)
+        {
+            databasePath = argv[++index];
+        }
+
+        else if (strcmp(argv[index], "--forget") == 0)
+        {
+            forget = true;
+        }
+
+        else if (outputPath == NULL && argv[index][0] != '-')
+        {
+            outputPath = argv[index];
+        }
+
+        else
+        {
+            argumentsValid = false;
+        }
+    }
+
+    if (!argumentsValid || batchSize < 1 || cursorName[0] == '\0' || strlen(cursorName) >= EXPORT_CURSOR_NAME_LENGTH ||
+        (forget == (outputPath != NULL)))
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    struct DatabaseConfig databaseConfig;
+    setDatabaseToolSettings(&databaseConfig.settings);
+
+    if (!openDatabaseConnection(&databaseConfig, databasePath))
+    {
+        return 1;
+    }
+
+    if (forget)
+    {
+        bool found = false;
+        bool deleted = deleteExportCursor(&databaseConfig, cursorName, &found);
+
+        if (deleted)
+        {
+            printf(found ? "Export cursor %s deleted.\n" : "There is no export cursor %s.\n", cursorName);
+        }
+
+        cleanupDatabase(&databaseConfig);
+
+        return deleted ? 0 : 1;
+    }
+
+    struct ExportCursor cursor;
+    bool found = false;
+
+    if (!selectExportCursor(&databaseConfig, cursorName, &cursor, &found) || !repairExportFile(&cursor))
+    {
+        cleanupDatabase(&databaseConfig);
+
+        return 1;
+    }
+
+    FILE *file = fopen(outputPath, "a");
+    char *resolvedPath = file != NULL ? realpath(outputPath, NULL) : NULL;
+
+    // The full path is saved, so the file is found again whichever folder the next run is started in.
+    if (resolvedPath == NULL || strlen(resolvedPath) >= sizeof(cursor.file))
+    {
+        fprintf(stderr, "Error opening file: %s\n", outputPath);
+
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+
+        free(resolvedPath);
+        cleanupDatabase(&databaseConfig);
+
+        return 1;
+    }
+
+    snprintf(cursor.file, sizeof(cursor.file), "%s", resolvedPath);
+    free(resolvedPath);
+
+    printf("Exporting log rows after ID %lld with cursor %s%s.\n", (long long)cursor.lastLogID, cursorName,
+           found ? "" : " (new)");
+
+    unsigned long exportedCount = 0;
+    double startTime = getCurrentTimeInSeconds();
+
+    bool exported = exportRows(&databaseConfig, &cursor, file, format, batchSize, &exportedCount);
+
+    printf("%lu log row(s) exported to %s in %.2f seconds, last row ID %lld.\n", exportedCount, cursor.file,
+           getCurrentTimeInSeconds() - startTime, (long long)cursor.lastLogID);
+
+    fclose(file);
+    cleanupDatabase(&databaseConfig);
+
+    return exported ? 0 : 1;
+}
+
+
+
+static bool exportRows(struct DatabaseConfig *databaseConfig, struct ExportCursor *cursor, FILE *file,
+                       const enum ExportFormat format, const int batchSize, unsigned long *exportedCount)
+{
+    struct LogRow *rows = malloc(sizeof(struct LogRow) * (size_t)batchSize);
+
+    if (rows == NULL || fseeko(file, 0, SEEK_END) != 0)
+    {
+        free(rows);
+
+        return false;
+    }
+
+    bool writeHeader = (format == EXPORT_FORMAT_CSV && ftello(file) == 0);
+    int rowCount = batchSize;
+    bool exported = true;
+
+    // A batch that isn't full is the last one.
+    while (exported && rowCount == batchSize)
+    {
+        if (!selectLogRowsAfterID(databaseConfig, cursor->lastLogID, rows, batchSize, &rowCount))
+        {
+            exported = false;
+
+            break;
+        }
+
+        if (rowCount == 0)
+        {
+            break;
+        }
+
+        if (writeHeader)
+        {
+            fprintf(file, "id,user_id,datetime,status\n");
+            writeHeader = false;
+        }
+
+        for (int index = 0; index < rowCount; index++)
+        {
+            writeLogRow(file, format, &rows[index]);
+        }
+
+        // The rows have to be on disk before the cursor says they are.
+        if (fflush(file) != 0 || fsync(fileno(file)) != 0)
+        {
+            fprintf(stderr, "Error writing file: %s\n", cursor->file);
+            exported = false;
+
+            break;
+        }
+
+        struct ExportCursor movedCursor = *cursor;
+        movedCursor.lastLogID = rows[rowCount - 1].id;
+        movedCursor.fileSize = (int64_t)ftello(file);
+
+        // If this fails, the batch is in the file but not in the cursor, and the next run cuts it off again.
+        if (!saveExportCursor(databaseConfig, &movedCursor))
+        {
+            exported = false;
+
+            break;
+        }
+
+        *cursor = movedCursor;
+        *exportedCount += (unsigned long)rowCount;
+    }
+
+    free(rows);
+
+    return exported;
+}
+
+static bool repairExportFile(const struct ExportCursor *cursor)
+{
+    struct stat fileStatus;
+
+    // A new cursor, or a file that has been moved away after the last run. Either way there's nothing to cut.
+    if (cursor->file[0] == '\0' || stat(cursor->file, &fileStatus) != 0)
+    {
+        return true;
+    }
+
+    if ((int64_t)fileStatus.st_size < cursor->fileSize)
+    {
+        fprintf(stderr, "%s is shorter than after the last export, it has been changed by something else.\n", cursor->file);
+
+        return true;
+    }
+
+    if ((int64_t)fileStatus.st_size == cursor->fileSize)
+    {
+        return true;
+    }
+
+    if (truncate(cursor->file, (off_t)cursor->fileSize) != 0)
+    {
+        fprintf(stderr, "Could not remove the rows of an interrupted export from %s.\n", cursor->file);
+
+        return false;
+    }
+
+    printf("Removed %lld byte(s) of an interrupted export from %s, they are exported again.\n",
+           (long long)fileStatus.st_size - (long long)cursor->fileSize, cursor->file);
+
+    return true;
+}
+
+static void writeLogRow(FILE *file, const enum ExportFormat format, const struct LogRow *row)
+{
+    // ISO 8601 in UTC with microseconds, like 2024-01-18T07:30:00.123456Z.
+    char datetime[sizeof("YYYY-MM-DDTHH:MM:SS.ffffffZ")];
+    time_t seconds = (time_t)(row->datetime / MICROSECONDS_PER_SECOND);
+    struct tm date;
+    gmtime_r(&seconds, &date);
+    size_t length = strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S", &date);
+    snprintf(datetime + length, sizeof(datetime) - length, ".%06dZ", (int)(row->datetime % MICROSECONDS_PER_SECOND));
+
+    const char *status = row->status == LOG_STATUS_IN ? "IN" : row->status == LOG_STATUS_OUT ? "OUT" : "ERROR";
+
+    if (format == EXPORT_FORMAT_CSV)
+    {
+        fprintf(file, "%lld,%d,%s,%s\n", (long long)row->id, row->userID, datetime, status);
+    }
+
+    else
+    {
+        fprintf(file, "{\"id\":%lld,\"user_id\":%d,\"datetime\":\"%s\",\"status\":\"%s\"}\n",
+                (long long)row->id, row->userID, datetime, status);
+    }
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s [--cursor NAME] [--format csv|ndjson] [--batch-size N] [--database FILE] OUTPUT\n",
+            programName);
+    fprintf(stderr, "       %s --forget [--cursor NAME] [--database FILE]\n", programName);
+    fprintf(stderr, "  OUTPUT          File the new log rows are appended to.\n");
+    fprintf(stderr, "  --cursor NAME   Name of the export, each remembers its own last row. Default %s.\n",
+            DEFAULT_CURSOR_NAME);
+    fprintf(stderr, "  --format FORMAT csv (default) or ndjson.\n");
+    fprintf(stderr, "  --batch-size N  Rows written per batch. Default %d.\n", DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  --database FILE Database file. Default %s.\n", DATABASE_FILEPATH);
+    fprintf(stderr, "  --forget        Delete the cursor, so the archiver no longer keeps rows for it.\n");
+}
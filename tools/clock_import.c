@@ -0,0 +1,393 @@
+/**
+ * @file clock_import.c
+ * @author Selkamies
+ *
+ * @brief Command line tool that adds users to the database from a CSV file.
+ *
+ * Usage: clock_import [--upsert] [--batch-size N] [--database FILE] USERS.csv
+ *
+ * The CSV has the columns first_name,last_name,pin, and an optional header line with the same names.
+ * Fields can be quoted with "", and a "" inside a quoted field is a quote character.
+ * "-" reads the CSV from standard input.
+ *
+ * Without --upsert, users whose PIN is already in the database are skipped. With --upsert,
+ * the PIN identifies the user and the names of existing users are updated instead.
+ * PINs that appear more than once in the file are always reported and only the first one is used.
+ *
+ * The file is read one line at a time and every user is saved with the same prepared statement,
+ * committing once per batch instead of once per user, so 100 000 users take seconds.
+ *
+ * @date Created  2024-01-15
+ * @date Modified 2024-01-15
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), fopen(), getline().
+#include <stdlib.h>             // atoi(), free().
+#include <string.h>             // strcmp(), strlen().
+#include <strings.h>            // strcasecmp().
+#include <stdbool.h>
+
+#include "database.h"           // openDatabaseConnection(), saveUserRow(), beginTransaction(), etc.
+#include "database_config.h"    // struct DatabaseConfig.
+#include "pin_index.h"          // createPINIndex(), insertPINIndex(), lookupPINIndex(), cleanupPINIndex().
+#include "timer.h"              // getCurrentTimeInSeconds().
+
+
+
+/** @brief Users saved per transaction if --batch-size is not given. */
+#define DEFAULT_BATCH_SIZE 10000
+/** @brief Number of columns in the CSV. */
+#define CSV_COLUMN_COUNT 3
+
+#define COLUMN_FIRST_NAME 0
+#define COLUMN_LAST_NAME 1
+#define COLUMN_PIN 2
+
+
+
+/**
+ * @brief Counts of what happened to the lines of the CSV, printed at the end.
+ */
+struct ImportCounts
+{
+    /** @brief Lines read, including the header and empty lines. */
+    unsigned long lines;
+    /** @brief New users added. */
+    unsigned long inserted;
+    /** @brief Existing users whose names were updated. */
+    unsigned long updated;
+    /** @brief Users skipped because the PIN was in the database already, or nothing would have changed. */
+    unsigned long skipped;
+    /** @brief Lines skipped because their PIN was on an earlier line of the file. */
+    unsigned long duplicates;
+    /** @brief Lines skipped because they didn't have three non-empty columns. */
+    unsigned long invalid;
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Reads the CSV and saves the users in batches.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param file The CSV file.
+ * @param updateExisting Whether existing users with the same PIN are updated.
+ * @param batchSize Users saved per transaction.
+ * @param counts Counts of what happened to the lines.
+ *
+ * @return true If the whole file was imported.
+ * @return false If the database failed. Batches committed before the failure are kept.
+ */
+static bool importUsers(struct DatabaseConfig *databaseConfig, FILE *file, const bool updateExisting, const int batchSize,
+                        struct ImportCounts *counts);
+
+/**
+ * @brief Splits a CSV line to fields in place. Handles quoted fields, and removes the line ending.
+ *
+ * @param line The line. Changed in place, the fields point into it.
+ * @param fields Array the field pointers are saved to.
+ * @param maxFields Size of the fields array.
+ *
+ * @return int Number of fields on the line. Can be more than maxFields, the extra fields are not saved.
+ */
+static int splitCSVLine(char *line, char **fields, const int maxFields);
+
+/**
+ * @brief Checks whether the fields are the header line.
+ *
+ * @param fields The fields of the line.
+ *
+ * @return true If the last column is named pin.
+ * @return false If it isn't.
+ */
+static bool isHeaderLine(char **fields);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+int main(int argc, char **argv)
+{
+    const char *databasePath = DATABASE_FILEPATH;
+    const char *csvPath = NULL;
+    bool updateExisting = false;
+    int batchSize = DEFAULT_BATCH_SIZE;
+
+    for (int index = 1; index < argc; index++)
+    {
+        if (strcmp(argv[index], "--upsert") == 0)
+        {
+            updateExisting = true;
+        }
+
+        else if (strcmp(argv[index], "--batch-size") == 0 && index + 1 < argc)
+        {
+            batchSize = atoi(argv[++index]);
+        }
+
+        else if (strcmp(argv[index], "--database") == 0 && index + 1 < argc)
+        {
+            databasePath = argv[++index];
+        }
+
+        else if (csvPath == NULL && (argv[index][0] != '-' || strcmp(argv[index], "-") == 0))
+        {
+            csvPath = argv[index];
+        }
+
+        else
+        {
+            printUsage(argv[0]);
+
+            return 1;
+        }
+    }
+
+    if (csvPath == NULL || batchSize < 1)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    FILE *file = strcmp(csvPath, "-") == 0 ? stdin : fopen(csvPath, "r");
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening file: %s\n", csvPath);
+
+        return 1;
+    }
+
+    struct DatabaseConfig databaseConfig;
+    setDatabaseToolSettings(&databaseConfig.settings);
+
+    // The PIN index isn't needed, the database itself catches PINs that already exist.
+    if (!openDatabaseConnection(&databaseConfig, databasePath))
+    {
+        if (file != stdin)
+        {
+            fclose(file);
+        }
+
+        return 1;
+    }
+
+    struct ImportCounts counts = { 0 };
+    double startTime = getCurrentTimeInSeconds();
+
+    bool imported = importUsers(&databaseConfig, file, updateExisting, batchSize, &counts);
+
+    printf("%lu line(s) read in %.2f seconds.\n", counts.lines, getCurrentTimeInSeconds() - startTime);
+    printf("  %lu user(s) added.\n", counts.inserted);
+    printf("  %lu user(s) updated.\n", counts.updated);
+    printf("  %lu user(s) skipped, %s.\n", counts.skipped,
+           updateExisting ? "nothing to change" : "PIN already in the database");
+    printf("  %lu line(s) skipped, PIN already earlier in the file.\n", counts.duplicates);
+    printf("  %lu line(s) skipped, not three non-empty columns.\n", counts.invalid);
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+
+    cleanupDatabase(&databaseConfig);
+
+    return imported ? 0 : 1;
+}
+
+
+
+static bool importUsers(struct DatabaseConfig *databaseConfig, FILE *file, const bool updateExisting, const int batchSize,
+                        struct ImportCounts *counts)
+{
+    // PINs seen so far in the file, with the line they were on. Reuses the device's PIN index, it's the same problem.
+    struct PINIndex *seenPINs = createPINIndex(batchSize);
+
+    if (seenPINs == NULL || !beginTransaction(databaseConfig))
+    {
+        cleanupPINIndex(seenPINs);
+
+        return false;
+    }
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    int rowsInBatch = 0;
+    bool imported = true;
+
+    while (getline(&line, &lineCapacity, file) != -1)
+    {
+        counts->lines++;
+
+        char *fields[CSV_COLUMN_COUNT];
+        int fieldCount = splitCSVLine(line, fields, CSV_COLUMN_COUNT);
+
+        // Empty line.
+        if (fieldCount == 1 && fields[0][0] == '\0')
+        {
+            continue;
+        }
+
+        if (fieldCount == CSV_COLUMN_COUNT && counts->lines == 1 && isHeaderLine(fields))
+        {
+            continue;
+        }
+
+        if (fieldCount != CSV_COLUMN_COUNT || fields[COLUMN_FIRST_NAME][0] == '\0' ||
+            fields[COLUMN_LAST_NAME][0] == '\0' || fields[COLUMN_PIN][0] == '\0')
+        {
+            fprintf(stderr, "Line %lu: expected first_name,last_name,pin, skipped.\n", counts->lines);
+            counts->invalid++;
+
+            continue;
+        }
+
+        // PINs too long for the index can't be checked here. Without --upsert the database still catches them.
+        int firstLine = 0;
+
+        if (lookupPINIndex(seenPINs, fields[COLUMN_PIN], &firstLine))
+        {
+            // The PIN itself is not printed, it's a secret.
+            fprintf(stderr, "Line %lu: same PIN as on line %d, skipped.\n", counts->lines, firstLine);
+            counts->duplicates++;
+
+            continue;
+        }
+
+        insertPINIndex(&seenPINs, fields[COLUMN_PIN], (int)counts->lines);
+
+        enum UserRowResult result;
+
+        if (!saveUserRow(databaseConfig, fields[COLUMN_FIRST_NAME], fields[COLUMN_LAST_NAME], fields[COLUMN_PIN],
+                         updateExisting, &result))
+        {
+            fprintf(stderr, "Line %lu: could not be saved, the current batch is rolled back.\n", counts->lines);
+            imported = false;
+
+            break;
+        }
+
+        switch (result)
+        {
+            case USER_ROW_INSERTED: counts->inserted++; break;
+            case USER_ROW_UPDATED:  counts->updated++;  break;
+            case USER_ROW_SKIPPED:  counts->skipped++;  break;
+        }
+
+        rowsInBatch++;
+
+        if (rowsInBatch >= batchSize)
+        {
+            if (!commitTransaction(databaseConfig) || !beginTransaction(databaseConfig))
+            {
+                imported = false;
+
+                break;
+            }
+
+            rowsInBatch = 0;
+        }
+    }
+
+    free(line);
+    cleanupPINIndex(seenPINs);
+
+    if (!imported || !commitTransaction(databaseConfig))
+    {
+        rollbackTransaction(databaseConfig);
+
+        return false;
+    }
+
+    return true;
+}
+
+static int splitCSVLine(char *line, char **fields, const int maxFields)
+{
+    int fieldCount = 0;
+    char *read = line;
+    char *write = line;
+
+    while (true)
+    {
+        if (fieldCount < maxFields)
+        {
+            fields[fieldCount] = write;
+        }
+
+        fieldCount++;
+
+        bool quoted = (*read == '"');
+
+        if (quoted)
+        {
+            read++;
+        }
+
+        // Copies the field over itself, dropping the quotes. The field can only get shorter.
+        while (*read != '\0')
+        {
+            if (quoted && *read == '"')
+            {
+                // "" inside a quoted field is a quote character.
+                if (read[1] == '"')
+                {
+                    *write++ = '"';
+                    read += 2;
+
+                    continue;
+                }
+
+                quoted = false;
+                read++;
+
+                continue;
+            }
+
+            if (!quoted && (*read == ',' || *read == '\n' || *read == '\r'))
+            {
+                break;
+            }
+
+            *write++ = *read++;
+        }
+
+        bool moreFields = (*read == ',');
+        *write++ = '\0';
+
+        if (!moreFields)
+        {
+            return fieldCount;
+        }
+
+        read++;
+    }
+}
+
+static bool isHeaderLine(char **fields)
+{
+    return strcasecmp(fields[COLUMN_PIN], "pin") == 0;
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s [--upsert] [--batch-size N] [--database FILE] USERS.csv\n", programName);
+    fprintf(stderr, "  USERS.csv       Columns first_name,last_name,pin. - reads standard input.\n");
+    fprintf(stderr, "  --upsert        Update the names of users whose PIN already exists, instead of skipping them.\n");
+    fprintf(stderr, "  --batch-size N  Users saved per transaction. Default %d.\n", DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  --database FILE Database file. Default %s.\n", DATABASE_FILEPATH);
+}
@@ -0,0 +1,929 @@
+/**
+ * @file clock_report.c
+ * @author Selkamies
+ *
+ * @brief Command line tool that reports worked hours from the log, per user, per day and for the whole period.
+ *
+ * Usage: clock_report [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--unmatched-in drop|end-of-day|cap]
+ *                     [--max-shift-hours H] [--page-size N] [--database FILE]
+ *
+ * Every IN row is paired with the user's next OUT row, and the time between them is split at local midnights
+ * into days. An IN row without an OUT, or with an OUT more than --max-shift-hours later, is an unmatched IN.
+ * It's counted as nothing (drop), until the end of its day (end-of-day), or as --max-shift-hours (cap).
+ * An OUT row without an IN before it is an unmatched OUT and is never counted.
+ *
+ * The report is CSV on standard output, with the columns row_type,user_id,first_name,last_name,date,hours,
+ * unmatched_in,unmatched_out. row_type is day, user or period.
+ *
+ * The log is read in one pass, user by user and in time order, using the index on (user_id, datetime, status).
+ * Only the current user and day are kept in memory, so the size of the log doesn't matter. The rows are read
+ * in pages, each page its own short read transaction, so the device can keep writing and checkpointing
+ * while the report runs. Months moved to archive files are attached and read as if they were still in the log.
+ *
+ * @date Created  2024-01-17
+ * @date Modified 2024-01-17
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), snprintf().
+#include <stdlib.h>             // atoi(), atof(), malloc(), free().
+#include <string.h>             // strcmp(), strlen(), strdup().
+#include <stdbool.h>
+#include <stdint.h>             // int64_t, INT64_MIN.
+#include <time.h>               // localtime_r(), mktime(), strftime().
+#include <sqlite3.h>
+
+#include "database.h"           // openDatabaseConnection(), attachLogArchive(), detachLogArchive(), etc.
+#include "database_config.h"    // struct DatabaseConfig.
+#include "database_sql.h"       // SELECT_NEXT_LOG_USER_ID_*, SELECT_USERS_LOG_PAGE_*, SELECT_USER_NAMES_BY_ID.
+#include "timer.h"              // getCurrentTimeInMicroseconds(), getCurrentTimeInSeconds().
+
+
+
+/** @brief Log rows read per query if --page-size is not given. */
+#define DEFAULT_PAGE_SIZE 1000
+/** @brief Longest IN to OUT time counted as a shift if --max-shift-hours is not given. */
+#define DEFAULT_MAX_SHIFT_HOURS 16.0
+/** @brief Longest allowed --max-shift-hours. Longer shifts could start before the day before the period. */
+#define MAX_SHIFT_HOURS_LIMIT 24.0
+/** @brief Most files the report reads at once, the database and its archive files. */
+#define MAX_REPORT_SOURCES 64
+
+#define MICROSECONDS_PER_SECOND 1000000LL
+#define MICROSECONDS_PER_HOUR (3600LL * MICROSECONDS_PER_SECOND)
+
+/** @brief Schema name of a month's archive file, like log_2024_01. */
+#define ARCHIVE_SCHEMA_NAME_FORMAT "log_%04d_%02d"
+#define SCHEMA_NAME_MAX_LENGTH 32
+
+
+
+/**
+ * @brief What is done with an IN row that has no OUT row within the longest shift.
+ */
+enum UnmatchedInPolicy
+{
+    /** @brief Not counted at all. */
+    UNMATCHED_IN_DROP,
+    /** @brief Counted until midnight, or until the user's next row if that's earlier. */
+    UNMATCHED_IN_END_OF_DAY,
+    /** @brief Counted as the longest shift, or until the user's next row if that's earlier. */
+    UNMATCHED_IN_CAP
+};
+
+/**
+ * @brief Worked time and unmatched rows, summed for a day, a user or the whole period.
+ */
+struct ReportTotals
+{
+    /** @brief Worked time in microseconds. */
+    int64_t worked;
+    /** @brief IN rows that weren't matched by an OUT row. */
+    unsigned long unmatchedIn;
+    /** @brief OUT rows without an IN row before them. */
+    unsigned long unmatchedOut;
+};
+
+/**
+ * @brief Everything known about the user being reported. The only per-user memory the report needs.
+ */
+struct UserReport
+{
+    int userID;
+    /** @brief First name, or NULL if the user has been removed. */
+    char *firstName;
+    /** @brief Last name, or NULL if the user has been removed. */
+    char *lastName;
+    /** @brief Whether the latest row was an IN row. */
+    bool clockedIn;
+    /** @brief Time of the latest IN row, if clockedIn. */
+    int64_t inTime;
+    /** @brief Start of the day being summed, local midnight. */
+    int64_t dayStart;
+    /** @brief End of the day being summed, the next local midnight. */
+    int64_t dayEnd;
+    /** @brief Totals of the day being summed. */
+    struct ReportTotals day;
+    /** @brief Totals of the user for the whole period. */
+    struct ReportTotals total;
+};
+
+/**
+ * @brief Options and state of the whole report.
+ */
+struct Report
+{
+    /** @brief Start of the period, local midnight, in microseconds since the Unix epoch. */
+    int64_t start;
+    /** @brief End of the period, local midnight after the last day. */
+    int64_t end;
+    /** @brief When the report was started. Shifts still open are counted until now at most. */
+    int64_t now;
+    /** @brief Longest IN to OUT time that is counted as a shift, in microseconds. */
+    int64_t maxShift;
+    enum UnmatchedInPolicy unmatchedIn;
+    /** @brief Log rows read per query. */
+    int pageSize;
+    /** @brief SELECT_NEXT_LOG_USER_ID_* built for the attached files. */
+    sqlite3_stmt *nextUserStatement;
+    /** @brief SELECT_USERS_LOG_PAGE_* built for the attached files. */
+    sqlite3_stmt *pageStatement;
+    /** @brief SELECT_USER_NAMES_BY_ID. */
+    sqlite3_stmt *namesStatement;
+    /** @brief Totals of all users. */
+    struct ReportTotals total;
+    unsigned long userCount;
+    unsigned long rowCount;
+};
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Attaches the archive files of the months the report needs rows from.
+ *
+ * @param databaseConfig Struct holding the database connection and the prepared statements.
+ * @param from Time of the first row needed.
+ * @param to Time after the last row needed.
+ * @param schemaNames Array the schema names of all the files are saved to, main first.
+ * @param schemaCount Pointer to the number of files, including main.
+ *
+ * @return true If the files that exist were attached.
+ * @return false If there were too many of them, or attaching failed. Files attached so far are left attached.
+ */
+static bool attachReportSources(struct DatabaseConfig *databaseConfig, const int64_t from, const int64_t to,
+                                char schemaNames[][SCHEMA_NAME_MAX_LENGTH], int *schemaCount);
+
+/**
+ * @brief Builds a compound SELECT with one part per file and prepares it.
+ *
+ * @param database The database connection.
+ * @param start Text before the parts.
+ * @param partFormat Format of one part, %s is the schema name.
+ * @param separator Text between the parts.
+ * @param end Text after the parts.
+ * @param schemaNames Schema names of the files.
+ * @param schemaCount Number of files.
+ * @param statement Pointer to the prepared statement.
+ *
+ * @return true If the statement was prepared.
+ * @return false If something went wrong.
+ */
+static bool prepareCompoundStatement(sqlite3 *database, const char *start, const char *partFormat, const char *separator,
+                                     const char *end, char schemaNames[][SCHEMA_NAME_MAX_LENGTH], const int schemaCount,
+                                     sqlite3_stmt **statement);
+
+/**
+ * @brief Finds the next user ID that has log rows in any of the files.
+ *
+ * @param report Options and state of the report.
+ * @param afterUserID User ID to continue after.
+ * @param userID Pointer to the next user ID.
+ * @param found Pointer to whether there was a next user.
+ *
+ * @return true If the query succeeded.
+ * @return false If something went wrong.
+ */
+static bool selectNextUserID(struct Report *report, const int afterUserID, int *userID, bool *found);
+
+/**
+ * @brief Reads the user's rows page by page, pairs them and prints the user's day and user rows.
+ *
+ * @param report Options and state of the report.
+ * @param userID User ID of the user.
+ *
+ * @return true If the user was reported.
+ * @return false If something went wrong.
+ */
+static bool reportUser(struct Report *report, const int userID);
+
+/**
+ * @brief Reads the first and last name of the user. Users that have been removed have no names.
+ *
+ * @param report Options and state of the report.
+ * @param user The user being reported.
+ *
+ * @return true If the query succeeded, whether or not the user still exists.
+ * @return false If something went wrong.
+ */
+static bool selectUserNames(struct Report *report, struct UserReport *user);
+
+/**
+ * @brief Pairs the next log row of the user with the previous ones.
+ *
+ * @param report Options and state of the report.
+ * @param user The user being reported.
+ * @param time Time of the row.
+ * @param status LOG_STATUS_IN or LOG_STATUS_OUT.
+ */
+static void processLogRow(struct Report *report, struct UserReport *user, const int64_t time, const int status);
+
+/**
+ * @brief Counts the user's open IN row as unmatched, and counts its time as the policy says.
+ *
+ * @param report Options and state of the report.
+ * @param user The user being reported.
+ * @param limit Time of the user's next row, or now. Nothing after it is counted.
+ */
+static void closeUnmatchedIn(struct Report *report, struct UserReport *user, const int64_t limit);
+
+/**
+ * @brief Adds worked time to the user's days. Only the part inside the period is counted.
+ *
+ * @param report Options and state of the report.
+ * @param user The user being reported.
+ * @param from Start of the worked time.
+ * @param to End of the worked time.
+ */
+static void addWorkedTime(struct Report *report, struct UserReport *user, int64_t from, int64_t to);
+
+/**
+ * @brief Makes the day containing the time the day being summed, printing the previous one first.
+ * Times only ever grow, so a day is finished once a later day is moved to.
+ *
+ * @param user The user being reported.
+ * @param time A time inside the period.
+ */
+static void moveToDay(struct UserReport *user, const int64_t time);
+
+/**
+ * @brief Prints the day being summed, if anything happened on it, and adds it to the user's totals.
+ *
+ * @param user The user being reported.
+ */
+static void finishDay(struct UserReport *user);
+
+/**
+ * @brief Prints one row of the report.
+ *
+ * @param rowType day, user or period.
+ * @param user The user, or NULL for the period row.
+ * @param date The date of a day row, or NULL.
+ * @param totals The totals to print.
+ */
+static void printReportRow(const char *rowType, const struct UserReport *user, const char *date,
+                           const struct ReportTotals *totals);
+
+/**
+ * @brief Prints a CSV field, quoted if it has to be.
+ *
+ * @param text The field, NULL prints nothing.
+ */
+static void printCSVField(const char *text);
+
+/**
+ * @brief Finds the local midnight that starts the day of the time, or a day after it.
+ *
+ * @param time Time in microseconds since the Unix epoch.
+ * @param dayOffset 0 for the day of the time, 1 for the next day, and so on.
+ *
+ * @return int64_t The local midnight in microseconds since the Unix epoch.
+ */
+static int64_t startOfLocalDay(const int64_t time, const int dayOffset);
+
+/**
+ * @brief Reads a YYYY-MM-DD date as the local midnight that starts it.
+ *
+ * @param text The date.
+ * @param time Pointer to the midnight in microseconds since the Unix epoch.
+ *
+ * @return true If the date was valid.
+ * @return false If it wasn't.
+ */
+static bool parseDate(const char *text, int64_t *time);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+int main(int argc, char **argv)
+{
+    const char *databasePath = DATABASE_FILEPATH;
+    struct Report report = { 0 };
+    double maxShiftHours = DEFAULT_MAX_SHIFT_HOURS;
+    bool fromGiven = false;
+    bool toGiven = false;
+    bool argumentsValid = true;
+
+    report.now = getCurrentTimeInMicroseconds();
+    report.unmatchedIn = UNMATCHED_IN_DROP;
+    report.pageSize = DEFAULT_PAGE_SIZE;
+
+    for (int index = 1; index < argc && argumentsValid; index++)
+    {
+        bool hasValue = index + 1 < argc;
+
+        if (strcmp(argv[index], "--from") == 0 && hasValue)
+        {
+            argumentsValid = parseDate(argv[++index], &report.start);
+            fromGiven = true;
+        }
+
+        else if (strcmp(argv[index], "--to") == 0 && hasValue)
+        {
+            // The period ends at the midnight after the last day.
+            argumentsValid = parseDate(argv[++index], &report.end);
+            report.end = startOfLocalDay(report.end, 1);
+            toGiven = true;
+        }
+
+        else if (strcmp(argv[index], "--unmatched-in") == 0 && hasValue)
+        {
+            const char *policy = argv[++index];
+
+            if (strcmp(policy, "drop") == 0)            report.unmatchedIn = UNMATCHED_IN_DROP;
+            else if (strcmp(policy, "end-of-day") == 0) report.unmatchedIn = UNMATCHED_IN_END_OF_DAY;
+            else if (strcmp(policy, "cap") == 0)        report.unmatchedIn = UNMATCHED_IN_CAP;
+            else                                        argumentsValid = false;
+        }
+
+        else if (strcmp(argv[index], "--max-shift-hours") == 0 && hasValue)
+        {
+            maxShiftHours = atof(argv[++index]);
+        }
+
+        else if (strcmp(argv[index], "--page-size") == 0 && hasValue)
+        {
+            report.pageSize = atoi(argv[++index]);
+        }
+
+        else if (strcmp(argv[index], "--database") == 0 && hasValue)
+        {
+            databasePath = argv[++index];
+        }
+
+        else
+        {
+            argumentsValid = false;
+        }
+    }
+
+    // By default the current month so far.
+    if (!fromGiven)
+    {
+        time_t seconds = (time_t)(report.now / MICROSECONDS_PER_SECOND);
+        struct tm date;
+        localtime_r(&seconds, &date);
+        date.tm_mday = 1;
+        date.tm_hour = date.tm_min = date.tm_sec = 0;
+        date.tm_isdst = -1;
+        report.start = (int64_t)mktime(&date) * MICROSECONDS_PER_SECOND;
+    }
+
+    if (!toGiven)
+    {
+        report.end = startOfLocalDay(report.now, 1);
+    }
+
+    if (!argumentsValid || report.start >= report.end || report.pageSize < 1 ||
+        maxShiftHours <= 0.0 || maxShiftHours > MAX_SHIFT_HOURS_LIMIT)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    report.maxShift = (int64_t)(maxShiftHours * MICROSECONDS_PER_HOUR);
+
+    struct DatabaseConfig databaseConfig;
+    setDatabaseToolSettings(&databaseConfig.settings);
+
+    if (!openDatabaseConnection(&databaseConfig, databasePath))
+    {
+        return 1;
+    }
+
+    // A shift that crosses the start or end of the period is at most maxShift long,
+    // so rows that far outside the period are read too, and only the part inside is counted.
+    int64_t readFrom = report.start - report.maxShift;
+    int64_t readTo = report.end + report.maxShift;
+
+    char schemaNames[MAX_REPORT_SOURCES][SCHEMA_NAME_MAX_LENGTH];
+    int schemaCount = 0;
+    bool reported = false;
+
+    double startTime = getCurrentTimeInSeconds();
+
+    if (attachReportSources(&databaseConfig, readFrom, readTo, schemaNames, &schemaCount) &&
+        prepareCompoundStatement(databaseConfig.database, SELECT_NEXT_LOG_USER_ID_START, SELECT_NEXT_LOG_USER_ID_PART_FORMAT,
+                                 SELECT_NEXT_LOG_USER_ID_SEPARATOR, SELECT_NEXT_LOG_USER_ID_END, schemaNames, schemaCount,
+                                 &report.nextUserStatement) &&
+        prepareCompoundStatement(databaseConfig.database, SELECT_USERS_LOG_PAGE_START, SELECT_USERS_LOG_PAGE_PART_FORMAT,
+                                 SELECT_USERS_LOG_PAGE_SEPARATOR, SELECT_USERS_LOG_PAGE_END, schemaNames, schemaCount,
+                                 &report.pageStatement) &&
+        sqlite3_prepare_v2(databaseConfig.database, SELECT_USER_NAMES_BY_ID, -1, &report.namesStatement, 0) == SQLITE_OK)
+    {
+        sqlite3_bind_int64(report.pageStatement, 2, readFrom);
+        sqlite3_bind_int64(report.pageStatement, 3, readTo);
+        sqlite3_bind_int(report.pageStatement, 7, report.pageSize);
+
+        printf("row_type,user_id,first_name,last_name,date,hours,unmatched_in,unmatched_out\n");
+
+        int userID = 0;
+        bool found = true;
+        reported = true;
+
+        while (reported && found)
+        {
+            reported = selectNextUserID(&report, userID, &userID, &found);
+
+            if (reported && found)
+            {
+                reported = reportUser(&report, userID);
+            }
+        }
+
+        if (reported)
+        {
+            printReportRow("period", NULL, NULL, &report.total);
+        }
+    }
+
+    else
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(databaseConfig.database));
+    }
+
+    fprintf(stderr, "%lu log row(s) of %lu user(s) from %d file(s) read in %.2f seconds.\n",
+            report.rowCount, report.userCount, schemaCount, getCurrentTimeInSeconds() - startTime);
+
+    sqlite3_finalize(report.nextUserStatement);
+    sqlite3_finalize(report.pageStatement);
+    sqlite3_finalize(report.namesStatement);
+
+    // main is not attached.
+    for (int index = 1; index < schemaCount; index++)
+    {
+        detachLogArchive(&databaseConfig, schemaNames[index]);
+    }
+
+    cleanupDatabase(&databaseConfig);
+
+    return reported ? 0 : 1;
+}
+
+
+
+static bool attachReportSources(struct DatabaseConfig *databaseConfig, const int64_t from, const int64_t to,
+                                char schemaNames[][SCHEMA_NAME_MAX_LENGTH], int *schemaCount)
+{
+    snprintf(schemaNames[0], SCHEMA_NAME_MAX_LENGTH, "main");
+    *schemaCount = 1;
+
+    // SQLite is usually built to allow 10 attached files, so a report can cover about that many archived months.
+    int maxSources = sqlite3_limit(databaseConfig->database, SQLITE_LIMIT_ATTACHED, -1) + 1;
+
+    if (maxSources > MAX_REPORT_SOURCES)
+    {
+        maxSources = MAX_REPORT_SOURCES;
+    }
+
+    time_t seconds = (time_t)(from / MICROSECONDS_PER_SECOND);
+    struct tm date;
+    localtime_r(&seconds, &date);
+
+    int year = date.tm_year + 1900;
+    int month = date.tm_mon + 1;
+
+    seconds = (time_t)((to - 1) / MICROSECONDS_PER_SECOND);
+    localtime_r(&seconds, &date);
+
+    int lastYear = date.tm_year + 1900;
+    int lastMonth = date.tm_mon + 1;
+
+    while (year < lastYear || (year == lastYear && month <= lastMonth))
+    {
+        char schemaName[SCHEMA_NAME_MAX_LENGTH];
+        snprintf(schemaName, sizeof(schemaName), ARCHIVE_SCHEMA_NAME_FORMAT, year, month);
+
+        if (*schemaCount >= maxSources)
+        {
+            fprintf(stderr, "The period needs more than %d archived months, report a shorter period.\n", maxSources - 1);
+
+            return false;
+        }
+
+        // Months that were never archived have no file, their rows are still in main.
+        if (attachLogArchive(databaseConfig, year, month, schemaName))
+        {
+            snprintf(schemaNames[*schemaCount], SCHEMA_NAME_MAX_LENGTH, "%s", schemaName);
+            (*schemaCount)++;
+        }
+
+        month++;
+
+        if (month > 12)
+        {
+            month = 1;
+            year++;
+        }
+    }
+
+    return true;
+}
+
+static bool prepareCompoundStatement(sqlite3 *database, const char *start, const char *partFormat, const char *separator,
+                                     const char *end, char schemaNames[][SCHEMA_NAME_MAX_LENGTH], const int schemaCount,
+                                     sqlite3_stmt **statement)
+{
+    size_t partLength = strlen(partFormat) + SCHEMA_NAME_MAX_LENGTH + strlen(separator);
+    size_t sqlLength = strlen(start) + partLength * schemaCount + strlen(end) + 1;
+    char *sql = malloc(sqlLength);
+
+    if (sql == NULL)
+    {
+        return false;
+    }
+
+    size_t length = (size_t)snprintf(sql, sqlLength, "%s", start);
+
+    for (int index = 0; index < schemaCount; index++)
+    {
+        if (index > 0)
+        {
+            length += (size_t)snprintf(sql + length, sqlLength - length, "%s", separator);
+        }
+
+        length += (size_t)snprintf(sql + length, sqlLength - length, partFormat, schemaNames[index]);
+    }
+
+    snprintf(sql + length, sqlLength - length, "%s", end);
+
+    bool prepared = sqlite3_prepare_v2(database, sql, -1, statement, 0) == SQLITE_OK;
+    free(sql);
+
+    return prepared;
+}
+
+static bool selectNextUserID(struct Report *report, const int afterUserID, int *userID, bool *found)
+{
+    sqlite3_stmt *statement = report->nextUserStatement;
+    sqlite3_bind_int(statement, 1, afterUserID);
+
+    int resultCode = sqlite3_step(statement);
+
+    // MIN() of no rows is NULL.
+    *found = (resultCode == SQLITE_ROW && sqlite3_column_type(statement, 0) != SQLITE_NULL);
+
+    if (*found)
+    {
+        *userID = sqlite3_column_int(statement, 0);
+    }
+
+    // Resetting ends the read transaction.
+    sqlite3_reset(statement);
+
+    if (resultCode != SQLITE_ROW)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+
+        return false;
+    }
+
+    return true;
+}
+
+static bool reportUser(struct Report *report, const int userID)
+{
+    struct UserReport user = { .userID = userID };
+
+    if (!selectUserNames(report, &user))
+    {
+        return false;
+    }
+
+    sqlite3_stmt *statement = report->pageStatement;
+    sqlite3_bind_int(statement, 1, userID);
+
+    // Where the next page continues from. The first page starts before every row.
+    sqlite3_int64 lastTime = INT64_MIN;
+    int lastStatus = 0;
+    sqlite3_int64 lastID = 0;
+    int rowsInPage = report->pageSize;
+    bool read = true;
+
+    // A page that isn't full is the last one.
+    while (read && rowsInPage == report->pageSize)
+    {
+        sqlite3_bind_int64(statement, 4, lastTime);
+        sqlite3_bind_int(statement, 5, lastStatus);
+        sqlite3_bind_int64(statement, 6, lastID);
+
+        rowsInPage = 0;
+        int resultCode;
+
+        while ((resultCode = sqlite3_step(statement)) == SQLITE_ROW)
+        {
+            lastTime = sqlite3_column_int64(statement, 0);
+            lastStatus = sqlite3_column_int(statement, 1);
+            lastID = sqlite3_column_int64(statement, 2);
+
+            processLogRow(report, &user, lastTime, lastStatus);
+            rowsInPage++;
+        }
+
+        if (resultCode != SQLITE_DONE)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+            read = false;
+        }
+
+        // Each page is its own read transaction, so the device's checkpoints aren't held back by the report.
+        sqlite3_reset(statement);
+        report->rowCount += (unsigned long)rowsInPage;
+    }
+
+    if (read)
+    {
+        // Still IN after the last row: a shift in progress, or a forgotten OUT.
+        if (user.clockedIn)
+        {
+            closeUnmatchedIn(report, &user, report->now);
+        }
+
+        finishDay(&user);
+
+        if (user.total.worked > 0 || user.total.unmatchedIn > 0 || user.total.unmatchedOut > 0)
+        {
+            printReportRow("user", &user, NULL, &user.total);
+
+            report->total.worked += user.total.worked;
+            report->total.unmatchedIn += user.total.unmatchedIn;
+            report->total.unmatchedOut += user.total.unmatchedOut;
+            report->userCount++;
+        }
+    }
+
+    free(user.firstName);
+    free(user.lastName);
+
+    return read;
+}
+
+static bool selectUserNames(struct Report *report, struct UserReport *user)
+{
+    sqlite3_stmt *statement = report->namesStatement;
+    sqlite3_bind_int(statement, 1, user->userID);
+
+    int resultCode = sqlite3_step(statement);
+
+    if (resultCode == SQLITE_ROW)
+    {
+        user->firstName = strdup((const char *)sqlite3_column_text(statement, 0));
+        user->lastName = strdup((const char *)sqlite3_column_text(statement, 1));
+    }
+
+    sqlite3_reset(statement);
+
+    if (resultCode != SQLITE_ROW && resultCode != SQLITE_DONE)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(sqlite3_db_handle(statement)));
+
+        return false;
+    }
+
+    return true;
+}
+
+static void processLogRow(struct Report *report, struct UserReport *user, const int64_t time, const int status)
+{
+    if (status == LOG_STATUS_IN)
+    {
+        // The device doesn't allow two INs in a row, but rows edited by hand can have them.
+        if (user->clockedIn)
+        {
+            closeUnmatchedIn(report, user, time);
+        }
+
+        user->clockedIn = true;
+        user->inTime = time;
+
+        return;
+    }
+
+    if (status != LOG_STATUS_OUT)
+    {
+        return;
+    }
+
+    if (!user->clockedIn)
+    {
+        // Rows outside the period are only read for shifts crossing its start or end.
+        if (time >= report->start && time < report->end)
+        {
+            moveToDay(user, time);
+            user->day.unmatchedOut++;
+        }
+
+        return;
+    }
+
+    // A forgotten OUT shows up as one very long shift, ended when the user next clocked out.
+    if (time - user->inTime > report->maxShift)
+    {
+        closeUnmatchedIn(report, user, time);
+    }
+
+    else
+    {
+        addWorkedTime(report, user, user->inTime, time);
+    }
+
+    user->clockedIn = false;
+}
+
+static void closeUnmatchedIn(struct Report *report, struct UserReport *user, const int64_t limit)
+{
+    user->clockedIn = false;
+
+    if (user->inTime < report->start || user->inTime >= report->end)
+    {
+        return;
+    }
+
+    moveToDay(user, user->inTime);
+    user->day.unmatchedIn++;
+
+    int64_t end = user->inTime;
+
+    switch (report->unmatchedIn)
+    {
+        case UNMATCHED_IN_DROP:       break;
+        case UNMATCHED_IN_END_OF_DAY: end = user->dayEnd;                     break;
+        case UNMATCHED_IN_CAP:        end = user->inTime + report->maxShift;  break;
+    }
+
+    addWorkedTime(report, user, user->inTime, end < limit ? end : limit);
+}
+
+static void addWorkedTime(struct Report *report, struct UserReport *user, int64_t from, int64_t to)
+{
+    if (from < report->start)
+    {
+        from = report->start;
+    }
+
+    if (to > report->end)
+    {
+        to = report->end;
+    }
+
+    // Split at every midnight the time crosses.
+    while (from < to)
+    {
+        moveToDay(user, from);
+
+        int64_t pieceEnd = to < user->dayEnd ? to : user->dayEnd;
+        user->day.worked += pieceEnd - from;
+        from = pieceEnd;
+    }
+}
+
+static void moveToDay(struct UserReport *user, const int64_t time)
+{
+    if (time >= user->dayStart && time < user->dayEnd)
+    {
+        return;
+    }
+
+    finishDay(user);
+
+    user->dayStart = startOfLocalDay(time, 0);
+    user->dayEnd = startOfLocalDay(time, 1);
+}
+
+static void finishDay(struct UserReport *user)
+{
+    if (user->day.worked > 0 || user->day.unmatchedIn > 0 || user->day.unmatchedOut > 0)
+    {
+        char date[sizeof("YYYY-MM-DD")];
+        time_t seconds = (time_t)(user->dayStart / MICROSECONDS_PER_SECOND);
+        struct tm localDate;
+        localtime_r(&seconds, &localDate);
+        strftime(date, sizeof(date), "%Y-%m-%d", &localDate);
+
+        printReportRow("day", user, date, &user->day);
+
+        user->total.worked += user->day.worked;
+        user->total.unmatchedIn += user->day.unmatchedIn;
+        user->total.unmatchedOut += user->day.unmatchedOut;
+    }
+
+    user->day = (struct ReportTotals){ 0 };
+}
+
+static void printReportRow(const char *rowType, const struct UserReport *user, const char *date,
+                           const struct ReportTotals *totals)
+{
+    printf("%s,", rowType);
+
+    if (user != NULL)
+    {
+        printf("%d,", user->userID);
+        printCSVField(user->firstName);
+        printf(",");
+        printCSVField(user->lastName);
+        printf(",");
+    }
+
+    else
+    {
+        printf(",,,");
+    }
+
+    printCSVField(date);
+    printf(",%.2f,%lu,%lu\n", (double)totals->worked / MICROSECONDS_PER_HOUR, totals->unmatchedIn, totals->unmatchedOut);
+}
+
+static void printCSVField(const char *text)
+{
+    if (text == NULL)
+    {
+        return;
+    }
+
+    if (strpbrk(text, ",\"\r\n") == NULL)
+    {
+        fputs(text, stdout);
+
+        return;
+    }
+
+    putchar('"');
+
+    for (const char *character = text; *character != '\0'; character++)
+    {
+        // A quote inside a quoted field is written twice.
+        if (*character == '"')
+        {
+            putchar('"');
+        }
+
+        putchar(*character);
+    }
+
+    putchar('"');
+}
+
+static int64_t startOfLocalDay(const int64_t time, const int dayOffset)
+{
+    time_t seconds = (time_t)(time / MICROSECONDS_PER_SECOND);
+    struct tm date;
+    localtime_r(&seconds, &date);
+
+    // mktime() normalizes the day past the end of the month, and finds whether DST is on at midnight.
+    date.tm_mday += dayOffset;
+    date.tm_hour = date.tm_min = date.tm_sec = 0;
+    date.tm_isdst = -1;
+
+    return (int64_t)mktime(&date) * MICROSECONDS_PER_SECOND;
+}
+
+static bool parseDate(const char *text, int64_t *time)
+{
+    int year, month, day;
+    char extra;
+
+    if (sscanf(text, "%4d-%2d-%2d%c", &year, &month, &day, &extra) != 3)
+    {
+        return false;
+    }
+
+    struct tm date = { .tm_year = year - 1900, .tm_mon = month - 1, .tm_mday = day, .tm_isdst = -1 };
+    time_t seconds = mktime(&date);
+
+    // mktime() turns dates like 2024-02-30 into real ones, which changes them.
+    if (seconds == (time_t)-1 || date.tm_year != year - 1900 || date.tm_mon != month - 1 || date.tm_mday != day)
+    {
+        return false;
+    }
+
+    *time = (int64_t)seconds * MICROSECONDS_PER_SECOND;
+
+    return true;
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--unmatched-in drop|end-of-day|cap]\n", programName);
+    fprintf(stderr, "          [--max-shift-hours H] [--page-size N] [--database FILE]\n");
+    fprintf(stderr, "  --from YYYY-MM-DD     First day of the period. Default the first day of this month.\n");
+    fprintf(stderr, "  --to YYYY-MM-DD       Last day of the period. Default today.\n");
+    fprintf(stderr, "  --unmatched-in POLICY How an IN without an OUT within the longest shift is counted:\n");
+    fprintf(stderr, "                        drop (default) not at all, end-of-day until midnight, cap as the longest shift.\n");
+    fprintf(stderr, "  --max-shift-hours H   Longest shift, up to %.0f. Default %.0f.\n", MAX_SHIFT_HOURS_LIMIT,
+            DEFAULT_MAX_SHIFT_HOURS);
+    fprintf(stderr, "  --page-size N         Log rows read per query. Default %d.\n", DEFAULT_PAGE_SIZE);
+    fprintf(stderr, "  --database FILE       Database file. Default %s.\n", DATABASE_FILEPATH);
+}
@@ -0,0 +1,586 @@
+/**
+ * @file clock_shipper.c
+ * @author Selkamies
+ *
+ * @brief Command line tool that sends the clock event journal to a central server over HTTP.
+ *
+ * Usage: clock_shipper --endpoint http://HOST[:PORT]/PATH [--journal DIR] [--batch-size N] [--interval SECONDS] [--once]
+ *
+ * Runs next to clock_in as its own process, so a slow or unreachable server never holds up the keypad.
+ * It reads the records after the last acknowledged one straight from the segment files and POSTs them
+ * as they are, JOURNAL_RECORD_SIZE bytes each, with Content-Type application/octet-stream and the sequence
+ * number of the first record in the X-Journal-First-Sequence header. Any 2xx response acknowledges the
+ * whole batch: its last sequence number is saved to the ack file and fully shipped segments are removed.
+ *
+ * If the shipper is stopped between a POST and saving the ack, the batch is sent again on the next run,
+ * so the server has to ignore records it already has. terminalID and logID identify a row.
+ * Failed POSTs are retried with a growing delay, up to a minute.
+ *
+ * @date Created  2024-01-19
+ * @date Modified 2024-01-19
+ *
+ * @copyright Copyright (c) 2024
+ */
+
+
+
+#include <stdio.h>              // printf(), fprintf(), snprintf().
+#include <stdlib.h>             // atoi(), strtod(), malloc(), free().
+#include <string.h>             // strcmp(), strncmp(), strchr(), memchr(), strlen().
+#include <stdbool.h>
+#include <stdint.h>             // uint64_t.
+#include <signal.h>             // sigaction(), SIGINT, SIGTERM.
+#include <time.h>               // nanosleep().
+#include <fcntl.h>              // open().
+#include <unistd.h>             // pread(), close(), unlink().
+#include <dirent.h>             // opendir(), readdir(), closedir().
+#include <netdb.h>              // getaddrinfo(), freeaddrinfo().
+#include <sys/socket.h>         // socket(), connect(), send(), recv(), setsockopt().
+#include <sys/time.h>           // struct timeval.
+
+#include "journal.h"            // struct JournalRecord, readJournalAck(), saveJournalAck(), etc.
+
+
+
+/** @brief Journal folder if --journal is not given. The same as the default in config.ini. */
+#define DEFAULT_JOURNAL_DIRECTORY "journal"
+/** @brief Records sent per POST if --batch-size is not given. */
+#define DEFAULT_BATCH_SIZE 1000
+/** @brief Most records sent per POST. Keeps a request at a few hundred kilobytes. */
+#define MAX_BATCH_SIZE 10000
+/** @brief Seconds between checks for new records if --interval is not given. */
+#define DEFAULT_INTERVAL_SECONDS 1.0
+/** @brief Longest wait between retries after failed POSTs. */
+#define MAX_RETRY_DELAY_SECONDS 60.0
+/** @brief How long a connect, send or receive may take before the POST fails. */
+#define SOCKET_TIMEOUT_SECONDS 10
+
+#define ENDPOINT_HOST_LENGTH 256
+#define ENDPOINT_PORT_LENGTH 8
+#define ENDPOINT_PATH_LENGTH 1024
+
+
+
+/**
+ * @brief Where the records are POSTed, parsed from --endpoint.
+ */
+struct Endpoint
+{
+    char host[ENDPOINT_HOST_LENGTH];
+    char port[ENDPOINT_PORT_LENGTH];
+    /** @brief Path and query, starting with /. */
+    char path[ENDPOINT_PATH_LENGTH];
+};
+
+
+
+/** @brief Set by SIGINT and SIGTERM to stop after the current POST. */
+static volatile sig_atomic_t stopRequested = 0;
+
+
+
+#pragma region FunctionDeclarations
+
+/**
+ * @brief Parses an http:// URL. https is not supported, put a local TLS proxy in front if it's needed.
+ *
+ * @param url The URL.
+ * @param endpoint Pointer to the endpoint we're looking to get.
+ *
+ * @return true If the URL is valid.
+ * @return false If it isn't.
+ */
+static bool parseEndpoint(const char *url, struct Endpoint *endpoint);
+
+/**
+ * @brief Reads consecutive valid records starting from a sequence number, at most to the end of its segment.
+ *
+ * @param directory The journal folder.
+ * @param firstSequence Sequence number of the first record to read.
+ * @param records Array the records are read to.
+ * @param maxRecords Length of the array.
+ * @param recordCount Pointer to the number of records read. 0 if the record hasn't been written yet.
+ *
+ * @return true If the segment could be read, even if there were no new records.
+ * @return false If the segment file is missing or can't be read.
+ */
+static bool readRecords(const char *directory, const uint64_t firstSequence, struct JournalRecord *records,
+                        const int maxRecords, int *recordCount);
+
+/**
+ * @brief POSTs records to the endpoint and waits for the response.
+ *
+ * @param endpoint Where to POST.
+ * @param records The records.
+ * @param recordCount Number of records.
+ * @param statusCode Pointer to the HTTP status code of the response. 0 if there was no response.
+ *
+ * @return true If the server answered with a 2xx status.
+ * @return false If the POST failed or the server answered with anything else.
+ */
+static bool postRecords(const struct Endpoint *endpoint, const struct JournalRecord *records, const int recordCount,
+                        int *statusCode);
+
+/**
+ * @brief Sends the whole buffer, however many send() calls it takes.
+ *
+ * @param socketDescriptor The connected socket.
+ * @param buffer Data to send.
+ * @param length Length of the data in bytes.
+ *
+ * @return true If everything was sent.
+ * @return false If the connection failed or timed out.
+ */
+static bool sendAll(const int socketDescriptor, const void *buffer, size_t length);
+
+/**
+ * @brief Removes segment files whose every record has been acknowledged. The latest segment is always kept,
+ * clock_in reads its last record on start.
+ *
+ * @param directory The journal folder.
+ * @param ackedSequence Sequence number of the last acknowledged record.
+ */
+static void removeShippedSegments(const char *directory, const uint64_t ackedSequence);
+
+/**
+ * @brief Sleeps, returning early if the shipper is asked to stop.
+ *
+ * @param seconds How long to sleep.
+ */
+static void sleepSeconds(const double seconds);
+
+/**
+ * @brief Asks the main loop to stop.
+ *
+ * @param signalNumber The signal, SIGINT or SIGTERM.
+ */
+static void handleStopSignal(int signalNumber);
+
+/**
+ * @brief Prints how to use the program.
+ *
+ * @param programName Name the program was started with.
+ */
+static void printUsage(const char *programName);
+
+#pragma endregion // FunctionDeclarations
+
+
+
+int main(int argc, char **argv)
+{
+    const char *endpointURL = NULL;
+    const char *directory = DEFAULT_JOURNAL_DIRECTORY;
+    int batchSize = DEFAULT_BATCH_SIZE;
+    double interval = DEFAULT_INTERVAL_SECONDS;
+    bool once = false;
+    bool argumentsValid = true;
+
+    for (int index = 1; index < argc && argumentsValid; index++)
+    {
+        bool hasValue = index + 1 < argc;
+
+        if (strcmp(argv[index], "--endpoint") == 0 && hasValue)
+        {
+            endpointURL = argv[++index];
+        }
+
+        else if (strcmp(argv[index], "--journal") == 0 && hasValue)
+        {
+            directory = argv[++index];
+        }
+
+        else if (strcmp(argv[index], "--batch-size") == 0 && hasValue)
+        {
+            batchSize = atoi(argv[++index]);
+        }
+
+        else if (strcmp(argv[index], "--interval") == 0 && hasValue)
+        {
+            interval = strtod(argv[++index], NULL);
+        }
+
+        else if (strcmp(argv[index], "--once") == 0)
+        {
+            once = true;
+        }
+
+        else
+        {
+            argumentsValid = false;
+        }
+    }
+
+    struct Endpoint endpoint;
+
+    if (!argumentsValid || endpointURL == NULL || batchSize < 1 || batchSize > MAX_BATCH_SIZE || interval <= 0.0 ||
+        strlen(directory) > JOURNAL_MAX_DIRECTORY_LENGTH)
+    {
+        printUsage(argv[0]);
+
+        return 1;
+    }
+
+    if (!parseEndpoint(endpointURL, &endpoint))
+    {
+        fprintf(stderr, "Invalid endpoint %s, it has to look like http://host[:port]/path.\n", endpointURL);
+
+        return 1;
+    }
+
+    struct JournalRecord *records = malloc(sizeof(struct JournalRecord) * (size_t)batchSize);
+
+    if (records == NULL)
+    {
+        return 1;
+    }
+
+    // No SA_RESTART, so a signal also cuts short a sleep or a blocking socket call.
+    struct sigaction stopAction = { .sa_handler = handleStopSignal };
+    sigemptyset(&stopAction.sa_mask);
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+
+    uint64_t ackedSequence = 0;
+    readJournalAck(directory, &ackedSequence);
+
+    printf("Shipping journal %s to %s, starting after record %llu.\n", directory, endpointURL,
+           (unsigned long long)ackedSequence);
+
+    double retryDelay = interval;
+    unsigned long shippedCount = 0;
+    bool failed = false;
+
+    while (!stopRequested)
+    {
+        int recordCount = 0;
+
+        // A missing segment means clock_in hasn't written that far yet, like an empty slot.
+        if (!readRecords(directory, ackedSequence + 1, records, batchSize, &recordCount) || recordCount == 0)
+        {
+            if (once)
+            {
+                break;
+            }
+
+            sleepSeconds(interval);
+
+            continue;
+        }
+
+        int statusCode = 0;
+
+        if (!postRecords(&endpoint, records, recordCount, &statusCode))
+        {
+            if (statusCode != 0)
+            {
+                fprintf(stderr, "%s answered %d, retrying in %.1f seconds.\n", endpointURL, statusCode, retryDelay);
+            }
+
+            else
+            {
+                fprintf(stderr, "Could not POST to %s, retrying in %.1f seconds.\n", endpointURL, retryDelay);
+            }
+
+            if (once)
+            {
+                failed = true;
+
+                break;
+            }
+
+            sleepSeconds(retryDelay);
+            retryDelay = retryDelay * 2.0 < MAX_RETRY_DELAY_SECONDS ? retryDelay * 2.0 : MAX_RETRY_DELAY_SECONDS;
+
+            continue;
+        }
+
+        ackedSequence += (uint64_t)recordCount;
+        shippedCount += (unsigned long)recordCount;
+        retryDelay = interval;
+
+        // If this fails the batch is sent again later, which the server ignores.
+        if (!saveJournalAck(directory, ackedSequence))
+        {
+            fprintf(stderr, "Could not save the ack file in %s.\n", directory);
+        }
+
+        removeShippedSegments(directory, ackedSequence);
+        printf("%d record(s) shipped, up to record %llu.\n", recordCount, (unsigned long long)ackedSequence);
+    }
+
+    printf("%lu record(s) shipped in total.\n", shippedCount);
+
+    free(records);
+
+    return failed ? 1 : 0;
+}
+
+
+
+static bool parseEndpoint(const char *url, struct Endpoint *endpoint)
+{
+    const char *scheme = "http://";
+
+    if (strncmp(url, scheme, strlen(scheme)) != 0)
+    {
+        return false;
+    }
+
+    const char *host = url + strlen(scheme);
+    const char *path = strchr(host, '/');
+    const char *hostEnd = path != NULL ? path : host + strlen(host);
+    const char *portStart = memchr(host, ':', (size_t)(hostEnd - host));
+    size_t hostLength = (size_t)((portStart != NULL ? portStart : hostEnd) - host);
+
+    if (hostLength == 0 || hostLength >= sizeof(endpoint->host))
+    {
+        return false;
+    }
+
+    snprintf(endpoint->host, sizeof(endpoint->host), "%.*s", (int)hostLength, host);
+
+    if (portStart != NULL)
+    {
+        size_t portLength = (size_t)(hostEnd - portStart - 1);
+
+        if (portLength == 0 || portLength >= sizeof(endpoint->port))
+        {
+            return false;
+        }
+
+        snprintf(endpoint->port, sizeof(endpoint->port), "%.*s", (int)portLength, portStart + 1);
+    }
+
+    else
+    {
+        snprintf(endpoint->port, sizeof(endpoint->port), "80");
+    }
+
+    snprintf(endpoint->path, sizeof(endpoint->path), "%s", path != NULL ? path : "/");
+
+    return path == NULL || strlen(path) < sizeof(endpoint->path);
+}
+
+static bool readRecords(const char *directory, const uint64_t firstSequence, struct JournalRecord *records,
+                        const int maxRecords, int *recordCount)
+{
+    *recordCount = 0;
+
+    uint64_t segmentIndex = (firstSequence - 1) / JOURNAL_SEGMENT_RECORDS;
+    uint64_t slot = (firstSequence - 1) % JOURNAL_SEGMENT_RECORDS;
+    uint64_t slotsLeft = JOURNAL_SEGMENT_RECORDS - slot;
+    size_t readCount = (uint64_t)maxRecords < slotsLeft ? (size_t)maxRecords : (size_t)slotsLeft;
+
+    char filePath[JOURNAL_PATH_LENGTH];
+    formatJournalSegmentPath(filePath, sizeof(filePath), directory, segmentIndex);
+
+    int fileDescriptor = open(filePath, O_RDONLY);
+
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    // One read for the whole batch. The page cache shares the pages clock_in has mapped, so this sees its writes.
+    ssize_t readBytes = pread(fileDescriptor, records, readCount * JOURNAL_RECORD_SIZE, (off_t)(slot * JOURNAL_RECORD_SIZE));
+    close(fileDescriptor);
+
+    if (readBytes < 0)
+    {
+        return false;
+    }
+
+    int readRecordCount = (int)((size_t)readBytes / JOURNAL_RECORD_SIZE);
+
+    // Records are written in order, the first one that isn't valid yet ends the batch.
+    while (*recordCount < readRecordCount &&
+           isValidJournalRecord(&records[*recordCount], firstSequence + (uint64_t)*recordCount))
+    {
+        (*recordCount)++;
+    }
+
+    return true;
+}
+
+static bool postRecords(const struct Endpoint *endpoint, const struct JournalRecord *records, const int recordCount,
+                        int *statusCode)
+{
+    *statusCode = 0;
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addresses = NULL;
+
+    if (getaddrinfo(endpoint->host, endpoint->port, &hints, &addresses) != 0)
+    {
+        return false;
+    }
+
+    int socketDescriptor = -1;
+    struct timeval timeout = { .tv_sec = SOCKET_TIMEOUT_SECONDS, .tv_usec = 0 };
+
+    for (struct addrinfo *address = addresses; address != NULL && socketDescriptor < 0; address = address->ai_next)
+    {
+        socketDescriptor = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+
+        if (socketDescriptor < 0)
+        {
+            continue;
+        }
+
+        // On Linux the send timeout also limits connect().
+        setsockopt(socketDescriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(socketDescriptor, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        if (connect(socketDescriptor, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            close(socketDescriptor);
+            socketDescriptor = -1;
+        }
+    }
+
+    freeaddrinfo(addresses);
+
+    if (socketDescriptor < 0)
+    {
+        return false;
+    }
+
+    size_t bodyLength = (size_t)recordCount * JOURNAL_RECORD_SIZE;
+    char header[ENDPOINT_PATH_LENGTH + ENDPOINT_HOST_LENGTH + 256];
+    int headerLength = snprintf(header, sizeof(header),
+                                "POST %s HTTP/1.1\r\n"
+                                "Host: %s:%s\r\n"
+                                "Content-Type: application/octet-stream\r\n"
+                                "Content-Length: %zu\r\n"
+                                "X-Journal-First-Sequence: %llu\r\n"
+                                "X-Journal-Record-Size: %d\r\n"
+                                "Connection: close\r\n"
+                                "\r\n",
+                                endpoint->path, endpoint->host, endpoint->port, bodyLength,
+                                (unsigned long long)records[0].sequence, JOURNAL_RECORD_SIZE);
+
+    bool sent = sendAll(socketDescriptor, header, (size_t)headerLength) && sendAll(socketDescriptor, records, bodyLength);
+
+    // Only the status line matters, like "HTTP/1.1 204 No Content".
+    char response[64] = { 0 };
+    size_t responseLength = 0;
+
+    while (sent && responseLength < sizeof(response) - 1 && strchr(response, '\n') == NULL)
+    {
+        ssize_t received = recv(socketDescriptor, response + responseLength, sizeof(response) - 1 - responseLength, 0);
+
+        if (received <= 0)
+        {
+            break;
+        }
+
+        responseLength += (size_t)received;
+    }
+
+    close(socketDescriptor);
+
+    if (!sent || sscanf(response, "HTTP/%*d.%*d %d", statusCode) != 1)
+    {
+        *statusCode = 0;
+
+        return false;
+    }
+
+    return *statusCode >= 200 && *statusCode < 300;
+}
+
+static bool sendAll(const int socketDescriptor, const void *buffer, size_t length)
+{
+    const char *data = (const char *)buffer;
+
+    while (length > 0)
+    {
+        // MSG_NOSIGNAL, so a server that hangs up early fails the POST instead of killing the process with SIGPIPE.
+        ssize_t sentBytes = send(socketDescriptor, data, length, MSG_NOSIGNAL);
+
+        if (sentBytes <= 0)
+        {
+            return false;
+        }
+
+        data += sentBytes;
+        length -= (size_t)sentBytes;
+    }
+
+    return true;
+}
+
+static void removeShippedSegments(const char *directory, const uint64_t ackedSequence)
+{
+    // Segment i holds sequence numbers up to (i + 1) * JOURNAL_SEGMENT_RECORDS.
+    uint64_t shippedSegmentCount = ackedSequence / JOURNAL_SEGMENT_RECORDS;
+
+    if (shippedSegmentCount == 0)
+    {
+        return;
+    }
+
+    DIR *folder = opendir(directory);
+
+    if (folder == NULL)
+    {
+        return;
+    }
+
+    uint64_t latestIndex = 0;
+    uint64_t index = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(folder)) != NULL)
+    {
+        if (parseJournalSegmentName(entry->d_name, &index) && index > latestIndex)
+        {
+            latestIndex = index;
+        }
+    }
+
+    rewinddir(folder);
+
+    while ((entry = readdir(folder)) != NULL)
+    {
+        if (parseJournalSegmentName(entry->d_name, &index) && index < shippedSegmentCount && index < latestIndex)
+        {
+            char filePath[JOURNAL_PATH_LENGTH];
+            formatJournalSegmentPath(filePath, sizeof(filePath), directory, index);
+
+            if (unlink(filePath) == 0)
+            {
+                printf("Removed shipped segment %s.\n", filePath);
+            }
+        }
+    }
+
+    closedir(folder);
+}
+
+static void sleepSeconds(const double seconds)
+{
+    struct timespec duration = { .tv_sec = (time_t)seconds, .tv_nsec = (long)((seconds - (double)(time_t)seconds) * 1e9) };
+
+    // Returns early with EINTR when a stop signal arrives.
+    nanosleep(&duration, NULL);
+}
+
+static void handleStopSignal(int signalNumber)
+{
+    (void)signalNumber;
+    stopRequested = 1;
+}
+
+static void printUsage(const char *programName)
+{
+    fprintf(stderr, "Usage: %s --endpoint URL [--journal DIR] [--batch-size N] [--interval SECONDS] [--once]\n",
+            programName);
+    fprintf(stderr, "  --endpoint URL     Where the records are POSTed, http://host[:port]/path.\n");
+    fprintf(stderr, "  --journal DIR      Journal folder of clock_in. Default %s.\n", DEFAULT_JOURNAL_DIRECTORY);
+    fprintf(stderr, "  --batch-size N     Most records per POST, up to %d. Default %d.\n", MAX_BATCH_SIZE,
+            DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "  --interval SECONDS Time between checks for new records. Default %.1f.\n", DEFAULT_INTERVAL_SECONDS);
+    fprintf(stderr, "  --once             Ship what's there and exit instead of following the journal.\n");
+}